@@ -0,0 +1,281 @@
+/**
+ * @file CCSDS-Packet.c
+ * @brief Implementation of the CCSDS space packet encoder for LTR-329 samples.
+ * @author Kent Hong
+ *
+ * Samples taken at the nominal period are collected into one packet with a
+ * single timestamp. A late or early sample closes the open packet so the
+ * ground can reconstruct every sample time exactly.
+ *
+ * @note The decoder is shared with the host tools and does not depend on the HAL.
+ */
+
+#include <string.h>
+#include "CCSDS-Packet.h"
+
+
+/** @brief CRC-16/CCITT-FALSE nibble table (polynomial 0x1021) */
+static const uint16_t crcNibbleTable[16] = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+/** @brief Big-endian field helpers */
+static void CCSDS_Put16(uint8_t *dest, uint16_t value) {
+	dest[0] = (uint8_t)(value >> 8);
+	dest[1] = (uint8_t)value;
+}
+
+static void CCSDS_Put32(uint8_t *dest, uint32_t value) {
+	CCSDS_Put16(dest, (uint16_t)(value >> 16));
+	CCSDS_Put16(&dest[2], (uint16_t)value);
+}
+
+static uint16_t CCSDS_Get16(const uint8_t *src) {
+	return (uint16_t)((src[0] << 8) | src[1]);
+}
+
+static uint32_t CCSDS_Get32(const uint8_t *src) {
+	return ((uint32_t)CCSDS_Get16(src) << 16) | CCSDS_Get16(&src[2]);
+}
+
+
+/*****************************************************************
+ * @brief Update a CRC-16/CCITT-FALSE                           *
+ * @param data: Bytes to add                                    *
+ * @param length: Number of bytes                               *
+ * @param crc: Running CRC, 0xFFFF to start                     *
+ * @return Updated CRC                                          *
+ ****************************************************************/
+uint16_t CCSDS_CRC16(const uint8_t *data, uint32_t length, uint16_t crc) {
+
+	for (uint32_t i = 0; i < length; i++) {
+		crc = (uint16_t)((crc << 4) ^ crcNibbleTable[(crc >> 12) ^ (data[i] >> 4)]);
+		crc = (uint16_t)((crc << 4) ^ crcNibbleTable[(crc >> 12) ^ (data[i] & 0x0F)]);
+	}
+
+	return crc;
+}
+
+
+/*****************************************************************
+ * @brief Initialize the packet encoder                         *
+ * @param enc: Pointer to the CCSDS_Encoder_t struct            *
+ * @param apid: Application process identifier (11 bits)        *
+ * @param periodMs: Nominal time between samples                *
+ ****************************************************************/
+void CCSDS_Encoder_Init(CCSDS_Encoder_t *enc, uint16_t apid, uint16_t periodMs) {
+	memset(enc, 0, sizeof(*enc));
+	enc->apid = apid & CCSDS_APID_MASK;
+	enc->periodMs = periodMs;
+}
+
+
+/*****************************************************************
+ * @brief Build a packet around an arbitrary payload            *
+ * @param apid: Application process identifier                  *
+ * @param seqCount: Sequence count for this APID                *
+ * @param tick: Time written to the secondary header (ms)       *
+ * @param periodMs: Period written to the secondary header      *
+ * @param data: Payload placed after the secondary header       *
+ * @param dataLength: Payload length                            *
+ * @param out: Buffer of CCSDS_PACKET_SIZE(0) + dataLength bytes *
+ * @return Packet length                                        *
+ ****************************************************************/
+uint16_t CCSDS_Build_Packet(uint16_t apid, uint16_t seqCount, uint32_t tick, uint16_t periodMs, const uint8_t *data, uint16_t dataLength, uint8_t *out) {
+
+	uint16_t length = CCSDS_PACKET_SIZE(0) + dataLength;
+
+	/* Primary header, the data length field counts the bytes after it minus one */
+	CCSDS_Put16(&out[0], (uint16_t)(CCSDS_SEC_HEADER_FLAG | (apid & CCSDS_APID_MASK)));
+	CCSDS_Put16(&out[2], (uint16_t)(CCSDS_SEQ_FLAGS_STANDALONE | (seqCount & CCSDS_SEQ_COUNT_MASK)));
+	CCSDS_Put16(&out[4], (uint16_t)(length - CCSDS_PRIMARY_HEADER_SIZE - 1));
+
+	/* Secondary header */
+	CCSDS_Put32(&out[6], tick);
+	CCSDS_Put16(&out[10], periodMs);
+
+	memmove(&out[CCSDS_PRIMARY_HEADER_SIZE + CCSDS_SECONDARY_HEADER_SIZE], data, dataLength);
+	CCSDS_Put16(&out[length - CCSDS_CRC_SIZE], CCSDS_CRC16(out, length - CCSDS_CRC_SIZE, 0xFFFF));
+
+	return length;
+}
+
+
+/*****************************************************************
+ * @brief Serialize a sample with its own tick                  *
+ * @param dest: CCSDS_TIMED_SAMPLE_SIZE bytes                   *
+ * @param sample: Sample to serialize                           *
+ ****************************************************************/
+void CCSDS_Put_Timed_Sample(uint8_t *dest, const CCSDS_Sample_t *sample) {
+	CCSDS_Put32(&dest[0], sample->tick);
+	CCSDS_Put16(&dest[4], sample->c0Data);
+	CCSDS_Put16(&dest[6], sample->c1Data);
+	dest[8] = sample->configCode;
+	dest[9] = sample->flags;
+}
+
+
+/*****************************************************************
+ * @brief Deserialize a sample written by CCSDS_Put_Timed_Sample *
+ * @param src: CCSDS_TIMED_SAMPLE_SIZE bytes                    *
+ * @param sample: Pointer to store the sample                   *
+ ****************************************************************/
+void CCSDS_Get_Timed_Sample(const uint8_t *src, CCSDS_Sample_t *sample) {
+	sample->tick = CCSDS_Get32(&src[0]);
+	sample->c0Data = CCSDS_Get16(&src[4]);
+	sample->c1Data = CCSDS_Get16(&src[6]);
+	sample->configCode = src[8];
+	sample->flags = src[9];
+}
+
+
+/*****************************************************************
+ * @brief Close the open packet and copy it out                 *
+ * @param enc: Pointer to the CCSDS_Encoder_t struct            *
+ * @param out: Buffer of at least CCSDS_PACKET_MAX bytes        *
+ * @return Packet length, 0 if no samples were pending          *
+ ****************************************************************/
+uint16_t CCSDS_Encoder_Flush(CCSDS_Encoder_t *enc, uint8_t *out) {
+
+	if (enc->sampleCount == 0) {
+		return 0;
+	}
+
+	uint16_t length = CCSDS_Build_Packet(enc->apid, enc->seqCount, enc->firstTick, enc->periodMs,
+			enc->samples, (uint16_t)(enc->sampleCount * CCSDS_SAMPLE_SIZE), out);
+
+	enc->seqCount = (enc->seqCount + 1) & CCSDS_SEQ_COUNT_MASK;
+	enc->sampleCount = 0;
+
+	return length;
+}
+
+
+/*****************************************************************
+ * @brief Add one sample to the open packet                     *
+ * @param enc: Pointer to the CCSDS_Encoder_t struct            *
+ * @param sample: Sample to add                                 *
+ * @param out: Buffer of at least CCSDS_PACKET_MAX bytes        *
+ * @return Length of a completed packet written to out, else 0  *
+ *                                                              *
+ * A sample more than half a period off the nominal schedule    *
+ * closes the open packet first and starts a new one.           *
+ ****************************************************************/
+uint16_t CCSDS_Encoder_Add(CCSDS_Encoder_t *enc, const CCSDS_Sample_t *sample, uint8_t *out) {
+
+	uint16_t length = 0;
+
+	if (enc->sampleCount != 0) {
+		int32_t offsetMs = (int32_t)(sample->tick - (enc->firstTick + (uint32_t)enc->sampleCount * enc->periodMs));
+		if ((offsetMs > (int32_t)(enc->periodMs / 2)) || (offsetMs < -(int32_t)(enc->periodMs / 2))) {
+			length = CCSDS_Encoder_Flush(enc, out);
+		}
+	}
+
+	if (enc->sampleCount == 0) {
+		enc->firstTick = sample->tick;
+	}
+
+	uint8_t *record = &enc->samples[enc->sampleCount * CCSDS_SAMPLE_SIZE];
+	CCSDS_Put16(&record[0], sample->c0Data);
+	CCSDS_Put16(&record[2], sample->c1Data);
+	record[4] = sample->configCode;
+	record[5] = sample->flags;
+	enc->sampleCount++;
+
+	/* A gap flush and a full packet cannot both happen, packets hold at least two samples (CCSDS-Packet.h) */
+	if ((length == 0) && (enc->sampleCount >= CCSDS_SAMPLES_PER_PACKET)) {
+		length = CCSDS_Encoder_Flush(enc, out);
+	}
+
+	return length;
+}
+
+
+/*****************************************************************
+ * @brief Validate one packet of any APID                       *
+ * @param packet: Start of the packet                           *
+ * @param length: Bytes available from packet                   *
+ * @param header: Pointer to store the parsed header fields     *
+ * @return Packet length, -1 if more bytes are needed,          *
+ *         -2 if this is not a valid packet                     *
+ ****************************************************************/
+int32_t CCSDS_Parse_Packet(const uint8_t *packet, uint32_t length, CCSDS_Header_t *header) {
+
+	if (length < CCSDS_PRIMARY_HEADER_SIZE) {
+		return -1;
+	}
+
+	/* Version 0, TM, secondary header present, standalone packet */
+	uint16_t idField = CCSDS_Get16(&packet[0]);
+	uint16_t seqField = CCSDS_Get16(&packet[2]);
+	if (((idField & ~CCSDS_APID_MASK) != CCSDS_SEC_HEADER_FLAG) || ((seqField & ~CCSDS_SEQ_COUNT_MASK) != CCSDS_SEQ_FLAGS_STANDALONE)) {
+		return -2;
+	}
+
+	uint32_t packetLength = (uint32_t)CCSDS_Get16(&packet[4]) + CCSDS_PRIMARY_HEADER_SIZE + 1;
+	if ((packetLength < CCSDS_PACKET_SIZE(0)) || (packetLength > CCSDS_PACKET_LIMIT)) {
+		return -2;
+	}
+	if (length < packetLength) {
+		return -1;
+	}
+
+	if (CCSDS_CRC16(packet, packetLength - CCSDS_CRC_SIZE, 0xFFFF) != CCSDS_Get16(&packet[packetLength - CCSDS_CRC_SIZE])) {
+		return -2;
+	}
+
+	header->apid = idField & CCSDS_APID_MASK;
+	header->seqCount = seqField & CCSDS_SEQ_COUNT_MASK;
+	header->tick = CCSDS_Get32(&packet[6]);
+	header->periodMs = CCSDS_Get16(&packet[10]);
+	header->data = &packet[CCSDS_PRIMARY_HEADER_SIZE + CCSDS_SECONDARY_HEADER_SIZE];
+	header->dataLength = (uint16_t)(packetLength - CCSDS_PACKET_SIZE(0));
+
+	return (int32_t)packetLength;
+}
+
+
+/*****************************************************************
+ * @brief Validate and decode one raw sample packet             *
+ * @param packet: Start of the packet                           *
+ * @param length: Bytes available from packet                   *
+ * @param apid: Expected APID                                   *
+ * @param samples: Array of at least CCSDS_SAMPLES_PER_PACKET   *
+ * @param seqCount: Optional pointer to store the sequence count *
+ * @return Number of samples, -1 if more bytes are needed,      *
+ *         -2 if this is not a valid packet                     *
+ *                                                              *
+ * The packet length is CCSDS_PACKET_SIZE(return value).        *
+ ****************************************************************/
+int16_t CCSDS_Decode_Packet(const uint8_t *packet, uint32_t length, uint16_t apid, CCSDS_Sample_t *samples, uint16_t *seqCount) {
+
+	CCSDS_Header_t header;
+	int32_t packetLength = CCSDS_Parse_Packet(packet, length, &header);
+	if (packetLength < 0) {
+		return (int16_t)packetLength;
+	}
+
+	if ((header.apid != apid) || (header.dataLength == 0) || (header.dataLength > CCSDS_SAMPLES_PER_PACKET * CCSDS_SAMPLE_SIZE)
+			|| ((header.dataLength % CCSDS_SAMPLE_SIZE) != 0)) {
+		return -2;
+	}
+
+	uint16_t sampleCount = header.dataLength / CCSDS_SAMPLE_SIZE;
+	const uint8_t *record = header.data;
+
+	for (uint16_t i = 0; i < sampleCount; i++, record += CCSDS_SAMPLE_SIZE) {
+		samples[i].tick = header.tick + (uint32_t)i * header.periodMs;
+		samples[i].c0Data = CCSDS_Get16(&record[0]);
+		samples[i].c1Data = CCSDS_Get16(&record[2]);
+		samples[i].configCode = record[4];
+		samples[i].flags = record[5];
+	}
+
+	if (seqCount != NULL) {
+		*seqCount = header.seqCount;
+	}
+
+	return (int16_t)sampleCount;
+}
@@ -0,0 +1,94 @@
+/**
+ * @file CCSDS-Packet.h
+ * @brief Header file for the CCSDS space packet encoder for LTR-329 samples.
+ * @author Kent Hong
+ *
+ * This file contains the packet layout and function prototypes for packing raw
+ * LTR-329 samples into CCSDS space packets (CCSDS 133.0-B-2). It has no HAL
+ * dependency so the ground tools in tools/ build against the same definitions.
+ *
+ * Packet layout, all fields big-endian:
+ *   Primary header    6 bytes  version 0, TM, secondary header flag, APID,
+ *                              standalone sequence flags, 14-bit sequence count
+ *   Secondary header  6 bytes  uint32 tick of the first sample (ms), uint16 sample period (ms)
+ *   Samples       N x 6 bytes  uint16 c0, uint16 c1, uint8 config code, uint8 quality flags
+ *                              (APID CCSDS_APID_ERROR_LOG: N x 8-byte Error-Log events, period 0)
+ *                              (APID CCSDS_APID_LTR_329_TIMED: N x 10-byte records, uint32 tick then
+ *                               the 6-byte sample, period 0)
+ *                              (APID CCSDS_APID_LUX_HISTOGRAM: one histogram, see Lux-Histogram.h)
+ *   Error control     2 bytes  CRC-16/CCITT-FALSE over all preceding bytes
+ */
+
+#ifndef INC_CCSDS_PACKET_H_
+#define INC_CCSDS_PACKET_H_
+
+#include <stdint.h>
+
+/** @brief Packet geometry */
+#define CCSDS_PRIMARY_HEADER_SIZE 6
+#define CCSDS_SECONDARY_HEADER_SIZE 6
+#define CCSDS_SAMPLE_SIZE 6
+#define CCSDS_CRC_SIZE 2
+#define CCSDS_ERROR_EVENT_SIZE 8 // One Error-Log event on CCSDS_APID_ERROR_LOG
+#define CCSDS_TIMED_SAMPLE_SIZE 10 // One sample with its own tick on CCSDS_APID_LTR_329_TIMED
+#ifndef CCSDS_SAMPLES_PER_PACKET
+#define CCSDS_SAMPLES_PER_PACKET 16 // 110-byte packets, 6.9 bytes per sample on the link
+#endif
+_Static_assert(CCSDS_SAMPLES_PER_PACKET >= 2, "CCSDS_Encoder_Add() returns one packet per call, a gap flush and a full packet must not coincide");
+#define CCSDS_PACKET_SIZE(samples) (CCSDS_PRIMARY_HEADER_SIZE + CCSDS_SECONDARY_HEADER_SIZE + (samples) * CCSDS_SAMPLE_SIZE + CCSDS_CRC_SIZE)
+#define CCSDS_PACKET_MAX CCSDS_PACKET_SIZE(CCSDS_SAMPLES_PER_PACKET)
+#define CCSDS_PACKET_LIMIT 256 // Largest packet of any APID accepted by the parser (one telemetry TX buffer)
+
+/** @brief Primary header fields */
+#define CCSDS_APID_LTR_329 0x0C9  // Default APID for LTR-329 samples
+#define CCSDS_APID_ERROR_LOG 0x0CA // APID for drained Error-Log events
+#define CCSDS_APID_LTR_329_DELTA 0x0CB // APID for delta + zigzag varint compressed samples (Sample-Codec.h)
+#define CCSDS_APID_LTR_329_TIMED 0x0CC // APID for individually timed samples (Downlink-Scheduler.h)
+#define CCSDS_APID_LUX_HISTOGRAM 0x0CD // APID for log-binned lux histograms (Lux-Histogram.h)
+#define CCSDS_APID_MASK 0x07FF
+#define CCSDS_SEQ_COUNT_MASK 0x3FFF
+#define CCSDS_SEC_HEADER_FLAG 0x0800
+#define CCSDS_SEQ_FLAGS_STANDALONE 0xC000
+
+/** @brief Struct to store the packet encoder state */
+typedef struct {
+	uint16_t apid;          // Application process identifier
+	uint16_t seqCount;      // Sequence count of the next packet, wraps at 14 bits
+	uint16_t periodMs;      // Nominal sample period written to the secondary header
+	uint8_t sampleCount;    // Samples in the open packet
+	uint32_t firstTick;     // Tick of the first sample in the open packet
+	uint8_t samples[CCSDS_SAMPLES_PER_PACKET * CCSDS_SAMPLE_SIZE]; // Records of the open packet
+} CCSDS_Encoder_t;
+
+/** @brief Header fields of a validated packet */
+typedef struct {
+	uint16_t apid;         // Application process identifier
+	uint16_t seqCount;     // 14-bit sequence count
+	uint32_t tick;         // Secondary header time (ms)
+	uint16_t periodMs;     // Secondary header sample period (ms)
+	const uint8_t *data;   // Payload after the secondary header
+	uint16_t dataLength;   // Payload length, excluding the CRC
+} CCSDS_Header_t;
+
+/** @brief One decoded sample */
+typedef struct {
+	uint32_t tick;       // Sample time (ms)
+	uint16_t c0Data;     // Raw CH0 counts
+	uint16_t c1Data;     // Raw CH1 counts
+	uint8_t configCode;  // Gain code << 3 | integration time code
+	uint8_t flags;       // LTR_329_FLAG_* quality flags
+} CCSDS_Sample_t;
+
+
+/** @brief Function Prototypes for the CCSDS packet encoder */
+uint16_t CCSDS_CRC16(const uint8_t *data, uint32_t length, uint16_t crc);
+void CCSDS_Put_Timed_Sample(uint8_t *dest, const CCSDS_Sample_t *sample);
+void CCSDS_Get_Timed_Sample(const uint8_t *src, CCSDS_Sample_t *sample);
+uint16_t CCSDS_Build_Packet(uint16_t apid, uint16_t seqCount, uint32_t tick, uint16_t periodMs, const uint8_t *data, uint16_t dataLength, uint8_t *out);
+void CCSDS_Encoder_Init(CCSDS_Encoder_t *enc, uint16_t apid, uint16_t periodMs);
+uint16_t CCSDS_Encoder_Add(CCSDS_Encoder_t *enc, const CCSDS_Sample_t *sample, uint8_t *out);
+uint16_t CCSDS_Encoder_Flush(CCSDS_Encoder_t *enc, uint8_t *out);
+int32_t CCSDS_Parse_Packet(const uint8_t *packet, uint32_t length, CCSDS_Header_t *header);
+int16_t CCSDS_Decode_Packet(const uint8_t *packet, uint32_t length, uint16_t apid, CCSDS_Sample_t *samples, uint16_t *seqCount);
+
+#endif /* INC_CCSDS_PACKET_H_ */
@@ -0,0 +1,500 @@
+/**
+ * @file Command-Console.c
+ * @brief Implementation of the UART RX command console.
+ * @author Kent Hong
+ *
+ * The RX event callback only advances rxHead. Command_Console_Process() walks the
+ * new bytes, and every complete line is tokenized directly in the circular DMA
+ * buffer through a cursor that wraps with the buffer mask.
+ *
+ * @note Replies go through the telemetry transmitter; in the CCSDS telemetry
+ *       formats they appear between packets and ground decoders skip them.
+ */
+
+#include <string.h>
+#include "Command-Console.h"
+#include "Error-Log.h"
+#include "Lux-Format.h"
+
+#define COMMAND_CONSOLE_RX_MASK (COMMAND_CONSOLE_RX_SIZE - 1U)
+
+/** @brief Read position inside one received line */
+typedef struct {
+	const uint8_t *rx;  // Circular buffer holding the line
+	uint32_t pos;       // Next byte, unwrapped
+	uint32_t end;       // End of the line, unwrapped
+} Command_Cursor_t;
+
+/** @brief Reply selected by the parser */
+typedef enum {
+	COMMAND_REPLY_SYNTAX = 0, // Line not understood
+	COMMAND_REPLY_CONFIG,     // Sensor configuration, after get config and every set
+	COMMAND_REPLY_COUNTERS,   // Driver and link counters
+	COMMAND_REPLY_REPORT,     // Deadband settings, after get report and every deadband set
+	COMMAND_REPLY_RING        // Store-and-forward ring state, after get ring and set pass
+} Command_Reply_Type_t;
+
+/** @brief Reply line under construction in the telemetry buffer */
+typedef struct {
+	char *buffer;
+	uint16_t length;
+} Command_Reply_t;
+
+
+static void Command_Skip_Spaces(Command_Cursor_t *cursor) {
+	while ((cursor->pos != cursor->end) && (cursor->rx[cursor->pos & COMMAND_CONSOLE_RX_MASK] == ' ')) {
+		cursor->pos++;
+	}
+}
+
+/** @brief Consume the next token if it equals word (case-insensitive), returns 1 on match */
+static uint8_t Command_Match(Command_Cursor_t *cursor, const char *word) {
+
+	Command_Skip_Spaces(cursor);
+
+	uint32_t pos = cursor->pos;
+	while (*word != '\0') {
+		if ((pos == cursor->end) || ((cursor->rx[pos & COMMAND_CONSOLE_RX_MASK] | 0x20) != *word)) {
+			return 0;
+		}
+		pos++;
+		word++;
+	}
+
+	if ((pos != cursor->end) && (cursor->rx[pos & COMMAND_CONSOLE_RX_MASK] != ' ')) {
+		return 0;
+	}
+
+	cursor->pos = pos;
+	return 1;
+}
+
+/** @brief Consume a decimal number of up to 5 digits, returns 1 on success */
+static uint8_t Command_Number(Command_Cursor_t *cursor, uint16_t *value) {
+
+	Command_Skip_Spaces(cursor);
+
+	uint32_t number = 0;
+	uint8_t digits = 0;
+	while ((cursor->pos != cursor->end) && (cursor->rx[cursor->pos & COMMAND_CONSOLE_RX_MASK] != ' ')) {
+		uint8_t ch = cursor->rx[cursor->pos & COMMAND_CONSOLE_RX_MASK];
+		if ((ch < '0') || (ch > '9') || (++digits > 5)) {
+			return 0;
+		}
+		number = number * 10U + (ch - '0');
+		cursor->pos++;
+	}
+
+	if ((digits == 0) || (number > UINT16_MAX)) {
+		return 0;
+	}
+
+	*value = (uint16_t)number;
+	return 1;
+}
+
+/** @brief Returns 1 if only spaces remain on the line */
+static uint8_t Command_End(Command_Cursor_t *cursor) {
+	Command_Skip_Spaces(cursor);
+	return cursor->pos == cursor->end;
+}
+
+static void Command_Reply_String(Command_Reply_t *reply, const char *text) {
+	while ((*text != '\0') && (reply->length < COMMAND_CONSOLE_REPLY_MAX - 2U)) {
+		reply->buffer[reply->length++] = *text++;
+	}
+}
+
+static void Command_Reply_Field(Command_Reply_t *reply, const char *name, uint32_t value) {
+	Command_Reply_String(reply, name);
+	reply->length += Lux_Format_Decimal(&reply->buffer[reply->length], COMMAND_CONSOLE_REPLY_MAX - 2U - reply->length, value, 0);
+}
+
+static void Command_Reply_Config(Command_Console_t *console, Command_Reply_t *reply) {
+
+	uint8_t gain;
+	uint16_t intTimeMs, measRateMs;
+	LTR_329_Get_Config(console->ltr329, &gain, &intTimeMs, &measRateMs);
+
+	Command_Reply_String(reply, "OK part=");
+	Command_Reply_String(reply, console->ltr329->part->name);
+	Command_Reply_Field(reply, " gain=", gain);
+	Command_Reply_Field(reply, " int=", intTimeMs);
+	Command_Reply_Field(reply, " rate=", measRateMs);
+	if (console->configBlock != NULL) {
+		Command_Reply_Field(reply, " cal=", (uint32_t)(console->configBlock->luxCalibration * 1000.0f + 0.5f));
+		Command_Reply_Field(reply, " gen=", console->configBlock->generation);
+	}
+}
+
+static void Command_Reply_Counters(Command_Console_t *console, Command_Reply_t *reply) {
+
+	uint32_t errors = 0;
+	for (uint8_t code = 0; code < ERROR_CODE_COUNT; code++) {
+		errors += Error_Log_Get_Count((Error_Code_t)code);
+	}
+
+	Command_Reply_Field(reply, "OK err=", errors);
+	Command_Reply_Field(reply, " lost=", Error_Log_Get_Overwritten());
+	Command_Reply_Field(reply, " txdrop=", console->tx->bytesDropped);
+	Command_Reply_Field(reply, " msgdrop=", console->tx->messagesDropped);
+	Command_Reply_Field(reply, " dmaerr=", console->tx->dmaErrors);
+	Command_Reply_Field(reply, " repair=", console->ltr329->scrubRepairs);
+	Command_Reply_Field(reply, " cmd=", console->commands);
+	Command_Reply_Field(reply, " bad=", console->badCommands);
+	Command_Reply_Field(reply, " ovr=", console->overruns);
+}
+
+static void Command_Reply_Report(Command_Console_t *console, Command_Reply_t *reply) {
+
+	const Report_Deadband_t *deadband = console->deadband;
+
+	Command_Reply_Field(reply, "OK abs=", deadband->absCounts);
+	Command_Reply_Field(reply, " rel=", deadband->relPermille);
+	Command_Reply_Field(reply, " heartbeat=", deadband->heartbeatMs);
+	Command_Reply_Field(reply, " reported=", deadband->reported);
+	Command_Reply_Field(reply, " suppressed=", deadband->suppressed);
+}
+
+static void Command_Reply_Ring(Command_Console_t *console, Command_Reply_t *reply) {
+
+	const Sample_Ring_t *ring = console->sampleRing;
+
+	Command_Reply_Field(reply, "OK pass=", ring->forced);
+	Command_Reply_Field(reply, " held=", Sample_Ring_Count(ring));
+	Command_Reply_Field(reply, " peak=", ring->peak);
+	Command_Reply_Field(reply, " dropped=", ring->dropped);
+}
+
+/** @brief Raise the measurement rate to the shortest one that fits the integration time */
+static HAL_StatusTypeDef Command_Set_Integration(Command_Console_t *console, uint16_t intTimeMs) {
+
+	static const uint16_t measRates[] = {50, 100, 200, 500, 1000, 2000};
+	uint8_t gain;
+	uint16_t currentIntMs, measRateMs;
+	LTR_329_Get_Config(console->ltr329, &gain, &currentIntMs, &measRateMs);
+
+	for (uint8_t i = 0; (measRateMs < intTimeMs) && (i < sizeof(measRates) / sizeof(measRates[0])); i++) {
+		measRateMs = measRates[i];
+	}
+
+	return LTR_329_Set_Timing(console->hi2c, console->ltr329, intTimeMs, measRateMs);
+}
+
+/** @brief Change the lux calibration, the driver reads the rederived factors from the next sample on */
+static HAL_StatusTypeDef Command_Set_Calibration(Command_Console_t *console, uint16_t permille) {
+
+	if ((console->configBlock == NULL) || (permille == 0)) {
+		return HAL_ERROR;
+	}
+
+	console->configBlock->luxCalibration = (float)permille / 1000.0f;
+	Config_Block_Derive(console->configBlock);
+	return HAL_OK;
+}
+
+/** @brief Capture the running settings into the configuration block and store it, the loop stalls for one page erase */
+static HAL_StatusTypeDef Command_Save_Config(Command_Console_t *console) {
+
+	Config_Block_t *block = console->configBlock;
+	if (block == NULL) {
+		return HAL_ERROR;
+	}
+
+	block->alsContr = console->ltr329->regShadow[LTR_329_SHADOW_ALS_CONTR] & (uint8_t)~LTR_329_ALS_CONTR_ACTIVE;
+	block->alsMeasRate = console->ltr329->regShadow[LTR_329_SHADOW_ALS_MEAS_RATE];
+	block->deadbandAbsCounts = console->deadband->absCounts;
+	block->deadbandRelPermille = console->deadband->relPermille;
+	block->heartbeatMs = console->deadband->heartbeatMs;
+
+	return Config_Block_Save(block, console->configDevice) ? HAL_OK : HAL_ERROR;
+}
+
+/** @brief Parse and run one line, the reply is written into the telemetry buffer */
+static void Command_Execute(Command_Console_t *console, uint32_t start, uint32_t end) {
+
+	Command_Cursor_t cursor = { console->rx, start, end };
+	HAL_StatusTypeDef status = HAL_ERROR;
+	Command_Reply_Type_t replyType = COMMAND_REPLY_CONFIG;
+	static const char *const setNames[] = { "gain", "int", "rate", "deadband", "heartbeat", "cal", "pass" };
+	const uint8_t setCount = sizeof(setNames) / sizeof(setNames[0]);
+	uint8_t setIndex = setCount;
+	uint16_t value = 0, relPermille = 0;
+	uint8_t save = 0;
+
+	/* Match the keyword first, then its arguments, so bad arguments never fall through to another command */
+	if (Command_Match(&cursor, "get")) {
+		status = HAL_OK;
+		if (Command_Match(&cursor, "counters")) {
+			replyType = COMMAND_REPLY_COUNTERS;
+		}
+		else if (Command_Match(&cursor, "report")) {
+			replyType = COMMAND_REPLY_REPORT;
+		}
+		else if (Command_Match(&cursor, "ring")) {
+			replyType = COMMAND_REPLY_RING;
+			status = (console->sampleRing != NULL) ? HAL_OK : HAL_ERROR;
+		}
+		else if (!Command_Match(&cursor, "config")) {
+			replyType = COMMAND_REPLY_SYNTAX;
+		}
+	}
+	else if (Command_Match(&cursor, "set")) {
+		setIndex = 0;
+		while ((setIndex < setCount) && !Command_Match(&cursor, setNames[setIndex])) {
+			setIndex++;
+		}
+
+		if ((setIndex == setCount) || !Command_Number(&cursor, &value)
+				|| ((setIndex == 3) && !Command_Number(&cursor, &relPermille))) {
+			replyType = COMMAND_REPLY_SYNTAX;
+		}
+	}
+	else if (Command_Match(&cursor, "save")) {
+		save = 1;
+		if (!Command_Match(&cursor, "config")) {
+			replyType = COMMAND_REPLY_SYNTAX;
+		}
+	}
+	else {
+		replyType = COMMAND_REPLY_SYNTAX;
+	}
+
+	if (!Command_End(&cursor)) {
+		replyType = COMMAND_REPLY_SYNTAX;
+	}
+
+	/* Run the set command only when the whole line parsed */
+	if ((replyType != COMMAND_REPLY_SYNTAX) && (setIndex < setCount)) {
+		uint8_t gain;
+		uint16_t intTimeMs, measRateMs;
+		LTR_329_Get_Config(console->ltr329, &gain, &intTimeMs, &measRateMs);
+		Report_Deadband_t *deadband = console->deadband;
+
+		switch (setIndex) {
+			case 0: // set gain <x>
+				status = (value <= UINT8_MAX) ? LTR_329_Set_Gain(console->hi2c, console->ltr329, (uint8_t)value) : HAL_ERROR;
+				break;
+			case 1: // set int <ms>
+				status = Command_Set_Integration(console, value);
+				break;
+			case 2: // set rate <ms>
+				status = LTR_329_Set_Timing(console->hi2c, console->ltr329, intTimeMs, value);
+				break;
+			case 3: // set deadband <counts> <permille>
+				Report_Deadband_Set(deadband, value, relPermille, deadband->heartbeatMs);
+				status = HAL_OK;
+				replyType = COMMAND_REPLY_REPORT;
+				break;
+			case 4: // set heartbeat <ms>
+				Report_Deadband_Set(deadband, deadband->absCounts, deadband->relPermille, value);
+				status = HAL_OK;
+				replyType = COMMAND_REPLY_REPORT;
+				break;
+			case 5: // set cal <permille>
+				status = Command_Set_Calibration(console, value);
+				break;
+			default: // set pass <0|1>, the main loop forwards the ring while a pass is on
+				status = ((console->sampleRing != NULL) && (value <= 1)) ? HAL_OK : HAL_ERROR;
+				if (status == HAL_OK) {
+					Sample_Ring_Force_Drain(console->sampleRing, (uint8_t)value);
+				}
+				replyType = COMMAND_REPLY_RING;
+				break;
+		}
+	}
+	else if ((replyType != COMMAND_REPLY_SYNTAX) && save) {
+		status = Command_Save_Config(console);
+	}
+
+	if (replyType == COMMAND_REPLY_SYNTAX) {
+		if (console->badCommands != UINT16_MAX) {
+			console->badCommands++;
+		}
+	}
+	else if (console->commands != UINT16_MAX) {
+		console->commands++;
+	}
+
+	Command_Reply_t reply = { (char *)Telemetry_TX_Reserve(console->tx, COMMAND_CONSOLE_REPLY_MAX), 0 };
+	if (reply.buffer == NULL) {
+		return;
+	}
+
+	if (replyType == COMMAND_REPLY_SYNTAX) {
+		Command_Reply_String(&reply, "ERR syntax");
+	}
+	else if (status != HAL_OK) {
+		Command_Reply_Field(&reply, "ERR status=", status);
+	}
+	else if (replyType == COMMAND_REPLY_COUNTERS) {
+		Command_Reply_Counters(console, &reply);
+	}
+	else if (replyType == COMMAND_REPLY_REPORT) {
+		Command_Reply_Report(console, &reply);
+	}
+	else if (replyType == COMMAND_REPLY_RING) {
+		Command_Reply_Ring(console, &reply);
+	}
+	else {
+		Command_Reply_Config(console, &reply);
+	}
+
+	reply.buffer[reply.length++] = '\r';
+	reply.buffer[reply.length++] = '\n';
+	Telemetry_TX_Commit(console->tx, reply.length);
+}
+
+
+/*****************************************************************
+ * @brief Initialize the console and start circular reception   *
+ * @param console: Pointer to the Command_Console_t struct      *
+ * @param huart: UART handle with circular RX DMA linked        *
+ * @param hi2c: Pointer to the I2C handle of the sensor         *
+ * @param ltr329: Pointer to the LTR329_t struct                *
+ * @param tx: Telemetry transmitter used for replies            *
+ * @param deadband: Reporting deadband configured by commands   *
+ * @return HAL status code of HAL_UARTEx_ReceiveToIdle_DMA()    *
+ ****************************************************************/
+HAL_StatusTypeDef Command_Console_Init(Command_Console_t *console, UART_HandleTypeDef *huart, I2C_HandleTypeDef *hi2c, LTR329_t *ltr329, Telemetry_TX_t *tx, Report_Deadband_t *deadband) {
+
+	memset(console, 0, sizeof(*console));
+	console->huart = huart;
+	console->hi2c = hi2c;
+	console->ltr329 = ltr329;
+	console->tx = tx;
+	console->deadband = deadband;
+
+	return HAL_UARTEx_ReceiveToIdle_DMA(huart, console->rx, COMMAND_CONSOLE_RX_SIZE);
+}
+
+
+/*****************************************************************
+ * @brief Enable "set cal" and "save config"                    *
+ * @param console: Pointer to the Command_Console_t struct      *
+ * @param block: Configuration block loaded at boot, changed by *
+ *               "set cal" and refreshed by "save config"       *
+ * @param dev: Two-page flash device holding its banks          *
+ ****************************************************************/
+void Command_Console_Attach_Config(Command_Console_t *console, Config_Block_t *block, const Flash_Log_Device_t *dev) {
+	console->configBlock = block;
+	console->configDevice = dev;
+}
+
+
+/*****************************************************************
+ * @brief Enable "set pass" and "get ring"                      *
+ * @param console: Pointer to the Command_Console_t struct      *
+ * @param ring: Store-and-forward ring forwarded by the main    *
+ *              loop, drained completely while a pass is on     *
+ ****************************************************************/
+void Command_Console_Attach_Ring(Command_Console_t *console, Sample_Ring_t *ring) {
+	console->sampleRing = ring;
+}
+
+
+/*****************************************************************
+ * @brief Publish the DMA write position                        *
+ * @param console: Pointer to the Command_Console_t struct      *
+ * @param position: Size argument of HAL_UARTEx_RxEventCallback *
+ *                                                              *
+ * Called on idle line, half transfer and transfer complete, so *
+ * the DMA never moves more than half the buffer between calls. *
+ ****************************************************************/
+void Command_Console_RX_Event_Callback(Command_Console_t *console, uint16_t position) {
+
+	console->rxHead += (uint16_t)(position - console->rxLastPos) & COMMAND_CONSOLE_RX_MASK;
+	console->rxLastPos = position & COMMAND_CONSOLE_RX_MASK;
+}
+
+
+/*****************************************************************
+ * @brief Restart reception after a UART error                  *
+ * @param console: Pointer to the Command_Console_t struct      *
+ *                                                              *
+ * HAL aborts reception on framing, noise and overrun errors.   *
+ * DMA restarts at the buffer start, so rxHead skips to the    *
+ * next lap. The skipped bytes are left over from the previous  *
+ * lap, the parser jumps over them and drops the partial line.  *
+ ****************************************************************/
+void Command_Console_Error_Callback(Command_Console_t *console) {
+
+	if (HAL_UARTEx_ReceiveToIdle_DMA(console->huart, console->rx, COMMAND_CONSOLE_RX_SIZE) == HAL_OK) {
+		uint32_t head = console->rxHead + ((COMMAND_CONSOLE_RX_SIZE - console->rxLastPos) & COMMAND_CONSOLE_RX_MASK);
+		console->rxLastPos = 0;
+		console->rxRestartHead = head;
+		console->rxHead = head;
+		console->rxRestarts++;
+	}
+}
+
+
+/*****************************************************************
+ * @brief Execute received commands                             *
+ * @param console: Pointer to the Command_Console_t struct      *
+ * @return Number of commands executed                          *
+ *                                                              *
+ * Call from the main loop. At most                             *
+ * COMMAND_CONSOLE_LINES_PER_CALL lines are executed per call   *
+ * so the time spent between samples stays bounded.             *
+ ****************************************************************/
+uint8_t Command_Console_Process(Command_Console_t *console) {
+
+	/* Stale bytes of the previous lap sit between the error and the restart, never parse them */
+	uint16_t restarts;
+	uint32_t restartHead;
+	do {
+		restarts = console->rxRestarts;
+		restartHead = console->rxRestartHead;
+	} while (restarts != console->rxRestarts); // An error in between would pair the count with an older head
+	if (restarts != console->rxRestartsSeen) {
+		console->rxRestartsSeen = restarts;
+		console->rxTail = restartHead;
+		console->lineStart = restartHead;
+		console->discarding = 1;
+		if (console->overruns != UINT16_MAX) {
+			console->overruns++;
+		}
+	}
+
+	uint32_t head = console->rxHead;
+	uint8_t executed = 0;
+
+	/* The DMA wrapped over bytes of the line being received */
+	if (head - console->lineStart > COMMAND_CONSOLE_RX_SIZE) {
+		if (console->overruns != UINT16_MAX) {
+			console->overruns++;
+		}
+		console->rxTail = head;
+		console->lineStart = head;
+		console->discarding = 1;
+		return 0;
+	}
+
+	while ((console->rxTail != head) && (executed < COMMAND_CONSOLE_LINES_PER_CALL)) {
+		uint8_t ch = console->rx[console->rxTail & COMMAND_CONSOLE_RX_MASK];
+
+		if ((ch == '\r') || (ch == '\n')) {
+			if (!console->discarding && (console->rxTail != console->lineStart)) {
+				Command_Execute(console, console->lineStart, console->rxTail);
+				executed++;
+			}
+			console->discarding = 0;
+			console->lineStart = console->rxTail + 1;
+		}
+		else if (!console->discarding && (console->rxTail - console->lineStart >= COMMAND_CONSOLE_LINE_MAX)) {
+			/* Overlong line, drop it up to the next line end */
+			console->discarding = 1;
+			if (console->badCommands != UINT16_MAX) {
+				console->badCommands++;
+			}
+		}
+
+		if (console->discarding) {
+			console->lineStart = console->rxTail + 1;
+		}
+		console->rxTail++;
+	}
+
+	return executed;
+}
@@ -0,0 +1,87 @@
+/**
+ * @file Command-Console.h
+ * @brief Header file for the UART RX command console.
+ * @author Kent Hong
+ *
+ * This file contains definitions and function prototypes for a line-based command
+ * channel on the telemetry UART. Reception runs continuously into a circular DMA
+ * buffer, the idle-line, half and full transfer events only publish the DMA write
+ * position. Lines are parsed in place in the DMA buffer from the main loop, so
+ * commands never run in interrupt context and never copy the received bytes.
+ *
+ * Commands, one per line (CR and/or LF), replies are "OK ..." or "ERR ...":
+ *   get config            gain, integration time, measurement rate and part
+ *   set gain <x>          1, 2, 4, 8, 48 or 96
+ *   set int <ms>          integration time, measurement rate is raised to match if needed
+ *   set rate <ms>         measurement repeat rate, not shorter than the integration time
+ *   get counters          error log, telemetry, scrub and console counters
+ *   get report            deadband thresholds and reported/suppressed sample counts
+ *   set deadband <n> <r>  absolute deadband in counts, relative deadband in 1/1000
+ *   set heartbeat <ms>    longest silence between reported samples, 0 reports every sample
+ *   set cal <permille>    lux calibration factor in 1/1000, applied at once (needs a configuration block)
+ *   save config           store gain, timing, deadband and calibration for the next boot
+ *   set pass <0|1>        1 drains the whole store-and-forward ring for a ground pass, 0 back to bursts (needs a ring)
+ *   get ring              pass state, samples held, peak fill and samples dropped by the ring
+ *
+ * @note The UART RX DMA channel must be linked to the UART handle in circular mode
+ *       (CubeMX: USART2_RX on DMA1 Channel 6, Mode Circular), with
+ *       the USART2 global interrupt enabled for idle-line detection.
+ *       HAL_UARTEx_RxEventCallback() must call Command_Console_RX_Event_Callback()
+ *       and HAL_UART_ErrorCallback() must call Command_Console_Error_Callback().
+ */
+
+#ifndef INC_COMMAND_CONSOLE_H_
+#define INC_COMMAND_CONSOLE_H_
+
+#include <stdint.h>
+#include "stm32L4xx_hal.h" // Adjust this include based on your STM32 series
+#include "LTR-329.h"
+#include "Telemetry-TX.h"
+#include "Report-Deadband.h"
+#include "Config-Block.h"
+#include "Sample-Ring.h"
+
+/** @brief Console geometry, override at compile time if needed */
+#ifndef COMMAND_CONSOLE_RX_SIZE
+#define COMMAND_CONSOLE_RX_SIZE 128    // Circular DMA buffer, power of two
+#endif
+#define COMMAND_CONSOLE_LINE_MAX 48    // Longer lines are discarded as bad commands
+#define COMMAND_CONSOLE_REPLY_MAX 128  // Longest reply line
+#define COMMAND_CONSOLE_LINES_PER_CALL 4 // Commands executed per Command_Console_Process() call
+
+_Static_assert((COMMAND_CONSOLE_RX_SIZE & (COMMAND_CONSOLE_RX_SIZE - 1)) == 0, "COMMAND_CONSOLE_RX_SIZE must be a power of two");
+
+/** @brief Struct to store the console state */
+typedef struct {
+	UART_HandleTypeDef *huart;      // UART receiving commands
+	I2C_HandleTypeDef *hi2c;        // I2C bus of the sensor
+	LTR329_t *ltr329;               // Sensor being configured
+	Telemetry_TX_t *tx;             // Transmitter for replies
+	Report_Deadband_t *deadband;    // Reporting deadband being configured
+	Config_Block_t *configBlock;    // Settings saved by "save config", NULL if none is attached
+	const Flash_Log_Device_t *configDevice; // Flash holding the configuration block banks
+	Sample_Ring_t *sampleRing;      // Store-and-forward ring drained by "set pass", NULL if none is attached
+	uint8_t rx[COMMAND_CONSOLE_RX_SIZE]; // Circular DMA target
+	volatile uint32_t rxHead;       // Total bytes written by DMA, updated by the RX event
+	uint16_t rxLastPos;             // DMA position at the previous RX event
+	volatile uint32_t rxRestartHead; // rxHead where DMA restarted after the last UART error
+	volatile uint16_t rxRestarts;   // UART errors that restarted the DMA, counted by the error callback
+	uint16_t rxRestartsSeen;        // rxRestarts already handled by the parser
+	uint32_t rxTail;                // Total bytes consumed by the parser
+	uint32_t lineStart;             // Start of the line being received
+	uint8_t discarding;             // 1 while skipping the rest of an overlong or overrun line
+	uint16_t commands;              // Saturating count of executed commands
+	uint16_t badCommands;           // Saturating count of rejected or overlong lines
+	uint16_t overruns;              // Saturating count of RX buffer overruns and UART errors
+} Command_Console_t;
+
+
+/** @brief Function Prototypes for the command console */
+HAL_StatusTypeDef Command_Console_Init(Command_Console_t *console, UART_HandleTypeDef *huart, I2C_HandleTypeDef *hi2c, LTR329_t *ltr329, Telemetry_TX_t *tx, Report_Deadband_t *deadband);
+void Command_Console_Attach_Config(Command_Console_t *console, Config_Block_t *block, const Flash_Log_Device_t *dev);
+void Command_Console_Attach_Ring(Command_Console_t *console, Sample_Ring_t *ring);
+void Command_Console_RX_Event_Callback(Command_Console_t *console, uint16_t position);
+void Command_Console_Error_Callback(Command_Console_t *console);
+uint8_t Command_Console_Process(Command_Console_t *console);
+
+#endif /* INC_COMMAND_CONSOLE_H_ */
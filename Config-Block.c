@@ -0,0 +1,136 @@
+/**
+ * @file Config-Block.c
+ * @brief Implementation of the persisted configuration and calibration block.
+ * @author Kent Hong
+ *
+ * Bank b of the block lives at page b of the device. A block with generation g is
+ * written to bank g & 1, so consecutive saves alternate banks.
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include "Config-Block.h"
+#include "CCSDS-Packet.h"
+#include "Report-Deadband.h"
+
+/** @brief Gain and integration time by register code (pg. 13-14 of LTR-329 datasheet), 0 for reserved codes */
+static const uint8_t gainByCode[8] = {1, 2, 4, 8, 0, 0, 48, 96};
+static const uint16_t intTimeByCode[8] = {100, 50, 200, 400, 150, 250, 300, 350};
+
+
+/*****************************************************************
+ * @brief Fill a block with the compiled-in settings            *
+ * @param block: Pointer to the Config_Block_t struct           *
+ ****************************************************************/
+void Config_Block_Defaults(Config_Block_t *block) {
+
+	memset(block, 0, sizeof(*block));
+	block->magic = CONFIG_BLOCK_MAGIC;
+	block->layout = CONFIG_BLOCK_LAYOUT;
+	block->heartbeatMs = REPORT_DEADBAND_HEARTBEAT_MS;
+	block->luxCalibration = 1.0f;
+	block->deadbandAbsCounts = REPORT_DEADBAND_ABS_COUNTS;
+	block->deadbandRelPermille = REPORT_DEADBAND_REL_PERMILLE;
+	block->alsContr = CONFIG_BLOCK_DEFAULT_ALS_CONTR;
+	block->alsMeasRate = CONFIG_BLOCK_DEFAULT_ALS_MEAS_RATE;
+
+	Config_Block_Derive(block);
+}
+
+
+/*****************************************************************
+ * @brief Recompute the lux factors after luxCalibration changed *
+ * @param block: Pointer to the Config_Block_t struct           *
+ *                                                              *
+ * Done when the block changes, never at boot: the factors are  *
+ * saved with the block and covered by its CRC.                 *
+ ****************************************************************/
+void Config_Block_Derive(Config_Block_t *block) {
+
+	for (uint8_t code = 0; code < CONFIG_BLOCK_CONFIG_CODES; code++) {
+		uint8_t gain = gainByCode[code >> 3];
+		block->luxScale[code] = (gain != 0) ? block->luxCalibration / ((float)gain * (float)intTimeByCode[code & 0x07]) : 0.0f;
+	}
+}
+
+
+/** @brief Returns 1 if the header read into block belongs to a block of this layout */
+static uint8_t Config_Block_Header_Valid(const Config_Block_t *block) {
+	return (block->magic == CONFIG_BLOCK_MAGIC) && (block->layout == CONFIG_BLOCK_LAYOUT);
+}
+
+
+/*****************************************************************
+ * @brief Load the newest valid bank                            *
+ * @param block: Pointer to store the block                     *
+ * @param dev: Two-page flash device holding the banks          *
+ * @return 1 if a stored block was loaded, 0 if block holds the *
+ *         defaults because neither bank is valid               *
+ *                                                              *
+ * Both headers are read first, then only the newer bank is     *
+ * copied in full. The older bank is copied only if the newer   *
+ * one fails its CRC.                                           *
+ ****************************************************************/
+uint8_t Config_Block_Load(Config_Block_t *block, const Flash_Log_Device_t *dev) {
+
+	const uint16_t headerSize = offsetof(Config_Block_t, heartbeatMs);
+	uint8_t headerValid[2];
+	uint32_t generation[2];
+
+	for (uint8_t bank = 0; bank < 2; bank++) {
+		headerValid[bank] = dev->read(dev->ctx, (uint32_t)bank * FLASH_LOG_PAGE_SIZE, (uint8_t *)block, headerSize)
+				&& Config_Block_Header_Valid(block);
+		generation[bank] = block->generation;
+	}
+
+	/* Newer bank first, an invalid header never outranks a valid one */
+	uint8_t first = (!headerValid[0] || (headerValid[1] && (generation[1] > generation[0]))) ? 1 : 0;
+	for (uint8_t i = 0; i < 2; i++) {
+		uint8_t bank = first ^ i;
+		if (headerValid[bank]
+				&& dev->read(dev->ctx, (uint32_t)bank * FLASH_LOG_PAGE_SIZE, (uint8_t *)block, sizeof(*block))
+				&& Config_Block_Header_Valid(block)
+				&& (CCSDS_CRC16((const uint8_t *)block, offsetof(Config_Block_t, crc), 0xFFFF) == block->crc)) {
+			return 1;
+		}
+	}
+
+	/* Continue numbering past any torn block, so the next save never overwrites the newest valid one */
+	uint32_t lastGeneration = 0;
+	for (uint8_t bank = 0; bank < 2; bank++) {
+		if (headerValid[bank] && (generation[bank] > lastGeneration)) {
+			lastGeneration = generation[bank];
+		}
+	}
+	Config_Block_Defaults(block);
+	block->generation = lastGeneration;
+
+	return 0;
+}
+
+
+/*****************************************************************
+ * @brief Store the block in the bank holding the older copy    *
+ * @param block: Block to store, its generation is advanced     *
+ * @param dev: Two-page flash device holding the banks          *
+ * @return 1 if stored, 0 on a flash error (the previous copy   *
+ *         is still loadable and the generation is kept)        *
+ ****************************************************************/
+uint8_t Config_Block_Save(Config_Block_t *block, const Flash_Log_Device_t *dev) {
+
+	block->magic = CONFIG_BLOCK_MAGIC;
+	block->layout = CONFIG_BLOCK_LAYOUT;
+	block->generation++;
+	memset(block->spare, 0, sizeof(block->spare));
+	block->crc = CCSDS_CRC16((const uint8_t *)block, offsetof(Config_Block_t, crc), 0xFFFF);
+
+	uint16_t bank = (uint16_t)(block->generation & 1U);
+	if (!dev->erase(dev->ctx, bank)
+			|| !dev->program(dev->ctx, (uint32_t)bank * FLASH_LOG_PAGE_SIZE, (const uint8_t *)block, sizeof(*block))) {
+		/* Retry into the same bank, the other one holds the last good copy */
+		block->generation--;
+		return 0;
+	}
+
+	return 1;
+}
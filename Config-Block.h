@@ -0,0 +1,59 @@
+/**
+ * @file Config-Block.h
+ * @brief Header file for the persisted configuration and calibration block.
+ * @author Kent Hong
+ *
+ * This file contains definitions and function prototypes for keeping the sensor
+ * settings, reporting thresholds, calibration and the lux factors derived from
+ * them in flash, so a reset or watchdog restart comes back with the settings
+ * uploaded from the ground instead of the compiled-in defaults.
+ *
+ * The block is stored in the native layout of Config_Block_t, so loading it is one
+ * copy of the newest valid bank, with nothing decoded or recomputed. Two banks
+ * (one flash page each) are written alternately: a save only erases the bank that
+ * holds the older copy, so power loss during a save leaves the previous block
+ * loadable. A bank is valid when magic, layout and CRC all match.
+ *
+ * @note HAL-free, flash is reached through a two-page Flash_Log_Device_t
+ *       (Flash_Log_STM32_Config_Device() on the STM32).
+ */
+
+#ifndef INC_CONFIG_BLOCK_H_
+#define INC_CONFIG_BLOCK_H_
+
+#include <stdint.h>
+#include "Flash-Log.h"
+
+#define CONFIG_BLOCK_MAGIC 0x4342         // "CB"
+#define CONFIG_BLOCK_LAYOUT 1             // Bump whenever Config_Block_t changes, older blocks are then ignored
+#define CONFIG_BLOCK_CONFIG_CODES 64      // Gain code << 3 | integration time code, as in LTR329_t.configCode
+#define CONFIG_BLOCK_DEFAULT_ALS_CONTR 0x00     // ALS_CONTR default, gain 1 (pg. 13 of LTR-329 datasheet)
+#define CONFIG_BLOCK_DEFAULT_ALS_MEAS_RATE 0x03 // ALS_MEAS_RATE default, 100 ms integration, 500 ms rate (pg. 14)
+
+/** @brief Persisted settings, ordered by alignment so there is no implicit padding */
+typedef struct {
+	uint16_t magic;               // CONFIG_BLOCK_MAGIC
+	uint16_t layout;              // CONFIG_BLOCK_LAYOUT
+	uint32_t generation;          // Incremented by every save, the newest valid bank is loaded
+	uint32_t heartbeatMs;         // Report_Deadband_t heartbeat
+	float luxCalibration;         // Window transmission correction, multiplies every lux value
+	float luxScale[CONFIG_BLOCK_CONFIG_CODES]; // luxCalibration / (gain x integration time ms), 0 for reserved gains
+	uint16_t deadbandAbsCounts;   // Report_Deadband_t absolute deadband
+	uint16_t deadbandRelPermille; // Report_Deadband_t relative deadband
+	uint8_t alsContr;             // ALS_CONTR gain bits, LTR_329_Init_Config() sets the mode bits
+	uint8_t alsMeasRate;          // ALS_MEAS_RATE integration time and repeat rate
+	uint8_t spare[8];             // Written as 0, pads the block to whole double words
+	uint16_t crc;                 // CCSDS_CRC16() of every byte before it
+} Config_Block_t;
+
+_Static_assert(sizeof(Config_Block_t) % FLASH_LOG_PROGRAM_SIZE == 0, "Config_Block_t must be whole double words");
+_Static_assert(sizeof(Config_Block_t) <= FLASH_LOG_PAGE_SIZE, "Config_Block_t must fit one page");
+
+
+/** @brief Function Prototypes for the configuration block */
+void Config_Block_Defaults(Config_Block_t *block);
+void Config_Block_Derive(Config_Block_t *block);
+uint8_t Config_Block_Load(Config_Block_t *block, const Flash_Log_Device_t *dev);
+uint8_t Config_Block_Save(Config_Block_t *block, const Flash_Log_Device_t *dev);
+
+#endif /* INC_CONFIG_BLOCK_H_ */
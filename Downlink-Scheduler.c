@@ -0,0 +1,166 @@
+/**
+ * @file Downlink-Scheduler.c
+ * @brief Implementation of the downlink-budget-aware telemetry scheduler.
+ * @author Kent Hong
+ *
+ * Slots live in one static pool and are threaded into singly linked FIFO lists,
+ * one per bucket, plus a free list. Bucket 0 has the highest priority, so the
+ * lowest set bit of nonEmpty is the next bucket to send and the highest set bit
+ * is the next bucket to evict.
+ */
+
+#include <string.h>
+#include "Downlink-Scheduler.h"
+
+_Static_assert(DOWNLINK_BUCKET_COUNT <= 16, "nonEmpty holds one bit per bucket");
+_Static_assert(DOWNLINK_SCHEDULER_SIZE < DOWNLINK_NONE, "slot indexes are 16-bit");
+
+
+/** @brief Bucket of a sample, routine levels are stored highest first */
+static uint8_t Downlink_Bucket(Downlink_Class_t sampleClass, uint8_t level) {
+	return (sampleClass == DOWNLINK_CLASS_ROUTINE) ? (uint8_t)(DOWNLINK_BUCKET_COUNT - 1 - level) : (uint8_t)sampleClass;
+}
+
+static Downlink_Class_t Downlink_Bucket_Class(uint8_t bucket) {
+	return (bucket < DOWNLINK_CLASS_ROUTINE) ? (Downlink_Class_t)bucket : DOWNLINK_CLASS_ROUTINE;
+}
+
+/** @brief Unlink the oldest slot of a non-empty bucket */
+static uint16_t Downlink_Pop(Downlink_Scheduler_t *sched, uint8_t bucket) {
+
+	uint16_t slot = sched->head[bucket];
+
+	sched->head[bucket] = sched->slots[slot].next;
+	if (sched->head[bucket] == DOWNLINK_NONE) {
+		sched->tail[bucket] = DOWNLINK_NONE;
+		sched->nonEmpty &= (uint16_t)~(1U << bucket);
+	}
+	sched->held--;
+
+	return slot;
+}
+
+static void Downlink_Free(Downlink_Scheduler_t *sched, uint16_t slot) {
+	sched->slots[slot].next = sched->freeHead;
+	sched->freeHead = slot;
+}
+
+
+/*****************************************************************
+ * @brief Initialize the scheduler                              *
+ * @param sched: Pointer to the Downlink_Scheduler_t struct     *
+ * @param apid: APID of the frames                              *
+ ****************************************************************/
+void Downlink_Scheduler_Init(Downlink_Scheduler_t *sched, uint16_t apid) {
+
+	memset(sched, 0, sizeof(*sched));
+	sched->apid = apid;
+
+	for (uint8_t b = 0; b < DOWNLINK_BUCKET_COUNT; b++) {
+		sched->head[b] = DOWNLINK_NONE;
+		sched->tail[b] = DOWNLINK_NONE;
+	}
+
+	for (uint16_t i = 0; i < DOWNLINK_SCHEDULER_SIZE; i++) {
+		sched->slots[i].next = (i + 1U < DOWNLINK_SCHEDULER_SIZE) ? (uint16_t)(i + 1U) : DOWNLINK_NONE;
+	}
+	sched->freeHead = 0;
+}
+
+
+/*****************************************************************
+ * @brief Hold a sample until a frame takes it                  *
+ * @param sched: Pointer to the Downlink_Scheduler_t struct     *
+ * @param sample: Sample to hold                                *
+ * @param sampleClass: Priority class of the sample             *
+ * @return 1 if held, 0 if refused because everything held has  *
+ *         a higher priority                                    *
+ *                                                              *
+ * A full pool evicts the oldest sample of the lowest bucket    *
+ * whose priority is not above the new sample's.                *
+ ****************************************************************/
+uint8_t Downlink_Scheduler_Add(Downlink_Scheduler_t *sched, const CCSDS_Sample_t *sample, Downlink_Class_t sampleClass) {
+
+	uint8_t level = 0;
+	if (sampleClass == DOWNLINK_CLASS_ROUTINE) {
+		/* Routine sample n goes to level ctz(n), n = 0 is the top level */
+		uint32_t n = sched->routineCount++;
+		level = (n == 0) ? (DOWNLINK_ROUTINE_LEVELS - 1) : (uint8_t)__builtin_ctz(n);
+		if (level >= DOWNLINK_ROUTINE_LEVELS) {
+			level = DOWNLINK_ROUTINE_LEVELS - 1;
+		}
+	}
+	uint8_t bucket = Downlink_Bucket(sampleClass, level);
+
+	if (sched->freeHead == DOWNLINK_NONE) {
+		uint8_t lowest = (uint8_t)(31 - __builtin_clz(sched->nonEmpty));
+		if (bucket > lowest) {
+			sched->dropped[sampleClass]++;
+			return 0;
+		}
+		Downlink_Free(sched, Downlink_Pop(sched, lowest));
+		sched->dropped[Downlink_Bucket_Class(lowest)]++;
+	}
+
+	uint16_t slot = sched->freeHead;
+	sched->freeHead = sched->slots[slot].next;
+
+	sched->slots[slot].sample = *sample;
+	sched->slots[slot].next = DOWNLINK_NONE;
+	if (sched->tail[bucket] == DOWNLINK_NONE) {
+		sched->head[bucket] = slot;
+	}
+	else {
+		sched->slots[sched->tail[bucket]].next = slot;
+	}
+	sched->tail[bucket] = slot;
+	sched->nonEmpty |= (uint16_t)(1U << bucket);
+	sched->held++;
+	sched->queued[sampleClass]++;
+
+	return 1;
+}
+
+
+/*****************************************************************
+ * @brief Fill one downlink frame within a byte budget          *
+ * @param sched: Pointer to the Downlink_Scheduler_t struct     *
+ * @param tick: Time written to the frame secondary header      *
+ * @param budget: Bytes available for the whole frame           *
+ * @param out: Buffer of at least min(budget, DOWNLINK_FRAME_MAX)*
+ *             bytes                                            *
+ * @return Frame length, 0 if nothing is held or nothing fits   *
+ *                                                              *
+ * Samples are taken highest priority first, oldest first       *
+ * within a bucket.                                             *
+ ****************************************************************/
+uint16_t Downlink_Scheduler_Build_Frame(Downlink_Scheduler_t *sched, uint32_t tick, uint16_t budget, uint8_t *out) {
+
+	if (budget > DOWNLINK_FRAME_MAX) {
+		budget = DOWNLINK_FRAME_MAX;
+	}
+	if ((budget < CCSDS_PACKET_SIZE(0) + CCSDS_TIMED_SAMPLE_SIZE) || (sched->nonEmpty == 0)) {
+		return 0;
+	}
+
+	/* Records are written in place, CCSDS_Build_Packet() moves them to the same spot */
+	uint8_t *records = &out[CCSDS_PRIMARY_HEADER_SIZE + CCSDS_SECONDARY_HEADER_SIZE];
+	uint16_t recordCount = (budget - CCSDS_PACKET_SIZE(0)) / CCSDS_TIMED_SAMPLE_SIZE;
+	uint16_t length = 0;
+
+	for (uint16_t i = 0; (i < recordCount) && (sched->nonEmpty != 0); i++) {
+		uint8_t bucket = (uint8_t)__builtin_ctz(sched->nonEmpty);
+		uint16_t slot = Downlink_Pop(sched, bucket);
+
+		CCSDS_Put_Timed_Sample(&records[length], &sched->slots[slot].sample);
+		length += CCSDS_TIMED_SAMPLE_SIZE;
+		sched->sent[Downlink_Bucket_Class(bucket)]++;
+
+		Downlink_Free(sched, slot);
+	}
+
+	uint16_t frameLength = CCSDS_Build_Packet(sched->apid, sched->seqCount, tick, 0, records, length, out);
+	sched->seqCount = (sched->seqCount + 1) & CCSDS_SEQ_COUNT_MASK;
+
+	return frameLength;
+}
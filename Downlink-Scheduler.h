@@ -0,0 +1,79 @@
+/**
+ * @file Downlink-Scheduler.h
+ * @brief Header file for the downlink-budget-aware telemetry scheduler.
+ * @author Kent Hong
+ *
+ * This file contains definitions and function prototypes for holding samples
+ * until a downlink frame is available and choosing which of them fit its byte
+ * budget. Every sample belongs to a priority class: events, quality-flagged
+ * samples and routine samples. Routine sample n is further assigned the
+ * decimation level ctz(n) (capped), so the levels from the top down form
+ * successively finer sub-series: every 128th sample, the samples halfway in
+ * between, and so on.
+ *
+ * Samples wait in FIFO buckets ordered by priority:
+ *   EVENT, QUALITY, ROUTINE level 7, ..., ROUTINE level 0
+ * A frame is filled from the highest non-empty bucket down. When the pool is
+ * full the oldest sample of the lowest non-empty bucket is evicted, so routine
+ * data loses time resolution (level 0 first) before anything important is lost.
+ * Finding a bucket is one bit scan of the non-empty mask, so selecting and
+ * evicting cost O(1) per sample, independent of the backlog.
+ *
+ * Frames are CCSDS packets on CCSDS_APID_LTR_329_TIMED, each record carries its
+ * own tick because the selected samples are not evenly spaced.
+ *
+ * @note HAL-free so the scheduler can be simulated on the host.
+ */
+
+#ifndef INC_DOWNLINK_SCHEDULER_H_
+#define INC_DOWNLINK_SCHEDULER_H_
+
+#include <stdint.h>
+#include "CCSDS-Packet.h"
+
+/** @brief Pool geometry, override at compile time if needed */
+#ifndef DOWNLINK_SCHEDULER_SIZE
+#define DOWNLINK_SCHEDULER_SIZE 256   // Samples held, at most 0xFFFE
+#endif
+#define DOWNLINK_ROUTINE_LEVELS 8     // Decimation levels of routine samples
+#define DOWNLINK_BUCKET_COUNT (2 + DOWNLINK_ROUTINE_LEVELS)
+#define DOWNLINK_NONE 0xFFFF          // End of a bucket list
+#define DOWNLINK_FRAME_MAX CCSDS_PACKET_LIMIT // Largest frame the scheduler builds
+
+/** @brief Priority classes, highest first */
+typedef enum {
+	DOWNLINK_CLASS_EVENT = 0,  // Sample tied to an event (threshold interrupt, configuration change)
+	DOWNLINK_CLASS_QUALITY,    // Sample with quality flags set
+	DOWNLINK_CLASS_ROUTINE,    // Everything else, decimated under pressure
+	DOWNLINK_CLASS_COUNT
+} Downlink_Class_t;
+
+/** @brief One held sample */
+typedef struct {
+	CCSDS_Sample_t sample;
+	uint16_t next;             // Next slot in the same bucket or the free list
+} Downlink_Slot_t;
+
+/** @brief Struct to store the scheduler state */
+typedef struct {
+	Downlink_Slot_t slots[DOWNLINK_SCHEDULER_SIZE];
+	uint16_t head[DOWNLINK_BUCKET_COUNT];  // Oldest sample of each bucket
+	uint16_t tail[DOWNLINK_BUCKET_COUNT];  // Newest sample of each bucket
+	uint16_t freeHead;                     // First free slot
+	uint16_t nonEmpty;                     // Bit b set while bucket b holds samples
+	uint16_t held;                         // Samples currently held
+	uint32_t routineCount;                 // Routine samples seen, selects the decimation level
+	uint16_t apid;                         // APID of the frames
+	uint16_t seqCount;                     // Sequence count of the next frame
+	uint32_t queued[DOWNLINK_CLASS_COUNT]; // Samples accepted per class
+	uint32_t sent[DOWNLINK_CLASS_COUNT];   // Samples sent per class
+	uint32_t dropped[DOWNLINK_CLASS_COUNT];// Samples evicted or refused per class
+} Downlink_Scheduler_t;
+
+
+/** @brief Function Prototypes for the downlink scheduler */
+void Downlink_Scheduler_Init(Downlink_Scheduler_t *sched, uint16_t apid);
+uint8_t Downlink_Scheduler_Add(Downlink_Scheduler_t *sched, const CCSDS_Sample_t *sample, Downlink_Class_t sampleClass);
+uint16_t Downlink_Scheduler_Build_Frame(Downlink_Scheduler_t *sched, uint32_t tick, uint16_t budget, uint8_t *out);
+
+#endif /* INC_DOWNLINK_SCHEDULER_H_ */
@@ -0,0 +1,113 @@
+/**
+ * @file Error-Log.c
+ * @brief Implementation of the deferred error event log.
+ * @author Kent Hong
+ *
+ * Error paths call Error_Log_Record() instead of formatting and transmitting a
+ * message, so a flaky bus no longer adds UART time to its own latency.
+ *
+ * @note When the ring is full the oldest event is overwritten, the counters still see every error.
+ */
+
+#include "Error-Log.h"
+
+#if (ERROR_LOG_SIZE & (ERROR_LOG_SIZE - 1)) != 0
+#error "ERROR_LOG_SIZE must be a power of two"
+#endif
+
+/** @brief Error ring and counters, a single log is shared by every driver instance */
+static Error_Event_t errorRing[ERROR_LOG_SIZE];
+static uint16_t errorHead;                        // Index of the next event to write (free running)
+static uint16_t errorTail;                        // Index of the next event to read (free running)
+static uint16_t errorCounts[ERROR_CODE_COUNT];    // Saturating count per error code
+static uint16_t errorOverwritten;                 // Saturating count of events lost to overwrite
+
+
+/*****************************************************************
+ * @brief Record an error event                                 *
+ * @param code: Error code                                      *
+ * @param regAddr: Register involved, 0 if none                 *
+ * @param status: HAL status of the failed transfer             *
+ * @param value: Code-specific detail                           *
+ ****************************************************************/
+void Error_Log_Record(Error_Code_t code, uint8_t regAddr, HAL_StatusTypeDef status, uint8_t value) {
+
+	if (errorCounts[code] != UINT16_MAX) {
+		errorCounts[code]++;
+	}
+
+	/* Full ring, drop the oldest event */
+	if ((uint16_t)(errorHead - errorTail) == ERROR_LOG_SIZE) {
+		errorTail++;
+		if (errorOverwritten != UINT16_MAX) {
+			errorOverwritten++;
+		}
+	}
+
+	Error_Event_t *event = &errorRing[errorHead & (ERROR_LOG_SIZE - 1)];
+	event->tick = HAL_GetTick();
+	event->code = (uint8_t)code;
+	event->regAddr = regAddr;
+	event->status = (uint8_t)status;
+	event->value = value;
+	errorHead++;
+}
+
+
+/*****************************************************************
+ * @brief Remove the oldest event from the ring                 *
+ * @param event: Pointer to store the event                     *
+ * @return 1 if an event was returned, 0 if the ring is empty   *
+ ****************************************************************/
+uint8_t Error_Log_Pop(Error_Event_t *event) {
+
+	if (errorHead == errorTail) {
+		return 0;
+	}
+
+	*event = errorRing[errorTail & (ERROR_LOG_SIZE - 1)];
+	errorTail++;
+
+	return 1;
+}
+
+
+/*****************************************************************
+ * @brief Serialize queued events for telemetry                 *
+ * @param dest: Buffer of maxEvents x ERROR_LOG_EVENT_SIZE      *
+ * @param maxEvents: Maximum number of events to drain          *
+ * @return Number of bytes written                              *
+ *                                                              *
+ * Each event is written big-endian: uint32 tick, code,         *
+ * register, status, value.                                     *
+ ****************************************************************/
+uint16_t Error_Log_Drain(uint8_t *dest, uint16_t maxEvents) {
+
+	Error_Event_t event;
+	uint16_t length = 0;
+
+	while ((maxEvents-- > 0) && Error_Log_Pop(&event)) {
+		dest[length++] = (uint8_t)(event.tick >> 24);
+		dest[length++] = (uint8_t)(event.tick >> 16);
+		dest[length++] = (uint8_t)(event.tick >> 8);
+		dest[length++] = (uint8_t)event.tick;
+		dest[length++] = event.code;
+		dest[length++] = event.regAddr;
+		dest[length++] = event.status;
+		dest[length++] = event.value;
+	}
+
+	return length;
+}
+
+
+/** @brief Number of times an error code has been recorded, saturates at UINT16_MAX */
+uint16_t Error_Log_Get_Count(Error_Code_t code) {
+	return errorCounts[code];
+}
+
+
+/** @brief Number of events lost because the ring was full, saturates at UINT16_MAX */
+uint16_t Error_Log_Get_Overwritten(void) {
+	return errorOverwritten;
+}
@@ -0,0 +1,59 @@
+/**
+ * @file Error-Log.h
+ * @brief Header file for the deferred error event log.
+ * @author Kent Hong
+ *
+ * This file contains definitions and function prototypes for recording error
+ * events into a fixed ring with saturating per-error counters. Recording costs a
+ * few stores, the ring is drained later by the telemetry path.
+ *
+ * @note Record and drain from the same execution context (main loop), the ring is not locked.
+ */
+
+#ifndef INC_ERROR_LOG_H_
+#define INC_ERROR_LOG_H_
+
+#include <stdint.h>
+#include "stm32L4xx_hal.h" // Adjust this include based on your STM32 series
+
+/** @brief Number of events held before the oldest is overwritten, must be a power of two */
+#ifndef ERROR_LOG_SIZE
+#define ERROR_LOG_SIZE 16
+#endif
+
+/** @brief Size of one serialized event: tick, code, register, status, value */
+#define ERROR_LOG_EVENT_SIZE 8
+
+/** @brief Error codes */
+typedef enum {
+	ERROR_I2C_READ = 0,      // Register read failed
+	ERROR_I2C_WRITE,         // Register write failed
+	ERROR_RESET_TIMEOUT,     // PART_ID did not answer after SW reset
+	ERROR_WAKEUP_TIMEOUT,    // No valid sample after Stand-by -> Active
+	ERROR_UNKNOWN_PART,      // PART_ID not recognized
+	ERROR_INVALID_GAIN,      // Reserved ALS gain code, value holds the code
+	ERROR_INVALID_INT_TIME,  // Reserved integration time code, value holds the code
+	ERROR_CONFIG_REPAIRED,   // Scrubbing rewrote a register, value holds the upset read-back
+	ERROR_FLASH_ERASE,       // Flash-Log page erase failed, value holds the log page
+	ERROR_FLASH_PROGRAM,     // Flash-Log page program failed, value holds the log page
+	ERROR_CODE_COUNT
+} Error_Code_t;
+
+/** @brief One error event */
+typedef struct {
+	uint32_t tick;    // HAL_GetTick() when the error was recorded
+	uint8_t code;     // Error_Code_t
+	uint8_t regAddr;  // Register involved, 0 if none
+	uint8_t status;   // HAL_StatusTypeDef of the failed transfer
+	uint8_t value;    // Code-specific detail
+} Error_Event_t;
+
+
+/** @brief Function Prototypes for the error log */
+void Error_Log_Record(Error_Code_t code, uint8_t regAddr, HAL_StatusTypeDef status, uint8_t value);
+uint8_t Error_Log_Pop(Error_Event_t *event);
+uint16_t Error_Log_Drain(uint8_t *dest, uint16_t maxEvents);
+uint16_t Error_Log_Get_Count(Error_Code_t code);
+uint16_t Error_Log_Get_Overwritten(void);
+
+#endif /* INC_ERROR_LOG_H_ */
@@ -0,0 +1,131 @@
+/**
+ * @file Flash-Log-STM32.c
+ * @brief Implementation of the STM32L4 internal flash device of the sample log.
+ * @author Kent Hong
+ *
+ * Erase and program go through the HAL with the flash unlocked only for the
+ * duration of one call. Reads are plain memory reads of the mapped region. The
+ * log and the configuration block share the functions, the device context
+ * selects the region.
+ */
+
+#include <string.h>
+#include "Flash-Log-STM32.h"
+#include "Error-Log.h"
+
+/** @brief First byte of a region starting at page firstPage of the bank */
+#define FLASH_LOG_STM32_BASE(firstPage) (FLASH_BASE + ((FLASH_LOG_STM32_BANK == FLASH_BANK_2) ? FLASH_BANK_SIZE : 0U) \
+		+ (uint32_t)(firstPage) * FLASH_PAGE_SIZE)
+
+/** @brief Flash region behind a device, passed as the device context */
+typedef struct {
+	uintptr_t base;      // First byte of the region
+	uint16_t firstPage;  // First page of the region within the bank
+} Flash_Log_STM32_Region_t;
+
+static Flash_Log_STM32_Region_t logRegion = { FLASH_LOG_STM32_BASE(FLASH_LOG_STM32_FIRST_PAGE), FLASH_LOG_STM32_FIRST_PAGE };
+static Flash_Log_STM32_Region_t configRegion = { FLASH_LOG_STM32_BASE(FLASH_LOG_STM32_CONFIG_FIRST_PAGE), FLASH_LOG_STM32_CONFIG_FIRST_PAGE };
+
+static volatile uint8_t eccError; // Set by Flash_Log_STM32_NMI() during a read
+
+
+static uint8_t Flash_Log_STM32_Erase(void *ctx, uint16_t page) {
+
+	const Flash_Log_STM32_Region_t *region = ctx;
+	FLASH_EraseInitTypeDef erase = { 0 };
+	uint32_t pageError;
+
+	erase.TypeErase = FLASH_TYPEERASE_PAGES;
+	erase.Banks = FLASH_LOG_STM32_BANK;
+	erase.Page = region->firstPage + page;
+	erase.NbPages = 1;
+
+	HAL_FLASH_Unlock();
+	__HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+	HAL_StatusTypeDef status = HAL_FLASHEx_Erase(&erase, &pageError);
+	HAL_FLASH_Lock();
+
+	if (status != HAL_OK) {
+		Error_Log_Record(ERROR_FLASH_ERASE, 0, status, (uint8_t)erase.Page);
+		return 0;
+	}
+
+	return 1;
+}
+
+static uint8_t Flash_Log_STM32_Program(void *ctx, uint32_t offset, const uint8_t *data, uint16_t length) {
+
+	const Flash_Log_STM32_Region_t *region = ctx;
+	HAL_StatusTypeDef status = HAL_OK;
+
+	HAL_FLASH_Unlock();
+	__HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+	for (uint16_t i = 0; (i < length) && (status == HAL_OK); i += FLASH_LOG_PROGRAM_SIZE) {
+		uint64_t doubleWord;
+		memcpy(&doubleWord, &data[i], sizeof(doubleWord));
+		status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, region->base + offset + i, doubleWord);
+	}
+	HAL_FLASH_Lock();
+
+	if (status != HAL_OK) {
+		Error_Log_Record(ERROR_FLASH_PROGRAM, 0, status, (uint8_t)(region->firstPage + offset / FLASH_PAGE_SIZE));
+		return 0;
+	}
+
+	return 1;
+}
+
+static uint8_t Flash_Log_STM32_Read(void *ctx, uint32_t offset, uint8_t *data, uint16_t length) {
+
+	const Flash_Log_STM32_Region_t *region = ctx;
+	eccError = 0;
+	memcpy(data, (const uint8_t *)(region->base + offset), length);
+
+	/* A torn double word fails ECC, the NMI handler reports it through eccError */
+	return !eccError;
+}
+
+static const Flash_Log_Device_t flashLogDevice = {
+	Flash_Log_STM32_Erase,
+	Flash_Log_STM32_Program,
+	Flash_Log_STM32_Read,
+	&logRegion,
+	FLASH_LOG_STM32_PAGES
+};
+
+static const Flash_Log_Device_t configBlockDevice = {
+	Flash_Log_STM32_Erase,
+	Flash_Log_STM32_Program,
+	Flash_Log_STM32_Read,
+	&configRegion,
+	2
+};
+
+
+/** @brief Device handle for Flash_Log_Mount() */
+const Flash_Log_Device_t *Flash_Log_STM32_Device(void) {
+	return &flashLogDevice;
+}
+
+
+/** @brief Device handle for Config_Block_Load() and Config_Block_Save(), one page per bank */
+const Flash_Log_Device_t *Flash_Log_STM32_Config_Device(void) {
+	return &configBlockDevice;
+}
+
+
+/*****************************************************************
+ * @brief Acknowledge a flash ECC double error from NMI_Handler()*
+ * @return 1 if the NMI was a flash ECC error and was cleared,  *
+ *         0 if it has another cause                            *
+ ****************************************************************/
+uint8_t Flash_Log_STM32_NMI(void) {
+
+	if (__HAL_FLASH_GET_FLAG(FLASH_FLAG_ECCD)) {
+		__HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ECCD);
+		eccError = 1;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,55 @@
+/**
+ * @file Flash-Log-STM32.h
+ * @brief Header file for the STM32L4 internal flash device of the sample log.
+ * @author Kent Hong
+ *
+ * This file contains the region definitions and the function prototype that
+ * connect Flash-Log.h to the internal flash of the STM32L476. By default the log
+ * takes the last 64 pages (128 KB) of bank 2, so the firmware keeps running from
+ * bank 1 while the log is erased or programmed.
+ *
+ * At 170 records per page the default region holds 10880 samples, and every
+ * page is erased once per 10880 logged samples. At 10k erase cycles (pg. 180 of
+ * the STM32L476 datasheet) that is 108 million samples, more than 2 years of one
+ * sample every 600 ms without deadband reporting.
+ *
+ * The two pages below the log hold the two banks of the configuration block
+ * (Config-Block.h), written only when new settings are saved.
+ *
+ * @note Both regions must be excluded from the linker script FLASH memory region.
+ *       A torn double word reads back with an ECC error, so NMI_Handler() must
+ *       clear FLASH_FLAG_ECCD and return instead of halting (see Flash_Log_STM32_NMI()).
+ */
+
+#ifndef INC_FLASH_LOG_STM32_H_
+#define INC_FLASH_LOG_STM32_H_
+
+#include <stdint.h>
+#include "stm32L4xx_hal.h" // Adjust this include based on your STM32 series
+#include "Flash-Log.h"
+
+/** @brief Log region, override at compile time if needed */
+#ifndef FLASH_LOG_STM32_BANK
+#define FLASH_LOG_STM32_BANK FLASH_BANK_2
+#endif
+#ifndef FLASH_LOG_STM32_FIRST_PAGE
+#define FLASH_LOG_STM32_FIRST_PAGE 192   // First page within the bank
+#endif
+#ifndef FLASH_LOG_STM32_PAGES
+#define FLASH_LOG_STM32_PAGES 64
+#endif
+#ifndef FLASH_LOG_STM32_CONFIG_FIRST_PAGE
+#define FLASH_LOG_STM32_CONFIG_FIRST_PAGE 190 // Two pages for the configuration block banks
+#endif
+
+_Static_assert(FLASH_LOG_PAGE_SIZE == FLASH_PAGE_SIZE, "log pages must match the flash pages");
+_Static_assert((FLASH_LOG_STM32_CONFIG_FIRST_PAGE + 2 <= FLASH_LOG_STM32_FIRST_PAGE)
+		|| (FLASH_LOG_STM32_CONFIG_FIRST_PAGE >= FLASH_LOG_STM32_FIRST_PAGE + FLASH_LOG_STM32_PAGES), "configuration pages must not overlap the log");
+
+
+/** @brief Function Prototypes for the STM32 flash device */
+const Flash_Log_Device_t *Flash_Log_STM32_Device(void);
+const Flash_Log_Device_t *Flash_Log_STM32_Config_Device(void);
+uint8_t Flash_Log_STM32_NMI(void);
+
+#endif /* INC_FLASH_LOG_STM32_H_ */
@@ -0,0 +1,334 @@
+/**
+ * @file Flash-Log.c
+ * @brief Implementation of the wear-leveled flash sample log.
+ * @author Kent Hong
+ *
+ * Only two kinds of flash writes happen: erasing the page that holds the oldest
+ * data, then programming it once from the RAM batch. A page is never programmed
+ * twice between erases, which the STM32L4 ECC requires anyway. The records are
+ * programmed before the header, so a page whose write was cut stays invisible
+ * and the same page is written again after the reboot.
+ */
+
+#include <string.h>
+#include "Flash-Log.h"
+
+_Static_assert(FLASH_LOG_HEADER_SIZE % FLASH_LOG_PROGRAM_SIZE == 0, "records start on a double word");
+
+/** @brief Result of reading one record slot */
+#define FLASH_LOG_SLOT_VALID 1
+#define FLASH_LOG_SLOT_ERASED 0
+#define FLASH_LOG_SLOT_CORRUPT (-1)
+
+
+static uint16_t Flash_Log_Get16(const uint8_t *src) {
+	return (uint16_t)((src[0] << 8) | src[1]);
+}
+
+static void Flash_Log_Put16(uint8_t *dest, uint16_t value) {
+	dest[0] = (uint8_t)(value >> 8);
+	dest[1] = (uint8_t)value;
+}
+
+/** @brief Read and validate a page header, returns 1 with its sequence if valid */
+static uint8_t Flash_Log_Page_Seq(const Flash_Log_t *log, uint16_t page, uint32_t *seq) {
+
+	uint8_t header[FLASH_LOG_HEADER_SIZE];
+
+	if (!log->dev->read(log->dev->ctx, (uint32_t)page * FLASH_LOG_PAGE_SIZE, header, sizeof(header))) {
+		return 0;
+	}
+	if ((Flash_Log_Get16(&header[0]) != FLASH_LOG_MAGIC) || (CCSDS_CRC16(header, 6, 0xFFFF) != Flash_Log_Get16(&header[6]))) {
+		return 0;
+	}
+
+	*seq = ((uint32_t)header[2] << 24) | ((uint32_t)header[3] << 16) | ((uint32_t)header[4] << 8) | header[5];
+	return 1;
+}
+
+/** @brief Read one record slot of the page holding pageSeq */
+static int8_t Flash_Log_Read_Record(const Flash_Log_t *log, uint32_t pageSeq, uint16_t record, CCSDS_Sample_t *sample) {
+
+	uint8_t slot[FLASH_LOG_RECORD_SIZE];
+	uint32_t offset = (pageSeq % log->dev->pageCount) * FLASH_LOG_PAGE_SIZE + FLASH_LOG_HEADER_SIZE + (uint32_t)record * FLASH_LOG_RECORD_SIZE;
+
+	if (!log->dev->read(log->dev->ctx, offset, slot, sizeof(slot))) {
+		return FLASH_LOG_SLOT_CORRUPT;
+	}
+
+	uint8_t erased = 0xFF;
+	for (uint8_t i = 0; i < sizeof(slot); i++) {
+		erased &= slot[i];
+	}
+	if (erased == 0xFF) {
+		return FLASH_LOG_SLOT_ERASED;
+	}
+	if (CCSDS_CRC16(slot, CCSDS_TIMED_SAMPLE_SIZE, 0xFFFF) != Flash_Log_Get16(&slot[CCSDS_TIMED_SAMPLE_SIZE])) {
+		return FLASH_LOG_SLOT_CORRUPT;
+	}
+
+	CCSDS_Get_Timed_Sample(slot, sample);
+	return FLASH_LOG_SLOT_VALID;
+}
+
+/** @brief Find the newest valid record, in the head page or, if that is torn empty, the page before */
+static void Flash_Log_Find_Latest(Flash_Log_t *log) {
+
+	log->hasLatest = 0;
+	log->nextSeq = (log->headSeq == FLASH_LOG_NO_PAGE) ? 0 : log->headSeq + 1;
+
+	for (uint32_t seq = log->headSeq; (seq != FLASH_LOG_NO_PAGE) && (log->headSeq - seq < 2U); seq--) {
+		/* Records are programmed in order, so the written slots are a prefix of the page */
+		uint16_t lo = 0;
+		uint16_t hi = FLASH_LOG_RECORDS_PER_PAGE;
+		while (lo < hi) {
+			uint16_t mid = (uint16_t)((lo + hi) / 2);
+			if (Flash_Log_Read_Record(log, seq, mid, &log->latest) == FLASH_LOG_SLOT_ERASED) {
+				hi = mid;
+			}
+			else {
+				lo = (uint16_t)(mid + 1);
+			}
+		}
+
+		/* Step back over a torn tail */
+		while (lo-- > 0) {
+			if (Flash_Log_Read_Record(log, seq, lo, &log->latest) == FLASH_LOG_SLOT_VALID) {
+				log->hasLatest = 1;
+				return;
+			}
+		}
+
+		/* A head page without records (e.g. corrupted since) is rewritten, erasing the oldest page
+		 * instead would lose the only copy of the newest records when the log has two pages */
+		if (seq == log->headSeq) {
+			log->nextSeq = seq;
+		}
+
+		uint32_t prevSeq;
+		if ((seq == 0) || !Flash_Log_Page_Seq(log, (uint16_t)((seq - 1) % log->dev->pageCount), &prevSeq) || (prevSeq != seq - 1)) {
+			return;
+		}
+	}
+}
+
+
+/*****************************************************************
+ * @brief Attach to the log on a device and find its newest page*
+ * @param log: Pointer to the Flash_Log_t struct                *
+ * @param dev: Flash device holding the log                     *
+ * @return 1 on success, 0 if the device failed                 *
+ *                                                              *
+ * Layouts that break the page = sequence % pageCount rule      *
+ * (e.g. after resizing the region) are formatted.              *
+ ****************************************************************/
+uint8_t Flash_Log_Mount(Flash_Log_t *log, const Flash_Log_Device_t *dev) {
+
+	memset(log, 0, sizeof(*log));
+	memset(log->page, 0xFF, sizeof(log->page));
+	log->dev = dev;
+	log->headSeq = FLASH_LOG_NO_PAGE;
+
+	uint16_t pageCount = dev->pageCount;
+	uint32_t seq0;
+	uint32_t seq;
+
+	if (Flash_Log_Page_Seq(log, 0, &seq0)) {
+		if ((seq0 % pageCount) != 0) {
+			return Flash_Log_Format(log);
+		}
+
+		/* Pages 0..head of the current lap hold seq0 + page, later pages are older or erased */
+		uint16_t lo = 0;
+		uint16_t hi = pageCount - 1;
+		while (lo < hi) {
+			uint16_t mid = (uint16_t)(lo + (hi - lo + 1) / 2);
+			if (Flash_Log_Page_Seq(log, mid, &seq) && (seq == seq0 + mid)) {
+				lo = mid;
+			}
+			else {
+				hi = (uint16_t)(mid - 1);
+			}
+		}
+		log->headSeq = seq0 + lo;
+	}
+	else if (Flash_Log_Page_Seq(log, pageCount - 1, &seq) && ((seq % pageCount) == (uint32_t)(pageCount - 1))) {
+		/* Power was lost while page 0 started the next lap */
+		log->headSeq = seq;
+	}
+	else if (Flash_Log_Page_Seq(log, 1, &seq)) {
+		/* Page 1 cannot be valid without page 0 or the last page */
+		return Flash_Log_Format(log);
+	}
+
+	Flash_Log_Find_Latest(log);
+
+	return 1;
+}
+
+
+/*****************************************************************
+ * @brief Erase every page of the log                           *
+ * @param log: Pointer to a mounted Flash_Log_t struct          *
+ * @return 1 on success, 0 if an erase failed                   *
+ *                                                              *
+ * Records still in the RAM batch are kept.                     *
+ ****************************************************************/
+uint8_t Flash_Log_Format(Flash_Log_t *log) {
+
+	uint8_t ok = 1;
+
+	for (uint16_t page = 0; page < log->dev->pageCount; page++) {
+		if (!log->dev->erase(log->dev->ctx, page)) {
+			ok = 0;
+		}
+	}
+
+	log->headSeq = FLASH_LOG_NO_PAGE;
+	log->nextSeq = 0;
+	log->hasLatest = 0;
+
+	return ok;
+}
+
+
+/*****************************************************************
+ * @brief Add a sample to the batch, a full batch is written    *
+ * @param log: Pointer to a mounted Flash_Log_t struct          *
+ * @param sample: Sample to log                                 *
+ * @return 0 if writing the full batch failed, 1 otherwise      *
+ ****************************************************************/
+uint8_t Flash_Log_Append(Flash_Log_t *log, const CCSDS_Sample_t *sample) {
+
+	uint8_t *record = &log->page[FLASH_LOG_HEADER_SIZE + log->batched * FLASH_LOG_RECORD_SIZE];
+
+	CCSDS_Put_Timed_Sample(record, sample);
+	Flash_Log_Put16(&record[CCSDS_TIMED_SAMPLE_SIZE], CCSDS_CRC16(record, CCSDS_TIMED_SAMPLE_SIZE, 0xFFFF));
+	log->batched++;
+
+	if (log->batched == FLASH_LOG_RECORDS_PER_PAGE) {
+		return Flash_Log_Flush(log);
+	}
+
+	return 1;
+}
+
+
+/*****************************************************************
+ * @brief Write the batch to the next page                      *
+ * @param log: Pointer to a mounted Flash_Log_t struct          *
+ * @return 1 on success or an empty batch, 0 if the erase or    *
+ *         program failed                                       *
+ *                                                              *
+ * A partial batch still uses a whole page. On failure the      *
+ * batch is dropped and the same page is retried next time, so  *
+ * the sequence of valid pages never has a hole.                *
+ ****************************************************************/
+uint8_t Flash_Log_Flush(Flash_Log_t *log) {
+
+	if (log->batched == 0) {
+		return 1;
+	}
+
+	uint32_t seq = log->nextSeq;
+	uint16_t pageIndex = (uint16_t)(seq % log->dev->pageCount);
+
+	Flash_Log_Put16(&log->page[0], FLASH_LOG_MAGIC);
+	log->page[2] = (uint8_t)(seq >> 24);
+	log->page[3] = (uint8_t)(seq >> 16);
+	log->page[4] = (uint8_t)(seq >> 8);
+	log->page[5] = (uint8_t)seq;
+	Flash_Log_Put16(&log->page[6], CCSDS_CRC16(log->page, 6, 0xFFFF));
+
+	/* The tail of the last double word is already erased-state padding */
+	uint16_t length = FLASH_LOG_HEADER_SIZE + log->batched * FLASH_LOG_RECORD_SIZE;
+	length = (uint16_t)((length + FLASH_LOG_PROGRAM_SIZE - 1) & ~(FLASH_LOG_PROGRAM_SIZE - 1));
+
+	/* Header last, it commits the page. Erasing the oldest page while the head page is torn would lose
+	 * the newest flushed records when the log has two pages */
+	uint32_t offset = (uint32_t)pageIndex * FLASH_LOG_PAGE_SIZE;
+	uint8_t ok = log->dev->erase(log->dev->ctx, pageIndex)
+			&& log->dev->program(log->dev->ctx, offset + FLASH_LOG_HEADER_SIZE, &log->page[FLASH_LOG_HEADER_SIZE], length - FLASH_LOG_HEADER_SIZE)
+			&& log->dev->program(log->dev->ctx, offset, log->page, FLASH_LOG_HEADER_SIZE);
+
+	if (ok) {
+		CCSDS_Get_Timed_Sample(&log->page[FLASH_LOG_HEADER_SIZE + (log->batched - 1) * FLASH_LOG_RECORD_SIZE], &log->latest);
+		log->hasLatest = 1;
+		log->headSeq = seq;
+		log->nextSeq = seq + 1;
+		log->pagesWritten++;
+		log->bytesProgrammed += length;
+		log->recordsWritten += log->batched;
+	}
+	else if (log->writeErrors != UINT16_MAX) {
+		log->writeErrors++;
+	}
+
+	log->batched = 0;
+	memset(log->page, 0xFF, sizeof(log->page));
+
+	return ok;
+}
+
+
+/*****************************************************************
+ * @brief Start reading at the oldest page still in flash       *
+ * @param log: Pointer to a mounted Flash_Log_t struct          *
+ * @param reader: Pointer to the Flash_Log_Reader_t struct      *
+ ****************************************************************/
+void Flash_Log_Reader_Init(const Flash_Log_t *log, Flash_Log_Reader_t *reader) {
+
+	reader->record = 0;
+
+	if (log->headSeq == FLASH_LOG_NO_PAGE) {
+		reader->pageSeq = 0;
+	}
+	else {
+		reader->pageSeq = (log->headSeq + 1U >= log->dev->pageCount) ? log->headSeq + 1U - log->dev->pageCount : 0;
+	}
+}
+
+
+/*****************************************************************
+ * @brief Read the next valid record                            *
+ * @param log: Pointer to a mounted Flash_Log_t struct          *
+ * @param reader: Pointer to the Flash_Log_Reader_t struct      *
+ * @param sample: Pointer to store the sample                   *
+ * @return 1 if a sample was returned, 0 at the end of the log  *
+ *                                                              *
+ * Corrupt records are skipped. A reader that fell a whole lap  *
+ * behind the writer continues at the oldest page.              *
+ ****************************************************************/
+uint8_t Flash_Log_Reader_Next(const Flash_Log_t *log, Flash_Log_Reader_t *reader, CCSDS_Sample_t *sample) {
+
+	while ((log->headSeq != FLASH_LOG_NO_PAGE) && (reader->pageSeq <= log->headSeq)) {
+
+		if (log->headSeq - reader->pageSeq >= log->dev->pageCount) {
+			reader->pageSeq = log->headSeq + 1U - log->dev->pageCount;
+			reader->record = 0;
+		}
+
+		uint32_t seq;
+		if ((reader->record == 0)
+				&& (!Flash_Log_Page_Seq(log, (uint16_t)(reader->pageSeq % log->dev->pageCount), &seq) || (seq != reader->pageSeq))) {
+			reader->pageSeq++;
+			continue;
+		}
+
+		while (reader->record < FLASH_LOG_RECORDS_PER_PAGE) {
+			int8_t result = Flash_Log_Read_Record(log, reader->pageSeq, reader->record, sample);
+			reader->record++;
+			if (result == FLASH_LOG_SLOT_VALID) {
+				return 1;
+			}
+			if (result == FLASH_LOG_SLOT_ERASED) {
+				break;
+			}
+		}
+
+		reader->pageSeq++;
+		reader->record = 0;
+	}
+
+	return 0;
+}
@@ -0,0 +1,84 @@
+/**
+ * @file Flash-Log.h
+ * @brief Header file for the wear-leveled flash sample log.
+ * @author Kent Hong
+ *
+ * This file contains definitions and function prototypes for a log-structured
+ * sample store on page-erasable flash. Samples are batched in RAM and written one
+ * whole page at a time, pages are used round-robin so every page is erased once
+ * per lap of the log (wear leveling without a mapping table).
+ *
+ * Page layout, all fields big-endian:
+ *   Header    8 bytes  uint16 magic, uint32 page sequence, uint16 CRC of the first 6 bytes
+ *   Records  12 bytes  10-byte timed sample (CCSDS_Put_Timed_Sample()), uint16 CRC
+ * The page with sequence s always lives at page s % pageCount, so the valid pages
+ * of the current lap form a prefix whose sequences step by one. Mount finds the
+ * newest page with a binary search over that prefix and the newest record with a
+ * binary search over the written records of that page, O(log n) reads in total.
+ *
+ * Power loss leaves at most one torn page. The header is programmed after the
+ * records, so a torn page has no valid header and the next flush writes the same
+ * page again. The head page is never erased before the page after it is whole,
+ * so the last flushed sample survives even in a 2-page log. Samples still in the
+ * RAM batch are lost, call Flash_Log_Flush() before a planned reset.
+ *
+ * @note HAL-free, the flash is reached through a Flash_Log_Device_t so the same
+ *       code runs on the STM32 (Flash-Log-STM32.h) and on the file-backed
+ *       emulator in tools/flash-log-sim.c.
+ */
+
+#ifndef INC_FLASH_LOG_H_
+#define INC_FLASH_LOG_H_
+
+#include <stdint.h>
+#include "CCSDS-Packet.h"
+
+/** @brief Log geometry */
+#define FLASH_LOG_PAGE_SIZE 2048      // STM32L4 flash page
+#define FLASH_LOG_PROGRAM_SIZE 8      // Programming granularity, one double word
+#define FLASH_LOG_HEADER_SIZE 8
+#define FLASH_LOG_RECORD_SIZE (CCSDS_TIMED_SAMPLE_SIZE + 2)
+#define FLASH_LOG_RECORDS_PER_PAGE ((FLASH_LOG_PAGE_SIZE - FLASH_LOG_HEADER_SIZE) / FLASH_LOG_RECORD_SIZE)
+#define FLASH_LOG_MAGIC 0x534C        // "SL"
+#define FLASH_LOG_NO_PAGE 0xFFFFFFFFU // Sequence of an empty log
+
+/** @brief Flash access, every function returns 1 on success */
+typedef struct {
+	uint8_t (*erase)(void *ctx, uint16_t page);
+	uint8_t (*program)(void *ctx, uint32_t offset, const uint8_t *data, uint16_t length); // offset and length multiples of FLASH_LOG_PROGRAM_SIZE
+	uint8_t (*read)(void *ctx, uint32_t offset, uint8_t *data, uint16_t length);
+	void *ctx;            // Passed to every function
+	uint16_t pageCount;   // Pages reserved for the log, at least 2
+} Flash_Log_Device_t;
+
+/** @brief Struct to store the log state */
+typedef struct {
+	const Flash_Log_Device_t *dev;
+	uint8_t page[FLASH_LOG_PAGE_SIZE] __attribute__((aligned(8))); // Batch of the next page
+	uint16_t batched;       // Records in the batch
+	uint32_t headSeq;       // Sequence of the newest page in flash, FLASH_LOG_NO_PAGE if none
+	uint32_t nextSeq;       // Sequence of the next page written
+	uint8_t hasLatest;      // 1 if latest holds a record
+	CCSDS_Sample_t latest;  // Newest record in flash
+	uint32_t pagesWritten;  // Pages written since mount
+	uint32_t bytesProgrammed; // Bytes programmed since mount, including headers and padding
+	uint32_t recordsWritten;  // Records programmed since mount
+	uint16_t writeErrors;   // Saturating count of failed erases or programs
+} Flash_Log_t;
+
+/** @brief Sequential reader, oldest record first */
+typedef struct {
+	uint32_t pageSeq;       // Page being read
+	uint16_t record;        // Next record in that page
+} Flash_Log_Reader_t;
+
+
+/** @brief Function Prototypes for the flash sample log */
+uint8_t Flash_Log_Mount(Flash_Log_t *log, const Flash_Log_Device_t *dev);
+uint8_t Flash_Log_Format(Flash_Log_t *log);
+uint8_t Flash_Log_Append(Flash_Log_t *log, const CCSDS_Sample_t *sample);
+uint8_t Flash_Log_Flush(Flash_Log_t *log);
+void Flash_Log_Reader_Init(const Flash_Log_t *log, Flash_Log_Reader_t *reader);
+uint8_t Flash_Log_Reader_Next(const Flash_Log_t *log, Flash_Log_Reader_t *reader, CCSDS_Sample_t *sample);
+
+#endif /* INC_FLASH_LOG_H_ */
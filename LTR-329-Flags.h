@@ -0,0 +1,24 @@
+/**
+ * @file LTR-329-Flags.h
+ * @brief Per-sample quality flags of the LTR-329 driver.
+ * @author Kent Hong
+ *
+ * The flags travel with every sample (CCSDS_Sample_t.flags), so the modules that
+ * filter, pack or archive samples test them too. They are kept apart from
+ * LTR-329.h, which needs the HAL, so those modules and the host tools can
+ * include them directly instead of copying the values.
+ */
+
+#ifndef INC_LTR_329_FLAGS_H_
+#define INC_LTR_329_FLAGS_H_
+
+/** @brief Per-sample quality flags set by LTR_329_Read_All() */
+#define LTR_329_FLAG_I2C_ERROR 0x01        // At least one register read failed
+#define LTR_329_FLAG_INVALID_CONFIG 0x02   // Gain or integration time code is reserved
+#define LTR_329_FLAG_CONFIG_REPAIRED 0x04  // Scrubbing repaired a configuration register on this sample
+#define LTR_329_FLAG_SATURATED 0x08        // A channel reads full scale
+
+/** @brief Flags that make the counts of a sample unusable, its lux is reported as 0 */
+#define LTR_329_FLAGS_INVALID (LTR_329_FLAG_I2C_ERROR | LTR_329_FLAG_INVALID_CONFIG)
+
+#endif /* INC_LTR_329_FLAGS_H_ */
@@ -10,76 +10,208 @@
  */
 
 #include "LTR-329.h"
+#include "Error-Log.h"
 
 
-/** @brief Default register values for the LTR-329 sensor. */
-uint8_t LTR_329_REG_CONFIG_SETTINGS[8] = {
-	0x00, // ALS_CONTR: Default settings
-	0x03, // ALS_MEAS_RATE: Default settings
-	0xA0, // PART_ID: Default settings
-	0x05, // MANUFAC_ID: Default settings
-	0x00, // ALS_DATA_CH1_0: Default settings
-	0x00, // ALS_DATA_CH1_1: Default settings
-	0x00, // ALS_DATA_CH0_0: Default settings
-	0x00, // ALS_DATA_CH0_1: Default settings
-	0x00  // ALS_STATUS: Default settings
+/** @brief Register map generated from LTR_329_CONFIG_REGS and LTR_329_STATUS_REGS */
+const LTR_329_RegDesc_t LTR_329_REG_MAP[LTR_329_REG_COUNT] = {
+#define LTR_329_REG_DESC(name, addr, def, mask, vol) { (addr), (def), (mask), (vol) },
+	LTR_329_CONFIG_REGS(LTR_329_REG_DESC)
+	LTR_303_CONFIG_REGS(LTR_329_REG_DESC)
+	LTR_329_STATUS_REGS(LTR_329_REG_DESC)
+#undef LTR_329_REG_DESC
+};
+
+/** @brief Part descriptors, indexed by LTR_329_PartType_t */
+const LTR_329_Part_t LTR_329_PARTS[LTR_329_PART_COUNT] = {
+	[LTR_329_PART_LTR329] = { "LTR-329", LTR_329_PART_ID, LTR_329_SHADOW_BASE_COUNT, 0 },
+	[LTR_329_PART_LTR303] = { "LTR-303", LTR_329_PART_ID, LTR_329_SHADOW_COUNT, 1 },
 };
 
 /** @brief Arrays to store binary mapping to readable values for ALS_CONTR and ALS_MEAS_RATE registers */
 const uint8_t gainMap[] = {1, 2, 4, 8, 48, 96}; // Gain mapping in pg. 13 of LTR-329 datasheet
 const uint16_t intTimeMap[] = {100, 50, 200, 400, 150, 250, 300, 350}; // Integration time mapping in pg. 14 of LTR-329 datasheet
+const uint16_t measRateMap[] = {50, 100, 200, 500, 1000, 2000, 2000, 2000}; // Measurement rate mapping in pg. 14 of LTR-329 datasheet
 
 
 /********************************************************
  * @brief Initialize LTR-329 Sensor and I2C Connection  *
  * @param hi2c: Pointer to the I2C handle               *
- * @return 0 if successful, error code otherwise        *
+ * @return HAL_OK if successful, error code otherwise   *
  ********************************************************/
-void LTR_329_Init(I2C_HandleTypeDef *hi2c, UART_HandleTypeDef *huart, LTR329_t *ltr329) {
+HAL_StatusTypeDef LTR_329_Init(I2C_HandleTypeDef *hi2c, LTR329_t *ltr329) {
+	return LTR_329_Init_Config(hi2c, ltr329, LTR_329_REG_MAP[LTR_329_SHADOW_ALS_CONTR].defaultValue,
+			LTR_329_REG_MAP[LTR_329_SHADOW_ALS_MEAS_RATE].defaultValue);
+}
+
+
+/*******************************************************************
+ * @brief Initialize the LTR-329 with stored register settings     *
+ * @param hi2c: Pointer to the I2C handle                          *
+ * @param ltr329: Pointer to the LTR329_t struct                   *
+ * @param alsContr: ALS_CONTR gain bits, the mode bits are set here *
+ * @param alsMeasRate: ALS_MEAS_RATE value                         *
+ * @return HAL_OK if successful, error code otherwise              *
+ *                                                                 *
+ * Both registers are written before the switch to Active mode,   *
+ * so the first sample already uses the stored settings.           *
+ ******************************************************************/
+HAL_StatusTypeDef LTR_329_Init_Config(I2C_HandleTypeDef *hi2c, LTR329_t *ltr329, uint8_t alsContr, uint8_t alsMeasRate) {
 
 	HAL_StatusTypeDef i2cStatus = HAL_OK; // Variable to store I2C status
 
-	/* Hard reset of LTR-329 */
-	LTR_329_Reset(hi2c, huart, ltr329);
+	/* Assume the base part until PART_ID has been checked */
+	ltr329->part = &LTR_329_PARTS[LTR_329_PART_LTR329];
+
+	/* Hard reset of LTR-329, returns once PART_ID reads back correctly */
+	i2cStatus = LTR_329_Reset(hi2c, ltr329);
 
 	/* Make sure I2C is working properly */
 	if (i2cStatus != HAL_OK) {
-		sprintf(ltr329->buffer, "I2C Init Error: %d\r\n", i2cStatus);
-		HAL_UART_Transmit(huart, (uint8_t*)ltr329->buffer, strlen(ltr329->buffer), HAL_MAX_DELAY);
+		return i2cStatus;
+	}
+
+	/* Select the part descriptor from PART_ID */
+	ltr329->part = LTR_329_Detect_Part(hi2c);
+	if (ltr329->part == NULL) {
+		Error_Log_Record(ERROR_UNKNOWN_PART, LTR_329_PART_ID_ADDR, HAL_ERROR, 0);
+		ltr329->part = &LTR_329_PARTS[LTR_329_PART_LTR329];
+		return HAL_ERROR;
 	}
 
-	/* Check Device ID */
-	uint8_t deviceID = 0x00; // Empty variable to store ID read from LTR_329_PART_ID Register
-	i2cStatus = LTR_329_RegRead(hi2c, LTR_329_PART_ID_ADDR, &deviceID);
-	if ((i2cStatus != HAL_OK) || ((deviceID & 0xF0) != LTR_329_PART_ID)) {
-		sprintf(ltr329->buffer, "I2C Read Error: %d\r\n", i2cStatus);
-		HAL_UART_Transmit(huart, (uint8_t*)ltr329->buffer, strlen(ltr329->buffer), HAL_MAX_DELAY);
+	/* Timing first, the write is skipped when it matches the default */
+	i2cStatus = LTR_329_Write_Config(hi2c, ltr329, LTR_329_SHADOW_ALS_MEAS_RATE, alsMeasRate);
+	if (i2cStatus != HAL_OK) {
+		Error_Log_Record(ERROR_I2C_WRITE, LTR_329_ALS_MEAS_RATE, i2cStatus, alsMeasRate);
+		return i2cStatus;
+	}
+
+	/* Switch from Stand-by mode to Active mode in LTR_329_ALS_CONTR Register, with the gain bits */
+	alsContr |= LTR_329_ALS_CONTR_ACTIVE;
+	i2cStatus = LTR_329_Write_Config(hi2c, ltr329, LTR_329_SHADOW_ALS_CONTR, alsContr);
+	if (i2cStatus != HAL_OK) {
+		Error_Log_Record(ERROR_I2C_WRITE, LTR_329_ALS_CONTR, i2cStatus, alsContr);
+		return i2cStatus;
+	}
+
+	/* Verify the configuration on the first sample and then every LTR_329_SCRUB_PERIOD samples */
+	ltr329->scrubPeriod = LTR_329_SCRUB_PERIOD;
+	ltr329->scrubCount = LTR_329_SCRUB_PERIOD - 1;
+
+	/* Wait for the first valid sample so the first LTR_329_Read_All() does not return stale data, a slow stored rate waits longer */
+	uint16_t measRateMs = measRateMap[alsMeasRate & LTR_329_ALS_MEAS_RATE_MASK];
+	uint16_t intTimeMs = intTimeMap[(alsMeasRate >> LTR_329_ALS_INT_TIME_SHIFT) & 0x07];
+	uint32_t wakeupTimeoutMs = LTR_329_WAKEUP_TIME_MS + ((measRateMs > intTimeMs) ? measRateMs : intTimeMs);
+	i2cStatus = LTR_329_Wait_Active(hi2c, (wakeupTimeoutMs > LTR_329_WAKEUP_TIMEOUT_MS) ? wakeupTimeoutMs : LTR_329_WAKEUP_TIMEOUT_MS);
+	if (i2cStatus != HAL_OK) {
+		Error_Log_Record(ERROR_WAKEUP_TIMEOUT, LTR_329_ALS_STATUS, i2cStatus, 0);
 	}
 
-	/* Switch from Stand-by mode to Active mode in LTR_329_ALS_CONTR Register */
-	i2cStatus = LTR_329_RegWrite(hi2c, LTR_329_ALS_CONTR, 0x01);
-	if (i2cStatus != HAL_OK) {
-		sprintf(ltr329->buffer, "I2C Write Error: %d\r\n", i2cStatus);
-		HAL_UART_Transmit(huart, (uint8_t*)ltr329->buffer, strlen(ltr329->buffer), HAL_MAX_DELAY);
-	}
+	return i2cStatus;
 }
 
 /** @brief Reset all registers of the LTR-329 sensor to their default values. */
-void LTR_329_Reset(I2C_HandleTypeDef *hi2c, UART_HandleTypeDef *huart, LTR329_t *ltr329) {
+HAL_StatusTypeDef LTR_329_Reset(I2C_HandleTypeDef *hi2c, LTR329_t *ltr329) {
 
 	HAL_StatusTypeDef i2cStatus;
 
 	/* SW Reset for LTR_329_ALS_CONTR Register */
-	i2cStatus = LTR_329_RegWrite(hi2c, LTR_329_ALS_CONTR, 0x02);
+	i2cStatus = LTR_329_RegWrite(hi2c, LTR_329_ALS_CONTR, LTR_329_ALS_CONTR_SW_RESET);
 	if (i2cStatus != HAL_OK) {
-		sprintf(ltr329->buffer, "I2C Write Error: %d\r\n", i2cStatus);
-		HAL_UART_Transmit(huart, (uint8_t*)ltr329->buffer, strlen(ltr329->buffer), HAL_MAX_DELAY);
+		Error_Log_Record(ERROR_I2C_WRITE, LTR_329_ALS_CONTR, i2cStatus, LTR_329_ALS_CONTR_SW_RESET);
+		return i2cStatus;
 	}
 
-	HAL_Delay(25); // Wait 25ms
+	/* Poll PART_ID instead of a fixed delay, a device that never answers is reported */
+	i2cStatus = LTR_329_Wait_Ready(hi2c, LTR_329_RESET_TIMEOUT_MS);
+	if (i2cStatus != HAL_OK) {
+		Error_Log_Record(ERROR_RESET_TIMEOUT, LTR_329_PART_ID_ADDR, i2cStatus, 0);
+		return i2cStatus;
+	}
+
+	/* Configuration registers are back at their defaults, reload the shadow cache */
+	for (uint8_t i = 0; i < LTR_329_SHADOW_COUNT; i++) {
+		ltr329->regShadow[i] = LTR_329_REG_MAP[i].defaultValue & LTR_329_REG_MAP[i].writableMask;
+	}
+
+	return i2cStatus;
+}
+
+
+/*****************************************************************
+ * @brief Wait until the LTR-329 answers with a valid PART_ID   *
+ * @param hi2c: Pointer to the I2C handle                       *
+ * @param timeoutMs: Maximum time to wait in milliseconds       *
+ * @return HAL_OK once ready, HAL_TIMEOUT otherwise             *
+ *                                                              *
+ * The device NACKs while it is still coming out of reset, so   *
+ * PART_ID is polled with an exponential backoff (1, 2, 4 ...   *
+ * LTR_329_POLL_BACKOFF_MAX_MS) until it reads back correctly.  *
+ ****************************************************************/
+HAL_StatusTypeDef LTR_329_Wait_Ready(I2C_HandleTypeDef *hi2c, uint32_t timeoutMs) {
+
+	uint32_t startTick = HAL_GetTick();
+	uint32_t backoffMs = 1;
+	uint8_t deviceID = 0x00;
+
+	for (;;) {
+		if ((LTR_329_RegRead(hi2c, LTR_329_PART_ID_ADDR, &deviceID) == HAL_OK) && ((deviceID & 0xF0) == LTR_329_PART_ID)) {
+			return HAL_OK;
+		}
+
+		uint32_t elapsedMs = HAL_GetTick() - startTick;
+		if (elapsedMs >= timeoutMs) {
+			return HAL_TIMEOUT;
+		}
+
+		/* Never sleep past the deadline */
+		if (backoffMs > (timeoutMs - elapsedMs)) {
+			backoffMs = timeoutMs - elapsedMs;
+		}
+		HAL_Delay(backoffMs);
+		if (backoffMs < LTR_329_POLL_BACKOFF_MAX_MS) {
+			backoffMs <<= 1;
+		}
+	}
 }
 
 
+/*****************************************************************
+ * @brief Wait until the LTR-329 reports a valid ALS sample     *
+ * @param hi2c: Pointer to the I2C handle                       *
+ * @param timeoutMs: Maximum time to wait in milliseconds       *
+ * @return HAL_OK once data is valid, HAL_TIMEOUT otherwise     *
+ *                                                              *
+ * Polls ALS_STATUS after the Stand-by -> Active transition     *
+ * until the data valid bit is clear and new data is flagged.   *
+ ****************************************************************/
+HAL_StatusTypeDef LTR_329_Wait_Active(I2C_HandleTypeDef *hi2c, uint32_t timeoutMs) {
+
+	uint32_t startTick = HAL_GetTick();
+	uint32_t backoffMs = 1;
+	uint8_t statusData = 0x00;
+
+	for (;;) {
+		if ((LTR_329_RegRead(hi2c, LTR_329_ALS_STATUS, &statusData) == HAL_OK)
+				&& ((statusData & (LTR_329_ALS_STATUS_INVALID | LTR_329_ALS_STATUS_NEW_DATA)) == LTR_329_ALS_STATUS_NEW_DATA)) {
+			return HAL_OK;
+		}
+
+		uint32_t elapsedMs = HAL_GetTick() - startTick;
+		if (elapsedMs >= timeoutMs) {
+			return HAL_TIMEOUT;
+		}
+
+		if (backoffMs > (timeoutMs - elapsedMs)) {
+			backoffMs = timeoutMs - elapsedMs;
+		}
+		HAL_Delay(backoffMs);
+		if (backoffMs < LTR_329_POLL_BACKOFF_MAX_MS) {
+			backoffMs <<= 1;
+		}
+	}
+}
+
 /***************************************************************
  * @brief Write a byte to a specific register of LTR-329 	   *
  * @param regAddr: Register address to write to         	   *
@@ -105,9 +237,180 @@ HAL_StatusTypeDef LTR_329_RegWrite(I2C_HandleTypeDef *hi2c, uint8_t regAddr, uin
  ***************************************************************/
 HAL_StatusTypeDef LTR_329_RegRead(I2C_HandleTypeDef *hi2c, uint8_t regAddr, uint8_t *regData) {
 	return HAL_I2C_Mem_Read(hi2c, LTR_329_I2C_ADDR, regAddr, I2C_MEMADD_SIZE_8BIT, regData, 1, HAL_MAX_DELAY);
+}
+
+
+/*******************************************************************
+ * @brief Write a configuration register through the shadow cache *
+ * @param ltr329: Pointer to the LTR329_t struct                   *
+ * @param reg: Shadow index of the configuration register         *
+ * @param regData: Data to write to the register                  *
+ * @return HAL status code                                        *
+ *                                                                *
+ * Bits outside the writable mask are dropped. The bus write is   *
+ * skipped when the register already holds the requested value.   *
+ ******************************************************************/
+HAL_StatusTypeDef LTR_329_Write_Config(I2C_HandleTypeDef *hi2c, LTR329_t *ltr329, LTR_329_Shadow_t reg, uint8_t regData) {
+
+	const LTR_329_RegDesc_t *desc = &LTR_329_REG_MAP[reg];
+	regData &= desc->writableMask;
+
+	if (ltr329->regShadow[reg] == regData) {
+		return HAL_OK;
+	}
+
+	HAL_StatusTypeDef i2cStatus = LTR_329_RegWrite(hi2c, desc->addr, regData);
+	if (i2cStatus == HAL_OK) {
+		ltr329->regShadow[reg] = regData;
+	}
+
+	return i2cStatus;
+}
+
+
+/*******************************************************************
+ * @brief Restore every configuration register to its default     *
+ * @param ltr329: Pointer to the LTR329_t struct                   *
+ * @return HAL status code of the first failed write, else HAL_OK *
+ *                                                                *
+ * Only registers whose shadow differs from the default are       *
+ * written, so the cost is the minimum number of bus writes.      *
+ ******************************************************************/
+HAL_StatusTypeDef LTR_329_Restore_Defaults(I2C_HandleTypeDef *hi2c, LTR329_t *ltr329) {
+
+	HAL_StatusTypeDef i2cStatus = HAL_OK;
+
+	for (uint8_t i = 0; i < ltr329->part->shadowCount; i++) {
+		HAL_StatusTypeDef regStatus = LTR_329_Write_Config(hi2c, ltr329, (LTR_329_Shadow_t)i, LTR_329_REG_MAP[i].defaultValue);
+		if ((regStatus != HAL_OK) && (i2cStatus == HAL_OK)) {
+			i2cStatus = regStatus;
+		}
+	}
+
+	return i2cStatus;
+}
+
+
+/*******************************************************************
+ * @brief Change the ALS gain, keeping the mode bits of ALS_CONTR  *
+ * @param ltr329: Pointer to the LTR329_t struct                   *
+ * @param gain: Gain multiplier, one of 1, 2, 4, 8, 48 or 96       *
+ * @return HAL_ERROR for an unsupported gain, else the I2C status *
+ ******************************************************************/
+HAL_StatusTypeDef LTR_329_Set_Gain(I2C_HandleTypeDef *hi2c, LTR329_t *ltr329, uint8_t gain) {
+
+	static const uint8_t gainCodes[] = {0, 1, 2, 3, 6, 7}; // ALS_CONTR gain code of each gainMap entry
+
+	for (uint8_t i = 0; i < sizeof(gainCodes); i++) {
+		if (gainMap[i] == gain) {
+			uint8_t alsContrData = ltr329->regShadow[LTR_329_SHADOW_ALS_CONTR] & ~(0x07 << LTR_329_ALS_GAIN_SHIFT);
+			return LTR_329_Write_Config(hi2c, ltr329, LTR_329_SHADOW_ALS_CONTR, alsContrData | (uint8_t)(gainCodes[i] << LTR_329_ALS_GAIN_SHIFT));
+		}
+	}
+
+	return HAL_ERROR;
+}
+
+
+/*******************************************************************
+ * @brief Change the integration time and measurement rate         *
+ * @param ltr329: Pointer to the LTR329_t struct                   *
+ * @param intTimeMs: Integration time, 50 to 400 ms in table steps *
+ * @param measRateMs: Measurement repeat rate, 50 to 2000 ms       *
+ * @return HAL_ERROR for an unsupported pair, else the I2C status *
+ *                                                                *
+ * The measurement rate must not be shorter than the integration  *
+ * time (pg. 14 of LTR-329 datasheet).                            *
+ ******************************************************************/
+HAL_StatusTypeDef LTR_329_Set_Timing(I2C_HandleTypeDef *hi2c, LTR329_t *ltr329, uint16_t intTimeMs, uint16_t measRateMs) {
+
+	uint8_t intCode = 0xFF, rateCode = 0xFF;
+
+	for (uint8_t i = 0; i < 8; i++) {
+		if ((intCode == 0xFF) && (intTimeMap[i] == intTimeMs)) {
+			intCode = i;
+		}
+		if ((rateCode == 0xFF) && (measRateMap[i] == measRateMs)) {
+			rateCode = i;
+		}
+	}
+
+	if ((intCode == 0xFF) || (rateCode == 0xFF) || (measRateMs < intTimeMs)) {
+		return HAL_ERROR;
+	}
+
+	return LTR_329_Write_Config(hi2c, ltr329, LTR_329_SHADOW_ALS_MEAS_RATE, (uint8_t)((intCode << LTR_329_ALS_INT_TIME_SHIFT) | rateCode));
+}
+
+
+/*******************************************************************
+ * @brief Decode the configured gain and timing from the shadow    *
+ * @param ltr329: Pointer to the LTR329_t struct                   *
+ * @param gain: Pointer to store the gain multiplier (0 if invalid)*
+ * @param intTimeMs: Pointer to store the integration time         *
+ * @param measRateMs: Pointer to store the measurement rate        *
+ ******************************************************************/
+void LTR_329_Get_Config(const LTR329_t *ltr329, uint8_t *gain, uint16_t *intTimeMs, uint16_t *measRateMs) {
+
+	uint8_t gainCode = (ltr329->regShadow[LTR_329_SHADOW_ALS_CONTR] >> LTR_329_ALS_GAIN_SHIFT) & 0x07;
+	uint8_t measRateData = ltr329->regShadow[LTR_329_SHADOW_ALS_MEAS_RATE];
+
+	*gain = (gainCode <= 3) ? gainMap[gainCode] : (gainCode >= 6) ? gainMap[gainCode - 2] : 0;
+	*intTimeMs = intTimeMap[(measRateData >> LTR_329_ALS_INT_TIME_SHIFT) & 0x07];
+	*measRateMs = measRateMap[measRateData & LTR_329_ALS_MEAS_RATE_MASK];
 }
 
 
+/*******************************************************************
+ * @brief Verify the configuration registers against the shadow   *
+ * @param ltr329: Pointer to the LTR329_t struct                   *
+ * @param configData: Optional array of LTR_329_SHADOW_COUNT bytes *
+ *                    that receives the values read back           *
+ * @return HAL status code of the first failed transfer, else OK   *
+ *                                                                *
+ * Any register whose writable bits differ from the shadow (e.g.  *
+ * after a single-event upset) is rewritten from the shadow and   *
+ * counted in ltr329->scrubRepairs.                               *
+ ******************************************************************/
+HAL_StatusTypeDef LTR_329_Scrub(I2C_HandleTypeDef *hi2c, LTR329_t *ltr329, uint8_t *configData) {
+
+	HAL_StatusTypeDef i2cStatus = HAL_OK;
+
+	for (uint8_t i = 0; i < ltr329->part->shadowCount; i++) {
+		const LTR_329_RegDesc_t *desc = &LTR_329_REG_MAP[i];
+		uint8_t regData;
+
+		HAL_StatusTypeDef regStatus = LTR_329_RegRead(hi2c, desc->addr, &regData);
+		if (regStatus != HAL_OK) {
+			Error_Log_Record(ERROR_I2C_READ, desc->addr, regStatus, 0);
+		}
+		else {
+			if (configData != NULL) {
+				configData[i] = regData;
+			}
+
+			/* Repair the register from the expected image */
+			if ((regData & desc->writableMask) != ltr329->regShadow[i]) {
+				Error_Log_Record(ERROR_CONFIG_REPAIRED, desc->addr, HAL_OK, regData);
+				regStatus = LTR_329_RegWrite(hi2c, desc->addr, ltr329->regShadow[i]);
+				if (regStatus != HAL_OK) {
+					Error_Log_Record(ERROR_I2C_WRITE, desc->addr, regStatus, ltr329->regShadow[i]);
+				}
+				if (ltr329->scrubRepairs != UINT16_MAX) {
+					ltr329->scrubRepairs++;
+				}
+			}
+		}
+
+		if ((regStatus != HAL_OK) && (i2cStatus == HAL_OK)) {
+			i2cStatus = regStatus;
+		}
+	}
+
+	return i2cStatus;
+}
+
+
 /*************************************************************************************
  * @brief Read the CH1, CH0, Gain, and Integration Time data from the LTR-329 sensor *
  * @param hi2c: Pointer to the I2C handle                                            *
@@ -116,23 +419,25 @@ HAL_StatusTypeDef LTR_329_RegRead(I2C_HandleTypeDef *hi2c, uint8_t regAddr, uint
  *                                                                                   *
  * This function reads the necessary data from the LTR-329 to calculate lux.         *
  ************************************************************************************/
-void LTR_329_Read_All(I2C_HandleTypeDef *hi2c, UART_HandleTypeDef *huart, LTR329_t *ltr329) {
+void LTR_329_Read_All(I2C_HandleTypeDef *hi2c, LTR329_t *ltr329) {
 
 	HAL_StatusTypeDef i2cStatus;
 
 	uint8_t c1RawData1, c1RawData2, c0RawData1, c0RawData2, gainRawData, intTimeRawData;
+	uint8_t sampleFlags = 0;
+	uint16_t scrubRepairs = ltr329->scrubRepairs;
 
 	/* Read C0 channel data */
 	i2cStatus = LTR_329_RegRead(hi2c, LTR_329_ALS_DATA_CH1_0, &c1RawData1);
 	if (i2cStatus != HAL_OK) {
-		sprintf(ltr329->buffer, "I2C Read Error: %d\r\n", c1RawData1);
-		HAL_UART_Transmit(huart, (uint8_t*)ltr329->buffer, strlen(ltr329->buffer), HAL_MAX_DELAY);
+		sampleFlags |= LTR_329_FLAG_I2C_ERROR;
+		Error_Log_Record(ERROR_I2C_READ, LTR_329_ALS_DATA_CH1_0, i2cStatus, 0);
 	}
 
 	i2cStatus = LTR_329_RegRead(hi2c, LTR_329_ALS_DATA_CH1_1, &c1RawData2);
 	if (i2cStatus != HAL_OK) {
-		sprintf(ltr329->buffer, "I2C Read Error: %d\r\n", c1RawData2);
-		HAL_UART_Transmit(huart, (uint8_t*)ltr329->buffer, strlen(ltr329->buffer), HAL_MAX_DELAY);
+		sampleFlags |= LTR_329_FLAG_I2C_ERROR;
+		Error_Log_Record(ERROR_I2C_READ, LTR_329_ALS_DATA_CH1_1, i2cStatus, 0);
 	}
 
 	ltr329->c1Data = (c1RawData2 << 8) | c1RawData1; // Combine the two bytes into a 16-bit value
@@ -140,24 +445,32 @@ void LTR_329_Read_All(I2C_HandleTypeDef *hi2c, UART_HandleTypeDef *huart, LTR329
 	/* Read C1 channel data */
 	i2cStatus = LTR_329_RegRead(hi2c, LTR_329_ALS_DATA_CH0_0, &c0RawData1);
 	if (i2cStatus != HAL_OK) {
-		sprintf(ltr329->buffer, "I2C Read Error: %d\r\n", c0RawData1);
-		HAL_UART_Transmit(huart, (uint8_t*)ltr329->buffer, strlen(ltr329->buffer), HAL_MAX_DELAY);
+		sampleFlags |= LTR_329_FLAG_I2C_ERROR;
+		Error_Log_Record(ERROR_I2C_READ, LTR_329_ALS_DATA_CH0_0, i2cStatus, 0);
 	}
 
 	i2cStatus = LTR_329_RegRead(hi2c, LTR_329_ALS_DATA_CH0_1, &c0RawData2);
 	if (i2cStatus != HAL_OK) {
-		sprintf(ltr329->buffer, "I2C Read Error: %d\r\n", c0RawData2);
-		HAL_UART_Transmit(huart, (uint8_t*)ltr329->buffer, strlen(ltr329->buffer), HAL_MAX_DELAY);
+		sampleFlags |= LTR_329_FLAG_I2C_ERROR;
+		Error_Log_Record(ERROR_I2C_READ, LTR_329_ALS_DATA_CH0_1, i2cStatus, 0);
 	}
 
 	ltr329->c0Data = (c0RawData2 << 8) | c0RawData1; // Combine the two bytes into a 16-bit value
 
-	/* Read ALS Gain */
-	i2cStatus = LTR_329_RegRead(hi2c, LTR_329_ALS_CONTR, &gainRawData);
-	if (i2cStatus != HAL_OK) {
-			sprintf(ltr329->buffer, "I2C Read Error: %d\r\n", gainRawData);
-			HAL_UART_Transmit(huart, (uint8_t*)ltr329->buffer, strlen(ltr329->buffer), HAL_MAX_DELAY);
+	/* Gain and integration time come from the shadow cache, the device is only read back on scrub samples */
+	uint8_t configData[LTR_329_SHADOW_COUNT];
+	memcpy(configData, ltr329->regShadow, sizeof(configData));
+
+	if ((ltr329->scrubPeriod != 0) && (++ltr329->scrubCount >= ltr329->scrubPeriod)) {
+		ltr329->scrubCount = 0;
+		i2cStatus = LTR_329_Scrub(hi2c, ltr329, configData);
+		if (i2cStatus != HAL_OK) {
+			sampleFlags |= LTR_329_FLAG_I2C_ERROR;
 		}
+	}
+
+	/* This sample was integrated with whatever the device held, so decode the read-back values */
+	gainRawData = (configData[LTR_329_SHADOW_ALS_CONTR] >> LTR_329_ALS_GAIN_SHIFT) & 0x07;
 
 	/* Map the binary gain data to actual gain values */
 	switch (gainRawData) {
@@ -181,17 +494,12 @@ void LTR_329_Read_All(I2C_HandleTypeDef *hi2c, UART_HandleTypeDef *huart, LTR329
 			break;
 		default: // Invalid gain setting
 			ltr329->alsGainData = 0;
-			sprintf(ltr329->buffer, "Invalid ALS Gain Data: %u\r\n", gainRawData);
-			HAL_UART_Transmit(huart, (uint8_t*)ltr329->buffer, strlen(ltr329->buffer), HAL_MAX_DELAY);
+			sampleFlags |= LTR_329_FLAG_INVALID_CONFIG;
+			Error_Log_Record(ERROR_INVALID_GAIN, LTR_329_ALS_CONTR, HAL_OK, gainRawData);
 			break;
 	}
 
-	/* Read ALS integration time */
-	i2cStatus = LTR_329_RegRead(hi2c, LTR_329_ALS_STATUS, &intTimeRawData);
-	if (i2cStatus != HAL_OK) {
-		 sprintf(ltr329->buffer, "I2C Read Error: %d\r\n", intTimeRawData);
-		 HAL_UART_Transmit(huart, (uint8_t*)ltr329->buffer, strlen(ltr329->buffer), HAL_MAX_DELAY);
-	}
+	intTimeRawData = (configData[LTR_329_SHADOW_ALS_MEAS_RATE] >> LTR_329_ALS_INT_TIME_SHIFT) & 0x07;
 
 	/* Map the binary integration time data to actual integration time values */
 	switch (intTimeRawData) {
@@ -221,9 +529,19 @@ void LTR_329_Read_All(I2C_HandleTypeDef *hi2c, UART_HandleTypeDef *huart, LTR329
 			break;
 		default: // Invalid integration time setting
 			ltr329->alsIntData = 0;
-			sprintf(ltr329->buffer, "Invalid ALS Integration Time Data: %u\r\n", intTimeRawData);
-			HAL_UART_Transmit(huart, (uint8_t*)ltr329->buffer, strlen(ltr329->buffer), HAL_MAX_DELAY);
+			sampleFlags |= LTR_329_FLAG_INVALID_CONFIG;
+			Error_Log_Record(ERROR_INVALID_INT_TIME, LTR_329_ALS_MEAS_RATE, HAL_OK, intTimeRawData);
+	}
+
+	/* Raw configuration code and quality flags for binary telemetry */
+	ltr329->configCode = (uint8_t)((gainRawData << LTR_329_CONFIG_GAIN_SHIFT) | intTimeRawData);
+	if ((ltr329->c0Data == UINT16_MAX) || (ltr329->c1Data == UINT16_MAX)) {
+		sampleFlags |= LTR_329_FLAG_SATURATED;
+	}
+	if (ltr329->scrubRepairs != scrubRepairs) {
+		sampleFlags |= LTR_329_FLAG_CONFIG_REPAIRED;
 	}
+	ltr329->sampleFlags = sampleFlags;
 }
 
 
@@ -233,6 +551,7 @@ void LTR_329_Read_All(I2C_HandleTypeDef *hi2c, UART_HandleTypeDef *huart, LTR329
  * @param c1Data: C1 channel data                                                       *
  * @param alsGainData: ALS gain                                                 *
  * @param alsIntData: ALS integration time                                              *
+ * @param luxScale: Optional lux per count table indexed by configCode                  *
  * @return Calculated lux value                                                         *
  *                                                                                      *                                                     *
  * Formula for Lux provided in Appendix A, pg. 3                                        *
@@ -243,24 +562,29 @@ void LTR_329_Calculate_Lux(LTR329_t *ltr329) {
 	// Validate input data to prevent division by zero
 	if (ltr329->alsGainData == 0 || ltr329->alsIntData == 0 || (ltr329->c0Data + ltr329->c1Data) == 0) {
 		ltr329->alsLuxData = 0.0f; // Return 0 if any of the parameters are invalid
+		return;
 	}
 
 	// Calculate the ratio of infrared to infrared + visible light data
 	float ratio = (float)ltr329->c1Data / (float)(ltr329->c0Data + ltr329->c1Data);
 
+	// Lux per count for this gain and integration time, precomputed and calibrated when a table is attached, divisors checked above
+	float luxScale = (ltr329->luxScale != NULL) ? ltr329->luxScale[ltr329->configCode & LTR_329_CONFIG_CODE_MASK]
+			: 1.0f / ltr329->alsGainData / ltr329->alsIntData;
+
 	// Adjusted calculation for ratio below 0.45
 	if (ratio < 0.45f) {
-		ltr329->alsLuxData = (float)(1.7743 * ltr329->c0Data + 1.1059 * ltr329->c1Data) / ltr329->alsGainData / ltr329->alsIntData;
+		ltr329->alsLuxData = (float)(1.7743 * ltr329->c0Data + 1.1059 * ltr329->c1Data) * luxScale;
 	}
 
 	// Adjusted calculation for ratio between 0.45 and 0.64
 	else if (ratio < 0.64f && ratio >= 0.45f) {
-		ltr329->alsLuxData = (float)(4.2785 * ltr329->c0Data - 1.9548 * ltr329->c1Data) / ltr329->alsGainData / ltr329->alsIntData;
+		ltr329->alsLuxData = (float)(4.2785 * ltr329->c0Data - 1.9548 * ltr329->c1Data) * luxScale;
 	}
 
 	// Adjusted calculation for ratio above 0.64 and below 0.85
 	else if (ratio < 0.85f && ratio >= 0.64f) {
-		ltr329->alsLuxData = (float)(0.5926 * ltr329->c0Data + 0.1185 * ltr329->c1Data) / ltr329->alsGainData / ltr329->alsIntData;
+		ltr329->alsLuxData = (float)(0.5926 * ltr329->c0Data + 0.1185 * ltr329->c1Data) * luxScale;
 	}
 
 	// Return 0 if the ratio is above 0.85, indicating no valid lux calculation
@@ -269,3 +593,276 @@ void LTR_329_Calculate_Lux(LTR329_t *ltr329) {
 	}
 }
 
+
+/*******************************************************************
+ * @brief Take one duty-cycled sample and return to Stand-by mode  *
+ * @param hi2c: Pointer to the I2C handle                          *
+ * @param ltr329: Pointer to the LTR329_t struct                   *
+ * @return HAL status code, HAL_TIMEOUT if the conversion was not  *
+ *         done after the wakeup time plus one integration         *
+ *                                                                 *
+ * Wakes the sensor through ALS_CONTR, waits the wakeup time plus  *
+ * exactly one integration, reads the sample and puts the sensor   *
+ * back into Stand-by mode. Call LTR_329_Calculate_Lux() after.    *
+ ******************************************************************/
+HAL_StatusTypeDef LTR_329_Sample_Once(I2C_HandleTypeDef *hi2c, LTR329_t *ltr329) {
+
+	HAL_StatusTypeDef i2cStatus;
+	uint8_t alsContrData = ltr329->regShadow[LTR_329_SHADOW_ALS_CONTR];
+	uint16_t intTimeMs = intTimeMap[(ltr329->regShadow[LTR_329_SHADOW_ALS_MEAS_RATE] >> LTR_329_ALS_INT_TIME_SHIFT) & 0x07];
+
+	/* Stand-by -> Active, gain bits are kept from the shadow */
+	i2cStatus = LTR_329_Write_Config(hi2c, ltr329, LTR_329_SHADOW_ALS_CONTR, alsContrData | LTR_329_ALS_CONTR_ACTIVE);
+	if (i2cStatus != HAL_OK) {
+		return i2cStatus;
+	}
+
+	/* Sleep through the conversion, then confirm it with a single status read */
+	HAL_Delay(LTR_329_WAKEUP_TIME_MS + intTimeMs);
+	uint8_t statusData = 0x00;
+	i2cStatus = LTR_329_RegRead(hi2c, LTR_329_ALS_STATUS, &statusData);
+	if ((i2cStatus == HAL_OK)
+			&& ((statusData & (LTR_329_ALS_STATUS_INVALID | LTR_329_ALS_STATUS_NEW_DATA)) != LTR_329_ALS_STATUS_NEW_DATA)) {
+		i2cStatus = HAL_TIMEOUT;
+	}
+
+	if (i2cStatus == HAL_OK) {
+		LTR_329_Read_All(hi2c, ltr329);
+	}
+
+	/* Always go back to Stand-by, even if the sample was lost */
+	HAL_StatusTypeDef standbyStatus = LTR_329_Write_Config(hi2c, ltr329, LTR_329_SHADOW_ALS_CONTR, alsContrData & ~LTR_329_ALS_CONTR_ACTIVE);
+
+	return (i2cStatus != HAL_OK) ? i2cStatus : standbyStatus;
+}
+
+
+/*******************************************************************
+ * @brief Estimate the per-sample energy of an acquisition mode    *
+ * @param ltr329: Pointer to the LTR329_t struct (shadow config)   *
+ * @param mode: Continuous or duty-cycled acquisition              *
+ * @param samplePeriodMs: Time between samples in milliseconds     *
+ * @param energy: Pointer to store the estimate                    *
+ *                                                                 *
+ * Energy = VDD x (I_active x t_active + I_standby x t_standby     *
+ *                 + I_bus x t_bus), using the LTR_329_*_UA and    *
+ * LTR_329_I2C_*_US constants. Scrub reads are amortized.          *
+ ******************************************************************/
+void LTR_329_Energy_Estimate(const LTR329_t *ltr329, LTR_329_Mode_t mode, uint32_t samplePeriodMs, LTR_329_Energy_t *energy) {
+
+	uint64_t periodUs = (uint64_t)samplePeriodMs * 1000U; // Past UINT32_MAX after 71 minutes
+	uint32_t intTimeUs = intTimeMap[(ltr329->regShadow[LTR_329_SHADOW_ALS_MEAS_RATE] >> LTR_329_ALS_INT_TIME_SHIFT) & 0x07] * 1000U;
+
+	/* Four data byte reads per sample, plus the amortized configuration read-back */
+	uint32_t busTimeUs = 4U * LTR_329_I2C_READ_US;
+	if (ltr329->scrubPeriod != 0) {
+		busTimeUs += (ltr329->part->shadowCount * LTR_329_I2C_READ_US) / ltr329->scrubPeriod;
+	}
+
+	uint64_t activeTimeUs;
+	if (mode == LTR_329_MODE_DUTY_CYCLED) {
+		/* Wake write, one status read, standby write */
+		busTimeUs += 2U * LTR_329_I2C_WRITE_US + LTR_329_I2C_READ_US;
+		activeTimeUs = LTR_329_WAKEUP_TIME_MS * 1000U + intTimeUs + busTimeUs;
+	}
+	else {
+		activeTimeUs = periodUs;
+	}
+	if (activeTimeUs > periodUs) {
+		activeTimeUs = periodUs;
+	}
+
+	/* uA x mV = nW, nW x us = fJ, divide by 1e6 for nJ */
+	uint64_t energyFj = (uint64_t)LTR_329_ACTIVE_CURRENT_UA * LTR_329_VDD_MV * activeTimeUs
+			+ (uint64_t)LTR_329_STANDBY_CURRENT_UA * LTR_329_VDD_MV * (periodUs - activeTimeUs)
+			+ (uint64_t)LTR_329_I2C_BUS_CURRENT_UA * LTR_329_VDD_MV * busTimeUs;
+
+	/* Saturated, continuous mode over periods of hours does not fit the 32-bit fields */
+	energy->activeTimeUs = (activeTimeUs > UINT32_MAX) ? UINT32_MAX : (uint32_t)activeTimeUs;
+	energy->busTimeUs = busTimeUs;
+	energy->energyNj = (energyFj / 1000000U > UINT32_MAX) ? UINT32_MAX : (uint32_t)(energyFj / 1000000U);
+	energy->avgPowerUw = (periodUs != 0) ? (uint32_t)(energyFj / 1000U / periodUs) : 0;
+}
+
+
+/*******************************************************************
+ * @brief Pick the cheapest mode that meets a sample period       *
+ * @param ltr329: Pointer to the LTR329_t struct (shadow config)   *
+ * @param samplePeriodMs: Required time between samples in ms      *
+ * @param energy: Optional pointer to store the chosen estimate    *
+ * @return Acquisition mode to use for this mission phase          *
+ *                                                                 *
+ * Duty cycling is only feasible when wakeup plus one integration  *
+ * fits in the period; continuous mode additionally needs the      *
+ * configured measurement rate to be at least as fast.             *
+ ******************************************************************/
+LTR_329_Mode_t LTR_329_Plan_Schedule(const LTR329_t *ltr329, uint32_t samplePeriodMs, LTR_329_Energy_t *energy) {
+
+	LTR_329_Energy_t continuous, dutyCycled;
+	uint16_t intTimeMs = intTimeMap[(ltr329->regShadow[LTR_329_SHADOW_ALS_MEAS_RATE] >> LTR_329_ALS_INT_TIME_SHIFT) & 0x07];
+
+	LTR_329_Energy_Estimate(ltr329, LTR_329_MODE_CONTINUOUS, samplePeriodMs, &continuous);
+	LTR_329_Energy_Estimate(ltr329, LTR_329_MODE_DUTY_CYCLED, samplePeriodMs, &dutyCycled);
+
+	uint16_t measRateMs = measRateMap[ltr329->regShadow[LTR_329_SHADOW_ALS_MEAS_RATE] & LTR_329_ALS_MEAS_RATE_MASK];
+	uint8_t dutyFeasible = samplePeriodMs >= (uint32_t)(LTR_329_WAKEUP_TIME_MS + intTimeMs);
+	uint8_t continuousFeasible = samplePeriodMs >= measRateMs;
+
+	LTR_329_Mode_t mode = LTR_329_MODE_CONTINUOUS;
+	if (dutyFeasible && (!continuousFeasible || (dutyCycled.energyNj < continuous.energyNj))) {
+		mode = LTR_329_MODE_DUTY_CYCLED;
+	}
+
+	if (energy != NULL) {
+		*energy = (mode == LTR_329_MODE_DUTY_CYCLED) ? dutyCycled : continuous;
+	}
+
+	return mode;
+}
+
+
+/*******************************************************************
+ * @brief Identify which member of the LTR-329 family is attached  *
+ * @param hi2c: Pointer to the I2C handle                          *
+ * @return Part descriptor, NULL if PART_ID is not recognized      *
+ *                                                                 *
+ * The LTR-329 and LTR-303 report the same PART_ID, so the LTR-303 *
+ * is told apart by writing a pattern to ALS_THRES_LOW_0, which    *
+ * only it implements, and reading it back. What an LTR-329 reads  *
+ * at that address is undocumented, so a plain read is no proof.   *
+ * The register is restored afterwards. A probe that fails on the  *
+ * bus is logged and the part is taken as the LTR-329, which has   *
+ * no INT pin to depend on.                                        *
+ ******************************************************************/
+const LTR_329_Part_t *LTR_329_Detect_Part(I2C_HandleTypeDef *hi2c) {
+
+	uint8_t deviceID = 0x00;
+	if ((LTR_329_RegRead(hi2c, LTR_329_PART_ID_ADDR, &deviceID) != HAL_OK) || ((deviceID & 0xF0) != LTR_329_PART_ID)) {
+		return NULL;
+	}
+
+	uint8_t savedData = 0x00;
+	HAL_StatusTypeDef i2cStatus = LTR_329_RegRead(hi2c, LTR_303_ALS_THRES_LOW_0, &savedData);
+	if (i2cStatus != HAL_OK) {
+		Error_Log_Record(ERROR_I2C_READ, LTR_303_ALS_THRES_LOW_0, i2cStatus, 0);
+		return &LTR_329_PARTS[LTR_329_PART_LTR329];
+	}
+
+	/* Alternate bits of the saved value flipped, a stuck or unimplemented register does not read this back */
+	uint8_t probeData = savedData ^ LTR_329_PART_PROBE_PATTERN;
+	i2cStatus = LTR_329_RegWrite(hi2c, LTR_303_ALS_THRES_LOW_0, probeData);
+	if (i2cStatus != HAL_OK) {
+		Error_Log_Record(ERROR_I2C_WRITE, LTR_303_ALS_THRES_LOW_0, i2cStatus, probeData);
+		return &LTR_329_PARTS[LTR_329_PART_LTR329];
+	}
+
+	uint8_t readData = 0x00;
+	i2cStatus = LTR_329_RegRead(hi2c, LTR_303_ALS_THRES_LOW_0, &readData);
+	if (i2cStatus != HAL_OK) {
+		Error_Log_Record(ERROR_I2C_READ, LTR_303_ALS_THRES_LOW_0, i2cStatus, 0);
+	}
+	uint8_t isLtr303 = (i2cStatus == HAL_OK) && (readData == probeData);
+
+	/* Restore in every case, an LTR-303 whose read-back failed still holds the pattern */
+	i2cStatus = LTR_329_RegWrite(hi2c, LTR_303_ALS_THRES_LOW_0, savedData);
+	if (i2cStatus != HAL_OK) {
+		Error_Log_Record(ERROR_I2C_WRITE, LTR_303_ALS_THRES_LOW_0, i2cStatus, savedData);
+	}
+
+	return &LTR_329_PARTS[isLtr303 ? LTR_329_PART_LTR303 : LTR_329_PART_LTR329];
+}
+
+
+/*******************************************************************
+ * @brief Configure the LTR-303 interrupt window on CH0 counts     *
+ * @param ltr329: Pointer to the LTR329_t struct                   *
+ * @param lowThreshold: INT asserts below this CH0 count           *
+ * @param highThreshold: INT asserts above this CH0 count          *
+ * @param persist: Consecutive out-of-window samples minus one     *
+ * @return HAL_ERROR on parts without interrupts, else HAL status  *
+ *                                                                 *
+ * Unchanged bytes are skipped by the shadow cache, so moving one  *
+ * edge of the window costs at most two writes.                    *
+ ******************************************************************/
+HAL_StatusTypeDef LTR_303_Set_Window(I2C_HandleTypeDef *hi2c, LTR329_t *ltr329, uint16_t lowThreshold, uint16_t highThreshold, uint8_t persist) {
+
+	if (!ltr329->part->hasInterrupt) {
+		return HAL_ERROR;
+	}
+
+	const struct {
+		LTR_329_Shadow_t reg;
+		uint8_t regData;
+	} windowData[] = {
+		{ LTR_303_SHADOW_ALS_THRES_UP_0, (uint8_t)(highThreshold & 0xFF) },
+		{ LTR_303_SHADOW_ALS_THRES_UP_1, (uint8_t)(highThreshold >> 8) },
+		{ LTR_303_SHADOW_ALS_THRES_LOW_0, (uint8_t)(lowThreshold & 0xFF) },
+		{ LTR_303_SHADOW_ALS_THRES_LOW_1, (uint8_t)(lowThreshold >> 8) },
+		{ LTR_303_SHADOW_INTERRUPT_PERSIST, (uint8_t)(persist & LTR_303_PERSIST_MASK) },
+	};
+
+	for (uint8_t i = 0; i < sizeof(windowData) / sizeof(windowData[0]); i++) {
+		HAL_StatusTypeDef i2cStatus = LTR_329_Write_Config(hi2c, ltr329, windowData[i].reg, windowData[i].regData);
+		if (i2cStatus != HAL_OK) {
+			return i2cStatus;
+		}
+	}
+
+	return HAL_OK;
+}
+
+
+/*******************************************************************
+ * @brief Enable or disable the LTR-303 threshold interrupt        *
+ * @param ltr329: Pointer to the LTR329_t struct                   *
+ * @param enable: 1 to drive INT (active low), 0 to disable it     *
+ * @return HAL_ERROR on parts without interrupts, else HAL status  *
+ ******************************************************************/
+HAL_StatusTypeDef LTR_303_Enable_Interrupt(I2C_HandleTypeDef *hi2c, LTR329_t *ltr329, uint8_t enable) {
+
+	if (!ltr329->part->hasInterrupt) {
+		return HAL_ERROR;
+	}
+
+	ltr329->intPending = 0;
+	return LTR_329_Write_Config(hi2c, ltr329, LTR_303_SHADOW_INTERRUPT, enable ? LTR_303_INTERRUPT_ENABLE : 0x00);
+}
+
+
+/*******************************************************************
+ * @brief Record an INT line assertion                             *
+ * @param ltr329: Pointer to the LTR329_t struct                   *
+ *                                                                 *
+ * Call from HAL_GPIO_EXTI_Callback() for the INT pin, or directly *
+ * to simulate the INT line. No bus traffic happens here.          *
+ ******************************************************************/
+void LTR_303_INT_Handler(LTR329_t *ltr329) {
+	ltr329->intPending = 1;
+}
+
+
+/*******************************************************************
+ * @brief Read a sample if the INT line has asserted               *
+ * @param hi2c: Pointer to the I2C handle                          *
+ * @param ltr329: Pointer to the LTR329_t struct                   *
+ * @return 1 if a new out-of-window sample was read, 0 otherwise   *
+ *                                                                 *
+ * Returns without touching the bus while no interrupt is pending, *
+ * so the MCU can __WFI() between calls and steady light costs no  *
+ * I2C traffic. Reading ALS_STATUS and the data clears INT.        *
+ ******************************************************************/
+uint8_t LTR_303_Service_Interrupt(I2C_HandleTypeDef *hi2c, LTR329_t *ltr329) {
+
+	if (!ltr329->intPending) {
+		return 0;
+	}
+	ltr329->intPending = 0;
+
+	uint8_t statusData = 0x00;
+	if ((LTR_329_RegRead(hi2c, LTR_329_ALS_STATUS, &statusData) != HAL_OK) || !(statusData & LTR_303_ALS_STATUS_INT)) {
+		return 0;
+	}
+
+	LTR_329_Read_All(hi2c, ltr329);
+	return 1;
+}
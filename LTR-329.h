@@ -13,41 +13,223 @@
 #define INC_LTR_329_H_
 
 #include <stdint.h>
-#include <stdio.h>
 #include <string.h>
 #include "stm32L4xx_hal.h" // Adjust this include based on your STM32 series
+#include "LTR-329-Flags.h"
 
-/** @brief Register Defines for LTR-329 Ambient Light Sensor */
+/** @brief I2C address for LTR-329 Ambient Light Sensor */
 #define LTR_329_I2C_ADDR (0x29 << 1) // LTR-329 I2C address shifted for HAL
-#define LTR_329_PART_ID_ADDR 0x86    // Device ID
-#define LTR_329_ALS_CONTR 0x80       // ALS Control Register
-#define LTR_329_ALS_MEAS_RATE 0x85   // ALS Measurement Rate Register
-#define LTR_329_MANUFAC_ID 0x87		 // Manufacturer ID Register
-#define LTR_329_ALS_DATA_CH1_0 0x88  // ALS Data Channel 1 Low Byte
-#define LTR_329_ALS_DATA_CH1_1 0x89  // ALS Data Channel 1 High Byte
-#define LTR_329_ALS_DATA_CH0_0 0x8A  // ALS Data Channel 0 Low Byte
-#define LTR_329_ALS_DATA_CH0_1 0x8B  // ALS Data Channel 0 High Byte
-#define LTR_329_ALS_STATUS 0x8C      // ALS Status Register
+
+/**
+ * @brief Declarative register map for the LTR-329 (pg. 12 of LTR-329 datasheet)
+ *
+ * X(name, address, default value, writable mask, volatile)
+ *
+ * Configuration registers are mirrored in LTR329_t.regShadow in table order, so
+ * they must stay first. Status and data registers are volatile and are always
+ * read back from the device. The SW reset bit of ALS_CONTR is left out of the
+ * writable mask because it is a self-clearing command, not configuration state.
+ */
+#define LTR_329_CONFIG_REGS(X) \
+	X(ALS_CONTR,      0x80, 0x00, 0x1D, 0) /* ALS Control Register */ \
+	X(ALS_MEAS_RATE,  0x85, 0x03, 0x3F, 0) /* ALS Measurement Rate Register */
+
+/** @brief Additional configuration registers of the pin-compatible LTR-303 (pg. 12 of LTR-303 datasheet) */
+#define LTR_303_CONFIG_REGS(X) \
+	X(INTERRUPT,         0x8F, 0x08, 0x06, 0) /* Interrupt Settings Register */ \
+	X(ALS_THRES_UP_0,    0x97, 0xFF, 0xFF, 0) /* ALS Upper Threshold Low Byte */ \
+	X(ALS_THRES_UP_1,    0x98, 0xFF, 0xFF, 0) /* ALS Upper Threshold High Byte */ \
+	X(ALS_THRES_LOW_0,   0x99, 0x00, 0xFF, 0) /* ALS Lower Threshold Low Byte */ \
+	X(ALS_THRES_LOW_1,   0x9A, 0x00, 0xFF, 0) /* ALS Lower Threshold High Byte */ \
+	X(INTERRUPT_PERSIST, 0x9E, 0x00, 0x0F, 0) /* ALS Interrupt Persist Register */
+
+#define LTR_329_STATUS_REGS(X) \
+	X(PART_ID_ADDR,   0x86, 0xA0, 0x00, 0) /* Device ID */ \
+	X(MANUFAC_ID,     0x87, 0x05, 0x00, 0) /* Manufacturer ID Register */ \
+	X(ALS_DATA_CH1_0, 0x88, 0x00, 0x00, 1) /* ALS Data Channel 1 Low Byte */ \
+	X(ALS_DATA_CH1_1, 0x89, 0x00, 0x00, 1) /* ALS Data Channel 1 High Byte */ \
+	X(ALS_DATA_CH0_0, 0x8A, 0x00, 0x00, 1) /* ALS Data Channel 0 Low Byte */ \
+	X(ALS_DATA_CH0_1, 0x8B, 0x00, 0x00, 1) /* ALS Data Channel 0 High Byte */ \
+	X(ALS_STATUS,     0x8C, 0x00, 0x00, 1) /* ALS Status Register */
+
+/** @brief Register address defines generated from the register map (LTR_329_ALS_CONTR, LTR_303_INTERRUPT, ...) */
+enum {
+#define LTR_329_REG_ADDR(name, addr, def, mask, vol) LTR_329_##name = (addr),
+#define LTR_303_REG_ADDR(name, addr, def, mask, vol) LTR_303_##name = (addr),
+	LTR_329_CONFIG_REGS(LTR_329_REG_ADDR)
+	LTR_303_CONFIG_REGS(LTR_303_REG_ADDR)
+	LTR_329_STATUS_REGS(LTR_329_REG_ADDR)
+#undef LTR_303_REG_ADDR
+#undef LTR_329_REG_ADDR
+};
+
+/** @brief Shadow cache indices, one per configuration register, LTR-303 registers last */
+typedef enum {
+#define LTR_329_REG_SHADOW(name, addr, def, mask, vol) LTR_329_SHADOW_##name,
+#define LTR_303_REG_SHADOW(name, addr, def, mask, vol) LTR_303_SHADOW_##name,
+	LTR_329_CONFIG_REGS(LTR_329_REG_SHADOW)
+	LTR_303_CONFIG_REGS(LTR_303_REG_SHADOW)
+#undef LTR_303_REG_SHADOW
+#undef LTR_329_REG_SHADOW
+	LTR_329_SHADOW_COUNT
+} LTR_329_Shadow_t;
+
+/** @brief Number of configuration registers present on every part */
+enum {
+#define LTR_329_REG_BASE(name, addr, def, mask, vol) LTR_329_BASE_##name,
+	LTR_329_CONFIG_REGS(LTR_329_REG_BASE)
+#undef LTR_329_REG_BASE
+	LTR_329_SHADOW_BASE_COUNT
+};
+
+/** @brief Total number of entries in the register map */
+enum {
+#define LTR_329_REG_INDEX(name, addr, def, mask, vol) LTR_329_INDEX_##name,
+	LTR_329_CONFIG_REGS(LTR_329_REG_INDEX)
+	LTR_303_CONFIG_REGS(LTR_329_REG_INDEX)
+	LTR_329_STATUS_REGS(LTR_329_REG_INDEX)
+#undef LTR_329_REG_INDEX
+	LTR_329_REG_COUNT
+};
+
+/** @brief Register map entry, the table itself is const and lives in flash */
+typedef struct {
+	uint8_t addr;         // Register address
+	uint8_t defaultValue; // Value after power-up or SW reset
+	uint8_t writableMask; // Bits that hold configuration state
+	uint8_t isVolatile;   // 1 if the device changes the register on its own
+} LTR_329_RegDesc_t;
+
+extern const LTR_329_RegDesc_t LTR_329_REG_MAP[LTR_329_REG_COUNT];
 
 #define LTR_329_PART_ID 0xA0 // LTR-329 Part ID Default Value (0xA0 -> 1010)
 
-/** @brief Struct to store LTR-329 variables */
+/** @brief Register bit fields */
+#define LTR_329_ALS_CONTR_ACTIVE 0x01      // ALS_CONTR ALS Mode bit (1 = Active)
+#define LTR_329_ALS_CONTR_SW_RESET 0x02    // ALS_CONTR SW Reset bit
+#define LTR_329_ALS_GAIN_SHIFT 2           // ALS_CONTR ALS Gain field, bits 4:2
+#define LTR_329_ALS_INT_TIME_SHIFT 3       // ALS_MEAS_RATE ALS Integration Time field, bits 5:3
+#define LTR_329_ALS_MEAS_RATE_MASK 0x07    // ALS_MEAS_RATE ALS Measurement Repeat Rate field, bits 2:0
+#define LTR_329_ALS_STATUS_INVALID 0x80    // ALS_STATUS ALS Data Valid bit (1 = Invalid)
+#define LTR_329_ALS_STATUS_NEW_DATA 0x04   // ALS_STATUS ALS Data Status bit (1 = New data)
+#define LTR_303_ALS_STATUS_INT 0x08        // ALS_STATUS ALS Interrupt Status bit (LTR-303 only)
+#define LTR_303_INTERRUPT_ENABLE 0x02      // INTERRUPT Interrupt Mode bit (1 = ALS measurement can trigger INT)
+#define LTR_303_INTERRUPT_POLARITY 0x04    // INTERRUPT Polarity bit (0 = INT active low)
+#define LTR_303_PERSIST_MASK 0x0F          // INTERRUPT_PERSIST ALS Persist field, N + 1 consecutive samples out of window
+
+/** @brief Layout of the per-sample configCode */
+#define LTR_329_CONFIG_GAIN_SHIFT 3        // configCode layout: gain code in bits 5:3, integration time code in bits 2:0
+#define LTR_329_CONFIG_CODE_MASK 0x3F      // configCode bits, also the size - 1 of a luxScale table
+
+/** @brief Readiness polling timeouts, override at compile time if needed */
+#ifndef LTR_329_RESET_TIMEOUT_MS
+#define LTR_329_RESET_TIMEOUT_MS 100  // Max wait for PART_ID after SW reset (100 ms initial startup, pg. 5 of LTR-329 datasheet)
+#endif
+#ifndef LTR_329_WAKEUP_TIMEOUT_MS
+#define LTR_329_WAKEUP_TIMEOUT_MS 600 // Max wait for first valid sample after Stand-by -> Active (10 ms wakeup + default 500 ms measurement rate)
+#endif
+#define LTR_329_POLL_BACKOFF_MAX_MS 8 // Upper bound of the exponential backoff between polls
+
+/** @brief Configuration scrubbing rate, number of LTR_329_Read_All() calls per read-back (0 disables) */
+#ifndef LTR_329_SCRUB_PERIOD
+#define LTR_329_SCRUB_PERIOD 10
+#endif
+
+/** @brief Written to ALS_THRES_LOW_0 XOR its saved value to detect the LTR-303, see LTR_329_Detect_Part() */
+#define LTR_329_PART_PROBE_PATTERN 0x5A
+
+/** @brief Supported parts of the LTR-329 family */
+typedef enum {
+	LTR_329_PART_LTR329 = 0, // LTR-329ALS-01, polling only
+	LTR_329_PART_LTR303,     // LTR-303ALS-01, adds INT pin, thresholds and persistence
+	LTR_329_PART_COUNT
+} LTR_329_PartType_t;
+
+/** @brief Part descriptor, selected from PART_ID in LTR_329_Init() */
+typedef struct {
+	const char *name;     // Part name for logs
+	uint8_t partId;       // Expected PART_ID[7:4] value
+	uint8_t shadowCount;  // Configuration registers present on this part
+	uint8_t hasInterrupt; // 1 if the part supports threshold interrupts
+} LTR_329_Part_t;
+
+extern const LTR_329_Part_t LTR_329_PARTS[LTR_329_PART_COUNT];
+
+/** @brief Energy model constants (typical values, pg. 5 of LTR-329 datasheet), override per board */
+#ifndef LTR_329_VDD_MV
+#define LTR_329_VDD_MV 3300             // Sensor supply voltage
+#endif
+#ifndef LTR_329_ACTIVE_CURRENT_UA
+#define LTR_329_ACTIVE_CURRENT_UA 220   // Supply current in Active mode
+#endif
+#ifndef LTR_329_STANDBY_CURRENT_UA
+#define LTR_329_STANDBY_CURRENT_UA 5    // Supply current in Stand-by mode
+#endif
+#ifndef LTR_329_I2C_BUS_CURRENT_UA
+#define LTR_329_I2C_BUS_CURRENT_UA 350  // Average pull-up current while the bus is busy (~50% low through 4.7k)
+#endif
+#define LTR_329_WAKEUP_TIME_MS 10       // Stand-by -> Active wakeup time
+#define LTR_329_I2C_READ_US 390         // One-byte register read at 100 kHz (~39 bit times)
+#define LTR_329_I2C_WRITE_US 290        // One-byte register write at 100 kHz (~29 bit times)
+
+/** @brief Acquisition schedules compared by the energy model */
+typedef enum {
+	LTR_329_MODE_CONTINUOUS = 0, // Sensor left in Active mode, sampled with LTR_329_Read_All()
+	LTR_329_MODE_DUTY_CYCLED     // Sensor woken per sample with LTR_329_Sample_Once()
+} LTR_329_Mode_t;
+
+/** @brief Per-sample energy estimate */
 typedef struct {
+	uint32_t activeTimeUs; // Time the sensor spends in Active mode per sample
+	uint32_t busTimeUs;    // I2C bus time per sample
+	uint32_t energyNj;     // Sensor and bus energy per sample period
+	uint32_t avgPowerUw;   // Average power at the requested sample period
+} LTR_329_Energy_t;
+
+/** @brief Struct to store LTR-329 variables, ordered by alignment so there is no interior padding */
+typedef struct {
+	const LTR_329_Part_t *part; // Part descriptor detected in LTR_329_Init()
+	const float *luxScale; // Lux per count by configCode (Config-Block.h), NULL divides by gain and integration time
+	float alsLuxData;    // Variable to store calculated lux value
 	uint16_t c0Data;     // Variable to store C0 channel data
 	uint16_t c1Data;     // Variable to store C0 and C1 channel data
-	uint8_t alsGainData; // Variable to store gain setting
 	uint16_t alsIntData; // Variable to store integration time setting
-	float alsLuxData;    // Variable to store calculated lux value
-	char buffer[128];    // Buffer for UART transmission
+	uint16_t scrubRepairs; // Saturating count of configuration registers repaired by scrubbing
+	uint8_t alsGainData; // Variable to store gain setting
+	uint8_t configCode;  // Raw gain and integration time codes of the last sample
+	uint8_t sampleFlags; // LTR_329_FLAG_* quality flags of the last sample
+	uint8_t scrubPeriod;  // Samples between configuration read-backs, 0 disables scrubbing
+	uint8_t scrubCount;   // Samples since the last configuration read-back
+	volatile uint8_t intPending; // Set by LTR_303_INT_Handler() when the INT line asserts
+	uint8_t regShadow[LTR_329_SHADOW_COUNT]; // Last value written to each configuration register
 } LTR329_t;
 
 
 /** @brief Function Prototypes for LTR-329 ALS */
-void LTR_329_Init(I2C_HandleTypeDef *hi2c, UART_HandleTypeDef *huart, LTR329_t *ltr329);
-void LTR_329_Reset(I2C_HandleTypeDef *hi2c, UART_HandleTypeDef *huart, LTR329_t *ltr329);
+HAL_StatusTypeDef LTR_329_Init(I2C_HandleTypeDef *hi2c, LTR329_t *ltr329);
+HAL_StatusTypeDef LTR_329_Init_Config(I2C_HandleTypeDef *hi2c, LTR329_t *ltr329, uint8_t alsContr, uint8_t alsMeasRate);
+HAL_StatusTypeDef LTR_329_Reset(I2C_HandleTypeDef *hi2c, LTR329_t *ltr329);
+HAL_StatusTypeDef LTR_329_Wait_Ready(I2C_HandleTypeDef *hi2c, uint32_t timeoutMs);
+HAL_StatusTypeDef LTR_329_Wait_Active(I2C_HandleTypeDef *hi2c, uint32_t timeoutMs);
 HAL_StatusTypeDef LTR_329_RegWrite(I2C_HandleTypeDef *hi2c, uint8_t regAddr, uint8_t regData);
 HAL_StatusTypeDef LTR_329_RegRead(I2C_HandleTypeDef *hi2c, uint8_t regAddr, uint8_t *regData);
-void LTR_329_Read_All(I2C_HandleTypeDef *hi2c, UART_HandleTypeDef *huart, LTR329_t *ltr329);
+HAL_StatusTypeDef LTR_329_Write_Config(I2C_HandleTypeDef *hi2c, LTR329_t *ltr329, LTR_329_Shadow_t reg, uint8_t regData);
+HAL_StatusTypeDef LTR_329_Restore_Defaults(I2C_HandleTypeDef *hi2c, LTR329_t *ltr329);
+HAL_StatusTypeDef LTR_329_Set_Gain(I2C_HandleTypeDef *hi2c, LTR329_t *ltr329, uint8_t gain);
+HAL_StatusTypeDef LTR_329_Set_Timing(I2C_HandleTypeDef *hi2c, LTR329_t *ltr329, uint16_t intTimeMs, uint16_t measRateMs);
+void LTR_329_Get_Config(const LTR329_t *ltr329, uint8_t *gain, uint16_t *intTimeMs, uint16_t *measRateMs);
+HAL_StatusTypeDef LTR_329_Scrub(I2C_HandleTypeDef *hi2c, LTR329_t *ltr329, uint8_t *configData);
+HAL_StatusTypeDef LTR_329_Sample_Once(I2C_HandleTypeDef *hi2c, LTR329_t *ltr329);
+void LTR_329_Energy_Estimate(const LTR329_t *ltr329, LTR_329_Mode_t mode, uint32_t samplePeriodMs, LTR_329_Energy_t *energy);
+LTR_329_Mode_t LTR_329_Plan_Schedule(const LTR329_t *ltr329, uint32_t samplePeriodMs, LTR_329_Energy_t *energy);
+const LTR_329_Part_t *LTR_329_Detect_Part(I2C_HandleTypeDef *hi2c);
+
+/** @brief Function Prototypes for LTR-303 threshold interrupts */
+HAL_StatusTypeDef LTR_303_Set_Window(I2C_HandleTypeDef *hi2c, LTR329_t *ltr329, uint16_t lowThreshold, uint16_t highThreshold, uint8_t persist);
+HAL_StatusTypeDef LTR_303_Enable_Interrupt(I2C_HandleTypeDef *hi2c, LTR329_t *ltr329, uint8_t enable);
+void LTR_303_INT_Handler(LTR329_t *ltr329);
+uint8_t LTR_303_Service_Interrupt(I2C_HandleTypeDef *hi2c, LTR329_t *ltr329);
+void LTR_329_Read_All(I2C_HandleTypeDef *hi2c, LTR329_t *ltr329);
 void LTR_329_Calculate_Lux(LTR329_t *ltr329);
 
 #endif /* INC_LTR_329_H_ */
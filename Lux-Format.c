@@ -0,0 +1,120 @@
+/**
+ * @file Lux-Format.c
+ * @brief Implementation of the allocation-free lux formatter.
+ * @author Kent Hong
+ *
+ * This file replaces sprintf("%.2f") on the telemetry path with integer
+ * digit generation into a caller buffer.
+ *
+ * @note No stdio or heap is used, and the only float operation is in Lux_To_Centi().
+ */
+
+#include "Lux-Format.h"
+
+
+/*****************************************************************
+ * @brief Convert a float lux value to hundredths of a lux      *
+ * @param lux: Lux value from LTR_329_Calculate_Lux()           *
+ * @return Lux x 100 rounded like printf("%.2f"), clamped       *
+ *                                                              *
+ * The fractional part of a float is exact in Q0.32 for every   *
+ * value that can round to 0.01, so it is scaled with one       *
+ * 32x32->64 multiply and rounded half-to-even on the exact     *
+ * remainder instead of in float.                               *
+ ****************************************************************/
+uint32_t Lux_To_Centi(float lux) {
+
+	/* Negative values and NaN both fail this comparison */
+	if (!(lux > 0.0f)) {
+		return 0;
+	}
+	if (lux >= (float)(UINT32_MAX / LUX_FORMAT_SCALE)) {
+		return UINT32_MAX;
+	}
+
+	uint32_t intPart = (uint32_t)lux;
+	uint32_t fracQ32 = (uint32_t)((lux - (float)intPart) * 4294967296.0f); // Multiply by 2^32 is exact
+	uint64_t scaled = (uint64_t)fracQ32 * LUX_FORMAT_SCALE;
+
+	uint32_t fracPart = (uint32_t)(scaled >> 32);
+	uint32_t remainder = (uint32_t)scaled;
+	if ((remainder > 0x80000000U) || ((remainder == 0x80000000U) && (fracPart & 1U))) {
+		fracPart++;
+	}
+
+	return intPart * LUX_FORMAT_SCALE + fracPart;
+}
+
+
+/*****************************************************************
+ * @brief Format a fixed-point value as decimal text            *
+ * @param buffer: Destination buffer                            *
+ * @param bufferSize: Size of the destination buffer            *
+ * @param value: Fixed-point value (value / 10^fracDigits)      *
+ * @param fracDigits: Number of digits after the decimal point  *
+ * @return Number of characters written, 0 if it does not fit  *
+ ****************************************************************/
+uint16_t Lux_Format_Decimal(char *buffer, uint16_t bufferSize, uint32_t value, uint8_t fracDigits) {
+
+	char digits[10]; // uint32_t has at most 10 decimal digits
+	uint8_t digitCount = 0;
+
+	/* Generate digits least significant first, at least one integer digit */
+	do {
+		digits[digitCount++] = (char)('0' + (value % 10U));
+		value /= 10U;
+	} while ((value != 0) || (digitCount <= fracDigits));
+
+	uint16_t length = digitCount + ((fracDigits != 0) ? 1U : 0U);
+	if (length > bufferSize) {
+		return 0;
+	}
+
+	uint16_t pos = 0;
+	while (digitCount > 0) {
+		if ((digitCount == fracDigits) && (fracDigits != 0)) {
+			buffer[pos++] = '.';
+		}
+		buffer[pos++] = digits[--digitCount];
+	}
+
+	return pos;
+}
+
+
+/*****************************************************************
+ * @brief Format a UART lux line, "Lux: 123.45\r\n"             *
+ * @param buffer: Destination buffer                            *
+ * @param bufferSize: Size of the destination buffer            *
+ * @param centiLux: Lux value in hundredths of a lux            *
+ * @return Line length excluding the NUL, 0 if it does not fit  *
+ *                                                              *
+ * Output matches sprintf("Lux: %.2f\r\n", lux) for the value   *
+ * returned by Lux_To_Centi(lux).                               *
+ ****************************************************************/
+uint16_t Lux_Format_Line(char *buffer, uint16_t bufferSize, uint32_t centiLux) {
+
+	static const char prefix[] = "Lux: ";
+	const uint16_t prefixLength = sizeof(prefix) - 1;
+
+	/* Prefix, CR, LF and NUL */
+	if (bufferSize < prefixLength + 3U) {
+		return 0;
+	}
+
+	for (uint16_t i = 0; i < prefixLength; i++) {
+		buffer[i] = prefix[i];
+	}
+
+	uint16_t length = Lux_Format_Decimal(&buffer[prefixLength], bufferSize - prefixLength - 3U, centiLux, 2);
+	if (length == 0) {
+		return 0;
+	}
+	length += prefixLength;
+
+	buffer[length++] = '\r';
+	buffer[length++] = '\n';
+	buffer[length] = '\0';
+
+	return length;
+}
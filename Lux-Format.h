@@ -0,0 +1,28 @@
+/**
+ * @file Lux-Format.h
+ * @brief Header file for the allocation-free lux formatter.
+ * @author Kent Hong
+ *
+ * This file contains function prototypes for formatting fixed-point lux values
+ * as decimal text without stdio, so float printf support is not linked in.
+ *
+ * @note All functions write into a caller buffer and never NUL-terminate past the returned length.
+ */
+
+#ifndef INC_LUX_FORMAT_H_
+#define INC_LUX_FORMAT_H_
+
+#include <stdint.h>
+
+/** @brief Fixed-point scale used for lux values (two decimal places) */
+#define LUX_FORMAT_SCALE 100U
+
+/** @brief Longest line produced by Lux_Format_Line(), "Lux: 42949672.95\r\n" plus NUL */
+#define LUX_FORMAT_LINE_MAX 19U
+
+/** @brief Function Prototypes for the lux formatter */
+uint32_t Lux_To_Centi(float lux);
+uint16_t Lux_Format_Decimal(char *buffer, uint16_t bufferSize, uint32_t value, uint8_t fracDigits);
+uint16_t Lux_Format_Line(char *buffer, uint16_t bufferSize, uint32_t centiLux);
+
+#endif /* INC_LUX_FORMAT_H_ */
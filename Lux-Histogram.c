@@ -0,0 +1,141 @@
+/**
+ * @file Lux-Histogram.c
+ * @brief Implementation of the log-binned lux histogram accumulator.
+ * @author Kent Hong
+ *
+ * Adding a sample is one leading-zero count, a shift and an increment. The range
+ * of non-empty bins is tracked as samples arrive so building a product does not
+ * scan the empty ends.
+ */
+
+#include <string.h>
+#include "Lux-Histogram.h"
+
+#define LUX_HISTOGRAM_SUB_MASK ((1U << LUX_HISTOGRAM_SUB_BITS) - 1U)
+
+
+/*****************************************************************
+ * @brief Start a new interval                                  *
+ * @param hist: Pointer to the Lux_Histogram_t struct           *
+ * @param tick: Start of the interval                           *
+ *                                                              *
+ * The product sequence count is kept across intervals.         *
+ ****************************************************************/
+void Lux_Histogram_Init(Lux_Histogram_t *hist, uint32_t tick) {
+
+	uint16_t seqCount = hist->seqCount;
+
+	memset(hist, 0, sizeof(*hist));
+	hist->startTick = tick;
+	hist->minBin = LUX_HISTOGRAM_BINS - 1;
+	hist->seqCount = seqCount;
+}
+
+
+/*****************************************************************
+ * @brief Log-scale bin of a lux value                          *
+ * @param centiLux: Lux value in hundredths of a lux            *
+ * @return Bin index, LUX_HISTOGRAM_BINS - 1 at most            *
+ ****************************************************************/
+uint8_t Lux_Histogram_Bin(uint32_t centiLux) {
+
+	if (centiLux <= LUX_HISTOGRAM_SUB_MASK) {
+		return (uint8_t)centiLux;
+	}
+
+	uint32_t msb = 31U - (uint32_t)__builtin_clz(centiLux);
+	if (msb > LUX_HISTOGRAM_TOP_BIT) {
+		return LUX_HISTOGRAM_BINS - 1;
+	}
+
+	return (uint8_t)(((msb - LUX_HISTOGRAM_SUB_BITS + 1U) << LUX_HISTOGRAM_SUB_BITS)
+			| ((centiLux >> (msb - LUX_HISTOGRAM_SUB_BITS)) & LUX_HISTOGRAM_SUB_MASK));
+}
+
+
+/*****************************************************************
+ * @brief Lowest lux value of a bin                             *
+ * @param bin: Bin index                                        *
+ * @return Lower bin edge in hundredths of a lux, the upper     *
+ *         edge is the floor of the next bin                    *
+ ****************************************************************/
+uint32_t Lux_Histogram_Bin_Floor(uint8_t bin) {
+
+	if (bin <= LUX_HISTOGRAM_SUB_MASK) {
+		return bin;
+	}
+
+	uint32_t octave = (uint32_t)(bin >> LUX_HISTOGRAM_SUB_BITS) - 1U;
+	return ((1U << LUX_HISTOGRAM_SUB_BITS) | (bin & LUX_HISTOGRAM_SUB_MASK)) << octave;
+}
+
+
+/*****************************************************************
+ * @brief Count one sample                                      *
+ * @param hist: Pointer to the Lux_Histogram_t struct           *
+ * @param centiLux: Lux value in hundredths of a lux            *
+ ****************************************************************/
+void Lux_Histogram_Add(Lux_Histogram_t *hist, uint32_t centiLux) {
+
+	uint8_t bin = Lux_Histogram_Bin(centiLux);
+
+	if (hist->counts[bin] != UINT16_MAX) {
+		hist->counts[bin]++;
+	}
+	if (bin < hist->minBin) {
+		hist->minBin = bin;
+	}
+	if (bin > hist->maxBin) {
+		hist->maxBin = bin;
+	}
+	hist->samples++;
+}
+
+
+/*****************************************************************
+ * @brief Close the interval and pack it as a CCSDS product     *
+ * @param hist: Pointer to the Lux_Histogram_t struct           *
+ * @param tick: End of the interval, start of the next one      *
+ * @param out: Buffer of at least LUX_HISTOGRAM_PRODUCT_MAX     *
+ *             bytes                                            *
+ * @return Packet length, 0 if no sample was binned             *
+ *                                                              *
+ * The histogram is cleared for the next interval either way.   *
+ ****************************************************************/
+uint16_t Lux_Histogram_Build_Product(Lux_Histogram_t *hist, uint32_t tick, uint8_t *out) {
+
+	if (hist->samples == 0) {
+		Lux_Histogram_Init(hist, tick);
+		return 0;
+	}
+
+	/* Payload is written in place, CCSDS_Build_Packet() moves it to the same spot */
+	uint8_t *payload = &out[CCSDS_PRIMARY_HEADER_SIZE + CCSDS_SECONDARY_HEADER_SIZE];
+	uint32_t durationMs = tick - hist->startTick;
+	uint8_t binCount = (uint8_t)(hist->maxBin - hist->minBin + 1U);
+
+	payload[0] = (uint8_t)(durationMs >> 24);
+	payload[1] = (uint8_t)(durationMs >> 16);
+	payload[2] = (uint8_t)(durationMs >> 8);
+	payload[3] = (uint8_t)durationMs;
+	payload[4] = (uint8_t)(hist->samples >> 24);
+	payload[5] = (uint8_t)(hist->samples >> 16);
+	payload[6] = (uint8_t)(hist->samples >> 8);
+	payload[7] = (uint8_t)hist->samples;
+	payload[8] = hist->minBin;
+	payload[9] = binCount;
+
+	uint16_t length = LUX_HISTOGRAM_HEADER_SIZE;
+	for (uint8_t i = 0; i < binCount; i++) {
+		uint16_t count = hist->counts[hist->minBin + i];
+		payload[length++] = (uint8_t)(count >> 8);
+		payload[length++] = (uint8_t)count;
+	}
+
+	uint16_t packetLength = CCSDS_Build_Packet(CCSDS_APID_LUX_HISTOGRAM, hist->seqCount, hist->startTick, 0, payload, length, out);
+	hist->seqCount = (hist->seqCount + 1) & CCSDS_SEQ_COUNT_MASK;
+
+	Lux_Histogram_Init(hist, tick);
+
+	return packetLength;
+}
@@ -0,0 +1,56 @@
+/**
+ * @file Lux-Histogram.h
+ * @brief Header file for the log-binned lux histogram accumulator.
+ * @author Kent Hong
+ *
+ * This file contains definitions and function prototypes for accumulating the
+ * distribution of illumination over an interval and packing it into one CCSDS
+ * product. Bins are log-scale in centi-lux with LUX_HISTOGRAM_SUB_BITS mantissa
+ * bits per octave, found with one leading-zero count and a shift (no log()):
+ *   v < 4         bin v (exact)
+ *   v >= 4        bin ((msb - 1) << 2) | next two bits below the msb
+ * so every bin above the first four is 1/4 octave (about 19%) wide.
+ *
+ * Product payload on CCSDS_APID_LUX_HISTOGRAM, all fields big-endian, the
+ * secondary header tick is the start of the interval and the period is 0:
+ *   uint32 duration (ms), uint32 samples binned, uint8 first bin, uint8 bin count,
+ *   bin count x uint16 counts (saturating)
+ * Only the range of non-empty bins is sent.
+ *
+ * @note HAL-free so the ground tools share the bin edges.
+ */
+
+#ifndef INC_LUX_HISTOGRAM_H_
+#define INC_LUX_HISTOGRAM_H_
+
+#include <stdint.h>
+#include "CCSDS-Packet.h"
+
+/** @brief Bin geometry */
+#define LUX_HISTOGRAM_SUB_BITS 2   // Bins per octave = 1 << LUX_HISTOGRAM_SUB_BITS
+#define LUX_HISTOGRAM_TOP_BIT 25   // Highest octave, centi-lux >= 2^26 (671 klux, above full scale) go to the last bin
+#define LUX_HISTOGRAM_BINS ((LUX_HISTOGRAM_TOP_BIT - LUX_HISTOGRAM_SUB_BITS + 2) << LUX_HISTOGRAM_SUB_BITS)
+#define LUX_HISTOGRAM_HEADER_SIZE 10 // Product payload before the counts
+#define LUX_HISTOGRAM_PRODUCT_MAX (CCSDS_PACKET_SIZE(0) + LUX_HISTOGRAM_HEADER_SIZE + LUX_HISTOGRAM_BINS * 2)
+
+_Static_assert(LUX_HISTOGRAM_PRODUCT_MAX <= CCSDS_PACKET_LIMIT, "a full histogram must fit one packet");
+
+/** @brief Struct to store one histogram interval */
+typedef struct {
+	uint16_t counts[LUX_HISTOGRAM_BINS]; // Samples per bin, saturating
+	uint32_t startTick;  // Start of the interval
+	uint32_t samples;    // Samples binned in the interval
+	uint8_t minBin;      // Lowest non-empty bin
+	uint8_t maxBin;      // Highest non-empty bin
+	uint16_t seqCount;   // Sequence count of the next product
+} Lux_Histogram_t;
+
+
+/** @brief Function Prototypes for the lux histogram */
+void Lux_Histogram_Init(Lux_Histogram_t *hist, uint32_t tick);
+uint8_t Lux_Histogram_Bin(uint32_t centiLux);
+uint32_t Lux_Histogram_Bin_Floor(uint8_t bin);
+void Lux_Histogram_Add(Lux_Histogram_t *hist, uint32_t centiLux);
+uint16_t Lux_Histogram_Build_Product(Lux_Histogram_t *hist, uint32_t tick, uint8_t *out);
+
+#endif /* INC_LUX_HISTOGRAM_H_ */
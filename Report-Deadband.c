@@ -0,0 +1,88 @@
+/**
+ * @file Report-Deadband.c
+ * @brief Implementation of change-threshold (deadband) sample reporting.
+ * @author Kent Hong
+ *
+ * Samples are compared against the last reported sample, not the previous one,
+ * so a slow drift is still reported once it adds up to the deadband.
+ */
+
+#include <string.h>
+#include "Report-Deadband.h"
+
+
+/** @brief Returns 1 if counts moved out of the deadband around reference */
+static uint8_t Report_Deadband_Exceeded(const Report_Deadband_t *deadband, uint16_t counts, uint16_t reference) {
+
+	uint32_t change = (counts > reference) ? (uint32_t)(counts - reference) : (uint32_t)(reference - counts);
+
+	/* change > reference * rel / 1000, kept in integers */
+	return (change > deadband->absCounts) && ((change * 1000U) > ((uint32_t)reference * deadband->relPermille));
+}
+
+
+/*****************************************************************
+ * @brief Initialize the deadband                               *
+ * @param deadband: Pointer to the Report_Deadband_t struct     *
+ * @param absCounts: Absolute deadband in raw counts            *
+ * @param relPermille: Relative deadband in 1/1000              *
+ * @param heartbeatMs: Maximum time between reported samples,  *
+ *                     0 reports every sample                   *
+ ****************************************************************/
+void Report_Deadband_Init(Report_Deadband_t *deadband, uint16_t absCounts, uint16_t relPermille, uint32_t heartbeatMs) {
+	memset(deadband, 0, sizeof(*deadband));
+	Report_Deadband_Set(deadband, absCounts, relPermille, heartbeatMs);
+}
+
+
+/*****************************************************************
+ * @brief Change the thresholds at runtime                      *
+ * @param deadband: Pointer to the Report_Deadband_t struct     *
+ * @param absCounts: Absolute deadband in raw counts            *
+ * @param relPermille: Relative deadband in 1/1000              *
+ * @param heartbeatMs: Maximum time between reported samples   *
+ *                                                              *
+ * Counters are kept, the next sample is always reported.       *
+ ****************************************************************/
+void Report_Deadband_Set(Report_Deadband_t *deadband, uint16_t absCounts, uint16_t relPermille, uint32_t heartbeatMs) {
+	deadband->absCounts = absCounts;
+	deadband->relPermille = relPermille;
+	deadband->heartbeatMs = heartbeatMs;
+	deadband->hasReference = 0;
+}
+
+
+/*****************************************************************
+ * @brief Decide whether a sample is reported                   *
+ * @param deadband: Pointer to the Report_Deadband_t struct     *
+ * @param tick: Sample time (ms)                                *
+ * @param c0Data: Raw CH0 counts                                *
+ * @param c1Data: Raw CH1 counts                                *
+ * @param configCode: Gain and integration time code            *
+ * @param flags: LTR_329_FLAG_* quality flags                   *
+ * @return 1 to report the sample, 0 to suppress it             *
+ ****************************************************************/
+uint8_t Report_Deadband_Check(Report_Deadband_t *deadband, uint32_t tick, uint16_t c0Data, uint16_t c1Data, uint8_t configCode, uint8_t flags) {
+
+	uint8_t report = !deadband->hasReference
+			|| (configCode != deadband->lastConfig)
+			|| (flags != deadband->lastFlags)
+			|| ((tick - deadband->lastTick) >= deadband->heartbeatMs)
+			|| Report_Deadband_Exceeded(deadband, c0Data, deadband->lastC0)
+			|| Report_Deadband_Exceeded(deadband, c1Data, deadband->lastC1);
+
+	if (!report) {
+		deadband->suppressed++;
+		return 0;
+	}
+
+	deadband->hasReference = 1;
+	deadband->lastC0 = c0Data;
+	deadband->lastC1 = c1Data;
+	deadband->lastConfig = configCode;
+	deadband->lastFlags = flags;
+	deadband->lastTick = tick;
+	deadband->reported++;
+
+	return 1;
+}
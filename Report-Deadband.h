@@ -0,0 +1,54 @@
+/**
+ * @file Report-Deadband.h
+ * @brief Header file for change-threshold (deadband) sample reporting.
+ * @author Kent Hong
+ *
+ * This file contains definitions and function prototypes for deciding whether a
+ * sample is worth sending. A sample is reported when either raw channel moved
+ * away from the last reported sample by more than the deadband, when the
+ * configuration code or quality flags differ, or when nothing was reported for
+ * the heartbeat interval. The decision uses raw counts only, no float work is
+ * done for suppressed samples.
+ *
+ * The deadband of a channel is max(absCounts, lastCounts * relPermille / 1000),
+ * so the absolute floor covers eclipse noise and the relative part covers sunlight.
+ */
+
+#ifndef INC_REPORT_DEADBAND_H_
+#define INC_REPORT_DEADBAND_H_
+
+#include <stdint.h>
+
+/** @brief Default thresholds, override at compile time if needed */
+#ifndef REPORT_DEADBAND_ABS_COUNTS
+#define REPORT_DEADBAND_ABS_COUNTS 8       // Absolute deadband in raw counts
+#endif
+#ifndef REPORT_DEADBAND_REL_PERMILLE
+#define REPORT_DEADBAND_REL_PERMILLE 20    // Relative deadband, 2%
+#endif
+#ifndef REPORT_DEADBAND_HEARTBEAT_MS
+#define REPORT_DEADBAND_HEARTBEAT_MS 30000 // Longest silence before a sample is reported anyway
+#endif
+
+/** @brief Struct to store the deadband state */
+typedef struct {
+	uint16_t absCounts;     // Absolute deadband, raw counts
+	uint16_t relPermille;   // Relative deadband, 1/1000 of the last reported counts, 0 disables
+	uint32_t heartbeatMs;   // Maximum silence, 0 reports every sample
+	uint8_t hasReference;   // 0 until the first sample is reported
+	uint16_t lastC0;        // Last reported CH0 counts
+	uint16_t lastC1;        // Last reported CH1 counts
+	uint8_t lastConfig;     // Last reported config code
+	uint8_t lastFlags;      // Last reported quality flags
+	uint32_t lastTick;      // Tick of the last reported sample
+	uint32_t reported;      // Samples reported
+	uint32_t suppressed;    // Samples suppressed
+} Report_Deadband_t;
+
+
+/** @brief Function Prototypes for deadband reporting */
+void Report_Deadband_Init(Report_Deadband_t *deadband, uint16_t absCounts, uint16_t relPermille, uint32_t heartbeatMs);
+void Report_Deadband_Set(Report_Deadband_t *deadband, uint16_t absCounts, uint16_t relPermille, uint32_t heartbeatMs);
+uint8_t Report_Deadband_Check(Report_Deadband_t *deadband, uint32_t tick, uint16_t c0Data, uint16_t c1Data, uint8_t configCode, uint8_t flags);
+
+#endif /* INC_REPORT_DEADBAND_H_ */
@@ -0,0 +1,276 @@
+/**
+ * @file Sample-Codec.c
+ * @brief Implementation of the delta + zigzag varint sample stream codec.
+ * @author Kent Hong
+ *
+ * Blocks are closed when they reach SAMPLE_CODEC_BLOCK_SAMPLES samples, when the
+ * next record might not fit, or when a sample is off the nominal schedule. A sample
+ * that is late by whole periods stays in the block with a skip count, so sample
+ * times are rebuilt from the packet header and the skips.
+ *
+ * @note Packets produced here are at most CCSDS_PACKET_SIZE(0) + SAMPLE_CODEC_BLOCK_MAX bytes.
+ */
+
+#include <string.h>
+#include "Sample-Codec.h"
+
+
+/** @brief Append an unsigned LEB128 varint, returns bytes written */
+static uint8_t Sample_Put_Varint(uint8_t *dest, uint32_t value) {
+
+	uint8_t length = 0;
+
+	while (value >= 0x80U) {
+		dest[length++] = (uint8_t)(value | 0x80U);
+		value >>= 7;
+	}
+	dest[length++] = (uint8_t)value;
+
+	return length;
+}
+
+/** @brief Read an unsigned LEB128 varint of up to 4 bytes, returns 0 if truncated or too long */
+static uint8_t Sample_Get_Varint(const uint8_t *src, uint16_t available, uint32_t *value) {
+
+	uint32_t result = 0;
+
+	for (uint8_t i = 0; (i < available) && (i < 4); i++) {
+		result |= (uint32_t)(src[i] & 0x7FU) << (7 * i);
+		if (!(src[i] & 0x80U)) {
+			*value = result;
+			return i + 1;
+		}
+	}
+
+	return 0;
+}
+
+/** @brief Map a signed delta to unsigned so small magnitudes stay short */
+static uint32_t Sample_Zigzag(int32_t delta) {
+	return ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+}
+
+static int32_t Sample_Unzigzag(uint32_t value) {
+	return (int32_t)(value >> 1) ^ -(int32_t)(value & 1U);
+}
+
+
+/*****************************************************************
+ * @brief Initialize the sample encoder                         *
+ * @param enc: Pointer to the Sample_Encoder_t struct           *
+ * @param apid: APID of the block packets                       *
+ * @param periodMs: Nominal time between samples                *
+ ****************************************************************/
+void Sample_Encoder_Init(Sample_Encoder_t *enc, uint16_t apid, uint16_t periodMs) {
+	memset(enc, 0, sizeof(*enc));
+	enc->apid = apid;
+	enc->periodMs = periodMs;
+}
+
+
+/*****************************************************************
+ * @brief Close the open block into a CCSDS packet              *
+ * @param enc: Pointer to the Sample_Encoder_t struct           *
+ * @param out: Buffer of CCSDS_PACKET_SIZE(0) +                 *
+ *             SAMPLE_CODEC_BLOCK_MAX bytes                     *
+ * @return Packet length, 0 if the block is empty               *
+ ****************************************************************/
+uint16_t Sample_Encoder_Flush(Sample_Encoder_t *enc, uint8_t *out) {
+
+	if (enc->sampleCount == 0) {
+		return 0;
+	}
+
+	uint16_t length = CCSDS_Build_Packet(enc->apid, enc->seqCount, enc->firstTick, enc->periodMs, enc->block, enc->length, out);
+
+	enc->seqCount = (enc->seqCount + 1) & CCSDS_SEQ_COUNT_MASK;
+	enc->sampleCount = 0;
+	enc->length = 0;
+
+	return length;
+}
+
+
+/*****************************************************************
+ * @brief Add one sample to the open block                      *
+ * @param enc: Pointer to the Sample_Encoder_t struct           *
+ * @param sample: Sample to add                                 *
+ * @param out: Buffer of CCSDS_PACKET_SIZE(0) +                 *
+ *             SAMPLE_CODEC_BLOCK_MAX bytes                     *
+ * @return Length of a completed packet written to out, else 0  *
+ ****************************************************************/
+uint16_t Sample_Encoder_Add(Sample_Encoder_t *enc, const CCSDS_Sample_t *sample, uint8_t *out) {
+
+	uint16_t packetLength = 0;
+
+	/* Samples late by whole periods are skips, other off-schedule samples start a new block */
+	uint32_t skip = 0;
+	if (enc->sampleCount != 0) {
+		int32_t offsetMs = (int32_t)(sample->tick - enc->nextTick);
+		if ((offsetMs > (int32_t)(enc->periodMs / 2)) && (enc->periodMs != 0)) {
+			skip = ((uint32_t)offsetMs + enc->periodMs / 2) / enc->periodMs;
+			offsetMs -= (int32_t)(skip * enc->periodMs);
+		}
+		if ((offsetMs > (int32_t)(enc->periodMs / 2)) || (offsetMs < -(int32_t)(enc->periodMs / 2)) || (skip > SAMPLE_CODEC_SKIP_MAX)) {
+			packetLength = Sample_Encoder_Flush(enc, out);
+			skip = 0;
+		}
+	}
+
+	uint8_t *record = &enc->block[enc->length];
+	uint16_t length = 0;
+
+	if (enc->sampleCount == 0) {
+		/* Keyframe: absolute counts, config and flags */
+		enc->firstTick = sample->tick;
+		length += Sample_Put_Varint(&record[length], 1U);
+		record[length++] = SAMPLE_CODEC_KEYFRAME | SAMPLE_CODEC_HAS_CONFIG | SAMPLE_CODEC_HAS_FLAGS;
+		record[length++] = sample->configCode;
+		record[length++] = sample->flags;
+		length += Sample_Put_Varint(&record[length], sample->c0Data);
+		length += Sample_Put_Varint(&record[length], sample->c1Data);
+	}
+	else {
+		uint8_t control = 0;
+		if (sample->configCode != enc->prev.configCode) {
+			control |= SAMPLE_CODEC_HAS_CONFIG;
+		}
+		if (sample->flags != enc->prev.flags) {
+			control |= SAMPLE_CODEC_HAS_FLAGS;
+		}
+		if (skip != 0) {
+			control |= SAMPLE_CODEC_HAS_SKIP;
+		}
+
+		uint32_t head = (Sample_Zigzag((int32_t)sample->c0Data - (int32_t)enc->prev.c0Data) << 1) | (control != 0);
+		length += Sample_Put_Varint(&record[length], head);
+		if (control != 0) {
+			record[length++] = control;
+			if (control & SAMPLE_CODEC_HAS_CONFIG) {
+				record[length++] = sample->configCode;
+			}
+			if (control & SAMPLE_CODEC_HAS_FLAGS) {
+				record[length++] = sample->flags;
+			}
+			if (control & SAMPLE_CODEC_HAS_SKIP) {
+				length += Sample_Put_Varint(&record[length], skip);
+			}
+		}
+		length += Sample_Put_Varint(&record[length], Sample_Zigzag((int32_t)sample->c1Data - (int32_t)enc->prev.c1Data));
+	}
+
+	enc->length += length;
+	enc->sampleCount++;
+	enc->nextTick = (enc->sampleCount == 1) ? sample->tick + enc->periodMs : enc->nextTick + (skip + 1U) * enc->periodMs;
+	enc->prev = *sample;
+
+	/* Close the block when full or when the worst-case next record might not fit */
+	if ((packetLength == 0) && ((enc->sampleCount >= SAMPLE_CODEC_BLOCK_SAMPLES)
+			|| (enc->length + SAMPLE_CODEC_RECORD_MAX > SAMPLE_CODEC_BLOCK_MAX))) {
+		packetLength = Sample_Encoder_Flush(enc, out);
+	}
+
+	return packetLength;
+}
+
+
+/*****************************************************************
+ * @brief Start decoding the block carried by one packet        *
+ * @param dec: Pointer to the Sample_Decoder_t struct           *
+ * @param header: Header from CCSDS_Parse_Packet()              *
+ ****************************************************************/
+void Sample_Decoder_Init(Sample_Decoder_t *dec, const CCSDS_Header_t *header) {
+	memset(dec, 0, sizeof(*dec));
+	dec->data = header->data;
+	dec->length = header->dataLength;
+	dec->tick = header->tick;
+	dec->periodMs = header->periodMs;
+}
+
+
+/*****************************************************************
+ * @brief Decode the next sample of the block                   *
+ * @param dec: Pointer to the Sample_Decoder_t struct           *
+ * @param sample: Pointer to store the sample                   *
+ * @return 1 if a sample was decoded, 0 at the end of the       *
+ *         block, -1 if the block is malformed                  *
+ ****************************************************************/
+int8_t Sample_Decoder_Next(Sample_Decoder_t *dec, CCSDS_Sample_t *sample) {
+
+	if (dec->pos >= dec->length) {
+		return 0;
+	}
+
+	const uint8_t *src = dec->data;
+	uint16_t pos = dec->pos;
+	uint32_t head, value;
+	uint8_t n;
+
+	if ((n = Sample_Get_Varint(&src[pos], dec->length - pos, &head)) == 0) {
+		return -1;
+	}
+	pos += n;
+
+	uint8_t control = 0;
+	if (head & 1U) {
+		if (pos >= dec->length) {
+			return -1;
+		}
+		control = src[pos++];
+	}
+
+	/* The first record of a block must be a keyframe */
+	if ((dec->pos == 0) != ((control & SAMPLE_CODEC_KEYFRAME) != 0)) {
+		return -1;
+	}
+
+	CCSDS_Sample_t next = dec->prev;
+	if (control & SAMPLE_CODEC_HAS_CONFIG) {
+		if (pos >= dec->length) {
+			return -1;
+		}
+		next.configCode = src[pos++];
+	}
+	if (control & SAMPLE_CODEC_HAS_FLAGS) {
+		if (pos >= dec->length) {
+			return -1;
+		}
+		next.flags = src[pos++];
+	}
+	uint32_t skip = 0;
+	if (control & SAMPLE_CODEC_HAS_SKIP) {
+		if ((n = Sample_Get_Varint(&src[pos], dec->length - pos, &skip)) == 0) {
+			return -1;
+		}
+		pos += n;
+	}
+
+	if (control & SAMPLE_CODEC_KEYFRAME) {
+		if ((n = Sample_Get_Varint(&src[pos], dec->length - pos, &value)) == 0) {
+			return -1;
+		}
+		pos += n;
+		next.c0Data = (uint16_t)value;
+		if ((n = Sample_Get_Varint(&src[pos], dec->length - pos, &value)) == 0) {
+			return -1;
+		}
+		pos += n;
+		next.c1Data = (uint16_t)value;
+	}
+	else {
+		next.c0Data = (uint16_t)((int32_t)next.c0Data + Sample_Unzigzag(head >> 1));
+		if ((n = Sample_Get_Varint(&src[pos], dec->length - pos, &value)) == 0) {
+			return -1;
+		}
+		pos += n;
+		next.c1Data = (uint16_t)((int32_t)next.c1Data + Sample_Unzigzag(value));
+	}
+
+	next.tick = dec->tick + skip * dec->periodMs;
+	dec->tick = next.tick + dec->periodMs;
+	dec->prev = next;
+	dec->pos = pos;
+	*sample = next;
+
+	return 1;
+}
@@ -0,0 +1,79 @@
+/**
+ * @file Sample-Codec.h
+ * @brief Header file for the delta + zigzag varint sample stream codec.
+ * @author Kent Hong
+ *
+ * This file contains definitions and function prototypes for compressing the
+ * LTR-329 sample series. Consecutive samples are sent as zigzag varint deltas of
+ * c0 and c1; every block starts with a keyframe and travels in its own CCSDS
+ * packet (CCSDS_APID_LTR_329_DELTA), so a lost packet loses one block only.
+ *
+ * Record layout:
+ *   varint(zigzag(c0 - prevC0) << 1 | control)
+ *   if control: control byte, bit 0 keyframe, bit 1 config follows, bit 2 flags follows,
+ *               bit 3 skip follows
+ *               [config byte] [flags byte] [varint(skip)]
+ *   keyframe:   varint(c0) varint(c1)       (the delta in the first varint is 0)
+ *   otherwise:  varint(zigzag(c1 - prevC1))
+ * The keyframe always carries config and flags. Flags and config are otherwise
+ * only sent when they change, so a steady stream costs two bytes per sample.
+ * Skip is the number of nominal periods left out before the sample (deadband
+ * reporting, Report-Deadband.h), the sample time is the previous one plus
+ * (skip + 1) periods.
+ *
+ * @note HAL-free so the ground tools in tools/ share the decoder.
+ */
+
+#ifndef INC_SAMPLE_CODEC_H_
+#define INC_SAMPLE_CODEC_H_
+
+#include <stdint.h>
+#include "CCSDS-Packet.h"
+
+/** @brief Block geometry, override at compile time if needed */
+#ifndef SAMPLE_CODEC_BLOCK_SAMPLES
+#define SAMPLE_CODEC_BLOCK_SAMPLES 64    // Samples per block (keyframe interval)
+#endif
+#define SAMPLE_CODEC_BLOCK_MAX 192       // Payload bytes per block, keeps packets inside one telemetry buffer
+#define SAMPLE_CODEC_RECORD_MAX 12       // Worst-case bytes of one record (a delta with config, flags and skip)
+#define SAMPLE_CODEC_SKIP_MAX 0xFFFF     // Longer gaps start a new block
+#define SAMPLE_CODEC_PACKET_MAX (CCSDS_PACKET_SIZE(0) + SAMPLE_CODEC_BLOCK_MAX) // Largest block packet
+
+/** @brief Control byte bits */
+#define SAMPLE_CODEC_KEYFRAME 0x01
+#define SAMPLE_CODEC_HAS_CONFIG 0x02
+#define SAMPLE_CODEC_HAS_FLAGS 0x04
+#define SAMPLE_CODEC_HAS_SKIP 0x08
+
+/** @brief Struct to store the encoder state */
+typedef struct {
+	uint16_t apid;          // APID of the block packets
+	uint16_t seqCount;      // Sequence count of the next packet
+	uint16_t periodMs;      // Nominal sample period
+	uint16_t sampleCount;   // Samples in the open block
+	uint16_t length;        // Payload bytes in the open block
+	uint32_t firstTick;     // Tick of the keyframe of the open block
+	uint32_t nextTick;      // Nominal tick of the next sample without a skip
+	CCSDS_Sample_t prev;    // Previous sample, delta reference
+	uint8_t block[SAMPLE_CODEC_BLOCK_MAX]; // Open block payload
+} Sample_Encoder_t;
+
+/** @brief Struct to store the streaming decoder state for one block */
+typedef struct {
+	const uint8_t *data;    // Block payload
+	uint16_t length;        // Payload length
+	uint16_t pos;           // Read position
+	uint32_t tick;          // Tick of the next sample
+	uint16_t periodMs;      // Sample period from the packet header
+	CCSDS_Sample_t prev;    // Previous decoded sample
+} Sample_Decoder_t;
+
+
+/** @brief Function Prototypes for the sample codec */
+void Sample_Encoder_Init(Sample_Encoder_t *enc, uint16_t apid, uint16_t periodMs);
+uint16_t Sample_Encoder_Add(Sample_Encoder_t *enc, const CCSDS_Sample_t *sample, uint8_t *out);
+uint16_t Sample_Encoder_Flush(Sample_Encoder_t *enc, uint8_t *out);
+void Sample_Decoder_Init(Sample_Decoder_t *dec, const CCSDS_Header_t *header);
+int8_t Sample_Decoder_Next(Sample_Decoder_t *dec, CCSDS_Sample_t *sample);
+
+#endif /* INC_SAMPLE_CODEC_H_ */
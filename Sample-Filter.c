@@ -0,0 +1,130 @@
+/**
+ * @file Sample-Filter.c
+ * @brief Implementation of the fixed-point oversampling filter of raw counts.
+ * @author Kent Hong
+ *
+ * Per sample the EMA is a shift, a subtract and an add per channel and the
+ * boxcar is a subtract and an add per channel, neither depends on the window
+ * length. The one division of the boxcar mean is done per filtered sample only.
+ */
+
+#include <string.h>
+#include "Sample-Filter.h"
+
+
+/*****************************************************************
+ * @brief Initialize the filter                                 *
+ * @param filter: Pointer to the Sample_Filter_t struct         *
+ * @param type: SAMPLE_FILTER_NONE, _EMA or _BOXCAR             *
+ * @param emaShift: EMA smoothing, alpha = 1 / 2^emaShift,      *
+ *                  clamped to SAMPLE_FILTER_EMA_SHIFT_MAX      *
+ * @param boxcarLength: Boxcar window, clamped to 1 to          *
+ *                      SAMPLE_FILTER_BOXCAR_MAX                *
+ * @param decimation: Samples per filtered sample, 0 counts as 1 *
+ *                                                              *
+ * SAMPLE_FILTER_NONE passes every decimation-th sample on      *
+ * unchanged.                                                   *
+ ****************************************************************/
+void Sample_Filter_Init(Sample_Filter_t *filter, uint8_t type, uint8_t emaShift, uint16_t boxcarLength, uint16_t decimation) {
+	memset(filter, 0, sizeof(*filter));
+	filter->type = (type <= SAMPLE_FILTER_BOXCAR) ? type : SAMPLE_FILTER_NONE;
+	filter->emaShift = (emaShift <= SAMPLE_FILTER_EMA_SHIFT_MAX) ? emaShift : SAMPLE_FILTER_EMA_SHIFT_MAX;
+	filter->length = (boxcarLength == 0) ? 1 : (boxcarLength > SAMPLE_FILTER_BOXCAR_MAX) ? SAMPLE_FILTER_BOXCAR_MAX : boxcarLength;
+	filter->decimation = (decimation != 0) ? decimation : 1;
+}
+
+
+/*****************************************************************
+ * @brief Forget the averaged counts                            *
+ * @param filter: Pointer to the Sample_Filter_t struct         *
+ *                                                              *
+ * The next valid sample seeds the filter. The decimation count *
+ * is kept, so filtered samples stay on the same grid.          *
+ ****************************************************************/
+void Sample_Filter_Restart(Sample_Filter_t *filter) {
+	filter->sum[0] = 0;
+	filter->sum[1] = 0;
+	filter->ema[0] = 0;
+	filter->ema[1] = 0;
+	filter->filled = 0;
+	filter->head = 0;
+}
+
+
+/** @brief Feed the counts of one channel */
+static void Sample_Filter_Update(Sample_Filter_t *filter, uint8_t channel, uint16_t counts) {
+
+	if (filter->type == SAMPLE_FILTER_EMA) {
+		/* ema = y * 2^shift, so y += (x - y) / 2^shift is ema += x - ema / 2^shift */
+		filter->ema[channel] = (filter->filled == 0) ? ((uint32_t)counts << filter->emaShift)
+				: filter->ema[channel] - (filter->ema[channel] >> filter->emaShift) + counts;
+	}
+	else {
+		/* head is the oldest counts once the window is full */
+		if (filter->filled == filter->length) {
+			filter->sum[channel] -= filter->window[channel][filter->head];
+		}
+		filter->window[channel][filter->head] = counts;
+		filter->sum[channel] += counts;
+	}
+}
+
+
+/** @brief Filtered counts of one channel, rounded to nearest */
+static uint16_t Sample_Filter_Output(const Sample_Filter_t *filter, uint8_t channel) {
+
+	if (filter->type == SAMPLE_FILTER_EMA) {
+		uint32_t half = (filter->emaShift != 0) ? (1UL << (filter->emaShift - 1)) : 0;
+		return (uint16_t)((filter->ema[channel] + half) >> filter->emaShift);
+	}
+	return (uint16_t)((filter->sum[channel] + filter->filled / 2U) / filter->filled);
+}
+
+
+/*****************************************************************
+ * @brief Add a sample                                          *
+ * @param filter: Pointer to the Sample_Filter_t struct         *
+ * @param sample: Raw sample                                    *
+ * @param filtered: Pointer to store the filtered sample        *
+ * @return 1 if a filtered sample is due and was stored, 0 if   *
+ *         the sample was only averaged in                      *
+ ****************************************************************/
+uint8_t Sample_Filter_Add(Sample_Filter_t *filter, const CCSDS_Sample_t *sample, CCSDS_Sample_t *filtered) {
+
+	if ((filter->type != SAMPLE_FILTER_NONE) && !(sample->flags & LTR_329_FLAGS_INVALID)) {
+		if ((filter->filled != 0) && (sample->configCode != filter->configCode)) {
+			Sample_Filter_Restart(filter);
+			filter->restarts++;
+		}
+		Sample_Filter_Update(filter, 0, sample->c0Data);
+		Sample_Filter_Update(filter, 1, sample->c1Data);
+		if (filter->type == SAMPLE_FILTER_BOXCAR) {
+			filter->head = (filter->head + 1U == filter->length) ? 0 : filter->head + 1U;
+			filter->filled += (filter->filled < filter->length);
+		}
+		else {
+			filter->filled = 1;
+		}
+		filter->configCode = sample->configCode;
+		filter->flags |= sample->flags;
+	}
+
+	if (++filter->pending < filter->decimation) {
+		return 0;
+	}
+	filter->pending = 0;
+
+	if ((filter->type == SAMPLE_FILTER_NONE) || (sample->flags & LTR_329_FLAGS_INVALID)) {
+		*filtered = *sample;
+	}
+	else {
+		filtered->tick = sample->tick;
+		filtered->c0Data = Sample_Filter_Output(filter, 0);
+		filtered->c1Data = Sample_Filter_Output(filter, 1);
+		filtered->configCode = filter->configCode;
+		filtered->flags = filter->flags;
+	}
+	filter->flags = 0;
+
+	return 1;
+}
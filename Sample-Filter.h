@@ -0,0 +1,69 @@
+/**
+ * @file Sample-Filter.h
+ * @brief Header file for the fixed-point oversampling filter of raw counts.
+ * @author Kent Hong
+ *
+ * This file contains definitions and function prototypes for averaging the raw
+ * CH0 and CH1 counts of consecutive samples on board, before any lux math, and
+ * passing on one filtered sample per decimation samples. Both filters update in
+ * O(1) per sample with integer arithmetic only:
+ *   EMA     y += (x - y) / 2^shift, kept as y * 2^shift so no fraction is lost
+ *   Boxcar  mean of the last length samples, a running sum over a ring of counts
+ * Averaging N samples of independent noise lowers it by sqrt(N). An EMA with
+ * shift k averages about 2^(k+1) - 1 samples.
+ *
+ * A change of gain or integration time restarts the filter, counts taken with
+ * different settings are not averaged together. Invalid samples (I2C error,
+ * reserved config code) are left out but still count toward the decimation, so
+ * filtered samples stay on a grid of decimation x the sample period. A filtered
+ * sample carries the tick of the newest input and the OR of the flags of the
+ * inputs averaged since the previous one. If the newest input is invalid it is
+ * passed on unchanged instead, so the ground sees the fault.
+ */
+
+#ifndef INC_SAMPLE_FILTER_H_
+#define INC_SAMPLE_FILTER_H_
+
+#include <stdint.h>
+#include "CCSDS-Packet.h"
+#include "LTR-329-Flags.h"
+
+/** @brief Filter types, defines so main.c can select one with #if */
+#define SAMPLE_FILTER_NONE 0    // Every sample is passed on unchanged
+#define SAMPLE_FILTER_EMA 1     // Exponential moving average
+#define SAMPLE_FILTER_BOXCAR 2  // Moving average over a window of samples
+
+/** @brief Longest boxcar window, sizes the static window of Sample_Filter_t */
+#ifndef SAMPLE_FILTER_BOXCAR_MAX
+#define SAMPLE_FILTER_BOXCAR_MAX 32
+#endif
+#define SAMPLE_FILTER_EMA_SHIFT_MAX 15  // 65535 << 15 still fits the 32-bit accumulator
+
+#if (SAMPLE_FILTER_BOXCAR_MAX < 1) || (SAMPLE_FILTER_BOXCAR_MAX > 65535)
+#error "SAMPLE_FILTER_BOXCAR_MAX must be 1 to 65535"
+#endif
+
+/** @brief Struct to store the filter state of both channels */
+typedef struct {
+	uint16_t window[2][SAMPLE_FILTER_BOXCAR_MAX]; // Boxcar: last counts of CH0 and CH1
+	uint32_t sum[2];         // Boxcar: sum of the counts in the window
+	uint32_t ema[2];         // EMA: filtered counts x 2^emaShift
+	uint16_t length;         // Boxcar: window length in samples
+	uint16_t filled;         // Boxcar: counts in the window, up to length. EMA: 1 once seeded
+	uint16_t head;           // Boxcar: window index written next, the oldest counts once full
+	uint16_t decimation;     // Samples per filtered sample
+	uint16_t pending;        // Samples since the last filtered sample
+	uint8_t type;            // SAMPLE_FILTER_NONE, _EMA or _BOXCAR
+	uint8_t emaShift;        // EMA: smoothing, alpha = 1 / 2^emaShift
+	uint8_t configCode;      // Config code of the averaged counts
+	uint8_t flags;           // OR of the flags of the inputs averaged since the last filtered sample
+	uint32_t restarts;       // Restarts on a config change
+} Sample_Filter_t;
+
+
+/** @brief Function Prototypes for the sample filter */
+void Sample_Filter_Init(Sample_Filter_t *filter, uint8_t type, uint8_t emaShift, uint16_t boxcarLength, uint16_t decimation);
+void Sample_Filter_Restart(Sample_Filter_t *filter);
+uint8_t Sample_Filter_Add(Sample_Filter_t *filter, const CCSDS_Sample_t *sample, CCSDS_Sample_t *filtered);
+
+#endif /* INC_SAMPLE_FILTER_H_ */
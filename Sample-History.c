@@ -0,0 +1,246 @@
+/**
+ * @file Sample-History.c
+ * @brief Implementation of the packed sample record and structure-of-arrays history.
+ * @author Kent Hong
+ *
+ * The kernels read each channel array front to back with no per-sample branches
+ * on the storage layout, and the lux kernel replaces the two divisions of
+ * LTR_329_Calculate_Lux() with one multiply by a per-config scale computed once
+ * per call.
+ */
+
+#include <string.h>
+#include "Sample-History.h"
+
+/** @brief Gain and integration time by register code (pg. 13-14 of LTR-329 datasheet), 0 for reserved codes */
+static const uint8_t gainByCode[8] = {1, 2, 4, 8, 0, 0, 48, 96};
+static const uint16_t intTimeByCode[8] = {100, 50, 200, 400, 150, 250, 300, 350};
+
+
+/*****************************************************************
+ * @brief Combine a config code and quality flags into one byte *
+ * @param configCode: Gain code << 3 | integration time code    *
+ * @param flags: LTR_329_FLAG_* quality flags                   *
+ * @return Mode byte, saturation is dropped on invalid samples  *
+ *         so a real sample never reads as SAMPLE_PACK_GAP      *
+ ****************************************************************/
+uint8_t Sample_Pack_Mode(uint8_t configCode, uint8_t flags) {
+
+	uint8_t mode = configCode & SAMPLE_PACK_CONFIG_MASK;
+
+	if (flags & LTR_329_FLAGS_INVALID) {
+		mode |= SAMPLE_PACK_FLAG_INVALID;
+	}
+	else if (flags & LTR_329_FLAG_SATURATED) {
+		mode |= SAMPLE_PACK_FLAG_SATURATED;
+	}
+
+	return mode;
+}
+
+
+/*****************************************************************
+ * @brief Pack a sample relative to the previous record         *
+ * @param sample: Sample to pack                                *
+ * @param prevTick: Tick of the previous record                 *
+ * @param periodMs: Sample period, the unit of dt               *
+ * @param packed: Pointer to store the packed record            *
+ * @return 1 if packed, 0 if the step exceeds SAMPLE_PACK_DT_MAX *
+ ****************************************************************/
+uint8_t Sample_Pack(const CCSDS_Sample_t *sample, uint32_t prevTick, uint16_t periodMs, Sample_Packed_t *packed) {
+
+	uint32_t steps = (sample->tick - prevTick) / periodMs;
+	if (steps > SAMPLE_PACK_DT_MAX) {
+		return 0;
+	}
+
+	packed->c0Data = sample->c0Data;
+	packed->c1Data = sample->c1Data;
+	packed->mode = Sample_Pack_Mode(sample->configCode, sample->flags);
+	packed->dt = (uint8_t)steps;
+
+	return 1;
+}
+
+
+/*****************************************************************
+ * @brief Unpack a record                                       *
+ * @param packed: Record to unpack                              *
+ * @param prevTick: Tick of the previous record                 *
+ * @param periodMs: Sample period, the unit of dt               *
+ * @param sample: Pointer to store the sample                   *
+ *                                                              *
+ * An invalid record comes back with both invalid LTR_329 flags *
+ * set, the packed form does not say which one it was.          *
+ ****************************************************************/
+void Sample_Unpack(const Sample_Packed_t *packed, uint32_t prevTick, uint16_t periodMs, CCSDS_Sample_t *sample) {
+
+	sample->tick = prevTick + (uint32_t)packed->dt * periodMs;
+	sample->c0Data = packed->c0Data;
+	sample->c1Data = packed->c1Data;
+	sample->configCode = packed->mode & SAMPLE_PACK_CONFIG_MASK;
+	sample->flags = ((packed->mode & SAMPLE_PACK_FLAG_INVALID) ? LTR_329_FLAGS_INVALID : 0)
+			| ((packed->mode & SAMPLE_PACK_FLAG_SATURATED) ? LTR_329_FLAG_SATURATED : 0);
+}
+
+
+/*****************************************************************
+ * @brief Initialize an empty history                           *
+ * @param hist: Pointer to the Sample_History_t struct          *
+ * @param periodMs: Sample period, the unit of dt               *
+ ****************************************************************/
+void Sample_History_Init(Sample_History_t *hist, uint16_t periodMs) {
+	hist->count = 0;
+	hist->periodMs = (periodMs != 0) ? periodMs : 1;
+	hist->firstTick = 0;
+	hist->lastTick = 0;
+}
+
+
+/** @brief Append one entry, the caller checked the capacity */
+static void Sample_History_Append(Sample_History_t *hist, uint16_t c0Data, uint16_t c1Data, uint8_t mode, uint8_t dt) {
+	uint16_t i = hist->count++;
+	hist->c0[i] = c0Data;
+	hist->c1[i] = c1Data;
+	hist->mode[i] = mode;
+	hist->dt[i] = dt;
+}
+
+
+/*****************************************************************
+ * @brief Append a sample                                       *
+ * @param hist: Pointer to the Sample_History_t struct          *
+ * @param sample: Sample to append, not older than the newest   *
+ *                entry                                         *
+ * @return 1 if appended, 0 if the history is full              *
+ *                                                              *
+ * Steps longer than SAMPLE_PACK_DT_MAX periods take one gap    *
+ * entry per SAMPLE_PACK_DT_MAX periods.                        *
+ ****************************************************************/
+uint8_t Sample_History_Push(Sample_History_t *hist, const CCSDS_Sample_t *sample) {
+
+	uint8_t mode = Sample_Pack_Mode(sample->configCode, sample->flags);
+
+	if (hist->count == 0) {
+		hist->firstTick = sample->tick;
+		hist->lastTick = sample->tick;
+		Sample_History_Append(hist, sample->c0Data, sample->c1Data, mode, 0);
+		return 1;
+	}
+
+	uint32_t steps = (sample->tick - hist->lastTick) / hist->periodMs;
+	uint32_t gaps = (steps > SAMPLE_PACK_DT_MAX) ? (steps - 1) / SAMPLE_PACK_DT_MAX : 0;
+	if ((uint32_t)hist->count + gaps + 1U > SAMPLE_HISTORY_SIZE) {
+		return 0;
+	}
+
+	hist->lastTick += steps * hist->periodMs;
+	for (; gaps > 0; gaps--) {
+		Sample_History_Append(hist, 0, 0, SAMPLE_PACK_GAP, SAMPLE_PACK_DT_MAX);
+		steps -= SAMPLE_PACK_DT_MAX;
+	}
+	Sample_History_Append(hist, sample->c0Data, sample->c1Data, mode, (uint8_t)steps);
+
+	return 1;
+}
+
+
+/*****************************************************************
+ * @brief Expand the history into samples, gaps are skipped     *
+ * @param hist: Pointer to the Sample_History_t struct          *
+ * @param samples: Array of at least hist->count samples        *
+ * @return Number of samples written                            *
+ ****************************************************************/
+uint16_t Sample_History_Unpack(const Sample_History_t *hist, CCSDS_Sample_t *samples) {
+
+	uint32_t tick = hist->firstTick;
+	uint16_t written = 0;
+
+	for (uint16_t i = 0; i < hist->count; i++) {
+		tick += (uint32_t)hist->dt[i] * hist->periodMs;
+		if (hist->mode[i] == SAMPLE_PACK_GAP) {
+			continue;
+		}
+		CCSDS_Sample_t *sample = &samples[written++];
+		sample->tick = tick;
+		sample->c0Data = hist->c0[i];
+		sample->c1Data = hist->c1[i];
+		sample->configCode = hist->mode[i] & SAMPLE_PACK_CONFIG_MASK;
+		sample->flags = ((hist->mode[i] & SAMPLE_PACK_FLAG_INVALID) ? LTR_329_FLAGS_INVALID : 0)
+				| ((hist->mode[i] & SAMPLE_PACK_FLAG_SATURATED) ? LTR_329_FLAG_SATURATED : 0);
+	}
+
+	return written;
+}
+
+
+/*****************************************************************
+ * @brief Min, max and sum of both channels over valid entries  *
+ * @param hist: Pointer to the Sample_History_t struct          *
+ * @param stats: Pointer to store the statistics, minimums are  *
+ *               0xFFFF if no entry is valid                    *
+ ****************************************************************/
+void Sample_History_Stats(const Sample_History_t *hist, Sample_History_Stats_t *stats) {
+
+	memset(stats, 0, sizeof(*stats));
+	stats->c0Min = UINT16_MAX;
+	stats->c1Min = UINT16_MAX;
+
+	for (uint16_t i = 0; i < hist->count; i++) {
+		if (hist->mode[i] & SAMPLE_PACK_FLAG_INVALID) {
+			continue;
+		}
+		uint16_t c0Data = hist->c0[i];
+		uint16_t c1Data = hist->c1[i];
+		stats->c0Min = (c0Data < stats->c0Min) ? c0Data : stats->c0Min;
+		stats->c0Max = (c0Data > stats->c0Max) ? c0Data : stats->c0Max;
+		stats->c1Min = (c1Data < stats->c1Min) ? c1Data : stats->c1Min;
+		stats->c1Max = (c1Data > stats->c1Max) ? c1Data : stats->c1Max;
+		stats->c0Sum += c0Data;
+		stats->c1Sum += c1Data;
+		stats->validCount++;
+	}
+}
+
+
+/*****************************************************************
+ * @brief Convert every entry to lux                            *
+ * @param hist: Pointer to the Sample_History_t struct          *
+ * @param lux: Array of at least hist->count values, 0 for      *
+ *             invalid entries, gaps and reserved gain codes    *
+ *                                                              *
+ * Same formula and units as LTR_329_Calculate_Lux() (Appendix  *
+ * A, pg. 3), equal up to float rounding.                       *
+ ****************************************************************/
+void Sample_History_Lux(const Sample_History_t *hist, float *lux) {
+
+	/* 1 / (gain x integration time) for every config code, 0 marks a reserved gain */
+	float scale[SAMPLE_PACK_CONFIG_MASK + 1];
+	for (uint8_t code = 0; code <= SAMPLE_PACK_CONFIG_MASK; code++) {
+		uint8_t gain = gainByCode[code >> 3];
+		scale[code] = (gain != 0) ? 1.0f / ((float)gain * (float)intTimeByCode[code & 0x07]) : 0.0f;
+	}
+
+	for (uint16_t i = 0; i < hist->count; i++) {
+		float c0Data = (float)hist->c0[i];
+		float c1Data = (float)hist->c1[i];
+		float sum = c0Data + c1Data;
+		float s = (hist->mode[i] & SAMPLE_PACK_FLAG_INVALID) ? 0.0f : scale[hist->mode[i] & SAMPLE_PACK_CONFIG_MASK];
+
+		/* Ratio bands of c1 / (c0 + c1) compared without dividing */
+		float value;
+		if (c1Data < 0.45f * sum) {
+			value = 1.7743f * c0Data + 1.1059f * c1Data;
+		}
+		else if (c1Data < 0.64f * sum) {
+			value = 4.2785f * c0Data - 1.9548f * c1Data;
+		}
+		else if (c1Data < 0.85f * sum) {
+			value = 0.5926f * c0Data + 0.1185f * c1Data;
+		}
+		else {
+			value = 0.0f;
+		}
+		lux[i] = value * s;
+	}
+}
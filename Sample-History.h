@@ -0,0 +1,88 @@
+/**
+ * @file Sample-History.h
+ * @brief Header file for the packed sample record and structure-of-arrays history.
+ * @author Kent Hong
+ *
+ * This file contains definitions and function prototypes for keeping sample
+ * history in 6 bytes per sample instead of whole LTR329_t copies:
+ *   uint16 c0, uint16 c1   raw counts
+ *   uint8 mode             config code (gain code << 3 | integration time code) in
+ *                          bits 5:0, SAMPLE_PACK_FLAG_* in bits 7:6
+ *   uint8 dt               sample periods since the previous record (side stream)
+ * Ticks are kept on the period grid, rounded down. A gap longer than 255 periods
+ * is bridged by gap entries (mode SAMPLE_PACK_GAP, zero counts).
+ *
+ * Sample_History_t stores the same fields as parallel arrays, so batch kernels
+ * (statistics, lux conversion, compression) stream over contiguous channel data.
+ * Gap entries carry the INVALID bit, so kernels that skip invalid samples skip
+ * gaps for free.
+ *
+ * @note HAL-free so the kernels can be benchmarked on the host (tools/sample-history-bench.c).
+ */
+
+#ifndef INC_SAMPLE_HISTORY_H_
+#define INC_SAMPLE_HISTORY_H_
+
+#include <stdint.h>
+#include "CCSDS-Packet.h"
+#include "LTR-329-Flags.h"
+
+/** @brief Number of entries held, override at compile time if needed */
+#ifndef SAMPLE_HISTORY_SIZE
+#define SAMPLE_HISTORY_SIZE 512
+#endif
+
+/** @brief Mode byte layout */
+#define SAMPLE_PACK_CONFIG_MASK 0x3F
+#define SAMPLE_PACK_FLAG_SATURATED 0x40 // A channel read full scale
+#define SAMPLE_PACK_FLAG_INVALID 0x80   // I2C error or reserved config code, counts are not usable
+#define SAMPLE_PACK_GAP 0xC0            // Both flags, never a real sample: time passes without data
+#define SAMPLE_PACK_DT_MAX 255          // Longest step between entries, in sample periods
+
+/** @brief One packed sample, 6 bytes with no padding */
+typedef struct {
+	uint16_t c0Data;   // Raw CH0 counts
+	uint16_t c1Data;   // Raw CH1 counts
+	uint8_t mode;      // Config code and SAMPLE_PACK_FLAG_* bits
+	uint8_t dt;        // Sample periods since the previous record
+} Sample_Packed_t;
+
+_Static_assert(sizeof(Sample_Packed_t) == 6, "Sample_Packed_t must stay 6 bytes");
+
+/** @brief Struct to store a structure-of-arrays sample history */
+typedef struct {
+	uint16_t c0[SAMPLE_HISTORY_SIZE];  // Raw CH0 counts
+	uint16_t c1[SAMPLE_HISTORY_SIZE];  // Raw CH1 counts
+	uint8_t mode[SAMPLE_HISTORY_SIZE]; // Config code and SAMPLE_PACK_FLAG_* bits
+	uint8_t dt[SAMPLE_HISTORY_SIZE];   // Side stream of time steps, dt[0] is 0
+	uint16_t count;      // Entries held
+	uint16_t periodMs;   // Sample period, the unit of dt
+	uint32_t firstTick;  // Tick of entry 0
+	uint32_t lastTick;   // Tick of the newest entry
+} Sample_History_t;
+
+/** @brief Channel statistics over the valid entries of a history */
+typedef struct {
+	uint16_t validCount;
+	uint16_t c0Min;
+	uint16_t c0Max;
+	uint16_t c1Min;
+	uint16_t c1Max;
+	uint32_t c0Sum;
+	uint32_t c1Sum;
+} Sample_History_Stats_t;
+
+
+/** @brief Function Prototypes for the packed sample record */
+uint8_t Sample_Pack_Mode(uint8_t configCode, uint8_t flags);
+uint8_t Sample_Pack(const CCSDS_Sample_t *sample, uint32_t prevTick, uint16_t periodMs, Sample_Packed_t *packed);
+void Sample_Unpack(const Sample_Packed_t *packed, uint32_t prevTick, uint16_t periodMs, CCSDS_Sample_t *sample);
+
+/** @brief Function Prototypes for the sample history */
+void Sample_History_Init(Sample_History_t *hist, uint16_t periodMs);
+uint8_t Sample_History_Push(Sample_History_t *hist, const CCSDS_Sample_t *sample);
+uint16_t Sample_History_Unpack(const Sample_History_t *hist, CCSDS_Sample_t *samples);
+void Sample_History_Stats(const Sample_History_t *hist, Sample_History_Stats_t *stats);
+void Sample_History_Lux(const Sample_History_t *hist, float *lux);
+
+#endif /* INC_SAMPLE_HISTORY_H_ */
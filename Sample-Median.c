@@ -0,0 +1,191 @@
+/**
+ * @file Sample-Median.c
+ * @brief Implementation of the sliding-window median filter of raw counts.
+ * @author Kent Hong
+ *
+ * Per sample and channel one slot is sifted through a heap of at most
+ * (window + 1) / 2 slots, plus at most one swap of the heap tops and two more
+ * sifts. No counts are copied or compared outside the heaps.
+ */
+
+#include <string.h>
+#include "Sample-Median.h"
+
+
+/** @brief 1 if slot a belongs above slot b in heap side: larger in the lower half, smaller in the upper half */
+static inline uint8_t Sample_Median_Above(const Sample_Median_Channel_t *ch, uint8_t side, uint8_t a, uint8_t b) {
+	return side ? (ch->counts[a] < ch->counts[b]) : (ch->counts[a] > ch->counts[b]);
+}
+
+
+/** @brief Store slot at index of heap side */
+static inline void Sample_Median_Place(Sample_Median_Channel_t *ch, uint8_t side, uint8_t index, uint8_t slot) {
+	ch->heap[side][index] = slot;
+	ch->position[slot] = index;
+	ch->side[slot] = side;
+}
+
+
+/** @brief Move the slot at index of heap side up or down until the heap is ordered again */
+static void Sample_Median_Sift(Sample_Median_Channel_t *ch, uint8_t side, uint8_t index) {
+
+	uint8_t *heap = ch->heap[side];
+	uint8_t size = ch->size[side];
+	uint8_t slot = heap[index];
+
+	while (index > 0) {
+		uint8_t parent = (uint8_t)((index - 1U) / 2U);
+		if (!Sample_Median_Above(ch, side, slot, heap[parent])) {
+			break;
+		}
+		Sample_Median_Place(ch, side, index, heap[parent]);
+		index = parent;
+	}
+	for (;;) {
+		uint16_t child = 2U * index + 1U;
+		if (child >= size) {
+			break;
+		}
+		if ((child + 1U < size) && Sample_Median_Above(ch, side, heap[child + 1U], heap[child])) {
+			child++;
+		}
+		if (!Sample_Median_Above(ch, side, heap[child], slot)) {
+			break;
+		}
+		Sample_Median_Place(ch, side, index, heap[child]);
+		index = (uint8_t)child;
+	}
+	Sample_Median_Place(ch, side, index, slot);
+}
+
+
+/** @brief Add slot to the bottom of heap side */
+static void Sample_Median_Push(Sample_Median_Channel_t *ch, uint8_t side, uint8_t slot) {
+	uint8_t index = ch->size[side]++;
+	Sample_Median_Place(ch, side, index, slot);
+	Sample_Median_Sift(ch, side, index);
+}
+
+
+/** @brief Move the top of heap side to the other heap */
+static void Sample_Median_Move_Top(Sample_Median_Channel_t *ch, uint8_t side) {
+	uint8_t top = ch->heap[side][0];
+	uint8_t last = ch->heap[side][--ch->size[side]];
+	if (ch->size[side] != 0) {
+		Sample_Median_Place(ch, side, 0, last);
+		Sample_Median_Sift(ch, side, 0);
+	}
+	Sample_Median_Push(ch, side ^ 1U, top);
+}
+
+
+/** @brief Counts of a new slot while the window fills, the lower half keeps the extra slot of an odd count */
+static void Sample_Median_Insert(Sample_Median_Channel_t *ch, uint8_t slot, uint16_t counts) {
+
+	ch->counts[slot] = counts;
+	if ((ch->size[0] == 0) || (counts <= ch->counts[ch->heap[0][0]])) {
+		Sample_Median_Push(ch, 0, slot);
+	}
+	else {
+		Sample_Median_Push(ch, 1, slot);
+	}
+	if (ch->size[0] > ch->size[1] + 1U) {
+		Sample_Median_Move_Top(ch, 0);
+	}
+	else if (ch->size[1] > ch->size[0]) {
+		Sample_Median_Move_Top(ch, 1);
+	}
+}
+
+
+/** @brief Overwrite the oldest counts once the window is full */
+static void Sample_Median_Replace(Sample_Median_Channel_t *ch, uint8_t slot, uint16_t counts) {
+
+	ch->counts[slot] = counts;
+	Sample_Median_Sift(ch, ch->side[slot], ch->position[slot]);
+
+	/* Only the new counts can be on the wrong side, one swap of the tops moves them across */
+	if ((ch->size[1] != 0) && (ch->counts[ch->heap[0][0]] > ch->counts[ch->heap[1][0]])) {
+		uint8_t low = ch->heap[0][0];
+		Sample_Median_Place(ch, 0, 0, ch->heap[1][0]);
+		Sample_Median_Place(ch, 1, 0, low);
+		Sample_Median_Sift(ch, 0, 0);
+		Sample_Median_Sift(ch, 1, 0);
+	}
+}
+
+
+/** @brief Median of the window, the two middle counts rounded to nearest for an even count */
+static uint16_t Sample_Median_Value(const Sample_Median_Channel_t *ch) {
+	uint16_t low = ch->counts[ch->heap[0][0]];
+	if (ch->size[0] != ch->size[1]) {
+		return low;
+	}
+	return (uint16_t)(((uint32_t)low + ch->counts[ch->heap[1][0]] + 1U) / 2U);
+}
+
+
+/*****************************************************************
+ * @brief Initialize the median filter                          *
+ * @param median: Pointer to the Sample_Median_t struct         *
+ * @param window: Window length in samples, clamped to 1 to     *
+ *                SAMPLE_MEDIAN_WINDOW_MAX. Odd lengths give a  *
+ *                median that is one of the inputs              *
+ ****************************************************************/
+void Sample_Median_Init(Sample_Median_t *median, uint16_t window) {
+	memset(median, 0, sizeof(*median));
+	median->window = (window == 0) ? 1 : (window > SAMPLE_MEDIAN_WINDOW_MAX) ? SAMPLE_MEDIAN_WINDOW_MAX : (uint8_t)window;
+}
+
+
+/*****************************************************************
+ * @brief Forget the counts in the window                       *
+ * @param median: Pointer to the Sample_Median_t struct         *
+ ****************************************************************/
+void Sample_Median_Restart(Sample_Median_t *median) {
+	median->filled = 0;
+	median->head = 0;
+	for (uint8_t c = 0; c < 2; c++) {
+		median->channel[c].size[0] = 0;
+		median->channel[c].size[1] = 0;
+	}
+}
+
+
+/*****************************************************************
+ * @brief Add a sample                                          *
+ * @param median: Pointer to the Sample_Median_t struct         *
+ * @param sample: Raw sample                                    *
+ * @param filtered: Pointer to store the sample with the median *
+ *                  counts, may be sample                       *
+ *                                                              *
+ * Until the window is full the median of the samples so far   *
+ * is used.                                                     *
+ ****************************************************************/
+void Sample_Median_Add(Sample_Median_t *median, const CCSDS_Sample_t *sample, CCSDS_Sample_t *filtered) {
+
+	*filtered = *sample;
+	if (sample->flags & LTR_329_FLAGS_INVALID) {
+		return;
+	}
+	if ((median->filled != 0) && (sample->configCode != median->configCode)) {
+		Sample_Median_Restart(median);
+		median->restarts++;
+	}
+	median->configCode = sample->configCode;
+
+	uint8_t slot = median->head;
+	if (median->filled == median->window) {
+		Sample_Median_Replace(&median->channel[0], slot, sample->c0Data);
+		Sample_Median_Replace(&median->channel[1], slot, sample->c1Data);
+	}
+	else {
+		Sample_Median_Insert(&median->channel[0], slot, sample->c0Data);
+		Sample_Median_Insert(&median->channel[1], slot, sample->c1Data);
+		median->filled++;
+	}
+	median->head = (slot + 1U == median->window) ? 0 : slot + 1U;
+
+	filtered->c0Data = Sample_Median_Value(&median->channel[0]);
+	filtered->c1Data = Sample_Median_Value(&median->channel[1]);
+}
@@ -0,0 +1,68 @@
+/**
+ * @file Sample-Median.h
+ * @brief Header file for the sliding-window median filter of raw counts.
+ * @author Kent Hong
+ *
+ * This file contains definitions and function prototypes for replacing the raw
+ * CH0 and CH1 counts of every sample with the median of the last window valid
+ * samples, which rejects single-event glitches and reflections before they
+ * reach any average. A burst of up to (window - 1) / 2 outlier samples is
+ * removed completely, a real step in light shows up (window + 1) / 2 samples
+ * late.
+ *
+ * Each channel keeps its window in two heaps, a max-heap of the lower half and
+ * a min-heap of the upper half, with the median on top. Every slot of the ring
+ * of counts knows its place in the heaps, so the oldest counts are overwritten
+ * in place and sifted, and at most one swap of the tops restores the halves.
+ * A sample costs O(log window), not a sort of the window.
+ *
+ * As in Sample-Filter.h, a change of gain or integration time restarts the
+ * window, invalid samples (I2C error, reserved config code) are left out and
+ * passed on unchanged, and a filtered sample keeps the tick and flags of its
+ * input.
+ */
+
+#ifndef INC_SAMPLE_MEDIAN_H_
+#define INC_SAMPLE_MEDIAN_H_
+
+#include <stdint.h>
+#include "CCSDS-Packet.h"
+#include "LTR-329-Flags.h"
+
+/** @brief Longest window, sizes the static heaps of Sample_Median_t. Slots are uint8_t */
+#ifndef SAMPLE_MEDIAN_WINDOW_MAX
+#define SAMPLE_MEDIAN_WINDOW_MAX 31
+#endif
+
+#if (SAMPLE_MEDIAN_WINDOW_MAX < 1) || (SAMPLE_MEDIAN_WINDOW_MAX > 255)
+#error "SAMPLE_MEDIAN_WINDOW_MAX must be 1 to 255"
+#endif
+
+#define SAMPLE_MEDIAN_HEAP_MAX ((SAMPLE_MEDIAN_WINDOW_MAX + 1) / 2) // The lower half holds the extra counts of an odd window
+
+/** @brief Window of one channel */
+typedef struct {
+	uint16_t counts[SAMPLE_MEDIAN_WINDOW_MAX];        // Counts by ring slot
+	uint8_t heap[2][SAMPLE_MEDIAN_HEAP_MAX];          // Slots, [0] max-heap of the lower half, [1] min-heap of the upper half
+	uint8_t position[SAMPLE_MEDIAN_WINDOW_MAX];       // Heap index of each slot
+	uint8_t side[SAMPLE_MEDIAN_WINDOW_MAX];           // Heap of each slot, 0 or 1
+	uint8_t size[2];                                  // Slots in each heap
+} Sample_Median_Channel_t;
+
+/** @brief Struct to store the median filter state of both channels */
+typedef struct {
+	Sample_Median_Channel_t channel[2]; // CH0 and CH1
+	uint8_t window;          // Window length in samples
+	uint8_t filled;          // Valid samples in the window, up to window
+	uint8_t head;            // Ring slot written next, the oldest counts once full
+	uint8_t configCode;      // Config code of the counts in the window
+	uint32_t restarts;       // Restarts on a config change
+} Sample_Median_t;
+
+
+/** @brief Function Prototypes for the median filter */
+void Sample_Median_Init(Sample_Median_t *median, uint16_t window);
+void Sample_Median_Restart(Sample_Median_t *median);
+void Sample_Median_Add(Sample_Median_t *median, const CCSDS_Sample_t *sample, CCSDS_Sample_t *filtered);
+
+#endif /* INC_SAMPLE_MEDIAN_H_ */
@@ -0,0 +1,127 @@
+/**
+ * @file Sample-Ring.c
+ * @brief Implementation of the timestamped store-and-forward sample ring.
+ * @author Kent Hong
+ *
+ * Head and tail are free-running 16-bit indexes, so the fill level is their
+ * difference and a full ring is distinguished from an empty one without a flag.
+ */
+
+#include <string.h>
+#include "Sample-Ring.h"
+
+
+/*****************************************************************
+ * @brief Initialize an empty ring                              *
+ * @param ring: Pointer to the Sample_Ring_t struct             *
+ * @param mode: Behaviour on a full ring                        *
+ * @param highWatermark: Fill level that starts a drain,        *
+ *                       clamped to SAMPLE_RING_SIZE            *
+ * @param lowWatermark: Fill level that ends a drain, below     *
+ *                      highWatermark                           *
+ ****************************************************************/
+void Sample_Ring_Init(Sample_Ring_t *ring, Sample_Ring_Mode_t mode, uint16_t highWatermark, uint16_t lowWatermark) {
+
+	memset(ring, 0, sizeof(*ring));
+
+	if ((highWatermark == 0) || (highWatermark > SAMPLE_RING_SIZE)) {
+		highWatermark = SAMPLE_RING_SIZE;
+	}
+	if (lowWatermark >= highWatermark) {
+		lowWatermark = highWatermark - 1;
+	}
+
+	ring->mode = (uint8_t)mode;
+	ring->highWatermark = highWatermark;
+	ring->lowWatermark = lowWatermark;
+}
+
+
+/*****************************************************************
+ * @brief Store a sample                                        *
+ * @param ring: Pointer to the Sample_Ring_t struct             *
+ * @param sample: Sample to store                               *
+ * @return 1 if stored, 0 if refused (SAMPLE_RING_STOP, full)   *
+ ****************************************************************/
+uint8_t Sample_Ring_Push(Sample_Ring_t *ring, const CCSDS_Sample_t *sample) {
+
+	if ((uint16_t)(ring->head - ring->tail) == SAMPLE_RING_SIZE) {
+		ring->dropped++;
+		if (ring->mode == SAMPLE_RING_STOP) {
+			return 0;
+		}
+		ring->tail++;
+	}
+
+	ring->samples[ring->head & (SAMPLE_RING_SIZE - 1)] = *sample;
+	ring->head++;
+	ring->pushed++;
+
+	uint16_t count = (uint16_t)(ring->head - ring->tail);
+	if (count > ring->peak) {
+		ring->peak = count;
+	}
+
+	return 1;
+}
+
+
+/*****************************************************************
+ * @brief Remove the oldest sample                              *
+ * @param ring: Pointer to the Sample_Ring_t struct             *
+ * @param sample: Pointer to store the sample                   *
+ * @return 1 if a sample was returned, 0 if the ring is empty   *
+ ****************************************************************/
+uint8_t Sample_Ring_Pop(Sample_Ring_t *ring, CCSDS_Sample_t *sample) {
+
+	if (ring->head == ring->tail) {
+		return 0;
+	}
+
+	*sample = ring->samples[ring->tail & (SAMPLE_RING_SIZE - 1)];
+	ring->tail++;
+
+	/* Checked here, not in Sample_Ring_Drain_Due(), so new pushes cannot keep a burst going */
+	if (Sample_Ring_Count(ring) <= ring->lowWatermark) {
+		ring->draining = 0;
+	}
+
+	return 1;
+}
+
+
+/** @brief Number of samples held */
+uint16_t Sample_Ring_Count(const Sample_Ring_t *ring) {
+	return (uint16_t)(ring->head - ring->tail);
+}
+
+
+/*****************************************************************
+ * @brief Force a drain regardless of the fill level            *
+ * @param ring: Pointer to the Sample_Ring_t struct             *
+ * @param enable: 1 at the start of a ground pass, 0 at its end *
+ ****************************************************************/
+void Sample_Ring_Force_Drain(Sample_Ring_t *ring, uint8_t enable) {
+	ring->forced = (enable != 0);
+}
+
+
+/*****************************************************************
+ * @brief Check whether samples should be forwarded now         *
+ * @param ring: Pointer to the Sample_Ring_t struct             *
+ * @return 1 while a drain is due                               *
+ *                                                              *
+ * A drain starts at highWatermark and continues down to        *
+ * lowWatermark, so the link is used in bursts. A forced drain  *
+ * empties the ring.                                            *
+ ****************************************************************/
+uint8_t Sample_Ring_Drain_Due(Sample_Ring_t *ring) {
+
+	uint16_t count = Sample_Ring_Count(ring);
+
+	if (count >= ring->highWatermark) {
+		ring->draining = 1;
+	}
+
+	return (ring->draining || ring->forced) && (count != 0);
+}
@@ -0,0 +1,67 @@
+/**
+ * @file Sample-Ring.h
+ * @brief Header file for the timestamped store-and-forward sample ring.
+ * @author Kent Hong
+ *
+ * This file contains definitions and function prototypes for holding timestamped
+ * samples while the link is not being used, so samples taken with the radio off
+ * are forwarded later instead of being overwritten in LTR329_t. Push and pop are
+ * O(1) on a fixed, statically allocated ring.
+ *
+ * Draining follows two watermarks: once the ring holds highWatermark samples (or
+ * a drain is forced, e.g. for a ground pass) it reports drain due until it is
+ * down to lowWatermark. With REPORT_ON_CHANGE a full orbit of reported samples
+ * fits the default size, without it one orbit is about 9000 samples.
+ *
+ * When the ring is full it either overwrites the oldest sample (keep the most
+ * recent history) or refuses new samples (keep the start of a collection window).
+ *
+ * @note Push and drain from the same execution context (main loop), the ring is not locked.
+ */
+
+#ifndef INC_SAMPLE_RING_H_
+#define INC_SAMPLE_RING_H_
+
+#include <stdint.h>
+#include "CCSDS-Packet.h"
+
+/** @brief Number of samples held, must be a power of two */
+#ifndef SAMPLE_RING_SIZE
+#define SAMPLE_RING_SIZE 1024
+#endif
+
+#if (SAMPLE_RING_SIZE & (SAMPLE_RING_SIZE - 1)) != 0 || SAMPLE_RING_SIZE > 32768
+#error "SAMPLE_RING_SIZE must be a power of two, at most 32768"
+#endif
+
+/** @brief Behaviour of Sample_Ring_Push() on a full ring */
+typedef enum {
+	SAMPLE_RING_OVERWRITE = 0, // Drop the oldest sample
+	SAMPLE_RING_STOP           // Drop the new sample
+} Sample_Ring_Mode_t;
+
+/** @brief Struct to store the ring state */
+typedef struct {
+	CCSDS_Sample_t samples[SAMPLE_RING_SIZE];
+	uint16_t head;           // Index of the next sample to write (free running)
+	uint16_t tail;           // Index of the next sample to read (free running)
+	uint16_t highWatermark;  // Fill level that starts a drain
+	uint16_t lowWatermark;   // Fill level that ends a drain
+	uint8_t mode;            // Sample_Ring_Mode_t
+	uint8_t draining;        // 1 between reaching highWatermark and falling to lowWatermark
+	uint8_t forced;          // 1 while a drain is forced regardless of the fill level
+	uint16_t peak;           // Highest fill level seen
+	uint32_t pushed;         // Samples stored
+	uint32_t dropped;        // Samples lost, overwritten or refused
+} Sample_Ring_t;
+
+
+/** @brief Function Prototypes for the sample ring */
+void Sample_Ring_Init(Sample_Ring_t *ring, Sample_Ring_Mode_t mode, uint16_t highWatermark, uint16_t lowWatermark);
+uint8_t Sample_Ring_Push(Sample_Ring_t *ring, const CCSDS_Sample_t *sample);
+uint8_t Sample_Ring_Pop(Sample_Ring_t *ring, CCSDS_Sample_t *sample);
+uint16_t Sample_Ring_Count(const Sample_Ring_t *ring);
+void Sample_Ring_Force_Drain(Sample_Ring_t *ring, uint8_t enable);
+uint8_t Sample_Ring_Drain_Due(Sample_Ring_t *ring);
+
+#endif /* INC_SAMPLE_RING_H_ */
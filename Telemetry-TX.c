@@ -0,0 +1,153 @@
+/**
+ * @file Telemetry-TX.c
+ * @brief Implementation of the double-buffered DMA UART telemetry transmitter.
+ * @author Kent Hong
+ *
+ * Producers reserve space in the fill buffer, format directly into it and commit.
+ * When the DMA buffer has drained the two buffers are swapped and the next
+ * transfer is started, either from the commit or from the DMA complete interrupt.
+ *
+ * @note Enqueueing never waits on the UART, a full fill buffer drops the message and counts it.
+ */
+
+#include <string.h>
+#include "Telemetry-TX.h"
+
+
+/** @brief Swap buffers and start DMA on the filled one, caller guarantees DMA idle and no writer */
+static void Telemetry_TX_Start(Telemetry_TX_t *tx) {
+
+	uint8_t sendIndex = tx->fillIndex;
+	uint16_t sendLength = tx->fill[sendIndex];
+
+	tx->fillIndex = sendIndex ^ 1U;
+	tx->fill[tx->fillIndex] = 0;
+	tx->dmaBusy = 1;
+
+	if (HAL_UART_Transmit_DMA(tx->huart, tx->buffer[sendIndex], sendLength) != HAL_OK) {
+		tx->dmaBusy = 0;
+		tx->bytesDropped += sendLength;
+		if (tx->dmaErrors != UINT16_MAX) {
+			tx->dmaErrors++;
+		}
+	}
+}
+
+
+/*****************************************************************
+ * @brief Initialize the telemetry transmitter                  *
+ * @param tx: Pointer to the Telemetry_TX_t struct              *
+ * @param huart: Pointer to the UART handle with TX DMA linked  *
+ ****************************************************************/
+void Telemetry_TX_Init(Telemetry_TX_t *tx, UART_HandleTypeDef *huart) {
+	memset(tx, 0, sizeof(*tx));
+	tx->huart = huart;
+}
+
+
+/*****************************************************************
+ * @brief Reserve space in the fill buffer                      *
+ * @param tx: Pointer to the Telemetry_TX_t struct              *
+ * @param length: Maximum number of bytes that will be written  *
+ * @return Pointer to write to, NULL if the message must drop   *
+ *                                                              *
+ * Must be followed by Telemetry_TX_Commit() when not NULL.     *
+ * The buffer cannot be swapped out while it is reserved.       *
+ ****************************************************************/
+uint8_t *Telemetry_TX_Reserve(Telemetry_TX_t *tx, uint16_t length) {
+
+	tx->writing = 1;
+
+	/* fillIndex is stable from here on, the DMA interrupt does not swap while writing is set */
+	uint8_t index = tx->fillIndex;
+	if ((uint32_t)tx->fill[index] + length > TELEMETRY_TX_BUFFER_SIZE) {
+		tx->writing = 0;
+		tx->bytesDropped += length;
+		if (tx->messagesDropped != UINT16_MAX) {
+			tx->messagesDropped++;
+		}
+		return NULL;
+	}
+
+	return &tx->buffer[index][tx->fill[index]];
+}
+
+
+/*****************************************************************
+ * @brief Commit bytes written after Telemetry_TX_Reserve()     *
+ * @param tx: Pointer to the Telemetry_TX_t struct              *
+ * @param length: Number of bytes actually written              *
+ *                                                              *
+ * Starts a DMA transfer right away if the UART is idle.        *
+ ****************************************************************/
+void Telemetry_TX_Commit(Telemetry_TX_t *tx, uint16_t length) {
+
+	tx->fill[tx->fillIndex] += length;
+	tx->bytesQueued += length;
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	tx->writing = 0;
+	if (!tx->dmaBusy && (tx->fill[tx->fillIndex] != 0)) {
+		Telemetry_TX_Start(tx);
+	}
+	__set_PRIMASK(primask);
+}
+
+
+/*****************************************************************
+ * @brief Queue a complete message without blocking             *
+ * @param tx: Pointer to the Telemetry_TX_t struct              *
+ * @param data: Message bytes                                   *
+ * @param length: Message length                                *
+ * @return HAL_OK if queued, HAL_BUSY if it was dropped         *
+ ****************************************************************/
+HAL_StatusTypeDef Telemetry_TX_Enqueue(Telemetry_TX_t *tx, const uint8_t *data, uint16_t length) {
+
+	uint8_t *dest = Telemetry_TX_Reserve(tx, length);
+	if (dest == NULL) {
+		return HAL_BUSY;
+	}
+
+	memcpy(dest, data, length);
+	Telemetry_TX_Commit(tx, length);
+
+	return HAL_OK;
+}
+
+
+/*****************************************************************
+ * @brief Handle the end of a DMA transfer                      *
+ * @param tx: Pointer to the Telemetry_TX_t struct              *
+ *                                                              *
+ * Call from HAL_UART_TxCpltCallback() for the telemetry UART.  *
+ * Chains the next transfer unless a producer is mid-write, in  *
+ * which case its commit starts it.                             *
+ ****************************************************************/
+void Telemetry_TX_Complete_Callback(Telemetry_TX_t *tx) {
+
+	tx->dmaBusy = 0;
+	if (!tx->writing && (tx->fill[tx->fillIndex] != 0)) {
+		Telemetry_TX_Start(tx);
+	}
+}
+
+
+/*****************************************************************
+ * @brief Recover from a UART error that ended the transfer     *
+ * @param tx: Pointer to the Telemetry_TX_t struct              *
+ *                                                              *
+ * Call from HAL_UART_ErrorCallback() for the telemetry UART    *
+ * when HAL has aborted the TX DMA. The rest of the aborted     *
+ * buffer is lost, the next buffer is started as on completion. *
+ ****************************************************************/
+void Telemetry_TX_Error_Callback(Telemetry_TX_t *tx) {
+
+	if (!tx->dmaBusy) {
+		return;
+	}
+	if (tx->dmaErrors != UINT16_MAX) {
+		tx->dmaErrors++;
+	}
+	Telemetry_TX_Complete_Callback(tx);
+}
@@ -0,0 +1,49 @@
+/**
+ * @file Telemetry-TX.h
+ * @brief Header file for the double-buffered DMA UART telemetry transmitter.
+ * @author Kent Hong
+ *
+ * This file contains definitions and function prototypes for queueing telemetry
+ * without blocking: messages are formatted into one buffer while the other buffer
+ * drains over UART DMA.
+ *
+ * @note The UART TX DMA channel must be linked to the UART handle (CubeMX: USART2_TX on DMA1 Channel 7),
+ *       HAL_UART_TxCpltCallback() must call Telemetry_TX_Complete_Callback() and HAL_UART_ErrorCallback()
+ *       must call Telemetry_TX_Error_Callback() when the error aborted the transmission.
+ */
+
+#ifndef INC_TELEMETRY_TX_H_
+#define INC_TELEMETRY_TX_H_
+
+#include <stdint.h>
+#include "stm32L4xx_hal.h" // Adjust this include based on your STM32 series
+
+/** @brief Size of each of the two TX buffers, override at compile time if needed */
+#ifndef TELEMETRY_TX_BUFFER_SIZE
+#define TELEMETRY_TX_BUFFER_SIZE 256
+#endif
+
+/** @brief Struct to store the telemetry transmitter state */
+typedef struct {
+	UART_HandleTypeDef *huart;                          // UART used for telemetry
+	uint8_t buffer[2][TELEMETRY_TX_BUFFER_SIZE];        // Fill buffer and DMA buffer
+	volatile uint16_t fill[2];                          // Bytes queued in each buffer
+	volatile uint8_t fillIndex;                         // Buffer currently being filled
+	volatile uint8_t dmaBusy;                           // 1 while a DMA transfer is running
+	volatile uint8_t writing;                           // 1 between Reserve and Commit, blocks the buffer swap
+	uint32_t bytesQueued;                               // Total bytes accepted
+	uint32_t bytesDropped;                              // Total bytes rejected because the fill buffer was full
+	uint16_t messagesDropped;                           // Saturating count of rejected messages
+	uint16_t dmaErrors;                                 // Saturating count of failed HAL_UART_Transmit_DMA() calls and aborted transfers
+} Telemetry_TX_t;
+
+
+/** @brief Function Prototypes for the telemetry transmitter */
+void Telemetry_TX_Init(Telemetry_TX_t *tx, UART_HandleTypeDef *huart);
+uint8_t *Telemetry_TX_Reserve(Telemetry_TX_t *tx, uint16_t length);
+void Telemetry_TX_Commit(Telemetry_TX_t *tx, uint16_t length);
+HAL_StatusTypeDef Telemetry_TX_Enqueue(Telemetry_TX_t *tx, const uint8_t *data, uint16_t length);
+void Telemetry_TX_Complete_Callback(Telemetry_TX_t *tx);
+void Telemetry_TX_Error_Callback(Telemetry_TX_t *tx);
+
+#endif /* INC_TELEMETRY_TX_H_ */
@@ -22,6 +22,20 @@
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
 #include "LTR-329.h"
+#include "Lux-Format.h"
+#include "Telemetry-TX.h"
+#include "CCSDS-Packet.h"
+#include "Sample-Codec.h"
+#include "Error-Log.h"
+#include "Command-Console.h"
+#include "Report-Deadband.h"
+#include "Downlink-Scheduler.h"
+#include "Lux-Histogram.h"
+#include "Sample-Ring.h"
+#include "Flash-Log-STM32.h"
+#include "Config-Block.h"
+#include "Sample-Filter.h"
+#include "Sample-Median.h"
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
@@ -34,6 +48,33 @@
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
+#define SAMPLE_PERIOD_MS 600 // Time between LTR-329 samples
+#define TELEMETRY_ASCII 0       // ASCII "Lux: " lines
+#define TELEMETRY_CCSDS_RAW 1   // CCSDS packets of fixed 6-byte sample records
+#define TELEMETRY_CCSDS_DELTA 2 // CCSDS packets of delta + zigzag varint blocks
+#define TELEMETRY_CCSDS_SCHEDULED 3 // Budgeted CCSDS frames of timed samples (Downlink-Scheduler.h)
+#define TELEMETRY_FORMAT TELEMETRY_CCSDS_DELTA
+#define DOWNLINK_FRAME_PERIOD_MS 6000 // TELEMETRY_CCSDS_SCHEDULED: time between downlink frames
+#define DOWNLINK_FRAME_BUDGET 110     // TELEMETRY_CCSDS_SCHEDULED: bytes per downlink frame
+#define ERROR_EVENTS_PER_LOOP 8 // Error-Log events drained into telemetry per sample
+#define REPORT_ON_CHANGE 1      // 1: send samples only when they leave the deadband (Report-Deadband.h), 0: send every sample
+#define LUX_HISTOGRAM_PERIOD_MS 600000 // CCSDS formats: lux histogram product interval (Lux-Histogram.h), 0 disables
+#define STORE_AND_FORWARD 0     // RAW/DELTA formats: 1 holds reported samples in a ring (Sample-Ring.h) and forwards them in bursts
+#define FORWARD_HIGH_WATERMARK 768 // STORE_AND_FORWARD: samples held before a burst starts
+#define FORWARD_LOW_WATERMARK 0    // STORE_AND_FORWARD: samples left when a burst ends
+#define FLASH_LOG_SAMPLES 0     // CCSDS formats: 1 also keeps reported samples in internal flash (Flash-Log-STM32.h, reserve the region first)
+#define PERSIST_CONFIG 0        // 1: boot with the settings and calibration stored by "save config" (Config-Block.h, reserve the region first)
+#define SAMPLE_MEDIAN_WINDOW 0     // 3 to SAMPLE_MEDIAN_WINDOW_MAX: replace counts with the median of this many samples, rejects spikes before any averaging (Sample-Median.h)
+#define SAMPLE_FILTER_TYPE SAMPLE_FILTER_NONE // SAMPLE_FILTER_EMA or SAMPLE_FILTER_BOXCAR: average raw counts on board (Sample-Filter.h)
+#define SAMPLE_FILTER_SHIFT 3      // SAMPLE_FILTER_EMA: alpha = 1/8, about 15 samples averaged
+#define SAMPLE_FILTER_LENGTH 8     // SAMPLE_FILTER_BOXCAR: samples averaged
+#define SAMPLE_FILTER_DECIMATION 1 // Samples per sample sent, sent samples are this many sample periods apart
+#define DEBUG_RAW_LINES 0       // 1: also send "Raw C0: ..." debug lines, mixed into the telemetry stream
+#define LTR_303_INT_WINDOW 0    // LTR-303 only: CH0 counts either side of the last sample, the sensor is read only after INT fires outside them (0 polls every sample)
+#define LTR_303_INT_PERSIST 1   // LTR_303_INT_WINDOW: samples outside the window before INT fires, minus one, rejects single-sample spikes
+#define LTR_303_INT_POLL_MS (SAMPLE_PERIOD_MS * LTR_329_SCRUB_PERIOD) // LTR_303_INT_WINDOW: longest time without a read, each forced read also scrubs the configuration
+#define LTR_303_INT_Pin GPIO_PIN_8 // LTR-303 INT (open drain, active low) on PA8, EXTI9_5_IRQHandler() must call HAL_GPIO_EXTI_IRQHandler(LTR_303_INT_Pin)
+#define LTR_303_INT_GPIO_Port GPIOA
 
 /* USER CODE END PD */
 
@@ -49,19 +90,138 @@ UART_HandleTypeDef huart2;
 
 /* USER CODE BEGIN PV */
 LTR329_t ltr329; // Create an instance of the LTR-329 struct for variable access
+Telemetry_TX_t telemetryTx; // Double-buffered DMA transmitter for telemetry on USART2
+#if TELEMETRY_FORMAT == TELEMETRY_CCSDS_DELTA
+Sample_Encoder_t sampleEncoder; // Delta-compresses samples into CCSDS space packets
+uint8_t ccsdsPacket[SAMPLE_CODEC_PACKET_MAX]; // Completed packet handed to the transmitter
+#elif TELEMETRY_FORMAT == TELEMETRY_CCSDS_RAW
+CCSDS_Encoder_t ccsdsEncoder; // Packs raw samples into CCSDS space packets
+uint8_t ccsdsPacket[CCSDS_PACKET_MAX]; // Completed packet handed to the transmitter
+#elif TELEMETRY_FORMAT == TELEMETRY_CCSDS_SCHEDULED
+Downlink_Scheduler_t downlinkScheduler; // Holds samples until a downlink frame has room
+uint8_t ccsdsPacket[DOWNLINK_FRAME_MAX]; // Completed frame handed to the transmitter
+#endif
+uint16_t errorSeqCount; // CCSDS sequence count of Error-Log packets
+#if (TELEMETRY_FORMAT != TELEMETRY_ASCII) && (LUX_HISTOGRAM_PERIOD_MS != 0)
+Lux_Histogram_t luxHistogram; // Distribution of every valid sample, reported or not
+#endif
+Command_Console_t commandConsole; // Runtime get/set commands received on USART2
+Report_Deadband_t reportDeadband; // Decides which samples are sent
+#if PERSIST_CONFIG
+Config_Block_t configBlock; // Sensor settings, thresholds and calibration restored at boot
+#endif
+#if FLASH_LOG_SAMPLES && (TELEMETRY_FORMAT != TELEMETRY_ASCII)
+Flash_Log_t flashLog; // Reported samples kept across resets, written a page at a time
+#endif
+#if STORE_AND_FORWARD && ((TELEMETRY_FORMAT == TELEMETRY_CCSDS_RAW) || (TELEMETRY_FORMAT == TELEMETRY_CCSDS_DELTA))
+#define FORWARD_FROM_RING 1
+Sample_Ring_t sampleRing; // Reported samples waiting for the next burst
+#else
+#define FORWARD_FROM_RING 0
+#endif
+#if SAMPLE_MEDIAN_WINDOW > SAMPLE_MEDIAN_WINDOW_MAX
+#error "SAMPLE_MEDIAN_WINDOW is over SAMPLE_MEDIAN_WINDOW_MAX, raise it with -DSAMPLE_MEDIAN_WINDOW_MAX"
+#elif SAMPLE_MEDIAN_WINDOW > 1
+#define MEDIAN_SAMPLES 1
+Sample_Median_t sampleMedian; // Median of the last SAMPLE_MEDIAN_WINDOW samples, O(log window) per sample
+#else
+#define MEDIAN_SAMPLES 0
+#endif
+#if (SAMPLE_FILTER_TYPE != SAMPLE_FILTER_NONE) || (SAMPLE_FILTER_DECIMATION > 1)
+#define FILTER_SAMPLES 1
+Sample_Filter_t sampleFilter; // Averages raw counts and passes on one sample per SAMPLE_FILTER_DECIMATION
+#else
+#define FILTER_SAMPLES 0
+#endif
+#define REPORT_PERIOD_MS (SAMPLE_PERIOD_MS * SAMPLE_FILTER_DECIMATION) // Nominal period of the samples sent
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
 void SystemClock_Config(void);
 static void MX_GPIO_Init(void);
+static void MX_DMA_Init(void);
 static void MX_USART2_UART_Init(void);
 static void MX_I2C1_Init(void);
 /* USER CODE BEGIN PFP */
+static void Telemetry_Send_Errors(uint32_t tick);
+#if DEBUG_RAW_LINES
+static void Telemetry_Send_Raw(const LTR329_t *sensor);
+#endif
 
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
 /* USER CODE BEGIN 0 */
+/**
+  * @brief  Drain queued Error-Log events into telemetry, outside the error paths.
+  * @param  tick: Current sample tick
+  * @retval None
+  */
+static void Telemetry_Send_Errors(uint32_t tick)
+{
+#if TELEMETRY_FORMAT != TELEMETRY_ASCII
+  uint8_t events[ERROR_EVENTS_PER_LOOP * ERROR_LOG_EVENT_SIZE];
+  uint16_t eventLength = Error_Log_Drain(events, ERROR_EVENTS_PER_LOOP);
+  if (eventLength != 0)
+  {
+    uint8_t packet[CCSDS_PACKET_SIZE(0) + sizeof(events)];
+    uint16_t packetLength = CCSDS_Build_Packet(CCSDS_APID_ERROR_LOG, errorSeqCount, tick, 0, events, eventLength, packet);
+    errorSeqCount = (errorSeqCount + 1) & CCSDS_SEQ_COUNT_MASK;
+    Telemetry_TX_Enqueue(&telemetryTx, packet, packetLength);
+  }
+#else
+  /* One "Err: code,reg,status,value" line per event */
+  Error_Event_t event;
+  for (uint8_t i = 0; (i < ERROR_EVENTS_PER_LOOP) && Error_Log_Pop(&event); i++)
+  {
+    char line[32] = "Err: ";
+    uint16_t length = 5;
+    const uint8_t fields[] = { event.code, event.regAddr, event.status, event.value };
+    for (uint8_t f = 0; f < sizeof(fields); f++)
+    {
+      length += Lux_Format_Decimal(&line[length], 3, fields[f], 0);
+      line[length++] = (f + 1U < sizeof(fields)) ? ',' : '\r';
+    }
+    line[length++] = '\n';
+    Telemetry_TX_Enqueue(&telemetryTx, (uint8_t *)line, length);
+  }
+  (void)tick;
+#endif
+}
+
+#if DEBUG_RAW_LINES
+/**
+  * @brief  Send a "Raw C0: , Raw C1: , Gain: , Integration Time: " debug line.
+  * @param  sensor: Sensor whose last sample is printed
+  * @retval None
+  * @note   Formatted straight into the telemetry buffer, so the sensor struct
+  *         carries no scratch buffer of its own.
+  */
+static void Telemetry_Send_Raw(const LTR329_t *sensor)
+{
+  static const char *const labels[] = { "Raw C0: ", ", Raw C1: ", ", Gain: ", ", Integration Time: " };
+  const uint32_t fields[] = { sensor->c0Data, sensor->c1Data, sensor->alsGainData, sensor->alsIntData };
+  const uint16_t lineMax = 64;
+
+  char *line = (char *)Telemetry_TX_Reserve(&telemetryTx, lineMax);
+  if (line == NULL)
+  {
+    return;
+  }
+  uint16_t length = 0;
+  for (uint8_t f = 0; f < 4; f++)
+  {
+    for (const char *c = labels[f]; *c != '\0'; c++)
+    {
+      line[length++] = *c;
+    }
+    length += Lux_Format_Decimal(&line[length], 10, fields[f], 0);
+  }
+  line[length++] = '\r';
+  line[length++] = '\n';
+  Telemetry_TX_Commit(&telemetryTx, length);
+}
+#endif
 
 /* USER CODE END 0 */
 
@@ -94,10 +254,55 @@ int main(void)
 
   /* Initialize all configured peripherals */
   MX_GPIO_Init();
+  MX_DMA_Init();
   MX_USART2_UART_Init();
   MX_I2C1_Init();
   /* USER CODE BEGIN 2 */
-  LTR_329_Init(&hi2c1, &huart2, &ltr329); // Initialize the LTR-329 sensor
+  Telemetry_TX_Init(&telemetryTx, &huart2); // Telemetry drains over DMA, the loop never waits on the UART
+#if PERSIST_CONFIG
+  Config_Block_Load(&configBlock, Flash_Log_STM32_Config_Device()); // One copy of the newest valid bank, compiled-in defaults if neither is valid
+  LTR_329_Init_Config(&hi2c1, &ltr329, configBlock.alsContr, configBlock.alsMeasRate); // Initialize the LTR-329 sensor with the stored settings
+  ltr329.luxScale = configBlock.luxScale; // Calibrated lux factors, derived when the block was saved
+  Report_Deadband_Init(&reportDeadband, configBlock.deadbandAbsCounts, configBlock.deadbandRelPermille, REPORT_ON_CHANGE ? configBlock.heartbeatMs : 0);
+#else
+  LTR_329_Init(&hi2c1, &ltr329); // Initialize the LTR-329 sensor
+  Report_Deadband_Init(&reportDeadband, REPORT_DEADBAND_ABS_COUNTS, REPORT_DEADBAND_REL_PERMILLE, REPORT_ON_CHANGE ? REPORT_DEADBAND_HEARTBEAT_MS : 0); // A zero heartbeat sends every sample
+#endif
+  Command_Console_Init(&commandConsole, &huart2, &hi2c1, &ltr329, &telemetryTx, &reportDeadband); // Commands arrive over circular DMA, replies share the telemetry buffers
+#if PERSIST_CONFIG
+  Command_Console_Attach_Config(&commandConsole, &configBlock, Flash_Log_STM32_Config_Device());
+#endif
+#if TELEMETRY_FORMAT == TELEMETRY_CCSDS_DELTA
+  Sample_Encoder_Init(&sampleEncoder, CCSDS_APID_LTR_329_DELTA, REPORT_PERIOD_MS);
+#elif TELEMETRY_FORMAT == TELEMETRY_CCSDS_RAW
+  CCSDS_Encoder_Init(&ccsdsEncoder, CCSDS_APID_LTR_329, REPORT_PERIOD_MS);
+#endif
+#if MEDIAN_SAMPLES
+  Sample_Median_Init(&sampleMedian, SAMPLE_MEDIAN_WINDOW);
+#endif
+#if FILTER_SAMPLES
+  Sample_Filter_Init(&sampleFilter, SAMPLE_FILTER_TYPE, SAMPLE_FILTER_SHIFT, SAMPLE_FILTER_LENGTH, SAMPLE_FILTER_DECIMATION);
+#endif
+#if FLASH_LOG_SAMPLES && (TELEMETRY_FORMAT != TELEMETRY_ASCII)
+  Flash_Log_Mount(&flashLog, Flash_Log_STM32_Device()); // Finds the newest page in O(log n) reads
+#endif
+#if FORWARD_FROM_RING
+  Sample_Ring_Init(&sampleRing, SAMPLE_RING_OVERWRITE, FORWARD_HIGH_WATERMARK, FORWARD_LOW_WATERMARK);
+  Command_Console_Attach_Ring(&commandConsole, &sampleRing); // "set pass 1" forwards everything held while the ground station is in view
+#endif
+#if TELEMETRY_FORMAT == TELEMETRY_CCSDS_SCHEDULED
+  Downlink_Scheduler_Init(&downlinkScheduler, CCSDS_APID_LTR_329_TIMED);
+  uint8_t lastConfigCode = ltr329.configCode;
+  uint32_t frameTick = HAL_GetTick() + DOWNLINK_FRAME_PERIOD_MS;
+#endif
+  uint32_t sampleTick = HAL_GetTick();
+#if (TELEMETRY_FORMAT != TELEMETRY_ASCII) && (LUX_HISTOGRAM_PERIOD_MS != 0)
+  Lux_Histogram_Init(&luxHistogram, sampleTick);
+#endif
+#if LTR_303_INT_WINDOW
+  uint8_t intArmed = 0; // Set once the window is armed around a sample, an LTR-329 never arms and keeps polling
+  uint32_t readTick = sampleTick; // Tick of the last sample read from the sensor
+#endif
   /* USER CODE END 2 */
 
   /* Infinite loop */
@@ -105,22 +310,170 @@ int main(void)
   while (1)
   {
 
+#if LTR_303_INT_WINDOW
+	  /* Once armed the sensor is only read after INT fired, so steady light costs little I2C traffic and sends nothing. A read is */
+	  /* still forced every LTR_303_INT_POLL_MS and when the heartbeat is due: the scrub and the heartbeat keep running, and a */
+	  /* sensor knocked out of Active mode, which never fires INT, is repaired and the window re-armed from that sample */
+	  uint8_t sampleRead = 1;
+	  uint8_t pollDue = ((uint32_t)(sampleTick - readTick) >= LTR_303_INT_POLL_MS)
+			  || ((reportDeadband.heartbeatMs != 0) && ((uint32_t)(sampleTick - reportDeadband.lastTick) >= reportDeadband.heartbeatMs));
+	  if (intArmed && !pollDue) {
+		  sampleRead = LTR_303_Service_Interrupt(&hi2c1, &ltr329);
+	  }
+	  else {
+		  if (intArmed && (ltr329.scrubPeriod != 0)) {
+			  ltr329.scrubCount = ltr329.scrubPeriod - 1; // Make the forced read a scrub sample
+		  }
+		  LTR_329_Read_All(&hi2c1, &ltr329);
+	  }
+	  if (sampleRead) {
+		  readTick = sampleTick;
+	  }
+
+	  /* Centre the window on the new sample, a failed read leaves it disarmed so the next pass polls */
+	  if (sampleRead && ltr329.part->hasInterrupt) {
+		  uint16_t c0 = ltr329.c0Data;
+		  intArmed = ((ltr329.sampleFlags & LTR_329_FLAGS_INVALID) == 0)
+				  && (LTR_303_Set_Window(&hi2c1, &ltr329, (c0 > LTR_303_INT_WINDOW) ? c0 - LTR_303_INT_WINDOW : 0,
+						  (c0 < UINT16_MAX - LTR_303_INT_WINDOW) ? c0 + LTR_303_INT_WINDOW : UINT16_MAX, LTR_303_INT_PERSIST) == HAL_OK)
+				  && (LTR_303_Enable_Interrupt(&hi2c1, &ltr329, 1) == HAL_OK);
+	  }
+#else
 	  /* Read all necessary data from the LTR-329 sensor */
-	  LTR_329_Read_All(&hi2c1, &huart2, &ltr329);
-
-	  /* Calculate lux value */
-	  LTR_329_Calculate_Lux(&ltr329);
+	  LTR_329_Read_All(&hi2c1, &ltr329);
+	  const uint8_t sampleRead = 1;
+#endif
 
+#if DEBUG_RAW_LINES
 	  /* Code for debugging C0 data, C1 data, gain, and integration time */
-	  //sprintf(ltr329.buffer, "Raw C0: %u, Raw C1: %u, Gain: %u, Integration Time: %u\r\n", ltr329.c0Data, ltr329.c1Data, ltr329.alsGainData, ltr329.alsIntData);
-	  //HAL_UART_Transmit(&huart2, (uint8_t*)ltr329.buffer, strlen(ltr329.buffer), HAL_MAX_DELAY);
-
-	  /* Output Lux data over UART */
-	  sprintf(ltr329.buffer, "Lux: %.2f\r\n", ltr329.alsLuxData);
-	  HAL_UART_Transmit(&huart2, (uint8_t *)ltr329.buffer, strlen(ltr329.buffer), HAL_MAX_DELAY);
-
-	  /* 600 ms delay for sensor stabilization */
-	  HAL_Delay(600);
+	  Telemetry_Send_Raw(&ltr329);
+#endif
+
+#if MEDIAN_SAMPLES || FILTER_SAMPLES
+	  /* Raw counts are filtered here, the rest of the loop only sees every SAMPLE_FILTER_DECIMATION-th sample, filtered */
+	  CCSDS_Sample_t filteredSample = { sampleTick, ltr329.c0Data, ltr329.c1Data, ltr329.configCode, ltr329.sampleFlags };
+#if MEDIAN_SAMPLES
+	  if (sampleRead) {
+		  Sample_Median_Add(&sampleMedian, &filteredSample, &filteredSample); // Spikes go first, so they never reach the averages
+	  }
+#endif
+#if FILTER_SAMPLES
+	  CCSDS_Sample_t rawSample = filteredSample;
+	  uint8_t sampleDue = sampleRead && Sample_Filter_Add(&sampleFilter, &rawSample, &filteredSample);
+#else
+	  const uint8_t sampleDue = sampleRead;
+#endif
+	  if (sampleDue) {
+		  ltr329.c0Data = filteredSample.c0Data;
+		  ltr329.c1Data = filteredSample.c1Data;
+		  ltr329.sampleFlags = filteredSample.flags;
+	  }
+#else
+	  const uint8_t sampleDue = sampleRead;
+#endif
+
+	  /* Samples inside the deadband are not sent, decided on raw counts before any lux math */
+	  if (sampleDue && Report_Deadband_Check(&reportDeadband, sampleTick, ltr329.c0Data, ltr329.c1Data, ltr329.configCode, ltr329.sampleFlags)) {
+#if TELEMETRY_FORMAT != TELEMETRY_ASCII
+		  /* Pack raw counts into a CCSDS packet, lux is computed on the ground */
+		  CCSDS_Sample_t sample = { sampleTick, ltr329.c0Data, ltr329.c1Data, ltr329.configCode, ltr329.sampleFlags };
+#if FLASH_LOG_SAMPLES
+		  Flash_Log_Append(&flashLog, &sample);
+#endif
+#if TELEMETRY_FORMAT == TELEMETRY_CCSDS_SCHEDULED
+		  /* Held until the next frame, a configuration change is an event, flagged samples outrank routine ones */
+		  Downlink_Class_t sampleClass = (ltr329.configCode != lastConfigCode) ? DOWNLINK_CLASS_EVENT
+				  : (ltr329.sampleFlags != 0) ? DOWNLINK_CLASS_QUALITY : DOWNLINK_CLASS_ROUTINE;
+		  lastConfigCode = ltr329.configCode;
+		  Downlink_Scheduler_Add(&downlinkScheduler, &sample, sampleClass);
+		  uint16_t packetLength = 0;
+#elif FORWARD_FROM_RING
+		  /* Stored with its timestamp, packed when the next burst drains the ring */
+		  Sample_Ring_Push(&sampleRing, &sample);
+		  uint16_t packetLength = 0;
+#elif TELEMETRY_FORMAT == TELEMETRY_CCSDS_DELTA
+		  uint16_t packetLength = Sample_Encoder_Add(&sampleEncoder, &sample, ccsdsPacket);
+#else
+		  uint16_t packetLength = CCSDS_Encoder_Add(&ccsdsEncoder, &sample, ccsdsPacket);
+#endif
+		  if (packetLength != 0) {
+			  Telemetry_TX_Enqueue(&telemetryTx, ccsdsPacket, packetLength);
+		  }
+#else
+		  /* Calculate lux value */
+		  LTR_329_Calculate_Lux(&ltr329);
+
+		  /* Format Lux data straight into the telemetry buffer, dropped and counted if the link is behind */
+		  char *txLine = (char *)Telemetry_TX_Reserve(&telemetryTx, LUX_FORMAT_LINE_MAX);
+		  if (txLine != NULL) {
+			  Telemetry_TX_Commit(&telemetryTx, Lux_Format_Line(txLine, LUX_FORMAT_LINE_MAX, Lux_To_Centi(ltr329.alsLuxData)));
+		  }
+#endif
+	  }
+
+#if FORWARD_FROM_RING
+	  /* At most one packet per sample period, so a burst never overruns the telemetry buffers */
+	  if (Sample_Ring_Drain_Due(&sampleRing)) {
+		  CCSDS_Sample_t stored;
+		  uint16_t packetLength = 0;
+		  while ((packetLength == 0) && Sample_Ring_Pop(&sampleRing, &stored)) {
+#if TELEMETRY_FORMAT == TELEMETRY_CCSDS_DELTA
+			  packetLength = Sample_Encoder_Add(&sampleEncoder, &stored, ccsdsPacket);
+#else
+			  packetLength = CCSDS_Encoder_Add(&ccsdsEncoder, &stored, ccsdsPacket);
+#endif
+		  }
+		  /* The last partial packet of a burst is not held back until the next one, during a pass samples go out in whole packets */
+		  if ((packetLength == 0) && (Sample_Ring_Count(&sampleRing) == 0) && !sampleRing.forced) {
+#if TELEMETRY_FORMAT == TELEMETRY_CCSDS_DELTA
+			  packetLength = Sample_Encoder_Flush(&sampleEncoder, ccsdsPacket);
+#else
+			  packetLength = CCSDS_Encoder_Flush(&ccsdsEncoder, ccsdsPacket);
+#endif
+		  }
+		  if (packetLength != 0) {
+			  Telemetry_TX_Enqueue(&telemetryTx, ccsdsPacket, packetLength);
+		  }
+	  }
+#endif
+
+#if TELEMETRY_FORMAT == TELEMETRY_CCSDS_SCHEDULED
+	  /* One frame per period, filled to the link budget by priority */
+	  if ((int32_t)(sampleTick - frameTick) >= 0) {
+		  frameTick += DOWNLINK_FRAME_PERIOD_MS;
+		  uint16_t frameLength = Downlink_Scheduler_Build_Frame(&downlinkScheduler, sampleTick, DOWNLINK_FRAME_BUDGET, ccsdsPacket);
+		  if (frameLength != 0) {
+			  Telemetry_TX_Enqueue(&telemetryTx, ccsdsPacket, frameLength);
+		  }
+	  }
+#endif
+
+#if (TELEMETRY_FORMAT != TELEMETRY_ASCII) && (LUX_HISTOGRAM_PERIOD_MS != 0)
+	  /* Every sample with a usable reading is binned, suppressed ones included */
+	  if (sampleDue && ((ltr329.sampleFlags & LTR_329_FLAGS_INVALID) == 0)) {
+		  LTR_329_Calculate_Lux(&ltr329);
+		  Lux_Histogram_Add(&luxHistogram, Lux_To_Centi(ltr329.alsLuxData));
+	  }
+	  if ((uint32_t)(sampleTick - luxHistogram.startTick) >= LUX_HISTOGRAM_PERIOD_MS) {
+		  uint8_t histogramPacket[LUX_HISTOGRAM_PRODUCT_MAX];
+		  uint16_t histogramLength = Lux_Histogram_Build_Product(&luxHistogram, sampleTick, histogramPacket);
+		  if (histogramLength != 0) {
+			  Telemetry_TX_Enqueue(&telemetryTx, histogramPacket, histogramLength);
+		  }
+	  }
+#endif
+
+	  /* Errors recorded by the driver are sent here, never from the error path itself */
+	  Telemetry_Send_Errors(sampleTick);
+
+	  /* Commands run between samples, right after the sample was taken */
+	  Command_Console_Process(&commandConsole);
+
+	  /* Sleep until the next sample is due, a fixed schedule keeps packet timestamps exact */
+	  sampleTick += SAMPLE_PERIOD_MS;
+	  while ((int32_t)(HAL_GetTick() - sampleTick) < 0) {
+		  __WFI();
+	  }
 
     /* USER CODE END WHILE */
 
@@ -261,6 +614,25 @@ static void MX_USART2_UART_Init(void)
 
 }
 
+/**
+  * Enable DMA controller clock
+  */
+static void MX_DMA_Init(void)
+{
+
+  /* DMA controller clock enable */
+  __HAL_RCC_DMA1_CLK_ENABLE();
+
+  /* DMA interrupt init */
+  /* DMA1_Channel6_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Channel6_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel6_IRQn);
+  /* DMA1_Channel7_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Channel7_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel7_IRQn);
+
+}
+
 /**
   * @brief GPIO Initialization Function
   * @param None
@@ -304,11 +676,80 @@ static void MX_GPIO_Init(void)
   HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
 
   /* USER CODE BEGIN MX_GPIO_Init_2 */
+#if LTR_303_INT_WINDOW
+  /*Configure GPIO pin : LTR_303_INT_Pin */
+  GPIO_InitStruct.Pin = LTR_303_INT_Pin;
+  GPIO_InitStruct.Mode = GPIO_MODE_IT_FALLING;
+  GPIO_InitStruct.Pull = GPIO_PULLUP;
+  HAL_GPIO_Init(LTR_303_INT_GPIO_Port, &GPIO_InitStruct);
+
+  /* EXTI interrupt init*/
+  HAL_NVIC_SetPriority(EXTI9_5_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(EXTI9_5_IRQn);
+#endif
 
   /* USER CODE END MX_GPIO_Init_2 */
 }
 
 /* USER CODE BEGIN 4 */
+/**
+  * @brief  Tx Transfer completed callback, chains the next telemetry buffer.
+  * @param  huart: UART handle
+  * @retval None
+  */
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+  if (huart == &huart2)
+  {
+    Telemetry_TX_Complete_Callback(&telemetryTx);
+  }
+}
+
+/**
+  * @brief  Rx event callback (idle line, half and full transfer), publishes received command bytes.
+  * @param  huart: UART handle
+  * @param  Size: DMA write position in the receive buffer
+  * @retval None
+  */
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
+{
+  if (huart == &huart2)
+  {
+    Command_Console_RX_Event_Callback(&commandConsole, Size);
+  }
+}
+
+/**
+  * @brief  EXTI line detection callback, records an LTR-303 INT assertion for the main loop.
+  * @param  GPIO_Pin: Pin that triggered the interrupt
+  * @retval None
+  */
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+  if (GPIO_Pin == LTR_303_INT_Pin)
+  {
+    LTR_303_INT_Handler(&ltr329);
+  }
+}
+
+/**
+  * @brief  UART error callback, restarts command reception and unblocks telemetry after an aborted transfer.
+  * @param  huart: UART handle
+  * @retval None
+  */
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+  if (huart == &huart2)
+  {
+    Command_Console_Error_Callback(&commandConsole);
+
+    /* HAL ends an aborted TX DMA transfer with gState back to ready, a receive error leaves it busy */
+    if (huart->gState != HAL_UART_STATE_BUSY_TX)
+    {
+      Telemetry_TX_Error_Callback(&telemetryTx);
+    }
+  }
+}
 
 /* USER CODE END 4 */
 
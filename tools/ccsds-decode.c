@@ -0,0 +1,451 @@
+/**
+ * @file ccsds-decode.c
+ * @brief Streaming host decoder and ingest tool for LTR-329 CCSDS telemetry.
+ * @author Kent Hong
+ *
+ * Reads a raw telemetry capture from a file, a pipe or a serial port/pseudo-terminal
+ * and decodes raw sample packets, delta-compressed sample blocks and scheduled
+ * frames of timed samples (in frame order, not time order). Error-Log
+ * packets and lux histograms are printed to stderr. Bytes that do not start a valid packet (bad
+ * header or CRC) are skipped up to the next possible primary header, so the
+ * decoder resynchronizes after corruption.
+ *
+ * Output is either CSV on stdout, one line per sample, or columnar with -c: one
+ * little-endian binary file per field (<prefix>.seq.u16, .tick.u32, .c0.u16,
+ * .c1.u16, .config.u8, .flags.u8) that numpy.fromfile() or similar loads directly.
+ * All buffers are fixed size, memory use does not depend on the capture size.
+ * Output is flushed before every blocking read from a pipe or tty, so a live
+ * link is decoded as it arrives.
+ *
+ * Build: cc -O2 -I.. -o ccsds-decode ccsds-decode.c ../CCSDS-Packet.c ../Sample-Codec.c ../Lux-Histogram.c
+ * Usage: ccsds-decode [-c prefix] [-b baud] [capture.bin | /dev/ttyACM0 | -] > samples.csv
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "CCSDS-Packet.h"
+#include "Sample-Codec.h"
+#include "Lux-Histogram.h"
+
+#define WINDOW_SIZE 65536  // Input window, refilled when the next packet is incomplete
+#define COLUMN_ROWS 16384  // Samples buffered per column before it is written out
+#define CSV_BUFFER_SIZE 65536
+#define CSV_LINE_MAX 48    // "16383,4294967295,65535,65535,7,7,0xFF\n"
+
+/** @brief First byte of every primary header we accept, all APIDs share it */
+#define SYNC_BYTE ((CCSDS_SEC_HEADER_FLAG | CCSDS_APID_LTR_329) >> 8)
+_Static_assert(((CCSDS_SEC_HEADER_FLAG | CCSDS_APID_LTR_329_DELTA) >> 8) == SYNC_BYTE, "APIDs must share the sync byte");
+_Static_assert(((CCSDS_SEC_HEADER_FLAG | CCSDS_APID_ERROR_LOG) >> 8) == SYNC_BYTE, "APIDs must share the sync byte");
+_Static_assert(((CCSDS_SEC_HEADER_FLAG | CCSDS_APID_LTR_329_TIMED) >> 8) == SYNC_BYTE, "APIDs must share the sync byte");
+_Static_assert(((CCSDS_SEC_HEADER_FLAG | CCSDS_APID_LUX_HISTOGRAM) >> 8) == SYNC_BYTE, "APIDs must share the sync byte");
+
+/** @brief Per-APID sequence tracking */
+typedef struct {
+	uint16_t apid;
+	int lastSeq;
+	unsigned long packets;
+	unsigned long gaps;
+} Stream_t;
+
+static Stream_t streams[] = {
+	{ CCSDS_APID_LTR_329, -1, 0, 0 },
+	{ CCSDS_APID_LTR_329_DELTA, -1, 0, 0 },
+	{ CCSDS_APID_LTR_329_TIMED, -1, 0, 0 },
+	{ CCSDS_APID_LUX_HISTOGRAM, -1, 0, 0 },
+	{ CCSDS_APID_ERROR_LOG, -1, 0, 0 },
+};
+
+/** @brief Columnar output, one file per field */
+typedef struct {
+	FILE *files[6];
+	uint32_t rows;
+	uint16_t seq[COLUMN_ROWS];
+	uint32_t tick[COLUMN_ROWS];
+	uint16_t c0[COLUMN_ROWS];
+	uint16_t c1[COLUMN_ROWS];
+	uint8_t config[COLUMN_ROWS];
+	uint8_t flags[COLUMN_ROWS];
+} Columns_t;
+
+static const char *columnNames[6] = { "seq.u16", "tick.u32", "c0.u16", "c1.u16", "config.u8", "flags.u8" };
+
+static Columns_t *columns;  // NULL: CSV output
+static char csvBuffer[CSV_BUFFER_SIZE];
+static uint32_t csvFill;
+static unsigned long long sampleCount;
+
+/** @brief Write the buffered rows of every column, values in little-endian order */
+static void Columns_Flush(Columns_t *col) {
+	/* Columns are written in host order, convert on big-endian hosts */
+	if ((col->rows != 0) && (*(const uint8_t *)&(uint16_t){ 1 } == 0)) {
+		for (uint32_t i = 0; i < col->rows; i++) {
+			col->seq[i] = (uint16_t)((col->seq[i] >> 8) | (col->seq[i] << 8));
+			col->c0[i] = (uint16_t)((col->c0[i] >> 8) | (col->c0[i] << 8));
+			col->c1[i] = (uint16_t)((col->c1[i] >> 8) | (col->c1[i] << 8));
+			uint32_t t = col->tick[i];
+			col->tick[i] = (t >> 24) | ((t >> 8) & 0xFF00) | ((t << 8) & 0xFF0000) | (t << 24);
+		}
+	}
+	fwrite(col->seq, sizeof(col->seq[0]), col->rows, col->files[0]);
+	fwrite(col->tick, sizeof(col->tick[0]), col->rows, col->files[1]);
+	fwrite(col->c0, sizeof(col->c0[0]), col->rows, col->files[2]);
+	fwrite(col->c1, sizeof(col->c1[0]), col->rows, col->files[3]);
+	fwrite(col->config, sizeof(col->config[0]), col->rows, col->files[4]);
+	fwrite(col->flags, sizeof(col->flags[0]), col->rows, col->files[5]);
+	col->rows = 0;
+}
+
+/** @brief Append an unsigned decimal, returns the new end */
+static char *Put_Decimal(char *p, uint32_t value) {
+	char digits[10];
+	int n = 0;
+	do {
+		digits[n++] = (char)('0' + value % 10);
+		value /= 10;
+	} while (value != 0);
+	while (n > 0) {
+		*p++ = digits[--n];
+	}
+	return p;
+}
+
+static void Csv_Flush(void) {
+	fwrite(csvBuffer, 1, csvFill, stdout);
+	csvFill = 0;
+}
+
+/** @brief Push all buffered output to the files/stdout */
+static void Output_Flush(void) {
+	if (columns != NULL) {
+		Columns_Flush(columns);
+		for (int i = 0; i < 6; i++) {
+			fflush(columns->files[i]);
+		}
+	} else {
+		Csv_Flush();
+		fflush(stdout);
+	}
+}
+
+static void Emit_Sample(uint16_t seqCount, const CCSDS_Sample_t *sample) {
+	static const char hex[] = "0123456789ABCDEF";
+
+	sampleCount++;
+
+	if (columns != NULL) {
+		uint32_t row = columns->rows;
+		columns->seq[row] = seqCount;
+		columns->tick[row] = sample->tick;
+		columns->c0[row] = sample->c0Data;
+		columns->c1[row] = sample->c1Data;
+		columns->config[row] = sample->configCode;
+		columns->flags[row] = sample->flags;
+		if (++columns->rows == COLUMN_ROWS) {
+			Columns_Flush(columns);
+		}
+		return;
+	}
+
+	if (csvFill > CSV_BUFFER_SIZE - CSV_LINE_MAX) {
+		Csv_Flush();
+	}
+	char *p = &csvBuffer[csvFill];
+	p = Put_Decimal(p, seqCount);
+	*p++ = ',';
+	p = Put_Decimal(p, sample->tick);
+	*p++ = ',';
+	p = Put_Decimal(p, sample->c0Data);
+	*p++ = ',';
+	p = Put_Decimal(p, sample->c1Data);
+	*p++ = ',';
+	*p++ = (char)('0' + ((sample->configCode >> 3) & 0x07));
+	*p++ = ',';
+	*p++ = (char)('0' + (sample->configCode & 0x07));
+	*p++ = ',';
+	*p++ = '0';
+	*p++ = 'x';
+	*p++ = hex[sample->flags >> 4];
+	*p++ = hex[sample->flags & 0x0F];
+	*p++ = '\n';
+	csvFill = (uint32_t)(p - csvBuffer);
+}
+
+/** @brief Decode one validated packet, returns 0 if its payload is not understood */
+static int Decode_Payload(const CCSDS_Header_t *header) {
+
+	if (header->apid == CCSDS_APID_LTR_329) {
+		if ((header->dataLength % CCSDS_SAMPLE_SIZE) != 0) {
+			return 0;
+		}
+		for (uint16_t i = 0; i < header->dataLength; i += CCSDS_SAMPLE_SIZE) {
+			const uint8_t *record = &header->data[i];
+			CCSDS_Sample_t sample = {
+				header->tick + (uint32_t)(i / CCSDS_SAMPLE_SIZE) * header->periodMs,
+				(uint16_t)((record[0] << 8) | record[1]), (uint16_t)((record[2] << 8) | record[3]), record[4], record[5]
+			};
+			Emit_Sample(header->seqCount, &sample);
+		}
+		return 1;
+	}
+
+	if (header->apid == CCSDS_APID_LTR_329_DELTA) {
+		/* Validate the whole block first so a corrupt block emits nothing */
+		Sample_Decoder_t dec;
+		CCSDS_Sample_t sample;
+		int8_t result;
+		Sample_Decoder_Init(&dec, header);
+		while ((result = Sample_Decoder_Next(&dec, &sample)) == 1) {
+		}
+		if (result != 0) {
+			return 0;
+		}
+		Sample_Decoder_Init(&dec, header);
+		while (Sample_Decoder_Next(&dec, &sample) == 1) {
+			Emit_Sample(header->seqCount, &sample);
+		}
+		return 1;
+	}
+
+	if (header->apid == CCSDS_APID_LTR_329_TIMED) {
+		if ((header->dataLength % CCSDS_TIMED_SAMPLE_SIZE) != 0) {
+			return 0;
+		}
+		for (uint16_t i = 0; i < header->dataLength; i += CCSDS_TIMED_SAMPLE_SIZE) {
+			CCSDS_Sample_t sample;
+			CCSDS_Get_Timed_Sample(&header->data[i], &sample);
+			Emit_Sample(header->seqCount, &sample);
+		}
+		return 1;
+	}
+
+	if (header->apid == CCSDS_APID_LUX_HISTOGRAM) {
+		const uint8_t *d = header->data;
+		if ((header->dataLength < LUX_HISTOGRAM_HEADER_SIZE)
+				|| (header->dataLength != LUX_HISTOGRAM_HEADER_SIZE + 2U * d[9])
+				|| ((unsigned)d[8] + d[9] > LUX_HISTOGRAM_BINS)) {
+			return 0;
+		}
+		/* One line per product, "floor_lux:count" per bin, the last bin is open-ended */
+		fprintf(stderr, "histogram tick=%lu duration_ms=%lu samples=%lu",
+				(unsigned long)header->tick,
+				(unsigned long)(((uint32_t)d[0] << 24) | ((uint32_t)d[1] << 16) | ((uint32_t)d[2] << 8) | d[3]),
+				(unsigned long)(((uint32_t)d[4] << 24) | ((uint32_t)d[5] << 16) | ((uint32_t)d[6] << 8) | d[7]));
+		for (uint8_t i = 0; i < d[9]; i++) {
+			uint32_t floor = Lux_Histogram_Bin_Floor((uint8_t)(d[8] + i));
+			uint16_t count = (uint16_t)((d[10 + 2 * i] << 8) | d[11 + 2 * i]);
+			if (count != 0) {
+				fprintf(stderr, " %lu.%02lu:%u", (unsigned long)(floor / 100), (unsigned long)(floor % 100), count);
+			}
+		}
+		fputc('\n', stderr);
+		return 1;
+	}
+
+	if (header->apid == CCSDS_APID_ERROR_LOG) {
+		for (uint16_t i = 0; i + CCSDS_ERROR_EVENT_SIZE <= header->dataLength; i += CCSDS_ERROR_EVENT_SIZE) {
+			const uint8_t *event = &header->data[i];
+			fprintf(stderr, "error tick=%lu code=%u reg=0x%02X status=%u value=0x%02X\n",
+					(unsigned long)(((uint32_t)event[0] << 24) | ((uint32_t)event[1] << 16) | ((uint32_t)event[2] << 8) | event[3]),
+					event[4], event[5], event[6], event[7]);
+		}
+		return 1;
+	}
+
+	return 0;
+}
+
+/** @brief Put a serial port or pseudo-terminal into raw 8N1 mode */
+static int Configure_Tty(int fd, long baud) {
+	struct termios tio;
+	if (tcgetattr(fd, &tio) != 0) {
+		return -1;
+	}
+	tio.c_iflag &= ~(tcflag_t)(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON | IXOFF);
+	tio.c_oflag &= ~(tcflag_t)OPOST;
+	tio.c_lflag &= ~(tcflag_t)(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+	tio.c_cflag &= ~(tcflag_t)(CSIZE | PARENB | CSTOPB);
+	tio.c_cflag |= CS8 | CREAD | CLOCAL;
+	tio.c_cc[VMIN] = 1;
+	tio.c_cc[VTIME] = 0;
+
+	speed_t speed;
+	switch (baud) {
+		case 9600: speed = B9600; break;
+		case 19200: speed = B19200; break;
+		case 38400: speed = B38400; break;
+#ifdef B57600
+		case 57600: speed = B57600; break;
+#endif
+#ifdef B115200
+		case 115200: speed = B115200; break;
+#endif
+#ifdef B230400
+		case 230400: speed = B230400; break;
+#endif
+		default: return -1;
+	}
+	cfsetispeed(&tio, speed);
+	cfsetospeed(&tio, speed);
+	return tcsetattr(fd, TCSANOW, &tio);
+}
+
+/** @brief read() that retries on EINTR, a hung-up pseudo-terminal reads as end of file */
+static ssize_t Read_Input(int fd, uint8_t *dest, size_t size) {
+	for (;;) {
+		ssize_t got = read(fd, dest, size);
+		if (got >= 0) {
+			return got;
+		}
+		if (errno == EIO) {
+			return 0;
+		}
+		if (errno != EINTR) {
+			return -1;
+		}
+	}
+}
+
+static void Usage(const char *name) {
+	fprintf(stderr, "usage: %s [-c prefix] [-b baud] [capture.bin | tty | -]\n", name);
+}
+
+int main(int argc, char **argv) {
+
+	const char *prefix = NULL;
+	long baud = 115200;
+	int opt;
+	while ((opt = getopt(argc, argv, "c:b:h")) != -1) {
+		if (opt == 'c') {
+			prefix = optarg;
+		} else if (opt == 'b') {
+			baud = strtol(optarg, NULL, 10);
+		} else {
+			Usage(argv[0]);
+			return 2;
+		}
+	}
+
+	int fd = STDIN_FILENO;
+	if ((optind < argc) && (strcmp(argv[optind], "-") != 0)) {
+		fd = open(argv[optind], O_RDONLY | O_NOCTTY);
+		if (fd < 0) {
+			perror(argv[optind]);
+			return 1;
+		}
+	}
+	if (isatty(fd) && (Configure_Tty(fd, baud) != 0)) {
+		fprintf(stderr, "cannot configure tty for %ld baud\n", baud);
+		return 1;
+	}
+
+	if (prefix != NULL) {
+		columns = calloc(1, sizeof(*columns));
+		if (columns == NULL) {
+			return 1;
+		}
+		for (int i = 0; i < 6; i++) {
+			char path[4096];
+			snprintf(path, sizeof(path), "%s.%s", prefix, columnNames[i]);
+			columns->files[i] = fopen(path, "wb");
+			if (columns->files[i] == NULL) {
+				perror(path);
+				return 1;
+			}
+		}
+	} else {
+		static const char header[] = "seq,tick_ms,c0,c1,gain_code,int_code,flags\n";
+		memcpy(csvBuffer, header, sizeof(header) - 1);
+		csvFill = sizeof(header) - 1;
+	}
+
+	static uint8_t window[WINDOW_SIZE];
+	uint32_t fill = 0, start = 0;
+	unsigned long long inputBytes = 0, skippedBytes = 0;
+	int eof = 0;
+	struct stat inputStat;
+	int live = (fstat(fd, &inputStat) != 0) || !S_ISREG(inputStat.st_mode);
+	struct timespec begin, end;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+
+	for (;;) {
+		CCSDS_Header_t header;
+		int32_t packetLength = CCSDS_Parse_Packet(&window[start], fill - start, &header);
+
+		if (packetLength == -1) {
+			if (eof) {
+				skippedBytes += fill - start;
+				break;
+			}
+			/* Live input blocks in read(), hand over what is decoded so far first */
+			if (live) {
+				Output_Flush();
+			}
+			memmove(window, &window[start], fill - start);
+			fill -= start;
+			start = 0;
+			ssize_t got = Read_Input(fd, &window[fill], sizeof(window) - fill);
+			if (got < 0) {
+				perror("read");
+				got = 0;
+			}
+			fill += (uint32_t)got;
+			inputBytes += (unsigned long long)got;
+			eof = (got == 0);
+			continue;
+		}
+
+		Stream_t *stream = NULL;
+		for (size_t i = 0; (packetLength > 0) && (i < sizeof(streams) / sizeof(streams[0])); i++) {
+			if (streams[i].apid == header.apid) {
+				stream = &streams[i];
+			}
+		}
+		if ((stream == NULL) || !Decode_Payload(&header)) {
+			/* Resynchronize on the next byte that can start a primary header */
+			const uint8_t *next = memchr(&window[start + 1], SYNC_BYTE, fill - start - 1);
+			uint32_t skip = (next != NULL) ? (uint32_t)(next - &window[start]) : (fill - start);
+			start += skip;
+			skippedBytes += skip;
+			continue;
+		}
+
+		if ((stream->lastSeq >= 0) && (header.seqCount != ((stream->lastSeq + 1) & CCSDS_SEQ_COUNT_MASK))) {
+			stream->gaps++;
+		}
+		stream->lastSeq = header.seqCount;
+		stream->packets++;
+		start += (uint32_t)packetLength;
+	}
+
+	Output_Flush();
+	if (columns != NULL) {
+		for (int i = 0; i < 6; i++) {
+			fclose(columns->files[i]);
+		}
+		free(columns);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double seconds = (double)(end.tv_sec - begin.tv_sec) + (double)(end.tv_nsec - begin.tv_nsec) * 1e-9;
+
+	for (size_t i = 0; i < sizeof(streams) / sizeof(streams[0]); i++) {
+		fprintf(stderr, "APID 0x%03X: %lu packets, %lu sequence gaps\n", streams[i].apid, streams[i].packets, streams[i].gaps);
+	}
+	fprintf(stderr, "%llu samples from %llu bytes, %llu bytes skipped, %.3f s (%.2f M samples/s)\n",
+			sampleCount, inputBytes, skippedBytes, seconds, (seconds > 0) ? (double)sampleCount / seconds * 1e-6 : 0.0);
+
+	if (fd != STDIN_FILENO) {
+		close(fd);
+	}
+	return 0;
+}
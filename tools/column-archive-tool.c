@@ -0,0 +1,286 @@
+/**
+ * @file column-archive-tool.c
+ * @brief Build, verify and query compressed columnar sample archives.
+ * @author Kent Hong
+ *
+ * Commands:
+ *   build   Convert a sample archive (sample-archive.h) into a columnar archive
+ *           and report the bytes per row of every column.
+ *   verify  Decode every column and compare it with the sample archive.
+ *   scan    Decode one column (time, c0, c1, gain, int or flags) of every block
+ *           and print its sum, min and max with the throughput. Given the sample
+ *           archive too, the same field is scanned from its rows for comparison.
+ *   filter  Count the rows whose c0 or c1 is at least a threshold. Blocks whose
+ *           max is below it are skipped and blocks whose min reaches it are
+ *           counted whole, only the others are decoded.
+ *   query   Count and average both channels over [from, to), decoding only the
+ *           blocks that overlap the range.
+ *
+ * Build: cc -O2 -I.. -o column-archive-tool column-archive-tool.c column-archive.c sample-archive.c
+ * Usage: column-archive-tool build|verify archive.lca samples.sar
+ *        column-archive-tool scan archive.lca column [samples.sar]
+ *        column-archive-tool filter archive.lca c0|c1 threshold
+ *        column-archive-tool query archive.lca from_ms to_ms
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "column-archive.h"
+
+static const char *const columnNames[COLUMN_COUNT] = { "time", "c0", "c1", "gain", "int", "flags" };
+
+static Column_Archive_Writer_t writer;
+static uint64_t values[COLUMN_COUNT][COLUMN_ARCHIVE_BLOCK_ROWS];
+
+static double Now_Ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void Usage(const char *name) {
+	fprintf(stderr, "usage: %s build|verify archive.lca samples.sar\n"
+			"       %s scan archive.lca time|c0|c1|gain|int|flags [samples.sar]\n"
+			"       %s filter archive.lca c0|c1 threshold\n"
+			"       %s query archive.lca from_ms to_ms\n", name, name, name, name);
+	exit(2);
+}
+
+static int Column_By_Name(const char *name) {
+	for (int c = 0; c < COLUMN_COUNT; c++) {
+		if (strcmp(name, columnNames[c]) == 0) {
+			return c;
+		}
+	}
+	return -1;
+}
+
+/** @brief Field of a row that is stored in a column */
+static uint64_t Record_Field(const Sample_Archive_Record_t *record, int column) {
+	switch (column) {
+		case COLUMN_TIME: return record->timeMs;
+		case COLUMN_C0: return record->c0Data;
+		case COLUMN_C1: return record->c1Data;
+		case COLUMN_GAIN: return record->alsGainData;
+		case COLUMN_INT: return record->alsIntData;
+		default: return record->flags;
+	}
+}
+
+static int Build(const char *path, const Sample_Archive_t *rows) {
+
+	if (!Column_Archive_Create(&writer, path)) {
+		perror(path);
+		return 1;
+	}
+	for (uint64_t i = 0; i < rows->header->recordCount; i++) {
+		if (!Column_Archive_Append(&writer, &rows->records[i])) {
+			perror(path);
+			return 1;
+		}
+	}
+	uint64_t rowCount = writer.header.rowCount;
+	uint64_t bytes[COLUMN_COUNT];
+	memcpy(bytes, writer.columnBytes, sizeof(bytes));
+	if (!Column_Archive_Finish(&writer)) {
+		perror(path);
+		return 1;
+	}
+
+	Column_Archive_t archive;
+	if (!Column_Archive_Open(&archive, path)) {
+		fprintf(stderr, "%s: written archive does not open\n", path);
+		return 1;
+	}
+	printf("%llu rows in %llu blocks, %zu bytes (%.2f bytes/row, %.1fx smaller than the %zu-byte sample archive)\n",
+			(unsigned long long)rowCount, (unsigned long long)archive.header->blockCount, archive.size,
+			(double)archive.size / (double)(rowCount ? rowCount : 1), (double)rows->size / (double)archive.size, rows->size);
+	for (int c = 0; c < COLUMN_COUNT; c++) {
+		printf("  %-5s %12llu bytes  %6.3f bytes/row\n", columnNames[c], (unsigned long long)bytes[c],
+				(double)bytes[c] / (double)(rowCount ? rowCount : 1));
+	}
+	Column_Archive_Close(&archive);
+	return 0;
+}
+
+static int Verify(const Column_Archive_t *archive, const Sample_Archive_t *rows) {
+
+	uint64_t row = 0;
+	if (archive->header->rowCount != rows->header->recordCount) {
+		fprintf(stderr, "row count %llu, expected %llu\n", (unsigned long long)archive->header->rowCount,
+				(unsigned long long)rows->header->recordCount);
+		return 1;
+	}
+	for (uint64_t b = 0; b < archive->header->blockCount; b++) {
+		uint32_t count = archive->blocks[b].rows;
+		for (int c = 0; c < COLUMN_COUNT; c++) {
+			if (Column_Archive_Read(archive, b, (Column_Id_t)c, values[c]) != count) {
+				fprintf(stderr, "block %llu column %s is corrupt\n", (unsigned long long)b, columnNames[c]);
+				return 1;
+			}
+			for (uint32_t i = 0; i < count; i++) {
+				if (values[c][i] != Record_Field(&rows->records[row + i], c)) {
+					fprintf(stderr, "row %llu column %s differs\n", (unsigned long long)(row + i), columnNames[c]);
+					return 1;
+				}
+			}
+		}
+		row += count;
+	}
+	printf("%llu rows match\n", (unsigned long long)row);
+	return 0;
+}
+
+static int Scan(const Column_Archive_t *archive, int column, const Sample_Archive_t *rows) {
+
+	uint64_t sum = 0, min = UINT64_MAX, max = 0, bytes = 0;
+	double t0 = Now_Ns();
+	for (uint64_t b = 0; b < archive->header->blockCount; b++) {
+		uint32_t count = Column_Archive_Read(archive, b, (Column_Id_t)column, values[0]);
+		bytes += archive->blocks[b].length[column];
+		for (uint32_t i = 0; i < count; i++) {
+			sum += values[0][i];
+			min = (values[0][i] < min) ? values[0][i] : min;
+			max = (values[0][i] > max) ? values[0][i] : max;
+		}
+	}
+	double ns = Now_Ns() - t0;
+	uint64_t rowCount = archive->header->rowCount;
+	printf("columnar %s: sum %llu min %llu max %llu, %llu bytes read, %.1f ms (%.0f Mvalues/s)\n", columnNames[column],
+			(unsigned long long)sum, (unsigned long long)min, (unsigned long long)max, (unsigned long long)bytes,
+			ns / 1e6, (double)rowCount * 1e3 / ns);
+
+	if (rows != NULL) {
+		sum = 0;
+		min = UINT64_MAX;
+		max = 0;
+		t0 = Now_Ns();
+		for (uint64_t i = 0; i < rows->header->recordCount; i++) {
+			uint64_t v = Record_Field(&rows->records[i], column);
+			sum += v;
+			min = (v < min) ? v : min;
+			max = (v > max) ? v : max;
+		}
+		ns = Now_Ns() - t0;
+		printf("row      %s: sum %llu min %llu max %llu, %llu bytes read, %.1f ms (%.0f Mvalues/s)\n", columnNames[column],
+				(unsigned long long)sum, (unsigned long long)min, (unsigned long long)max,
+				(unsigned long long)(rows->header->recordCount * sizeof(Sample_Archive_Record_t)), ns / 1e6,
+				(double)rows->header->recordCount * 1e3 / ns);
+	}
+	return 0;
+}
+
+static int Filter(const Column_Archive_t *archive, int column, uint64_t threshold) {
+
+	uint64_t matches = 0, skipped = 0, whole = 0, decoded = 0;
+	double t0 = Now_Ns();
+	for (uint64_t b = 0; b < archive->header->blockCount; b++) {
+		const Column_Block_t *entry = &archive->blocks[b];
+		uint16_t min = (column == COLUMN_C0) ? entry->c0Min : entry->c1Min;
+		uint16_t max = (column == COLUMN_C0) ? entry->c0Max : entry->c1Max;
+		if (max < threshold) {
+			skipped++;
+		}
+		else if (min >= threshold) {
+			matches += entry->rows;
+			whole++;
+		}
+		else {
+			uint32_t count = Column_Archive_Read(archive, b, (Column_Id_t)column, values[0]);
+			for (uint32_t i = 0; i < count; i++) {
+				matches += (values[0][i] >= threshold);
+			}
+			decoded++;
+		}
+	}
+	printf("%llu rows with %s >= %llu, blocks: %llu skipped, %llu counted whole, %llu decoded, %.2f ms\n",
+			(unsigned long long)matches, columnNames[column], (unsigned long long)threshold, (unsigned long long)skipped,
+			(unsigned long long)whole, (unsigned long long)decoded, (Now_Ns() - t0) / 1e6);
+	return 0;
+}
+
+static int Query(const Column_Archive_t *archive, uint64_t fromMs, uint64_t toMs) {
+
+	uint64_t count = 0, c0Sum = 0, c1Sum = 0, blocks = 0;
+	double t0 = Now_Ns();
+	for (uint64_t b = Column_Archive_Find_Block(archive, fromMs);
+			(b < archive->header->blockCount) && (archive->blocks[b].firstTimeMs < toMs); b++) {
+		uint32_t rows = Column_Archive_Read(archive, b, COLUMN_TIME, values[COLUMN_TIME]);
+		Column_Archive_Read(archive, b, COLUMN_C0, values[COLUMN_C0]);
+		Column_Archive_Read(archive, b, COLUMN_C1, values[COLUMN_C1]);
+		for (uint32_t i = 0; i < rows; i++) {
+			if ((values[COLUMN_TIME][i] >= fromMs) && (values[COLUMN_TIME][i] < toMs)) {
+				count++;
+				c0Sum += values[COLUMN_C0][i];
+				c1Sum += values[COLUMN_C1][i];
+			}
+		}
+		blocks++;
+	}
+	printf("%llu rows", (unsigned long long)count);
+	if (count != 0) {
+		printf(", c0 mean %.1f, c1 mean %.1f", (double)c0Sum / (double)count, (double)c1Sum / (double)count);
+	}
+	printf(", %llu blocks decoded, %.3f ms\n", (unsigned long long)blocks, (Now_Ns() - t0) / 1e6);
+	return 0;
+}
+
+int main(int argc, char **argv) {
+
+	if (argc < 4) {
+		Usage(argv[0]);
+	}
+	const char *command = argv[1];
+	const char *path = argv[2];
+	Sample_Archive_t rows = { 0 };
+	int rowsOpen = 0;
+
+	/* The sample archive argument of build, verify and scan */
+	if ((strcmp(command, "build") == 0) || (strcmp(command, "verify") == 0)
+			|| ((strcmp(command, "scan") == 0) && (argc > 4))) {
+		const char *rowsPath = (strcmp(command, "scan") == 0) ? argv[4] : argv[3];
+		if (!Sample_Archive_Open(&rows, rowsPath)) {
+			fprintf(stderr, "%s: not a sample archive\n", rowsPath);
+			return 1;
+		}
+		rowsOpen = 1;
+	}
+	if (strcmp(command, "build") == 0) {
+		return Build(path, &rows);
+	}
+
+	Column_Archive_t archive;
+	if (!Column_Archive_Open(&archive, path)) {
+		fprintf(stderr, "%s: not a columnar archive\n", path);
+		return 1;
+	}
+
+	int result;
+	if (strcmp(command, "verify") == 0) {
+		result = Verify(&archive, &rows);
+	}
+	else if ((strcmp(command, "scan") == 0) && (Column_By_Name(argv[3]) >= 0)) {
+		result = Scan(&archive, Column_By_Name(argv[3]), rowsOpen ? &rows : NULL);
+	}
+	else if ((strcmp(command, "filter") == 0) && (argc == 5)
+			&& ((Column_By_Name(argv[3]) == COLUMN_C0) || (Column_By_Name(argv[3]) == COLUMN_C1))) {
+		result = Filter(&archive, Column_By_Name(argv[3]), strtoull(argv[4], NULL, 0));
+	}
+	else if ((strcmp(command, "query") == 0) && (argc == 5)) {
+		result = Query(&archive, strtoull(argv[3], NULL, 0), strtoull(argv[4], NULL, 0));
+	}
+	else {
+		Usage(argv[0]);
+		result = 2;
+	}
+
+	Column_Archive_Close(&archive);
+	if (rowsOpen) {
+		Sample_Archive_Close(&rows);
+	}
+	return result;
+}
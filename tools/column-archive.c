@@ -0,0 +1,408 @@
+/**
+ * @file column-archive.c
+ * @brief Implementation of the compressed columnar ground archive of LTR-329 samples.
+ * @author Kent Hong
+ *
+ * The writer buffers one block of rows, encodes every column into its own chunk
+ * and keeps only the block directory in memory. The header is written last, so an
+ * archive whose writer did not finish has no magic and is refused by
+ * Column_Archive_Open(). Every function returning int returns 1 on success and
+ * 0 on failure.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "column-archive.h"
+
+static int Host_Is_Little_Endian(void) {
+	return *(const uint8_t *)&(uint16_t){ 1 } == 1;
+}
+
+static uint8_t Bit_Width(uint64_t value) {
+	return (value == 0) ? 0 : (uint8_t)(64 - __builtin_clzll(value));
+}
+
+static uint64_t Load64(const uint8_t *p) {
+	uint64_t value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+
+/*****************************************************************
+ * @brief Encode one column of a block into a chunk             *
+ * @param values: Column values                                 *
+ * @param count: Number of values, 1 to COLUMN_ARCHIVE_BLOCK_ROWS *
+ * @param out: Chunk buffer of COLUMN_ARCHIVE_CHUNK_MAX bytes   *
+ * @return Chunk length, padding included                       *
+ ****************************************************************/
+uint32_t Column_Encode(const uint64_t *values, uint32_t count, uint8_t *out) {
+
+	uint64_t min = values[0], max = values[0];
+	int64_t deltaMin = 0, deltaMax = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		min = (values[i] < min) ? values[i] : min;
+		max = (values[i] > max) ? values[i] : max;
+		if (i != 0) {
+			int64_t delta = (int64_t)(values[i] - values[i - 1]);
+			deltaMin = ((i == 1) || (delta < deltaMin)) ? delta : deltaMin;
+			deltaMax = ((i == 1) || (delta > deltaMax)) ? delta : deltaMax;
+		}
+	}
+
+	uint8_t forWidth = Bit_Width(max - min);
+	uint8_t deltaWidth = Bit_Width((uint64_t)deltaMax - (uint64_t)deltaMin);
+	uint8_t encoding = ((count > 1) && (deltaWidth < forWidth)) ? COLUMN_ENCODING_DELTA : COLUMN_ENCODING_FOR;
+	uint8_t width = (encoding == COLUMN_ENCODING_DELTA) ? deltaWidth : forWidth;
+	uint64_t base = (encoding == COLUMN_ENCODING_DELTA) ? (uint64_t)deltaMin : min;
+
+	memset(out, 0, COLUMN_ARCHIVE_CHUNK_HEADER);
+	out[0] = encoding;
+	out[1] = width;
+	memcpy(&out[8], &base, sizeof(base));
+	memcpy(&out[16], &values[0], sizeof(values[0]));
+
+	/* Pack LSB-first through a 64-bit accumulator */
+	uint8_t *p = &out[COLUMN_ARCHIVE_CHUNK_HEADER];
+	uint64_t acc = 0;
+	uint32_t bits = 0;
+	if (width != 0) {
+		for (uint32_t i = (encoding == COLUMN_ENCODING_DELTA) ? 1 : 0; i < count; i++) {
+			uint64_t v = (encoding == COLUMN_ENCODING_DELTA) ? values[i] - values[i - 1] - base : values[i] - base;
+			acc |= v << bits;
+			if (bits + width >= 64) {
+				memcpy(p, &acc, sizeof(acc));
+				p += sizeof(acc);
+				acc = (bits == 0) ? 0 : v >> (64 - bits);
+				bits = bits + width - 64;
+			}
+			else {
+				bits += width;
+			}
+		}
+	}
+	memcpy(p, &acc, sizeof(acc));
+	p += (bits + 7) / 8;
+	memset(p, 0, COLUMN_ARCHIVE_CHUNK_PAD);
+	p += COLUMN_ARCHIVE_CHUNK_PAD;
+
+	return (uint32_t)(p - out);
+}
+
+
+/*****************************************************************
+ * @brief Decode a chunk                                        *
+ * @param chunk: Chunk written by Column_Encode()               *
+ * @param count: Number of values it holds                      *
+ * @param values: Array of at least count values                *
+ * @return count, 0 if the chunk header is not understood       *
+ ****************************************************************/
+uint32_t Column_Decode(const uint8_t *chunk, uint32_t count, uint64_t *values) {
+
+	uint8_t encoding = chunk[0];
+	uint8_t width = chunk[1];
+	uint64_t base = Load64(&chunk[8]);
+	uint64_t first = Load64(&chunk[16]);
+	const uint8_t *p = &chunk[COLUMN_ARCHIVE_CHUNK_HEADER];
+	if ((encoding > COLUMN_ENCODING_DELTA) || (width > 64) || (count == 0)) {
+		return 0;
+	}
+
+	uint64_t mask = (width == 64) ? UINT64_MAX : ((1ULL << width) - 1);
+	if (encoding == COLUMN_ENCODING_FOR) {
+		if (width == 0) {
+			for (uint32_t i = 0; i < count; i++) {
+				values[i] = base;
+			}
+		}
+		else if (width <= 56) {
+			for (uint32_t i = 0; i < count; i++) {
+				uint64_t bit = (uint64_t)i * width;
+				values[i] = base + ((Load64(&p[bit >> 3]) >> (bit & 7)) & mask);
+			}
+		}
+		else {
+			for (uint32_t i = 0; i < count; i++) {
+				uint64_t bit = (uint64_t)i * width;
+				uint64_t v = Load64(&p[bit >> 3]) >> (bit & 7);
+				if ((bit & 7) != 0) {
+					v |= (uint64_t)p[(bit >> 3) + 8] << (64 - (bit & 7));
+				}
+				values[i] = base + (v & mask);
+			}
+		}
+		return count;
+	}
+
+	/* Delta: the packed values start with the second row */
+	values[0] = first;
+	for (uint32_t i = 1; i < count; i++) {
+		uint64_t bit = (uint64_t)(i - 1) * width;
+		uint64_t v = 0;
+		if (width != 0) {
+			v = Load64(&p[bit >> 3]) >> (bit & 7);
+			if ((width > 56) && ((bit & 7) != 0)) {
+				v |= (uint64_t)p[(bit >> 3) + 8] << (64 - (bit & 7));
+			}
+		}
+		values[i] = values[i - 1] + base + (v & mask);
+	}
+	return count;
+}
+
+
+/** @brief Returns 1 if the packed values of a chunk, as its header describes them, fit its length */
+static int Column_Chunk_Fits(const uint8_t *chunk, uint32_t rows, uint32_t length) {
+	uint64_t packed = (chunk[0] == COLUMN_ENCODING_DELTA) ? rows - 1U : rows;
+	return (chunk[0] <= COLUMN_ENCODING_DELTA) && (chunk[1] <= 64)
+			&& ((packed * chunk[1] + 7) / 8 <= length - COLUMN_ARCHIVE_CHUNK_HEADER - COLUMN_ARCHIVE_CHUNK_PAD);
+}
+
+
+/*****************************************************************
+ * @brief Map an archive and check its header and directory     *
+ * @param archive: Pointer to the Column_Archive_t struct       *
+ * @param path: Archive file                                    *
+ * @return 1 if the archive is mapped, 0 otherwise              *
+ ****************************************************************/
+int Column_Archive_Open(Column_Archive_t *archive, const char *path) {
+
+	struct stat st;
+	memset(archive, 0, sizeof(*archive));
+	if (!Host_Is_Little_Endian()) {
+		return 0;
+	}
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return 0;
+	}
+	if ((fstat(fd, &st) != 0) || ((size_t)st.st_size < sizeof(Column_Archive_Header_t))) {
+		close(fd);
+		return 0;
+	}
+	void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		return 0;
+	}
+
+	const Column_Archive_Header_t *header = map;
+	uint64_t size = (uint64_t)st.st_size;
+	int valid = (memcmp(header->magic, COLUMN_ARCHIVE_MAGIC, sizeof(header->magic)) == 0)
+			&& (header->version == COLUMN_ARCHIVE_VERSION)
+			&& (header->blockRows != 0) && (header->blockRows <= COLUMN_ARCHIVE_BLOCK_ROWS)
+			&& (header->directoryOffset % 8 == 0)
+			&& (header->directoryOffset <= size)
+			&& (header->blockCount <= (size - header->directoryOffset) / sizeof(Column_Block_t));
+
+	/* Every chunk must lie between the header and the directory */
+	const Column_Block_t *blocks = (const Column_Block_t *)((const uint8_t *)map + (valid ? header->directoryOffset : 0));
+	for (uint64_t b = 0; valid && (b < header->blockCount); b++) {
+		valid = (blocks[b].rows != 0) && (blocks[b].rows <= header->blockRows);
+		for (int c = 0; valid && (c < COLUMN_COUNT); c++) {
+			valid = (blocks[b].offset[c] >= sizeof(Column_Archive_Header_t))
+					&& (blocks[b].length[c] >= COLUMN_ARCHIVE_CHUNK_HEADER + COLUMN_ARCHIVE_CHUNK_PAD)
+					&& (blocks[b].offset[c] + blocks[b].length[c] <= header->directoryOffset)
+					&& Column_Chunk_Fits((const uint8_t *)map + blocks[b].offset[c], blocks[b].rows, blocks[b].length[c]);
+		}
+	}
+	if (!valid) {
+		munmap(map, (size_t)st.st_size);
+		return 0;
+	}
+
+	archive->map = map;
+	archive->size = (size_t)st.st_size;
+	archive->header = header;
+	archive->blocks = blocks;
+	return 1;
+}
+
+
+/** @brief Unmap an archive */
+void Column_Archive_Close(Column_Archive_t *archive) {
+	if (archive->map != NULL) {
+		munmap((void *)archive->map, archive->size);
+	}
+	memset(archive, 0, sizeof(*archive));
+}
+
+
+/*****************************************************************
+ * @brief Decode one column of one block                        *
+ * @param archive: Pointer to the Column_Archive_t struct       *
+ * @param block: Block number                                   *
+ * @param column: Column to decode                              *
+ * @param values: Array of at least blockRows values            *
+ * @return Rows decoded, 0 on a corrupt chunk                   *
+ ****************************************************************/
+uint32_t Column_Archive_Read(const Column_Archive_t *archive, uint64_t block, Column_Id_t column, uint64_t *values) {
+	const Column_Block_t *entry = &archive->blocks[block];
+	return Column_Decode(&archive->map[entry->offset[column]], entry->rows, values);
+}
+
+
+/*****************************************************************
+ * @brief Find the first block that can hold a time             *
+ * @param archive: Pointer to the Column_Archive_t struct       *
+ * @param timeMs: Time to look for                              *
+ * @return First block whose last row is at or after timeMs,    *
+ *         blockCount if every block is older                   *
+ ****************************************************************/
+uint64_t Column_Archive_Find_Block(const Column_Archive_t *archive, uint64_t timeMs) {
+
+	uint64_t lo = 0, hi = archive->header->blockCount;
+	while (lo < hi) {
+		uint64_t mid = lo + (hi - lo) / 2;
+		if (archive->blocks[mid].lastTimeMs < timeMs) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+
+/*****************************************************************
+ * @brief Start writing an archive                              *
+ * @param writer: Pointer to the Column_Archive_Writer_t struct *
+ * @param path: Archive file, truncated                         *
+ * @return 1 if the file is open, 0 otherwise                   *
+ ****************************************************************/
+int Column_Archive_Create(Column_Archive_Writer_t *writer, const char *path) {
+
+	static const uint8_t zeros[sizeof(Column_Archive_Header_t)];
+	memset(&writer->header, 0, sizeof(writer->header));
+	writer->rows = 0;
+	writer->blocks = NULL;
+	writer->blockCapacity = 0;
+	memset(writer->columnBytes, 0, sizeof(writer->columnBytes));
+	if (!Host_Is_Little_Endian()) {
+		return 0;
+	}
+
+	writer->file = fopen(path, "wb");
+	if (writer->file == NULL) {
+		return 0;
+	}
+	setvbuf(writer->file, NULL, _IOFBF, 1 << 20);
+
+	memcpy(writer->header.magic, COLUMN_ARCHIVE_MAGIC, sizeof(writer->header.magic));
+	writer->header.version = COLUMN_ARCHIVE_VERSION;
+	writer->header.blockRows = COLUMN_ARCHIVE_BLOCK_ROWS;
+	writer->offset = sizeof(zeros);
+
+	/* Placeholder, the real header goes in once the directory is written */
+	return fwrite(zeros, 1, sizeof(zeros), writer->file) == sizeof(zeros);
+}
+
+
+/** @brief Encode and write the buffered rows as one block */
+static int Column_Archive_Write_Block(Column_Archive_Writer_t *writer) {
+
+	if (writer->header.blockCount == writer->blockCapacity) {
+		uint64_t capacity = (writer->blockCapacity != 0) ? writer->blockCapacity * 2 : 256;
+		Column_Block_t *blocks = realloc(writer->blocks, capacity * sizeof(*blocks));
+		if (blocks == NULL) {
+			return 0;
+		}
+		writer->blocks = blocks;
+		writer->blockCapacity = capacity;
+	}
+
+	Column_Block_t *entry = &writer->blocks[writer->header.blockCount];
+	memset(entry, 0, sizeof(*entry));
+	entry->rows = writer->rows;
+	entry->firstTimeMs = writer->values[COLUMN_TIME][0];
+	entry->lastTimeMs = writer->values[COLUMN_TIME][writer->rows - 1];
+	entry->c0Min = entry->c1Min = UINT16_MAX;
+	for (uint32_t i = 0; i < writer->rows; i++) {
+		uint16_t c0 = (uint16_t)writer->values[COLUMN_C0][i], c1 = (uint16_t)writer->values[COLUMN_C1][i];
+		entry->c0Min = (c0 < entry->c0Min) ? c0 : entry->c0Min;
+		entry->c0Max = (c0 > entry->c0Max) ? c0 : entry->c0Max;
+		entry->c1Min = (c1 < entry->c1Min) ? c1 : entry->c1Min;
+		entry->c1Max = (c1 > entry->c1Max) ? c1 : entry->c1Max;
+	}
+
+	for (int c = 0; c < COLUMN_COUNT; c++) {
+		uint32_t length = Column_Encode(writer->values[c], writer->rows, writer->chunk);
+		if (fwrite(writer->chunk, 1, length, writer->file) != length) {
+			return 0;
+		}
+		entry->offset[c] = writer->offset;
+		entry->length[c] = length;
+		writer->offset += length;
+		writer->columnBytes[c] += length;
+	}
+
+	writer->header.blockCount++;
+	writer->rows = 0;
+	return 1;
+}
+
+
+/*****************************************************************
+ * @brief Append one row                                        *
+ * @param writer: Pointer to the Column_Archive_Writer_t struct *
+ * @param record: Row to append, not older than the last one    *
+ * @return 1 if appended, 0 if out of order or on a write error *
+ ****************************************************************/
+int Column_Archive_Append(Column_Archive_Writer_t *writer, const Sample_Archive_Record_t *record) {
+
+	Column_Archive_Header_t *header = &writer->header;
+	if ((header->rowCount != 0) && (record->timeMs < header->lastTimeMs)) {
+		return 0;
+	}
+
+	uint32_t row = writer->rows++;
+	writer->values[COLUMN_TIME][row] = record->timeMs;
+	writer->values[COLUMN_C0][row] = record->c0Data;
+	writer->values[COLUMN_C1][row] = record->c1Data;
+	writer->values[COLUMN_GAIN][row] = record->alsGainData;
+	writer->values[COLUMN_INT][row] = record->alsIntData;
+	writer->values[COLUMN_FLAGS][row] = record->flags;
+
+	if (header->rowCount == 0) {
+		header->firstTimeMs = record->timeMs;
+	}
+	header->lastTimeMs = record->timeMs;
+	header->rowCount++;
+
+	return (writer->rows < COLUMN_ARCHIVE_BLOCK_ROWS) || Column_Archive_Write_Block(writer);
+}
+
+
+/*****************************************************************
+ * @brief Write the last block, directory and header and close  *
+ * @param writer: Pointer to the Column_Archive_Writer_t struct *
+ * @return 1 if the archive is complete, 0 on a write error     *
+ ****************************************************************/
+int Column_Archive_Finish(Column_Archive_Writer_t *writer) {
+
+	static const uint8_t zeros[8];
+	Column_Archive_Header_t *header = &writer->header;
+	int ok = (writer->rows == 0) || Column_Archive_Write_Block(writer);
+
+	uint32_t pad = (uint32_t)((8 - writer->offset % 8) % 8);
+	header->directoryOffset = writer->offset + pad;
+	ok = ok && (fwrite(zeros, 1, pad, writer->file) == pad)
+			&& (fwrite(writer->blocks, sizeof(*writer->blocks), (size_t)header->blockCount, writer->file) == header->blockCount)
+			&& (fflush(writer->file) == 0)
+			&& (fseek(writer->file, 0, SEEK_SET) == 0)
+			&& (fwrite(header, sizeof(*header), 1, writer->file) == 1);
+	ok = (fclose(writer->file) == 0) && ok;
+
+	free(writer->blocks);
+	writer->blocks = NULL;
+	writer->file = NULL;
+	return ok;
+}
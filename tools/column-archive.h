@@ -0,0 +1,124 @@
+/**
+ * @file column-archive.h
+ * @brief Header file for the compressed columnar ground archive of LTR-329 samples.
+ * @author Kent Hong
+ *
+ * This file contains the on-disk format and function prototypes for a columnar
+ * archive of the Sample_Archive_Record_t fields (sample-archive.h). Rows are cut
+ * into blocks of COLUMN_ARCHIVE_BLOCK_ROWS and every column of a block is stored
+ * as its own chunk, so a scan of one column reads only that column's bytes.
+ *
+ * Each chunk is bit-packed with the smaller of two encodings, chosen per block:
+ *   FOR    value - min, at the bit width of max - min (constant gain,
+ *          integration time and flags take 0 bits per row)
+ *   DELTA  first value, then value - previous - min delta, at the bit width of
+ *          the delta range (a steady sample period takes 0 bits per row)
+ * Chunk layout, little-endian:
+ *   uint8 encoding, uint8 width, uint16 zero, uint32 zero, uint64 base,
+ *   uint64 first, packed values LSB-first, 8 zero bytes of padding
+ *
+ * The block directory at the end of the file holds the time range and the
+ * channel min/max of every block, so range queries find their blocks with a
+ * binary search and filters skip blocks that cannot match without decoding them.
+ * All fields are little-endian, the tools require a little-endian host.
+ *
+ * Build: see column-archive-tool.c
+ */
+
+#ifndef COLUMN_ARCHIVE_H_
+#define COLUMN_ARCHIVE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "sample-archive.h"
+
+#define COLUMN_ARCHIVE_MAGIC "LTR329CA"
+#define COLUMN_ARCHIVE_VERSION 1
+#define COLUMN_ARCHIVE_BLOCK_ROWS 8192
+#define COLUMN_ARCHIVE_CHUNK_HEADER 24
+#define COLUMN_ARCHIVE_CHUNK_PAD 8     // Zero bytes after the packed values, lets the decoder load 8 bytes at a time
+#define COLUMN_ARCHIVE_CHUNK_MAX (COLUMN_ARCHIVE_CHUNK_HEADER + COLUMN_ARCHIVE_BLOCK_ROWS * 8 + COLUMN_ARCHIVE_CHUNK_PAD)
+
+/** @brief Chunk encodings */
+#define COLUMN_ENCODING_FOR 0
+#define COLUMN_ENCODING_DELTA 1
+
+/** @brief Stored columns */
+typedef enum {
+	COLUMN_TIME = 0,  // timeMs
+	COLUMN_C0,        // c0Data
+	COLUMN_C1,        // c1Data
+	COLUMN_GAIN,      // alsGainData
+	COLUMN_INT,       // alsIntData
+	COLUMN_FLAGS,     // flags
+	COLUMN_COUNT
+} Column_Id_t;
+
+/** @brief File header, the first 64 bytes */
+typedef struct {
+	char magic[8];            // COLUMN_ARCHIVE_MAGIC, not terminated
+	uint32_t version;         // COLUMN_ARCHIVE_VERSION
+	uint32_t blockRows;       // Rows per block, the last block may hold fewer
+	uint64_t rowCount;
+	uint64_t blockCount;
+	uint64_t directoryOffset; // Offset of blockCount Column_Block_t entries
+	uint64_t firstTimeMs;
+	uint64_t lastTimeMs;
+	uint64_t reserved;        // Zero
+} Column_Archive_Header_t;
+
+_Static_assert(sizeof(Column_Archive_Header_t) == 64, "header must stay 64 bytes");
+
+/** @brief Directory entry of one block */
+typedef struct {
+	uint64_t firstTimeMs;
+	uint64_t lastTimeMs;
+	uint64_t offset[COLUMN_COUNT];  // Chunk offsets
+	uint32_t length[COLUMN_COUNT];  // Chunk lengths, padding included
+	uint32_t rows;
+	uint16_t c0Min, c0Max;
+	uint16_t c1Min, c1Max;
+	uint32_t reserved;              // Zero
+} Column_Block_t;
+
+_Static_assert(sizeof(Column_Block_t) == 104, "directory entries must stay 104 bytes");
+
+/** @brief Open archive, read-only mapping */
+typedef struct {
+	const uint8_t *map;
+	size_t size;
+	const Column_Archive_Header_t *header;
+	const Column_Block_t *blocks;   // header->blockCount entries
+} Column_Archive_t;
+
+/** @brief Archive being written, one block of rows is buffered */
+typedef struct {
+	FILE *file;
+	Column_Archive_Header_t header;
+	uint64_t offset;               // Bytes written so far
+	uint32_t rows;                 // Rows in the buffered block
+	uint64_t values[COLUMN_COUNT][COLUMN_ARCHIVE_BLOCK_ROWS];
+	uint8_t chunk[COLUMN_ARCHIVE_CHUNK_MAX];
+	Column_Block_t *blocks;        // Directory, grown as blocks are written
+	uint64_t blockCapacity;
+	uint64_t columnBytes[COLUMN_COUNT]; // Chunk bytes per column, for reports
+} Column_Archive_Writer_t;
+
+
+/** @brief Function Prototypes for the chunk codec */
+uint32_t Column_Encode(const uint64_t *values, uint32_t count, uint8_t *out);
+uint32_t Column_Decode(const uint8_t *chunk, uint32_t count, uint64_t *values);
+
+/** @brief Function Prototypes for reading an archive */
+int Column_Archive_Open(Column_Archive_t *archive, const char *path);
+void Column_Archive_Close(Column_Archive_t *archive);
+uint32_t Column_Archive_Read(const Column_Archive_t *archive, uint64_t block, Column_Id_t column, uint64_t *values);
+uint64_t Column_Archive_Find_Block(const Column_Archive_t *archive, uint64_t timeMs);
+
+/** @brief Function Prototypes for writing an archive */
+int Column_Archive_Create(Column_Archive_Writer_t *writer, const char *path);
+int Column_Archive_Append(Column_Archive_Writer_t *writer, const Sample_Archive_Record_t *record);
+int Column_Archive_Finish(Column_Archive_Writer_t *writer);
+
+#endif /* COLUMN_ARCHIVE_H_ */
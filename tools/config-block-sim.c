@@ -0,0 +1,193 @@
+/**
+ * @file config-block-sim.c
+ * @brief Host power-cut check of the double-banked configuration block on a RAM flash.
+ * @author Kent Hong
+ *
+ * Runs Config-Block.c unchanged against a two-page Flash_Log_Device_t kept in
+ * RAM, which counts reads and can cut the power part way through an erase or a
+ * program.
+ *
+ * Checks: blank flash loads the defaults; a clean load takes 3 reads (both
+ * headers, then the newer bank); a save is cut at every step it takes, with the
+ * erase leaving each multiple of 64 bytes of the page erased and the rest
+ * holding the old copy, and the program leaving each number of double words
+ * written. After every cut Config_Block_Load() must return the previous
+ * generation with its settings, and a retried save must then land and load
+ * with the generation after it. This repeats for several saves, so both banks
+ * take the cut. A bank corrupted outside a save must fall back to the other,
+ * and the next save must go into the corrupted bank.
+ *
+ * Build: cc -O2 -I.. -o config-block-sim config-block-sim.c ../Config-Block.c ../CCSDS-Packet.c
+ * Usage: config-block-sim [-g generations]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "Config-Block.h"
+
+#define PAGES 2
+#define ERASE_STEP 64 // Granularity of the partly erased pages tried
+
+/** @brief RAM flash with a power cut after a given number of bytes of one operation */
+typedef struct {
+	uint8_t image[PAGES * FLASH_LOG_PAGE_SIZE];
+	int32_t cutOperation;   // Operation that loses power, -1 for none
+	uint32_t cutBytes;      // Bytes of it completed before the cut
+	int32_t operations;     // Erases and programs started
+	uint8_t powerLost;      // Set from the cut on, later operations do nothing
+	uint32_t reads;
+} RAM_Flash_t;
+
+static RAM_Flash_t flash;
+static int failures;
+
+static void Check(int ok, const char *what) {
+	printf("%-4s %s\n", ok ? "ok" : "FAIL", what);
+	failures += !ok;
+}
+
+/** @brief Bytes of the next operation to carry out, length unless this is the one that loses power */
+static uint32_t RAM_Flash_Begin(RAM_Flash_t *ram, uint32_t length) {
+	if (ram->powerLost) {
+		return 0;
+	}
+	if (ram->operations++ == ram->cutOperation) {
+		ram->powerLost = 1;
+		return (ram->cutBytes < length) ? ram->cutBytes : length;
+	}
+	return length;
+}
+
+static uint8_t RAM_Flash_Erase(void *ctx, uint16_t page) {
+	RAM_Flash_t *ram = ctx;
+	if (page >= PAGES) {
+		return 0;
+	}
+	memset(&ram->image[page * FLASH_LOG_PAGE_SIZE], 0xFF, RAM_Flash_Begin(ram, FLASH_LOG_PAGE_SIZE));
+	return !ram->powerLost;
+}
+
+static uint8_t RAM_Flash_Program(void *ctx, uint32_t offset, const uint8_t *data, uint16_t length) {
+	RAM_Flash_t *ram = ctx;
+	if ((offset % FLASH_LOG_PROGRAM_SIZE != 0) || (length % FLASH_LOG_PROGRAM_SIZE != 0) || (offset + length > sizeof(ram->image))) {
+		return 0;
+	}
+	/* Flash only clears bits, programming a word that is not erased corrupts it */
+	uint32_t done = RAM_Flash_Begin(ram, length);
+	for (uint32_t i = 0; i < done; i++) {
+		ram->image[offset + i] &= data[i];
+	}
+	return !ram->powerLost;
+}
+
+static uint8_t RAM_Flash_Read(void *ctx, uint32_t offset, uint8_t *data, uint16_t length) {
+	RAM_Flash_t *ram = ctx;
+	if (offset + length > sizeof(ram->image)) {
+		return 0;
+	}
+	ram->reads++;
+	memcpy(data, &ram->image[offset], length);
+	return 1;
+}
+
+static const Flash_Log_Device_t device = { RAM_Flash_Erase, RAM_Flash_Program, RAM_Flash_Read, &flash, PAGES };
+
+/** @brief Power back on, no cut pending */
+static void Reboot(void) {
+	flash.cutOperation = -1;
+	flash.operations = 0;
+	flash.powerLost = 0;
+}
+
+/** @brief Load and compare with the expected generation and settings */
+static uint8_t Load_Is(uint32_t generation, uint16_t deadbandAbsCounts) {
+	Config_Block_t block;
+	return Config_Block_Load(&block, &device) && (block.generation == generation) && (block.deadbandAbsCounts == deadbandAbsCounts);
+}
+
+/** @brief Save generation + 1 with power cut at byte cutBytes of operation cutOperation, then reboot and check */
+static uint8_t Cut_Save(const Config_Block_t *saved, int32_t cutOperation, uint32_t cutBytes) {
+	Config_Block_t block = *saved;
+	block.deadbandAbsCounts = (uint16_t)(saved->deadbandAbsCounts + 1U);
+	flash.cutOperation = cutOperation;
+	flash.cutBytes = cutBytes;
+	flash.operations = 0;
+	uint8_t stored = Config_Block_Save(&block, &device);
+	Reboot();
+	return !stored && Load_Is(saved->generation, saved->deadbandAbsCounts);
+}
+
+int main(int argc, char **argv) {
+
+	long generations = 6;
+	int opt;
+	while ((opt = getopt(argc, argv, "g:")) != -1) {
+		if (opt == 'g') {
+			generations = strtol(optarg, NULL, 0);
+		}
+		else {
+			fprintf(stderr, "usage: %s [-g generations]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (generations < 2) {
+		fprintf(stderr, "at least 2 generations\n");
+		return 2;
+	}
+
+	/* Blank flash */
+	Config_Block_t block, defaults;
+	memset(flash.image, 0xFF, sizeof(flash.image));
+	Reboot();
+	Config_Block_Defaults(&defaults);
+	Check(!Config_Block_Load(&block, &device) && (block.generation == 0) && (memcmp(block.luxScale, defaults.luxScale, sizeof(block.luxScale)) == 0)
+			&& (block.deadbandAbsCounts == defaults.deadbandAbsCounts), "blank flash loads the defaults at generation 0");
+
+	/* Saves cut at every step, each followed by a retry that must land */
+	uint32_t cuts = 0, failedCuts = 0;
+	const uint32_t words = sizeof(Config_Block_t) / FLASH_LOG_PROGRAM_SIZE;
+	for (long g = 0; g < generations; g++) {
+		if (g > 0) {
+			for (uint32_t bytes = 0; bytes < FLASH_LOG_PAGE_SIZE; bytes += ERASE_STEP) {
+				failedCuts += !Cut_Save(&block, 0, bytes);
+				cuts++;
+			}
+			for (uint32_t word = 0; word < words; word++) {
+				failedCuts += !Cut_Save(&block, 1, word * FLASH_LOG_PROGRAM_SIZE);
+				cuts++;
+			}
+		}
+		uint16_t deadbandAbsCounts = (uint16_t)(block.deadbandAbsCounts + 1U);
+		block.deadbandAbsCounts = deadbandAbsCounts;
+		if (!Config_Block_Save(&block, &device) || !Load_Is(block.generation, deadbandAbsCounts)) {
+			failedCuts++;
+		}
+		Config_Block_Load(&block, &device);
+	}
+	printf("%u cut saves over %ld generations, %u did not load the previous block\n", cuts, generations, failedCuts);
+	Check(failedCuts == 0, "a cut save loads the previous generation, the retry the next one");
+
+	/* Clean load */
+	flash.reads = 0;
+	Check(Load_Is(block.generation, block.deadbandAbsCounts) && (flash.reads == 3), "clean load takes 3 reads");
+
+	/* Newest bank corrupted outside a save, previous generation in the other bank */
+	uint32_t newest = block.generation;
+	flash.image[(newest & 1U) * FLASH_LOG_PAGE_SIZE + offsetof(Config_Block_t, luxScale)] ^= 0x01;
+	Check(Load_Is(newest - 1U, (uint16_t)(block.deadbandAbsCounts - 1U)), "corrupted newest bank falls back to the other");
+	Config_Block_Load(&block, &device);
+	static uint8_t goodBank[FLASH_LOG_PAGE_SIZE];
+	uint8_t *good = &flash.image[((newest - 1U) & 1U) * FLASH_LOG_PAGE_SIZE];
+	memcpy(goodBank, good, sizeof(goodBank));
+	block.deadbandAbsCounts = 1;
+	Check(Config_Block_Save(&block, &device) && (block.generation == newest) && Load_Is(newest, 1) && (memcmp(goodBank, good, sizeof(goodBank)) == 0),
+			"the next save replaces the corrupted bank, the good one is kept");
+
+	printf("%d failures\n", failures);
+	return (failures == 0) ? 0 : 1;
+}
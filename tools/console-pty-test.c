@@ -0,0 +1,383 @@
+/**
+ * @file console-pty-test.c
+ * @brief Host test of the UART command console over a pseudo-terminal.
+ * @author Kent Hong
+ *
+ * Runs Command-Console.c, Telemetry-TX.c and LTR-329.c unchanged on Linux. The
+ * MCU end of USART2 is the slave side of a pseudo-terminal: bytes read from it
+ * are copied into the console buffer the way circular RX DMA does, with the
+ * half transfer, transfer complete and idle-line events, and replies queued
+ * on the telemetry transmitter are written back to it. The ground end is the
+ * master side, it sends command lines and reads the replies. The sensor is
+ * the register emulator of ltr-329-emu.c.
+ *
+ * Checks:
+ *   commands    get/set round trips, replies and sensor registers agree
+ *   stream      several laps of the DMA buffer in random chunk sizes, every
+ *               line answered once, lines split across the wrap included
+ *   overlong    a line over COMMAND_CONSOLE_LINE_MAX is dropped and counted
+ *   overrun     the DMA laps the parser, the broken line is dropped
+ *   uart error  an error mid-line restarts DMA at the buffer start, the rest
+ *               of the old lap (earlier "set gain" lines) is never run again
+ *   tx abort    a TX DMA error loses that reply, later replies still go out
+ *   pass        "set pass" is refused until a ring is attached, then forces
+ *               and releases its drain
+ *
+ * Build: cc -O2 -Ihost-hal -I.. -o console-pty-test console-pty-test.c ltr-329-emu.c ../Command-Console.c
+ *            ../LTR-329.c ../Telemetry-TX.c ../Error-Log.c ../Lux-Format.c ../Report-Deadband.c ../Config-Block.c ../CCSDS-Packet.c ../Sample-Ring.c
+ * Usage: console-pty-test [-s seed]
+ */
+
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "Command-Console.h"
+#include "ltr-329-emu.h"
+
+#define REPLY_MAX 64      // Reply lines kept per check
+#define EXCHANGE_CHUNK 24 // Bytes sent between main loop passes, well inside half the DMA buffer
+
+/** @brief MCU side of the UART */
+typedef struct {
+	int fd;                  // Slave side of the pseudo-terminal
+	uint8_t *dmaBuffer;      // Circular RX DMA target, NULL while reception is stopped
+	uint16_t dmaSize;
+	uint16_t dmaPos;         // Next byte written by the emulated DMA
+	uint8_t txPending;       // TX complete interrupt still to be raised
+	uint8_t txAbort;         // 1 to fail the next transfer with a DMA error
+} Uart_Emu_t;
+
+static Uart_Emu_t uart;
+static int groundFd;         // Master side of the pseudo-terminal
+static UART_HandleTypeDef huart2;
+static I2C_HandleTypeDef hi2c1;
+static LTR329_t ltr329;
+static Telemetry_TX_t telemetryTx;
+static Report_Deadband_t reportDeadband;
+static Command_Console_t console;
+static Sample_Ring_t sampleRing;
+static char replies[REPLY_MAX][COMMAND_CONSOLE_REPLY_MAX];
+static int replyCount;
+static char replyLine[COMMAND_CONSOLE_REPLY_MAX];
+static int replyLength;
+static double processNsMax;
+static int failures;
+
+HAL_StatusTypeDef HAL_UARTEx_ReceiveToIdle_DMA(UART_HandleTypeDef *huart, uint8_t *data, uint16_t size) {
+	(void)huart;
+	uart.dmaBuffer = data;
+	uart.dmaSize = size;
+	uart.dmaPos = 0;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, const uint8_t *data, uint16_t size) {
+	(void)huart;
+	if (uart.txAbort) {
+		/* DMA error, HAL aborts the transfer and calls the error callback */
+		uart.txAbort = 0;
+		return HAL_OK;
+	}
+	while (size > 0) {
+		ssize_t n = write(uart.fd, data, size);
+		if (n < 0) {
+			return HAL_ERROR;
+		}
+		data += n;
+		size -= (uint16_t)n;
+	}
+	uart.txPending = 1;
+	return HAL_OK;
+}
+
+static double Now_Ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/** @brief Move the bytes waiting on the pseudo-terminal into the DMA buffer, raising the RX events */
+static void Uart_Receive(void) {
+	uint8_t chunk[256];
+	ssize_t n;
+	usleep(1000); // Let the pseudo-terminal pass the bytes on
+	while ((n = read(uart.fd, chunk, sizeof(chunk))) > 0) {
+		for (ssize_t i = 0; (i < n) && (uart.dmaBuffer != NULL); i++) {
+			uart.dmaBuffer[uart.dmaPos++] = chunk[i];
+			if (uart.dmaPos == uart.dmaSize / 2U) {
+				Command_Console_RX_Event_Callback(&console, uart.dmaPos);
+			}
+			else if (uart.dmaPos == uart.dmaSize) {
+				Command_Console_RX_Event_Callback(&console, uart.dmaPos);
+				uart.dmaPos = 0;
+			}
+		}
+	}
+	/* Idle line after the burst */
+	Command_Console_RX_Event_Callback(&console, uart.dmaPos);
+}
+
+/** @brief Framing or noise error, HAL stops reception and calls the error callback */
+static void Uart_Error(void) {
+	uart.dmaBuffer = NULL;
+	Command_Console_Error_Callback(&console);
+}
+
+/** @brief One main loop pass: parse, then finish the TX transfers */
+static void Mcu_Loop(void) {
+	double t0 = Now_Ns();
+	Command_Console_Process(&console);
+	double elapsed = Now_Ns() - t0;
+	processNsMax = (elapsed > processNsMax) ? elapsed : processNsMax;
+	while (uart.txPending) {
+		uart.txPending = 0;
+		Telemetry_TX_Complete_Callback(&telemetryTx);
+	}
+}
+
+/** @brief Collect complete reply lines from the ground side */
+static void Ground_Read(void) {
+	char chunk[256];
+	ssize_t n;
+	usleep(1000);
+	while ((n = read(groundFd, chunk, sizeof(chunk))) > 0) {
+		for (ssize_t i = 0; i < n; i++) {
+			if (chunk[i] == '\n') {
+				replyLine[(replyLength > 0) && (replyLine[replyLength - 1] == '\r') ? replyLength - 1 : replyLength] = '\0';
+				if (replyCount < REPLY_MAX) {
+					strcpy(replies[replyCount], replyLine);
+				}
+				replyCount++;
+				replyLength = 0;
+			}
+			else if (replyLength < COMMAND_CONSOLE_REPLY_MAX - 1) {
+				replyLine[replyLength++] = chunk[i];
+			}
+		}
+	}
+}
+
+static void Ground_Send(const char *text, size_t length) {
+	while (length > 0) {
+		ssize_t n = write(groundFd, text, length);
+		if (n < 0) {
+			if (errno == EAGAIN) {
+				continue;
+			}
+			perror("write");
+			exit(1);
+		}
+		text += n;
+		length -= (size_t)n;
+	}
+}
+
+/** @brief Send text a line's worth at a time, let the MCU receive and process it until nothing is left */
+static void Exchange(const char *text) {
+	size_t length = strlen(text);
+	replyCount = 0;
+	for (size_t sent = 0; sent < length; sent += EXCHANGE_CHUNK) {
+		Ground_Send(&text[sent], (length - sent < EXCHANGE_CHUNK) ? length - sent : EXCHANGE_CHUNK);
+		Uart_Receive();
+		Mcu_Loop();
+	}
+	for (int i = 0; i < 8; i++) {
+		Mcu_Loop();
+	}
+	Ground_Read();
+}
+
+static void Check(int ok, const char *what) {
+	printf("%-4s %s\n", ok ? "ok" : "FAIL", what);
+	failures += !ok;
+}
+
+static uint8_t Gain(void) {
+	uint8_t gain;
+	uint16_t intTimeMs, measRateMs;
+	LTR_329_Get_Config(&ltr329, &gain, &intTimeMs, &measRateMs);
+	return gain;
+}
+
+static void Check_Commands(void) {
+	Exchange("get config\r\n");
+	Check((replyCount == 1) && (strcmp(replies[0], "OK part=LTR-329 gain=1 int=100 rate=500") == 0), "get config");
+
+	Exchange("set gain 8\n");
+	Check((replyCount == 1) && (strstr(replies[0], "gain=8") != NULL) && (((ltr329Emu.regs[LTR_329_ALS_CONTR] >> 2) & 0x07) == 3),
+			"set gain reaches ALS_CONTR");
+
+	Exchange("SET INT 200\n");
+	Check((replyCount == 1) && (strstr(replies[0], "int=200 rate=500") != NULL) && (ltr329Emu.regs[LTR_329_ALS_MEAS_RATE] == 0x13),
+			"set int reaches ALS_MEAS_RATE");
+
+	Exchange("set rate 100\nset gain 3\nset deadband 12 50\nfrobnicate\n");
+	Check((replyCount == 4) && (strncmp(replies[0], "ERR status=", 11) == 0) && (strncmp(replies[1], "ERR status=", 11) == 0)
+			&& (strcmp(replies[2], "OK abs=12 rel=50 heartbeat=0 reported=0 suppressed=0") == 0) && (strcmp(replies[3], "ERR syntax") == 0),
+			"rejected values and unknown commands");
+}
+
+static void Check_Stream(unsigned seed) {
+	static char text[8192];
+	size_t length = 0;
+	int lines = 0;
+	srand(seed);
+	while (length < sizeof(text) - 64) {
+		length += (size_t)sprintf(&text[length], (lines % 3 == 0) ? "get report\r\n" : (lines % 3 == 1) ? "set heartbeat %d\n" : "get config\n", lines);
+		lines++;
+	}
+
+	uint16_t commands = console.commands;
+	int answered = 0;
+	for (size_t sent = 0; sent < length; ) {
+		size_t chunk = 1 + (size_t)(rand() % 40);
+		chunk = (chunk > length - sent) ? length - sent : chunk;
+		replyCount = 0;
+		Ground_Send(&text[sent], chunk);
+		sent += chunk;
+		Uart_Receive();
+		Mcu_Loop();
+		Ground_Read();
+		answered += replyCount;
+	}
+	for (int i = 0; i < 8; i++) {
+		replyCount = 0;
+		Mcu_Loop();
+		Ground_Read();
+		answered += replyCount;
+	}
+	printf("     %d lines, %zu bytes, %.1f laps of the %d-byte DMA buffer\n", lines, length, (double)length / COMMAND_CONSOLE_RX_SIZE, COMMAND_CONSOLE_RX_SIZE);
+	Check((answered == lines) && ((uint16_t)(console.commands - commands) == lines) && (console.overruns == 0), "stream: every line answered once");
+}
+
+static void Check_Overlong(void) {
+	uint16_t bad = console.badCommands;
+	Exchange("get config xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx\nget config\n");
+	Check((replyCount == 1) && (strncmp(replies[0], "OK part=", 8) == 0) && (console.badCommands == bad + 1), "overlong line dropped and counted");
+}
+
+static void Check_Overrun(void) {
+	static char text[COMMAND_CONSOLE_RX_SIZE + 64];
+	memset(text, 'x', sizeof(text));
+	Ground_Send(text, sizeof(text));
+	Uart_Receive();
+	Mcu_Loop();
+	/* The parser cannot tell where the lapped line ended, the next newline resynchronises it */
+	Exchange("\nget config\n");
+	Check((console.overruns == 1) && (replyCount == 1) && (strncmp(replies[0], "OK part=", 8) == 0), "overrun dropped, next line runs");
+}
+
+static void Check_Uart_Error(void) {
+	char text[COMMAND_CONSOLE_RX_SIZE * 2];
+	size_t length = 0;
+
+	/* Fill a whole lap with "set gain 48", then go back to gain 2 */
+	while (length < COMMAND_CONSOLE_RX_SIZE + 16) {
+		length += (size_t)sprintf(&text[length], "set gain 48\n");
+	}
+	text[length] = '\0';
+	Exchange(text);
+	Exchange("set gain 2\n");
+	uint16_t commands = console.commands;
+	uint16_t overruns = console.overruns;
+
+	/* Error in the middle of a line, the old lap behind the DMA position still holds "set gain 48" */
+	Ground_Send("set ga", 6);
+	Uart_Receive();
+	Mcu_Loop();
+	Uart_Error();
+	Exchange("in 4\nget config\n");
+
+	Check((Gain() == 2) && (((ltr329Emu.regs[LTR_329_ALS_CONTR] >> 2) & 0x07) == 1), "uart error: stale lap never executed");
+	Check((replyCount == 1) && (strstr(replies[0], "gain=2") != NULL) && (console.commands == commands + 1), "uart error: broken line dropped, next line runs");
+	Check(console.overruns == overruns + 1, "uart error counted");
+}
+
+static void Check_Tx_Abort(void) {
+	uart.txAbort = 1;
+	Exchange("get counters\n");
+	Telemetry_TX_Error_Callback(&telemetryTx);
+	int lost = (replyCount == 0);
+	Exchange("get config\n");
+	Check(lost && (replyCount == 1) && (strncmp(replies[0], "OK part=", 8) == 0) && (telemetryTx.dmaErrors == 1), "tx abort: telemetry resumes");
+}
+
+static void Check_Pass(void) {
+	Exchange("set pass 1\nget ring\n");
+	Check((replyCount == 2) && (strncmp(replies[0], "ERR status=", 11) == 0) && (strncmp(replies[1], "ERR status=", 11) == 0), "pass: refused without a ring");
+
+	CCSDS_Sample_t sample = { 0 };
+	Sample_Ring_Init(&sampleRing, SAMPLE_RING_OVERWRITE, 768, 0);
+	for (uint16_t i = 0; i < 10; i++) {
+		Sample_Ring_Push(&sampleRing, &sample);
+	}
+	Command_Console_Attach_Ring(&console, &sampleRing);
+	Exchange("set pass 1\n");
+	Check((replyCount == 1) && (strcmp(replies[0], "OK pass=1 held=10 peak=10 dropped=0") == 0) && Sample_Ring_Drain_Due(&sampleRing),
+			"pass: set pass 1 forces the drain");
+	Exchange("set pass 2\nset pass 0\n");
+	Check((replyCount == 2) && (strncmp(replies[0], "ERR status=", 11) == 0) && (strcmp(replies[1], "OK pass=0 held=10 peak=10 dropped=0") == 0)
+			&& !Sample_Ring_Drain_Due(&sampleRing), "pass: set pass 0 returns to bursts");
+}
+
+int main(int argc, char **argv) {
+
+	unsigned seed = 1;
+	int opt;
+	while ((opt = getopt(argc, argv, "s:")) != -1) {
+		if (opt == 's') {
+			seed = (unsigned)strtoul(optarg, NULL, 0);
+		}
+		else {
+			fprintf(stderr, "usage: %s [-s seed]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	/* Raw pseudo-terminal, bytes pass unchanged in both directions */
+	groundFd = posix_openpt(O_RDWR | O_NOCTTY);
+	if ((groundFd < 0) || (grantpt(groundFd) != 0) || (unlockpt(groundFd) != 0)) {
+		perror("posix_openpt");
+		return 1;
+	}
+	uart.fd = open(ptsname(groundFd), O_RDWR | O_NOCTTY);
+	struct termios tio;
+	if ((uart.fd < 0) || (tcgetattr(uart.fd, &tio) != 0)) {
+		perror(ptsname(groundFd));
+		return 1;
+	}
+	cfmakeraw(&tio);
+	tcsetattr(uart.fd, TCSANOW, &tio);
+	fcntl(uart.fd, F_SETFL, O_NONBLOCK);
+	fcntl(groundFd, F_SETFL, O_NONBLOCK);
+	printf("console on %s\n", ptsname(groundFd));
+
+	LTR_329_Emu_Init(1000.0, 0);
+	if (LTR_329_Init(&hi2c1, &ltr329) != HAL_OK) {
+		fprintf(stderr, "sensor init failed\n");
+		return 1;
+	}
+	Telemetry_TX_Init(&telemetryTx, &huart2);
+	Report_Deadband_Init(&reportDeadband, 0, 0, 0);
+	Command_Console_Init(&console, &huart2, &hi2c1, &ltr329, &telemetryTx, &reportDeadband);
+
+	Check_Commands();
+	Check_Stream(seed);
+	Check_Overlong();
+	Check_Overrun();
+	Check_Uart_Error();
+	Check_Tx_Abort();
+	Check_Pass();
+
+	printf("longest Command_Console_Process() call %.1f us, at most %d lines per call\n", processNsMax / 1e3, COMMAND_CONSOLE_LINES_PER_CALL);
+	printf("%d failures\n", failures);
+	return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,189 @@
+/**
+ * @file downlink-scheduler-sim.c
+ * @brief Host simulation of the downlink scheduler over one day of samples.
+ * @author Kent Hong
+ *
+ * Feeds one synthetic day of 600 ms samples (144000) to Downlink_Scheduler_Add()
+ * and builds a frame every 6 s with Downlink_Scheduler_Build_Frame() under a
+ * byte budget. About one sample in 500 carries a quality flag and one in 3000
+ * a configuration change event, both drawn from the seed. Every frame is then
+ * parsed back with CCSDS_Parse_Packet() and CCSDS_Get_Timed_Sample() as the
+ * ground does, and the tool prints per class how many samples were queued,
+ * delivered and dropped, the largest gap between delivered samples, and the
+ * host cost of one add and one frame (best of several rounds).
+ *
+ * Every event and quality sample must reach the ground.
+ *
+ * Build: cc -O2 -I.. -o downlink-scheduler-sim downlink-scheduler-sim.c ../Downlink-Scheduler.c ../CCSDS-Packet.c
+ * Usage: downlink-scheduler-sim [-b budget_bytes] [-s seed] [-r rounds]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "Downlink-Scheduler.h"
+#include "LTR-329-Flags.h"
+
+#define PERIOD_MS 600
+#define FRAME_PERIOD_MS 6000
+#define SAMPLES (86400000U / PERIOD_MS) // One day
+#define QUALITY_ONE_IN 500
+#define EVENT_ONE_IN 3000
+
+static Downlink_Scheduler_t sched;
+static CCSDS_Sample_t samples[SAMPLES];
+static uint8_t classes[SAMPLES];
+static uint8_t delivered[SAMPLES];
+static uint8_t frames[SAMPLES / (FRAME_PERIOD_MS / PERIOD_MS) + DOWNLINK_SCHEDULER_SIZE][DOWNLINK_FRAME_MAX];
+static uint16_t frameLengths[sizeof(frames) / sizeof(frames[0])];
+
+static double Now_Ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void Make_Samples(unsigned seed) {
+	uint8_t configCode = 0x00;
+	srand(seed);
+	for (uint32_t i = 0; i < SAMPLES; i++) {
+		classes[i] = DOWNLINK_CLASS_ROUTINE;
+		samples[i].flags = 0;
+		if ((rand() % QUALITY_ONE_IN) == 0) {
+			samples[i].flags = LTR_329_FLAG_SATURATED;
+			classes[i] = DOWNLINK_CLASS_QUALITY;
+		}
+		if ((rand() % EVENT_ONE_IN) == 0) {
+			configCode ^= 0x01;
+			classes[i] = DOWNLINK_CLASS_EVENT;
+		}
+		samples[i].tick = i * PERIOD_MS;
+		samples[i].c0Data = (uint16_t)(1000U + i % 300U);
+		samples[i].c1Data = (uint16_t)(500U + i % 200U);
+		samples[i].configCode = configCode;
+	}
+}
+
+/** @brief One day through the scheduler, returns the frames built, times go to *totalNs and *frameNs
+ *         The samples still held at the end go out in extra frames after the day, untimed */
+static uint32_t Run(uint16_t budget, double *totalNs, double *frameNs) {
+	uint32_t frameCount = 0;
+	uint32_t frameTick = FRAME_PERIOD_MS;
+	*frameNs = 0.0;
+	Downlink_Scheduler_Init(&sched, CCSDS_APID_LTR_329_TIMED);
+	double t0 = Now_Ns();
+	for (uint32_t i = 0; i < SAMPLES; i++) {
+		Downlink_Scheduler_Add(&sched, &samples[i], (Downlink_Class_t)classes[i]);
+		if ((int32_t)(samples[i].tick - frameTick) >= 0) {
+			frameTick += FRAME_PERIOD_MS;
+			double f0 = Now_Ns();
+			frameLengths[frameCount] = Downlink_Scheduler_Build_Frame(&sched, samples[i].tick, budget, frames[frameCount]);
+			*frameNs += Now_Ns() - f0;
+			frameCount++;
+		}
+	}
+	*totalNs = Now_Ns() - t0;
+	while ((sched.held != 0) && (frameCount < sizeof(frames) / sizeof(frames[0]))) {
+		frameLengths[frameCount] = Downlink_Scheduler_Build_Frame(&sched, frameTick, budget, frames[frameCount]);
+		frameTick += FRAME_PERIOD_MS;
+		frameCount++;
+	}
+	return frameCount;
+}
+
+int main(int argc, char **argv) {
+
+	long budget = 110, seed = 1, rounds = 5;
+	int opt;
+	while ((opt = getopt(argc, argv, "b:s:r:")) != -1) {
+		if (opt == 'b') {
+			budget = strtol(optarg, NULL, 0);
+		}
+		else if (opt == 's') {
+			seed = strtol(optarg, NULL, 0);
+		}
+		else if (opt == 'r') {
+			rounds = strtol(optarg, NULL, 0);
+		}
+		else {
+			fprintf(stderr, "usage: %s [-b budget_bytes] [-s seed] [-r rounds]\n", argv[0]);
+			return 2;
+		}
+	}
+	if ((budget < 1) || (budget > DOWNLINK_FRAME_MAX) || (rounds < 1)) {
+		fprintf(stderr, "budget 1..%d bytes, at least 1 round\n", DOWNLINK_FRAME_MAX);
+		return 2;
+	}
+
+	Make_Samples((unsigned)seed);
+
+	/* Best of the rounds, every round is the same day */
+	uint32_t frameCount = 0, dayFrames = SAMPLES / (FRAME_PERIOD_MS / PERIOD_MS);
+	double addNs = 1e30, frameNs = 1e30;
+	for (long r = 0; r < rounds; r++) {
+		double totalNs, buildNs;
+		frameCount = Run((uint16_t)budget, &totalNs, &buildNs);
+		addNs = ((totalNs - buildNs) < addNs) ? totalNs - buildNs : addNs;
+		frameNs = (buildNs < frameNs) ? buildNs : frameNs;
+	}
+
+	/* Decode the frames as the ground does */
+	uint32_t received[DOWNLINK_CLASS_COUNT] = { 0 };
+	uint32_t badFrames = 0;
+	size_t bytes = 0;
+	for (uint32_t f = 0; f < frameCount; f++) {
+		if (frameLengths[f] == 0) {
+			continue;
+		}
+		CCSDS_Header_t header;
+		bytes += frameLengths[f];
+		if ((CCSDS_Parse_Packet(frames[f], frameLengths[f], &header) != frameLengths[f]) || (header.dataLength % CCSDS_TIMED_SAMPLE_SIZE != 0)) {
+			badFrames++;
+			continue;
+		}
+		for (uint16_t i = 0; i < header.dataLength; i += CCSDS_TIMED_SAMPLE_SIZE) {
+			CCSDS_Sample_t sample;
+			CCSDS_Get_Timed_Sample(&header.data[i], &sample);
+			uint32_t n = sample.tick / PERIOD_MS;
+			const CCSDS_Sample_t *in = &samples[(n < SAMPLES) ? n : 0];
+			if ((n >= SAMPLES) || delivered[n] || (sample.tick != in->tick) || (sample.c0Data != in->c0Data) || (sample.c1Data != in->c1Data)
+					|| (sample.configCode != in->configCode) || (sample.flags != in->flags)) {
+				badFrames++;
+				break;
+			}
+			delivered[n] = 1;
+			received[classes[n]]++;
+		}
+	}
+
+	/* Largest gap in the delivered series */
+	uint32_t gapMs = 0, last = 0;
+	for (uint32_t n = 1; n < SAMPLES; n++) {
+		if (delivered[n]) {
+			gapMs = ((n - last) * PERIOD_MS > gapMs) ? (n - last) * PERIOD_MS : gapMs;
+			last = n;
+		}
+	}
+
+	static const char *const names[DOWNLINK_CLASS_COUNT] = { "event", "quality", "routine" };
+	long records = (budget - (CCSDS_PRIMARY_HEADER_SIZE + CCSDS_SECONDARY_HEADER_SIZE + CCSDS_CRC_SIZE)) / CCSDS_TIMED_SAMPLE_SIZE;
+	printf("%u samples, %u frames + %u after the day, budget %ld bytes (%ld records), %zu bytes sent (%.1f B/s)\n", SAMPLES, dayFrames,
+			frameCount - dayFrames, budget, (records > 0) ? records : 0, bytes, (double)bytes / 86400.0);
+	printf("class      queued   received    dropped\n");
+	for (uint8_t c = 0; c < DOWNLINK_CLASS_COUNT; c++) {
+		printf("%-8s %8u   %8u   %8u\n", names[c], sched.queued[c], received[c], sched.dropped[c]);
+	}
+	printf("%u bad frames, largest gap %u ms (%.1f%% of routine samples dropped)\n", badFrames, gapMs,
+			100.0 * sched.dropped[DOWNLINK_CLASS_ROUTINE] / sched.queued[DOWNLINK_CLASS_ROUTINE]);
+	printf("add %.1f ns, frame %.2f us\n", addNs / SAMPLES, frameNs / dayFrames / 1000.0);
+
+	uint8_t ok = (badFrames == 0) && (sched.held == 0)
+			&& (received[DOWNLINK_CLASS_EVENT] == sched.queued[DOWNLINK_CLASS_EVENT])
+			&& (received[DOWNLINK_CLASS_QUALITY] == sched.queued[DOWNLINK_CLASS_QUALITY]);
+	printf("%s: every event and quality sample delivered\n", ok ? "ok" : "FAIL");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,282 @@
+/**
+ * @file flash-log-sim.c
+ * @brief File-backed flash emulator and power-loss test for the flash sample log.
+ * @author Kent Hong
+ *
+ * Runs Flash-Log.c on Linux against an image file that behaves like STM32L4 flash:
+ * erase sets a page to 0xFF, programming is by aligned double words and a double
+ * word may only be programmed once between erases (programming it twice is
+ * reported as a log bug, as PROGERR would be on the part).
+ *
+ * Modes:
+ *   wear       Log -n samples, flushing every -F samples (0: full pages only), and
+ *              report write amplification, erase counts per page and mount cost.
+ *   powerloss  Repeat -t trials: log samples until power is cut at a random flash
+ *              operation (the double word or page in progress is left half
+ *              written), remount from the image, check that every flushed sample
+ *              survived, nothing corrupt is read back and logging continues.
+ *
+ * Checks to run after changing Flash-Log.c, all must report 0 failures. The
+ * small logs are the hard case, there the next flush erases the page before
+ * the head:
+ *   flash-log-sim -p 64 -t 1000 powerloss
+ *   flash-log-sim -p 3 -t 1000 powerloss
+ *   flash-log-sim -p 2 -t 2000 powerloss
+ *   flash-log-sim -p 2 -t 1000 -F 5 powerloss
+ *
+ * Build: cc -O2 -I.. -o flash-log-sim flash-log-sim.c ../Flash-Log.c ../CCSDS-Packet.c
+ * Usage: flash-log-sim [-i image] [-p pages] [-n samples] [-F flush] [-t trials] [-s seed] wear|powerloss
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "Flash-Log.h"
+
+/** @brief Emulated flash */
+typedef struct {
+	uint8_t *image;          // Mapped image file
+	uint16_t pageCount;
+	uint32_t *eraseCounts;   // Erases per page
+	unsigned long long programmed; // Bytes programmed
+	unsigned long reads;     // Read calls
+	long powerBudget;        // Flash operations left before the cut, -1 for none
+	int doubleProgram;       // Set if a double word was programmed twice
+	jmp_buf powerLoss;       // Where the cut returns to
+} Emulator_t;
+
+static Emulator_t emu;
+
+/** @brief Count one flash operation, returns 1 if power is cut during it */
+static int Power_Cut(void) {
+	if (emu.powerBudget < 0) {
+		return 0;
+	}
+	return (emu.powerBudget-- == 0);
+}
+
+static uint8_t Emu_Erase(void *ctx, uint16_t page) {
+	uint8_t *p = &emu.image[(size_t)page * FLASH_LOG_PAGE_SIZE];
+	(void)ctx;
+	if (Power_Cut()) {
+		/* Interrupted erase, bits are partly set */
+		for (uint32_t i = 0; i < FLASH_LOG_PAGE_SIZE; i++) {
+			p[i] |= (uint8_t)rand();
+		}
+		longjmp(emu.powerLoss, 1);
+	}
+	memset(p, 0xFF, FLASH_LOG_PAGE_SIZE);
+	emu.eraseCounts[page]++;
+	return 1;
+}
+
+static uint8_t Emu_Program(void *ctx, uint32_t offset, const uint8_t *data, uint16_t length) {
+	(void)ctx;
+	if ((offset % FLASH_LOG_PROGRAM_SIZE) || (length % FLASH_LOG_PROGRAM_SIZE)) {
+		fprintf(stderr, "unaligned program at %u length %u\n", offset, length);
+		exit(2);
+	}
+	for (uint32_t i = 0; i < length; i += FLASH_LOG_PROGRAM_SIZE) {
+		uint8_t *dw = &emu.image[offset + i];
+		for (uint32_t b = 0; b < FLASH_LOG_PROGRAM_SIZE; b++) {
+			if (dw[b] != 0xFF) {
+				emu.doubleProgram = 1;
+			}
+		}
+		if (Power_Cut()) {
+			/* Interrupted program, bits are partly cleared */
+			for (uint32_t b = 0; b < FLASH_LOG_PROGRAM_SIZE; b++) {
+				dw[b] &= (uint8_t)(data[i + b] | rand());
+			}
+			longjmp(emu.powerLoss, 1);
+		}
+		for (uint32_t b = 0; b < FLASH_LOG_PROGRAM_SIZE; b++) {
+			dw[b] &= data[i + b];
+		}
+		emu.programmed += FLASH_LOG_PROGRAM_SIZE;
+	}
+	return 1;
+}
+
+static uint8_t Emu_Read(void *ctx, uint32_t offset, uint8_t *data, uint16_t length) {
+	(void)ctx;
+	memcpy(data, &emu.image[offset], length);
+	emu.reads++;
+	return 1;
+}
+
+static Flash_Log_Device_t device = { Emu_Erase, Emu_Program, Emu_Read, NULL, 0 };
+static Flash_Log_t flashLog;
+
+static void Make_Sample(uint32_t n, CCSDS_Sample_t *sample) {
+	sample->tick = n;
+	sample->c0Data = (uint16_t)(n * 7);
+	sample->c1Data = (uint16_t)(n * 3);
+	sample->configCode = 0x10;
+	sample->flags = 0;
+}
+
+/** @brief Read the whole log back, returns 0 and prints why if it is inconsistent */
+static int Verify(uint32_t appended, uint32_t durable, const char *when) {
+	Flash_Log_Reader_t reader;
+	CCSDS_Sample_t sample, expect;
+	long long last = -1;
+	int sawDurable = (durable == 0);
+
+	Flash_Log_Reader_Init(&flashLog, &reader);
+	while (Flash_Log_Reader_Next(&flashLog, &reader, &sample)) {
+		Make_Sample(sample.tick, &expect);
+		if ((sample.tick >= appended) || ((long long)sample.tick <= last) || (sample.c0Data != expect.c0Data)
+				|| (sample.c1Data != expect.c1Data) || (sample.configCode != expect.configCode) || (sample.flags != expect.flags)) {
+			fprintf(stderr, "%s: bad record tick %u after %lld\n", when, sample.tick, last);
+			return 0;
+		}
+		last = sample.tick;
+		sawDurable |= (sample.tick == durable - 1);
+	}
+	if (!sawDurable) {
+		fprintf(stderr, "%s: last flushed sample %u missing\n", when, durable - 1);
+		return 0;
+	}
+	if ((last >= 0) != (flashLog.hasLatest != 0) || ((last >= 0) && (flashLog.latest.tick != (uint32_t)last))) {
+		fprintf(stderr, "%s: latest %u does not match the last record %lld\n", when, flashLog.latest.tick, last);
+		return 0;
+	}
+	return 1;
+}
+
+static void Usage(const char *name) {
+	fprintf(stderr, "usage: %s [-i image] [-p pages] [-n samples] [-F flush] [-t trials] [-s seed] wear|powerloss\n", name);
+	exit(2);
+}
+
+int main(int argc, char **argv) {
+
+	/* Static, the power-loss longjmp() would clobber automatic variables */
+	static const char *imagePath = "flash-log.img";
+	static long pages = 64;
+	static long samples = 100000;
+	static long flushEvery = 0;
+	static long trials = 1000;
+	static unsigned seed = 1;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "i:p:n:F:t:s:")) != -1) {
+		switch (opt) {
+			case 'i': imagePath = optarg; break;
+			case 'p': pages = strtol(optarg, NULL, 0); break;
+			case 'n': samples = strtol(optarg, NULL, 0); break;
+			case 'F': flushEvery = strtol(optarg, NULL, 0); break;
+			case 't': trials = strtol(optarg, NULL, 0); break;
+			case 's': seed = (unsigned)strtoul(optarg, NULL, 0); break;
+			default: Usage(argv[0]);
+		}
+	}
+	if ((optind + 1 != argc) || (pages < 2) || (pages > 0xFFFF)) {
+		Usage(argv[0]);
+	}
+	srand(seed);
+
+	size_t imageSize = (size_t)pages * FLASH_LOG_PAGE_SIZE;
+	int fd = open(imagePath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if ((fd < 0) || (ftruncate(fd, (off_t)imageSize) != 0)) {
+		perror(imagePath);
+		return 1;
+	}
+	emu.image = mmap(NULL, imageSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (emu.image == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+	emu.pageCount = (uint16_t)pages;
+	emu.eraseCounts = calloc((size_t)pages, sizeof(*emu.eraseCounts));
+	device.pageCount = (uint16_t)pages;
+	memset(emu.image, 0xFF, imageSize);
+	emu.powerBudget = -1;
+
+	if (strcmp(argv[optind], "wear") == 0) {
+		CCSDS_Sample_t sample;
+		Flash_Log_Mount(&flashLog, &device);
+		for (long n = 0; n < samples; n++) {
+			Make_Sample((uint32_t)n, &sample);
+			Flash_Log_Append(&flashLog, &sample);
+			if ((flushEvery > 0) && ((n + 1) % flushEvery == 0)) {
+				Flash_Log_Flush(&flashLog);
+			}
+		}
+		Flash_Log_Flush(&flashLog);
+
+		uint32_t minErase = UINT32_MAX, maxErase = 0;
+		for (long p = 0; p < pages; p++) {
+			minErase = (emu.eraseCounts[p] < minErase) ? emu.eraseCounts[p] : minErase;
+			maxErase = (emu.eraseCounts[p] > maxErase) ? emu.eraseCounts[p] : maxErase;
+		}
+		printf("%ld samples, %lu pages written, %llu bytes programmed\n", samples, (unsigned long)flashLog.pagesWritten, emu.programmed);
+		printf("write amplification %.3f (programmed bytes per %d-byte sample), %.3f including the erased pages\n",
+				(double)emu.programmed / ((double)samples * CCSDS_TIMED_SAMPLE_SIZE), CCSDS_TIMED_SAMPLE_SIZE,
+				(double)flashLog.pagesWritten * FLASH_LOG_PAGE_SIZE / ((double)samples * CCSDS_TIMED_SAMPLE_SIZE));
+		printf("erases per page min %u max %u\n", minErase, maxErase);
+
+		emu.reads = 0;
+		Flash_Log_Mount(&flashLog, &device);
+		printf("mount: %lu reads for %ld pages x %d records, latest tick %u\n", emu.reads, pages, FLASH_LOG_RECORDS_PER_PAGE, flashLog.latest.tick);
+		return (Verify((uint32_t)samples, (uint32_t)samples, "wear") && !emu.doubleProgram) ? 0 : 1;
+	}
+
+	if (strcmp(argv[optind], "powerloss") == 0) {
+		static long failures = 0;
+		static unsigned long mountReadsMax = 0;
+		static long t;
+		static int cycle;
+		for (t = 0; t < trials; t++) {
+			memset(emu.image, 0xFF, imageSize);
+			emu.doubleProgram = 0;
+			static uint32_t appended, durable;
+			CCSDS_Sample_t sample;
+			appended = 0;
+			durable = 0;
+
+			/* Several power cycles per trial, each cut at a random flash operation */
+			for (cycle = 0; cycle < 4; cycle++) {
+				emu.powerBudget = -1;
+				emu.reads = 0;
+				Flash_Log_Mount(&flashLog, &device);
+				mountReadsMax = (emu.reads > mountReadsMax) ? emu.reads : mountReadsMax;
+				if (!Verify(appended, durable, "after power loss")) {
+					failures++;
+					break;
+				}
+				emu.powerBudget = rand() % (long)(pages * (FLASH_LOG_PAGE_SIZE / FLASH_LOG_PROGRAM_SIZE + 1) * 2);
+				if (setjmp(emu.powerLoss) == 0) {
+					for (;;) {
+						Make_Sample(appended++, &sample);
+						Flash_Log_Append(&flashLog, &sample);
+						if (flashLog.batched == 0) {
+							durable = appended;
+						}
+						if ((rand() % 97) == 0) {
+							Flash_Log_Flush(&flashLog);
+							durable = appended;
+						}
+					}
+				}
+			}
+			if (emu.doubleProgram) {
+				fprintf(stderr, "trial %ld: a double word was programmed twice\n", t);
+				failures++;
+			}
+		}
+		printf("%ld trials x 4 power cuts, %ld failures, mount took at most %lu reads\n", trials, failures, mountReadsMax);
+		return (failures == 0) ? 0 : 1;
+	}
+
+	Usage(argv[0]);
+	return 2;
+}
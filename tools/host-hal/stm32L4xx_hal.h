@@ -0,0 +1,53 @@
+/**
+ * @file stm32L4xx_hal.h
+ * @brief Host stand-in for the few STM32 HAL declarations the firmware modules use.
+ * @author Kent Hong
+ *
+ * Lets the host tests in tools/ compile the driver, console and telemetry
+ * sources unchanged. Only types and prototypes live here, every test defines
+ * the HAL functions it links against with the behaviour it wants to emulate.
+ *
+ * Build: add -Ihost-hal before -I.. so this header wins over the real HAL
+ */
+
+#ifndef HOST_HAL_STM32L4XX_HAL_H_
+#define HOST_HAL_STM32L4XX_HAL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+	HAL_OK = 0x00,
+	HAL_ERROR = 0x01,
+	HAL_BUSY = 0x02,
+	HAL_TIMEOUT = 0x03
+} HAL_StatusTypeDef;
+
+#define HAL_MAX_DELAY 0xFFFFFFFFU
+
+typedef struct {
+	void *Instance;
+} I2C_HandleTypeDef;
+
+#define I2C_MEMADD_SIZE_8BIT 0x00000001U
+
+typedef struct {
+	void *Instance;
+} UART_HandleTypeDef;
+
+/** @brief Interrupt masking has nothing to mask on the host */
+#define __get_PRIMASK() 0U
+#define __set_PRIMASK(primask) ((void)(primask))
+#define __disable_irq() do { } while (0)
+#define __enable_irq() do { } while (0)
+#define __WFI() do { } while (0)
+
+/** @brief HAL functions, defined by each test */
+void HAL_Delay(uint32_t delayMs);
+uint32_t HAL_GetTick(void);
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef *hi2c, uint16_t devAddress, uint16_t memAddress, uint16_t memAddSize, uint8_t *data, uint16_t size, uint32_t timeout);
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef *hi2c, uint16_t devAddress, uint16_t memAddress, uint16_t memAddSize, uint8_t *data, uint16_t size, uint32_t timeout);
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, const uint8_t *data, uint16_t size);
+HAL_StatusTypeDef HAL_UARTEx_ReceiveToIdle_DMA(UART_HandleTypeDef *huart, uint8_t *data, uint16_t size);
+
+#endif /* HOST_HAL_STM32L4XX_HAL_H_ */
@@ -0,0 +1,241 @@
+/**
+ * @file ltr-303-int-sim.c
+ * @brief Host simulation of the LTR-303 threshold interrupt mode with an emulated INT line.
+ * @author Kent Hong
+ *
+ * Runs LTR-329.c unchanged against the register emulator of ltr-329-emu.c.
+ *
+ * Part detection: LTR_329_Init() against an LTR-329 whose unimplemented
+ * addresses read 0xFF, read 0x00 or NACK, and against an LTR-303. Only the
+ * LTR-303 may be detected as one, the probed threshold must be restored and a
+ * NACKed probe must reach the error log.
+ *
+ * Interrupt mode: the main loop of main.c with LTR_303_INT_WINDOW, one pass per
+ * sample period. The emulated INT line calls LTR_303_INT_Handler() as the EXTI
+ * callback does; the loop reads the sensor after INT fired, and at least every
+ * LTR_303_INT_POLL_MS as a scrub sample, and re-centres the window on that
+ * sample. The light is steady with noise, with a step up, a ramp down,
+ * single-conversion spikes and a step back. Shortly before the step back an
+ * upset clears the Active bit of ALS_CONTR, so the sensor stops converting and
+ * INT can no longer fire: the forced read must repair it in time to see the
+ * step. The same light is also run with plain polling, and the I2C traffic of
+ * both is printed.
+ *
+ * Build: cc -O2 -Ihost-hal -I.. -o ltr-303-int-sim ltr-303-int-sim.c ltr-329-emu.c ../LTR-329.c ../Error-Log.c
+ * Usage: ltr-303-int-sim [-w window_counts] [-p persist] [-m minutes]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "LTR-329.h"
+#include "Error-Log.h"
+#include "ltr-329-emu.h"
+
+#define SAMPLE_PERIOD_MS 600 // As in main.c
+#define LTR_303_INT_POLL_MS (SAMPLE_PERIOD_MS * LTR_329_SCRUB_PERIOD)
+#define EMU_STEP_MS 50       // Light is updated this often inside a sample period
+#define STEADY_LIGHT 1000.0  // CH0 counts at gain 1, 100 ms
+#define NOISE_PERMILLE 5     // Peak noise on the steady light
+#define SPIKE_MS 500         // Spike length, one 500 ms conversion period, so exactly one conversion sees it
+
+static I2C_HandleTypeDef hi2c1;
+static LTR329_t ltr329;
+static int failures;
+
+static void INT_Falling_Edge(void) {
+	LTR_303_INT_Handler(&ltr329);
+}
+
+static void Check(int ok, const char *what) {
+	printf("%-4s %s\n", ok ? "ok" : "FAIL", what);
+	failures += !ok;
+}
+
+/** @brief Light at a time of the run: steady, step up, ramp down, spikes, step back */
+static double Light_At(uint32_t ms, uint32_t runMs) {
+	uint32_t eighth = runMs / 8U;
+	double noise = STEADY_LIGHT * (double)((rand() % (2 * NOISE_PERMILLE + 1)) - NOISE_PERMILLE) / 1000.0;
+	if ((ms >= 2 * eighth) && (ms < 3 * eighth)) {
+		return 3.0 * STEADY_LIGHT + noise; // Step up
+	}
+	if ((ms >= 3 * eighth) && (ms < 4 * eighth)) {
+		return STEADY_LIGHT * (3.0 - 2.0 * (double)(ms - 3 * eighth) / eighth) + noise; // Ramp back down
+	}
+	if ((ms >= 5 * eighth) && (ms < 6 * eighth) && ((ms % 60000U) < SPIKE_MS)) {
+		return 8.0 * STEADY_LIGHT; // Spike every minute, shorter than one conversion period
+	}
+	if (ms >= 7 * eighth) {
+		return 0.2 * STEADY_LIGHT + noise; // Step down
+	}
+	return STEADY_LIGHT + noise;
+}
+
+static const char *Detect(double unimplementedRead, uint8_t nack, uint8_t ltr303, uint8_t *restored, uint16_t *logged) {
+	uint16_t before = Error_Log_Get_Count(ERROR_I2C_WRITE) + Error_Log_Get_Count(ERROR_I2C_READ);
+	LTR_329_Emu_Init(STEADY_LIGHT, ltr303);
+	ltr329Emu.unimplementedRead = (uint8_t)unimplementedRead;
+	ltr329Emu.nackUnimplemented = nack;
+	LTR_329_Init(&hi2c1, &ltr329);
+	*restored = (ltr329Emu.regs[LTR_303_ALS_THRES_LOW_0] == 0x00);
+	*logged = (uint16_t)(Error_Log_Get_Count(ERROR_I2C_WRITE) + Error_Log_Get_Count(ERROR_I2C_READ) - before);
+	return ltr329.part->name;
+}
+
+static void Check_Detection(void) {
+	uint8_t restored;
+	uint16_t logged;
+	const char *name = Detect(0xFF, 0, 0, &restored, &logged);
+	Check((name == LTR_329_PARTS[LTR_329_PART_LTR329].name) && (logged == 0), "LTR-329 reading 0xFF at unimplemented addresses");
+	name = Detect(0x00, 0, 0, &restored, &logged);
+	Check((name == LTR_329_PARTS[LTR_329_PART_LTR329].name) && (logged == 0), "LTR-329 reading 0x00 at unimplemented addresses");
+	name = Detect(0xFF, 1, 0, &restored, &logged);
+	Check((name == LTR_329_PARTS[LTR_329_PART_LTR329].name) && (logged == 1), "LTR-329 NACKing the probe, failure logged");
+	name = Detect(0xFF, 0, 1, &restored, &logged);
+	Check((name == LTR_329_PARTS[LTR_329_PART_LTR303].name) && restored && (logged == 0), "LTR-303 detected, probed threshold restored");
+}
+
+/** @brief Centre the window on the last CH0 count, as main.c does after every read */
+static uint8_t Arm_Window(uint16_t window, uint8_t persist) {
+	uint16_t c0 = ltr329.c0Data;
+	return (LTR_303_Set_Window(&hi2c1, &ltr329, (c0 > window) ? c0 - window : 0, (c0 < UINT16_MAX - window) ? c0 + window : UINT16_MAX, persist) == HAL_OK)
+			&& (LTR_303_Enable_Interrupt(&hi2c1, &ltr329, 1) == HAL_OK);
+}
+
+/** @brief Counts of one simulated run */
+typedef struct {
+	uint32_t samples;         // Samples read
+	uint32_t transfers;       // I2C byte transfers
+	uint32_t steadyTransfers; // I2C byte transfers in steady light before the first step
+	uint32_t stepLatencyMs;   // Time from the step up to the first sample read above it
+	uint32_t spikeInterrupts; // INT assertions during the spikes
+	uint32_t readGapMs;       // Longest time between two samples read
+	uint8_t stepDownSeen;     // 1 if a sample after the step back was read
+} Run_Counts_t;
+
+/** @brief The main loop for runMs, ALS_CONTR upset upsetMs into the run */
+static void Run(uint8_t interruptMode, uint16_t window, uint8_t persist, uint32_t runMs, uint32_t upsetMs, Run_Counts_t *counts) {
+
+	srand(1);
+	LTR_329_Emu_Init(Light_At(0, runMs), 1);
+	ltr329Emu.intHandler = INT_Falling_Edge;
+	LTR_329_Init(&hi2c1, &ltr329);
+	uint32_t startMs = ltr329Emu.nowMs;
+	uint32_t startTransfers = ltr329Emu.reads + ltr329Emu.writes;
+	uint32_t readMs = 0;
+	uint8_t armed = 0;
+	memset(counts, 0, sizeof(*counts));
+
+	for (uint32_t t = 0; t < runMs; t += SAMPLE_PERIOD_MS) {
+		uint32_t before = ltr329Emu.reads + ltr329Emu.writes;
+
+		/* As main.c, without the deadband heartbeat, which is longer than LTR_303_INT_POLL_MS by default */
+		uint8_t sampleRead = 1;
+		if (armed && (t - readMs < LTR_303_INT_POLL_MS)) {
+			sampleRead = LTR_303_Service_Interrupt(&hi2c1, &ltr329);
+		}
+		else {
+			if (armed && (ltr329.scrubPeriod != 0)) {
+				ltr329.scrubCount = ltr329.scrubPeriod - 1;
+			}
+			LTR_329_Read_All(&hi2c1, &ltr329);
+		}
+		if (sampleRead && interruptMode) {
+			armed = Arm_Window(window, persist);
+		}
+		if (sampleRead) {
+			counts->readGapMs = (t - readMs > counts->readGapMs) ? t - readMs : counts->readGapMs;
+			readMs = t;
+		}
+		counts->samples += sampleRead;
+
+		/* Steady light before the first step, after the warm-up sample */
+		if ((t > 10000) && (t < runMs / 4U)) {
+			counts->steadyTransfers += ltr329Emu.reads + ltr329Emu.writes - before;
+		}
+		/* First sample read after the step up */
+		if (sampleRead && (t >= runMs / 4U) && (counts->stepLatencyMs == 0) && (ltr329.c0Data > 2.0 * STEADY_LIGHT)) {
+			counts->stepLatencyMs = t - runMs / 4U;
+		}
+		counts->stepDownSeen |= sampleRead && (t >= 7 * (runMs / 8U)) && (ltr329.c0Data < 0.5 * STEADY_LIGHT);
+
+		/* A single-event upset puts the sensor in Standby, it stops converting */
+		if (t == upsetMs) {
+			ltr329Emu.regs[LTR_329_ALS_CONTR] &= (uint8_t)~LTR_329_ALS_CONTR_ACTIVE;
+			ltr329Emu.active = 0;
+		}
+
+		/* __WFI() until the next sample is due, the INT line may fire meanwhile */
+		uint32_t interrupts = ltr329Emu.interrupts;
+		for (uint32_t step = 0; step < SAMPLE_PERIOD_MS; step += EMU_STEP_MS) {
+			ltr329Emu.light = Light_At(ltr329Emu.nowMs - startMs, runMs);
+			LTR_329_Emu_Advance(EMU_STEP_MS);
+		}
+		if ((t >= 5 * (runMs / 8U)) && (t < 6 * (runMs / 8U))) {
+			counts->spikeInterrupts += ltr329Emu.interrupts - interrupts;
+		}
+	}
+
+	counts->transfers = ltr329Emu.reads + ltr329Emu.writes - startTransfers;
+}
+
+int main(int argc, char **argv) {
+
+	long window = 50, persist = 1, minutes = 60;
+	int opt;
+	while ((opt = getopt(argc, argv, "w:p:m:")) != -1) {
+		if (opt == 'w') {
+			window = strtol(optarg, NULL, 0);
+		}
+		else if (opt == 'p') {
+			persist = strtol(optarg, NULL, 0);
+		}
+		else if (opt == 'm') {
+			minutes = strtol(optarg, NULL, 0);
+		}
+		else {
+			fprintf(stderr, "usage: %s [-w window_counts] [-p persist] [-m minutes]\n", argv[0]);
+			return 2;
+		}
+	}
+	if ((window < 1) || (window > 30000) || (persist < 0) || (persist > 15) || (minutes < 8)) {
+		fprintf(stderr, "window 1..30000, persist 0..15, at least 8 minutes\n");
+		return 2;
+	}
+	uint32_t runMs = (uint32_t)minutes * 60000U;
+
+	Check_Detection();
+
+	/* The upset lands half way between the spikes and the step back, on a sample period */
+	uint32_t upsetMs = (13U * (runMs / 16U)) / SAMPLE_PERIOD_MS * SAMPLE_PERIOD_MS;
+	Run_Counts_t poll, intr;
+	Run(0, 0, 0, runMs, upsetMs, &poll);
+	uint16_t pollRepairs = ltr329.scrubRepairs;
+	Run(1, (uint16_t)window, (uint8_t)persist, runMs, upsetMs, &intr);
+	uint16_t intRepairs = ltr329.scrubRepairs;
+	uint32_t interrupts = ltr329Emu.interrupts;
+
+	printf("%ld min, window +-%ld counts, persist %ld, forced read every %d ms\n", minutes, window, persist, LTR_303_INT_POLL_MS);
+	printf("mode        samples read   I2C byte transfers   steady light transfers   step latency ms   longest gap ms   repairs\n");
+	printf("polling     %12u   %18u   %22u   %15u   %14u   %7u\n", poll.samples, poll.transfers, poll.steadyTransfers, poll.stepLatencyMs, poll.readGapMs,
+			pollRepairs);
+	printf("interrupt   %12u   %18u   %22u   %15u   %14u   %7u\n", intr.samples, intr.transfers, intr.steadyTransfers, intr.stepLatencyMs, intr.readGapMs,
+			intRepairs);
+	printf("%u INT assertions, %u of them during the spikes\n", interrupts, intr.spikeInterrupts);
+
+	/* INT needs persist + 1 conversions of the 500 ms default rate outside the window, read on the next loop pass */
+	uint32_t latencyMaxMs = (uint32_t)(persist + 2) * 500U + SAMPLE_PERIOD_MS;
+	Check(intr.steadyTransfers < poll.steadyTransfers / 3U, "steady light costs under a third of the polling traffic");
+	Check(intr.readGapMs <= LTR_303_INT_POLL_MS, "the sensor is read at least every LTR_303_INT_POLL_MS");
+	Check((intr.stepLatencyMs != 0) && (intr.stepLatencyMs <= latencyMaxMs), "step up read within persist + 1 conversions and one loop pass");
+	Check((persist == 0) ? (intr.spikeInterrupts != 0) : (intr.spikeInterrupts == 0),
+			(persist == 0) ? "spikes fire INT without persistence" : "spikes shorter than the persistence do not fire INT");
+	Check((intRepairs != 0) && intr.stepDownSeen, "a sensor knocked out of Active mode is repaired and the step back read");
+	Check(intr.transfers < poll.transfers / 2U, "interrupt mode uses under half of the polling traffic");
+
+	printf("%d failures\n", failures);
+	return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,182 @@
+/**
+ * @file ltr-329-emu.c
+ * @brief Implementation of the host LTR-329 emulator.
+ * @author Kent Hong
+ */
+
+#include <string.h>
+#include "ltr-329-emu.h"
+
+#define EMU_ALS_CONTR 0x80
+#define EMU_ALS_MEAS_RATE 0x85
+#define EMU_ALS_DATA_CH1_0 0x88
+#define EMU_ALS_STATUS 0x8C
+#define EMU_INTERRUPT 0x8F
+#define EMU_ALS_THRES_UP_0 0x97
+#define EMU_ALS_THRES_LOW_0 0x99
+#define EMU_INTERRUPT_PERSIST 0x9E
+#define EMU_CONTR_ACTIVE 0x01
+#define EMU_CONTR_SW_RESET 0x02
+#define EMU_STATUS_NEW_DATA 0x04
+#define EMU_STATUS_INT 0x08
+#define EMU_INTERRUPT_ENABLE 0x02
+
+LTR_329_Emu_t ltr329Emu;
+
+static const uint8_t emuGains[8] = {1, 2, 4, 8, 0, 0, 48, 96};
+static const uint16_t emuIntTimes[8] = {100, 50, 200, 400, 150, 250, 300, 350};
+static const uint16_t emuMeasRates[8] = {50, 100, 200, 500, 1000, 2000, 2000, 2000};
+
+/** @brief Power-up register values of the LTR-329, plus the interrupt registers of the LTR-303 */
+static void Emu_Defaults(void) {
+	static const uint8_t defaults[][2] = {
+		{ 0x80, 0x00 }, { 0x85, 0x03 }, { 0x86, 0xA0 }, { 0x87, 0x05 },
+		{ 0x88, 0x00 }, { 0x89, 0x00 }, { 0x8A, 0x00 }, { 0x8B, 0x00 }, { 0x8C, 0x00 },
+	};
+	static const uint8_t ltr303Defaults[][2] = {
+		{ 0x8F, 0x08 }, { 0x97, 0xFF }, { 0x98, 0xFF }, { 0x99, 0x00 }, { 0x9A, 0x00 }, { 0x9E, 0x00 },
+	};
+	for (size_t i = 0; i < sizeof(defaults) / sizeof(defaults[0]); i++) {
+		ltr329Emu.regs[defaults[i][0]] = defaults[i][1];
+		ltr329Emu.implemented[defaults[i][0]] = 1;
+	}
+	for (size_t i = 0; ltr329Emu.ltr303 && (i < sizeof(ltr303Defaults) / sizeof(ltr303Defaults[0])); i++) {
+		ltr329Emu.regs[ltr303Defaults[i][0]] = ltr303Defaults[i][1];
+		ltr329Emu.implemented[ltr303Defaults[i][0]] = 1;
+	}
+	ltr329Emu.active = 0;
+	ltr329Emu.outOfWindow = 0;
+	ltr329Emu.intLine = 0;
+}
+
+/** @brief LTR-303 window check of a new CH0 count, asserts INT after persist + 1 samples outside */
+static void Emu_Check_Window(uint16_t ch0) {
+	uint16_t upper = (uint16_t)(ltr329Emu.regs[EMU_ALS_THRES_UP_0] | (ltr329Emu.regs[EMU_ALS_THRES_UP_0 + 1] << 8));
+	uint16_t lower = (uint16_t)(ltr329Emu.regs[EMU_ALS_THRES_LOW_0] | (ltr329Emu.regs[EMU_ALS_THRES_LOW_0 + 1] << 8));
+	if (!ltr329Emu.ltr303 || !(ltr329Emu.regs[EMU_INTERRUPT] & EMU_INTERRUPT_ENABLE)) {
+		return;
+	}
+	ltr329Emu.outOfWindow = ((ch0 > upper) || (ch0 < lower)) ? ltr329Emu.outOfWindow + 1U : 0;
+	if ((ltr329Emu.outOfWindow > (ltr329Emu.regs[EMU_INTERRUPT_PERSIST] & 0x0FU)) && !ltr329Emu.intLine) {
+		ltr329Emu.regs[EMU_ALS_STATUS] |= EMU_STATUS_INT;
+		ltr329Emu.intLine = 1;
+		ltr329Emu.interrupts++;
+		if (ltr329Emu.intHandler != NULL) {
+			ltr329Emu.intHandler(); // Falling edge on the EXTI pin
+		}
+	}
+}
+
+static uint16_t Emu_Int_Time(void) {
+	return emuIntTimes[(ltr329Emu.regs[EMU_ALS_MEAS_RATE] >> 3) & 0x07];
+}
+
+/** @brief Latch one conversion of the current light level */
+static void Emu_Convert(void) {
+	uint8_t gainCode = (ltr329Emu.regs[EMU_ALS_CONTR] >> 2) & 0x07;
+	double scale = (double)emuGains[gainCode] * Emu_Int_Time() / 100.0;
+	double c0 = ltr329Emu.light * scale;
+	double c1 = c0 * ltr329Emu.irRatio;
+	uint16_t ch0 = (c0 >= 65535.0) ? 65535 : (uint16_t)c0;
+	uint16_t ch1 = (c1 >= 65535.0) ? 65535 : (uint16_t)c1;
+
+	ltr329Emu.regs[EMU_ALS_DATA_CH1_0] = (uint8_t)ch1;
+	ltr329Emu.regs[EMU_ALS_DATA_CH1_0 + 1] = (uint8_t)(ch1 >> 8);
+	ltr329Emu.regs[EMU_ALS_DATA_CH1_0 + 2] = (uint8_t)ch0;
+	ltr329Emu.regs[EMU_ALS_DATA_CH1_0 + 3] = (uint8_t)(ch0 >> 8);
+	ltr329Emu.regs[EMU_ALS_STATUS] = (uint8_t)((gainCode << 4) | EMU_STATUS_NEW_DATA | (ltr329Emu.regs[EMU_ALS_STATUS] & EMU_STATUS_INT));
+	ltr329Emu.conversions++;
+	Emu_Check_Window(ch0);
+}
+
+/*****************************************************************
+ * @brief Power up the emulated sensor                          *
+ * @param light: CH0 counts at gain 1 and 100 ms integration    *
+ * @param ltr303: 1 to emulate the LTR-303 with its INT pin     *
+ ****************************************************************/
+void LTR_329_Emu_Init(double light, uint8_t ltr303) {
+	memset(&ltr329Emu, 0, sizeof(ltr329Emu));
+	ltr329Emu.ltr303 = ltr303;
+	ltr329Emu.unimplementedRead = 0xFF;
+	ltr329Emu.light = light;
+	ltr329Emu.irRatio = 0.3;
+	Emu_Defaults();
+}
+
+/*****************************************************************
+ * @brief Advance the virtual clock, converting while Active    *
+ * @param ms: Milliseconds to advance                           *
+ ****************************************************************/
+void LTR_329_Emu_Advance(uint32_t ms) {
+	uint32_t endMs = ltr329Emu.nowMs + ms;
+	while (ltr329Emu.active && ((int32_t)(ltr329Emu.nextSampleMs - endMs) <= 0)) {
+		ltr329Emu.nowMs = ltr329Emu.nextSampleMs;
+		Emu_Convert();
+		uint16_t periodMs = emuMeasRates[ltr329Emu.regs[EMU_ALS_MEAS_RATE] & 0x07];
+		ltr329Emu.nextSampleMs += (periodMs > Emu_Int_Time()) ? periodMs : Emu_Int_Time();
+	}
+	ltr329Emu.nowMs = endMs;
+}
+
+void HAL_Delay(uint32_t delayMs) {
+	LTR_329_Emu_Advance(delayMs);
+}
+
+uint32_t HAL_GetTick(void) {
+	return ltr329Emu.nowMs;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef *hi2c, uint16_t devAddress, uint16_t memAddress, uint16_t memAddSize, uint8_t *data, uint16_t size, uint32_t timeout) {
+	(void)hi2c; (void)devAddress; (void)memAddSize; (void)timeout;
+	if ((int32_t)(ltr329Emu.nowMs - ltr329Emu.busyUntilMs) < 0) {
+		return HAL_ERROR;
+	}
+	for (uint16_t i = 0; i < size; i++) {
+		uint8_t addr = (uint8_t)(memAddress + i);
+		ltr329Emu.writes++;
+		if (!ltr329Emu.implemented[addr]) {
+			if (ltr329Emu.nackUnimplemented) {
+				return HAL_ERROR;
+			}
+			continue;
+		}
+		if ((addr == EMU_ALS_CONTR) && (data[i] & EMU_CONTR_SW_RESET)) {
+			Emu_Defaults();
+			ltr329Emu.busyUntilMs = ltr329Emu.nowMs + LTR_329_EMU_RESET_BUSY_MS;
+			continue;
+		}
+		ltr329Emu.regs[addr] = data[i];
+		if (addr == EMU_INTERRUPT) {
+			ltr329Emu.regs[addr] = (uint8_t)((data[i] & 0x06) | 0x08); // Bit 3 is reserved and reads 1
+		}
+		if (addr == EMU_ALS_CONTR) {
+			uint8_t active = data[i] & EMU_CONTR_ACTIVE;
+			if (active && !ltr329Emu.active) {
+				ltr329Emu.nextSampleMs = ltr329Emu.nowMs + 10U + Emu_Int_Time();
+			}
+			ltr329Emu.active = active;
+		}
+	}
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef *hi2c, uint16_t devAddress, uint16_t memAddress, uint16_t memAddSize, uint8_t *data, uint16_t size, uint32_t timeout) {
+	(void)hi2c; (void)devAddress; (void)memAddSize; (void)timeout;
+	if ((int32_t)(ltr329Emu.nowMs - ltr329Emu.busyUntilMs) < 0) {
+		return HAL_ERROR;
+	}
+	for (uint16_t i = 0; i < size; i++) {
+		uint8_t addr = (uint8_t)(memAddress + i);
+		ltr329Emu.reads++;
+		if (!ltr329Emu.implemented[addr] && ltr329Emu.nackUnimplemented) {
+			return HAL_ERROR;
+		}
+		data[i] = ltr329Emu.implemented[addr] ? ltr329Emu.regs[addr] : ltr329Emu.unimplementedRead;
+		if (addr == EMU_ALS_STATUS) {
+			/* Reading the status clears new data and releases INT */
+			ltr329Emu.regs[addr] &= (uint8_t)~(EMU_STATUS_NEW_DATA | EMU_STATUS_INT);
+			ltr329Emu.intLine = 0;
+		}
+	}
+	return HAL_OK;
+}
@@ -0,0 +1,60 @@
+/**
+ * @file ltr-329-emu.h
+ * @brief Host emulator of the LTR-329 and LTR-303 behind HAL_I2C_Mem_Read()/HAL_I2C_Mem_Write().
+ * @author Kent Hong
+ *
+ * Defines the I2C, HAL_Delay() and HAL_GetTick() functions of the host HAL
+ * stand-in (host-hal/stm32L4xx_hal.h) so LTR-329.c and the modules above it
+ * run unchanged on Linux against a register file with a virtual millisecond
+ * clock. The device behaves like the datasheet where the driver depends on it:
+ *   - SW reset restores the register defaults and NACKs for a few ms
+ *   - Active mode converts after the wakeup time plus one integration, then once
+ *     per measurement period, ALS_STATUS flags new data until it is read
+ *   - Counts follow a light level in counts at gain 1 and 100 ms, saturating
+ *   - Addresses the part does not implement ignore writes and read
+ *     unimplementedRead, or NACK with nackUnimplemented
+ *   - The LTR-303 adds INTERRUPT, the CH0 threshold window and persistence:
+ *     after persist + 1 conversions outside the window the INT line asserts
+ *     and intHandler runs, as the EXTI callback would; reading ALS_STATUS
+ *     releases it
+ *
+ * Build: see console-pty-test.c or ltr-303-int-sim.c
+ */
+
+#ifndef LTR_329_EMU_H_
+#define LTR_329_EMU_H_
+
+#include <stdint.h>
+#include "stm32L4xx_hal.h"
+
+#define LTR_329_EMU_RESET_BUSY_MS 5 // NACK time after a SW reset
+
+/** @brief Emulated sensor, one per test, reached through the HAL I2C calls */
+typedef struct {
+	uint8_t ltr303;             // 1 to emulate the LTR-303
+	uint8_t regs[256];          // Register file by address
+	uint8_t implemented[256];   // 1 for addresses the part answers
+	uint8_t unimplementedRead;  // Value read from other addresses
+	uint8_t nackUnimplemented;  // 1 to NACK other addresses instead
+	uint32_t nowMs;             // Virtual HAL_GetTick()
+	uint32_t busyUntilMs;       // NACK every transfer before this time
+	uint32_t nextSampleMs;      // Time of the next conversion while Active
+	uint8_t active;             // 1 in Active mode
+	double light;               // CH0 counts at gain 1 and 100 ms, CH1 is irRatio of it
+	double irRatio;
+	uint8_t outOfWindow;        // LTR-303: consecutive conversions outside the window
+	uint8_t intLine;            // LTR-303: 1 while INT is asserted
+	void (*intHandler)(void);   // LTR-303: called when INT asserts
+	uint32_t interrupts;        // LTR-303: INT assertions
+	uint32_t conversions;       // Conversions since start
+	uint32_t reads;             // I2C reads
+	uint32_t writes;            // I2C writes
+} LTR_329_Emu_t;
+
+extern LTR_329_Emu_t ltr329Emu;
+
+/** @brief Function Prototypes for the emulator */
+void LTR_329_Emu_Init(double light, uint8_t ltr303);
+void LTR_329_Emu_Advance(uint32_t ms);
+
+#endif /* LTR_329_EMU_H_ */
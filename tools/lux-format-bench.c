@@ -0,0 +1,158 @@
+/**
+ * @file lux-format-bench.c
+ * @brief Host check of the integer lux formatter against sprintf("%.2f"), with timing of both.
+ * @author Kent Hong
+ *
+ * Range check: Lux_Format_Line(Lux_To_Centi(lux)) must equal
+ * sprintf("Lux: %.2f\r\n", lux) for every float from 0 up to the clamp at
+ * UINT32_MAX / 100, taken every stride-th bit pattern (-s 1 checks all 1.28
+ * billion of them, which takes a while). Every float in [512, 1024), about
+ * 8 million with 16000 per hundredth, and the halfway cases of the first
+ * 10^6 hundredths are always checked. Negative values, NaN, infinities and
+ * values at the clamp must give 0.00 or 42949672.95, and every buffer one
+ * byte too small must be refused.
+ *
+ * Timing: best of several rounds of formatting the same realistic lux values
+ * (0 to 100000 lux) both ways, in ns per line. The flash cost is not visible
+ * on the host. Measure it on the target toolchain by linking main.c once
+ * with the formatter and once with sprintf("%.2f") plus -u _printf_float, and
+ * compare arm-none-eabi-size of the two images.
+ *
+ * Build: cc -O2 -I.. -o lux-format-bench lux-format-bench.c ../Lux-Format.c -lm
+ * Usage: lux-format-bench [-s stride] [-r rounds]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "Lux-Format.h"
+
+#define TIMING_VALUES 100000
+
+static float timingValues[TIMING_VALUES];
+static volatile uint32_t sink;
+static unsigned long long checked, mismatches;
+
+static double Now_Ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static float Float_From_Bits(uint32_t bits) {
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+static void Compare(float lux, const char *expected) {
+	char line[LUX_FORMAT_LINE_MAX];
+	char reference[64];
+	if (expected == NULL) {
+		snprintf(reference, sizeof(reference), "Lux: %.2f\r\n", (double)lux);
+		expected = reference;
+	}
+	uint16_t length = Lux_Format_Line(line, sizeof(line), Lux_To_Centi(lux));
+	checked++;
+	if ((length != strlen(expected)) || (strcmp(line, expected) != 0)) {
+		if (mismatches++ < 10) {
+			fprintf(stderr, "%.9g: got \"%.*s\", expected \"%.*s\"\n", (double)lux,
+					(int)length - 2, line, (int)strlen(expected) - 2, expected);
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+
+	unsigned long stride = 97;
+	long rounds = 10;
+	int opt;
+	while ((opt = getopt(argc, argv, "s:r:")) != -1) {
+		if (opt == 's') {
+			stride = strtoul(optarg, NULL, 0);
+		}
+		else if (opt == 'r') {
+			rounds = strtol(optarg, NULL, 0);
+		}
+		else {
+			fprintf(stderr, "usage: %s [-s stride] [-r rounds]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (stride == 0) {
+		stride = 1;
+	}
+
+	/* Every stride-th float below the clamp, then every float of one binade */
+	const float clamp = (float)(UINT32_MAX / LUX_FORMAT_SCALE);
+	uint32_t clampBits;
+	memcpy(&clampBits, &clamp, sizeof(clampBits));
+	for (uint64_t bits = 0; bits < clampBits; bits += stride) {
+		Compare(Float_From_Bits((uint32_t)bits), NULL);
+	}
+	for (float lux = 512.0f; lux < 1024.0f; lux = nextafterf(lux, 1024.0f)) {
+		Compare(lux, NULL);
+	}
+	/* x.xx5 sits between two hundredths, the float nearest to it decides the rounding */
+	for (uint32_t centi = 0; centi < 1000000U; centi++) {
+		Compare(((float)centi + 0.5f) / 100.0f, NULL);
+	}
+	printf("range: %llu values compared with sprintf, %llu mismatches\n", checked, mismatches);
+
+	/* Clamped and invalid inputs */
+	unsigned long long before = mismatches;
+	Compare(-1.0f, "Lux: 0.00\r\n");
+	Compare(-0.0f, "Lux: 0.00\r\n");
+	Compare(NAN, "Lux: 0.00\r\n");
+	Compare(-INFINITY, "Lux: 0.00\r\n");
+	Compare(INFINITY, "Lux: 42949672.95\r\n");
+	Compare(clamp, "Lux: 42949672.95\r\n");
+	Compare(1e30f, "Lux: 42949672.95\r\n");
+
+	/* Every line refused by a buffer one byte short */
+	char line[LUX_FORMAT_LINE_MAX];
+	for (uint32_t centi = 1; centi != 0; centi = (centi > UINT32_MAX / 10U) ? 0 : centi * 10U) {
+		uint16_t length = Lux_Format_Line(line, sizeof(line), centi);
+		if ((length == 0) || (Lux_Format_Line(line, length, centi) != 0) || (Lux_Format_Line(line, length + 1U, centi) != length)) {
+			mismatches++;
+			fprintf(stderr, "%u: buffer of %u bytes not handled\n", centi, length);
+		}
+	}
+	if (Lux_Format_Line(line, sizeof(line), UINT32_MAX) != LUX_FORMAT_LINE_MAX - 1U) {
+		mismatches++;
+		fprintf(stderr, "longest line is not LUX_FORMAT_LINE_MAX - 1\n");
+	}
+	printf("clamping and buffer sizes: %s\n", (mismatches == before) ? "ok" : "FAIL");
+
+	/* Timing on dim to bright light, best of the rounds as the host is not quiet */
+	srand(1);
+	for (uint32_t i = 0; i < TIMING_VALUES; i++) {
+		timingValues[i] = (float)(100000.0 * pow((double)rand() / RAND_MAX, 3.0));
+	}
+	double formatNs = 1e30, sprintfNs = 1e30;
+	for (long r = 0; r < rounds; r++) {
+		double t0 = Now_Ns();
+		for (uint32_t i = 0; i < TIMING_VALUES; i++) {
+			sink += Lux_Format_Line(line, sizeof(line), Lux_To_Centi(timingValues[i]));
+		}
+		double elapsed = Now_Ns() - t0;
+		formatNs = (elapsed < formatNs) ? elapsed : formatNs;
+
+		char reference[64];
+		t0 = Now_Ns();
+		for (uint32_t i = 0; i < TIMING_VALUES; i++) {
+			sink += (uint32_t)sprintf(reference, "Lux: %.2f\r\n", (double)timingValues[i]);
+		}
+		elapsed = Now_Ns() - t0;
+		sprintfNs = (elapsed < sprintfNs) ? elapsed : sprintfNs;
+	}
+	printf("Lux_Format_Line(Lux_To_Centi()) %.1f ns/line, sprintf %.1f ns/line, %.1fx\n",
+			formatNs / TIMING_VALUES, sprintfNs / TIMING_VALUES, sprintfNs / formatNs);
+
+	return (mismatches == 0) ? 0 : 1;
+}
@@ -0,0 +1,195 @@
+/**
+ * @file lux-series-tool.c
+ * @brief Compression ratio and throughput of the lux series format on archived samples.
+ * @author Kent Hong
+ *
+ * Converts the samples of a sample archive (sample-archive.h) to (timeMs, lux)
+ * pairs with the formula of LTR_329_Calculate_Lux(), the float series the legacy
+ * ground tools keep, and packs them into independent lux series of -b pairs each
+ * (0: one series). Prints the size against 12 raw bytes per pair, checks that
+ * every pair decodes bit for bit, and prints the best encode and decode
+ * throughput of several rounds. Series are decoded one at a time into the
+ * same scratch arrays, as a reader aggregating them would.
+ *
+ * With -r the raw little-endian pairs are written to a file as well, for
+ * comparing with general-purpose compressors.
+ *
+ * Build: cc -O2 -I.. -o lux-series-tool lux-series-tool.c lux-series.c sample-archive.c
+ * Usage: lux-series-tool [-b pairs] [-r raw.bin] archive.sar [from_ms to_ms]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "LTR-329-Flags.h"
+#include "lux-series.h"
+#include "sample-archive.h"
+
+static double Now_Ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void Usage(const char *name) {
+	fprintf(stderr, "usage: %s [-b pairs] [-r raw.bin] archive.sar [from_ms to_ms]\n", name);
+	exit(2);
+}
+
+/** @brief Formula of LTR_329_Calculate_Lux() (Appendix A, pg. 3) without calibration */
+static float Record_Lux(const Sample_Archive_Record_t *record) {
+	uint32_t sum = (uint32_t)record->c0Data + record->c1Data;
+	if ((record->flags & LTR_329_FLAGS_INVALID) || (record->alsGainData == 0) || (record->alsIntData == 0) || (sum == 0)) {
+		return 0.0f;
+	}
+	float ratio = (float)record->c1Data / (float)sum;
+	double raw;
+	if (ratio < 0.45f) {
+		raw = 1.7743 * record->c0Data + 1.1059 * record->c1Data;
+	}
+	else if (ratio < 0.64f) {
+		raw = 4.2785 * record->c0Data - 1.9548 * record->c1Data;
+	}
+	else if (ratio < 0.85f) {
+		raw = 0.5926 * record->c0Data + 0.1185 * record->c1Data;
+	}
+	else {
+		return 0.0f;
+	}
+	return (float)raw / record->alsGainData / record->alsIntData;
+}
+
+int main(int argc, char **argv) {
+
+	uint64_t blockPairs = SAMPLE_ARCHIVE_BLOCK_RECORDS;
+	const char *rawPath = NULL;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "b:r:")) != -1) {
+		switch (opt) {
+			case 'b': blockPairs = strtoull(optarg, NULL, 0); break;
+			case 'r': rawPath = optarg; break;
+			default: Usage(argv[0]);
+		}
+	}
+	if ((optind + 1 != argc) && (optind + 3 != argc)) {
+		Usage(argv[0]);
+	}
+
+	Sample_Archive_t archive;
+	if (!Sample_Archive_Open(&archive, argv[optind])) {
+		fprintf(stderr, "%s: not a sample archive\n", argv[optind]);
+		return 1;
+	}
+	const Sample_Archive_Record_t *records = archive.records;
+	uint64_t count = archive.header->recordCount;
+	if (optind + 3 == argc) {
+		count = Sample_Archive_Range(&archive, strtoull(argv[optind + 1], NULL, 0), strtoull(argv[optind + 2], NULL, 0), &records);
+	}
+	if (count == 0) {
+		fprintf(stderr, "no samples in range\n");
+		return 1;
+	}
+	if ((blockPairs == 0) || (blockPairs > count)) {
+		blockPairs = count;
+	}
+	uint64_t blockCount = (count + blockPairs - 1) / blockPairs;
+
+	uint64_t *times = malloc(count * sizeof(*times));
+	float *lux = malloc(count * sizeof(*lux));
+	uint64_t *decodedTimes = malloc(blockPairs * sizeof(*decodedTimes));
+	float *decodedLux = malloc(blockPairs * sizeof(*decodedLux));
+	size_t blockCapacity = LUX_SERIES_BYTES_MAX(blockPairs);
+	uint8_t *stream = malloc(blockCount * blockCapacity);
+	size_t *streamBytes = malloc(blockCount * sizeof(*streamBytes));
+	if (!times || !lux || !decodedTimes || !decodedLux || !stream || !streamBytes) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+	for (uint64_t i = 0; i < count; i++) {
+		times[i] = records[i].timeMs;
+		lux[i] = Record_Lux(&records[i]);
+	}
+
+	if (rawPath != NULL) {
+		FILE *raw = fopen(rawPath, "wb");
+		for (uint64_t i = 0; (raw != NULL) && (i < count); i++) {
+			fwrite(&times[i], sizeof(times[i]), 1, raw);
+			fwrite(&lux[i], sizeof(lux[i]), 1, raw);
+		}
+		if ((raw == NULL) || (fclose(raw) != 0)) {
+			perror(rawPath);
+			return 1;
+		}
+	}
+
+	/* Best of at least 5 rounds and 20M pairs, the host is not quiet */
+	uint64_t rounds = (count < 4000000) ? 20000000 / count : 5;
+	Lux_Series_Encoder_t enc;
+	size_t totalBytes = 0;
+	double appendNs = 1e30, encodeNs = 1e30, decodeNs = 1e30;
+	for (uint64_t r = 0; r < rounds; r++) {
+		double t0 = Now_Ns();
+		for (uint64_t b = 0; b < blockCount; b++) {
+			uint64_t first = b * blockPairs;
+			uint64_t pairs = (count - first < blockPairs) ? count - first : blockPairs;
+			Lux_Series_Encoder_Init(&enc, &stream[b * blockCapacity], blockCapacity);
+			for (uint64_t i = first; i < first + pairs; i++) {
+				Lux_Series_Append(&enc, times[i], lux[i]);
+			}
+			streamBytes[b] = Lux_Series_Finish(&enc);
+		}
+		double elapsed = Now_Ns() - t0;
+		appendNs = (elapsed < appendNs) ? elapsed : appendNs;
+	}
+	for (uint64_t r = 0; r < rounds; r++) {
+		double t0 = Now_Ns();
+		totalBytes = 0;
+		for (uint64_t b = 0; b < blockCount; b++) {
+			uint64_t first = b * blockPairs;
+			uint64_t pairs = (count - first < blockPairs) ? count - first : blockPairs;
+			Lux_Series_Encoder_Init(&enc, &stream[b * blockCapacity], blockCapacity);
+			Lux_Series_Append_Array(&enc, &times[first], &lux[first], pairs);
+			streamBytes[b] = Lux_Series_Finish(&enc);
+			totalBytes += streamBytes[b];
+		}
+		double elapsed = Now_Ns() - t0;
+		encodeNs = (elapsed < encodeNs) ? elapsed : encodeNs;
+	}
+
+	/* Series by series into one scratch block, as a reader consuming them would */
+	for (uint64_t r = 0; r < rounds; r++) {
+		double t0 = Now_Ns();
+		for (uint64_t b = 0; b < blockCount; b++) {
+			uint64_t pairs = (count - b * blockPairs < blockPairs) ? count - b * blockPairs : blockPairs;
+			Lux_Series_Decode(&stream[b * blockCapacity], streamBytes[b], pairs, decodedTimes, decodedLux);
+		}
+		double elapsed = Now_Ns() - t0;
+		decodeNs = (elapsed < decodeNs) ? elapsed : decodeNs;
+	}
+
+	for (uint64_t b = 0; b < blockCount; b++) {
+		uint64_t first = b * blockPairs;
+		uint64_t pairs = (count - first < blockPairs) ? count - first : blockPairs;
+		if ((Lux_Series_Decode(&stream[b * blockCapacity], streamBytes[b], pairs, decodedTimes, decodedLux) != pairs)
+				|| (memcmp(decodedTimes, &times[first], pairs * sizeof(*times)) != 0)
+				|| (memcmp(decodedLux, &lux[first], pairs * sizeof(*lux)) != 0)) {
+			fprintf(stderr, "series %llu decodes differently from its input\n", (unsigned long long)b);
+			return 1;
+		}
+	}
+
+	double rawBytes = (double)count * (sizeof(uint64_t) + sizeof(float));
+	printf("%llu pairs in %llu series of up to %llu, %zu bytes (%.2f bits/pair), %.1fx smaller than %.0f raw bytes\n",
+			(unsigned long long)count, (unsigned long long)blockCount, (unsigned long long)blockPairs, totalBytes,
+			(double)totalBytes * 8 / (double)count, rawBytes / (double)totalBytes, rawBytes);
+	printf("encode %.0f Mpairs/s (%.0f one Append call per pair), decode %.0f Mpairs/s, all pairs decode bit for bit\n",
+			(double)count * 1e3 / encodeNs, (double)count * 1e3 / appendNs, (double)count * 1e3 / decodeNs);
+
+	Sample_Archive_Close(&archive);
+	return 0;
+}
@@ -0,0 +1,330 @@
+/**
+ * @file lux-series.c
+ * @brief Implementation of the XOR float compressor of archived lux time series.
+ * @author Kent Hong
+ *
+ * The encoder keeps the partial byte in a 64-bit register and stores 8 bytes
+ * after every field, advancing by the whole bytes written. The decoder loads 64
+ * bits at the read position and usually takes both fields of a pair from one
+ * load. The value forms are selected with conditional moves, as noisy lux makes
+ * them unpredictable. The per-pair helpers are inlined into loops that keep the
+ * state in locals. Every function returning int returns 1 on success and 0 on
+ * failure.
+ */
+
+#include <string.h>
+#include "lux-series.h"
+
+/** @brief Bucket of the time delta-of-delta by the number of leading 1 bits of its prefix */
+static const uint8_t dodWidth[5] = {0, 7, 9, 12, 64};
+
+static uint32_t Float_Bits(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+static float Bits_Float(uint32_t bits) {
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+/** @brief Append the low n bits of value (n 1 to 56, no higher bits set), storing 8 bytes at the write position */
+static inline void Put_Bits(uint8_t *out, size_t *bytes, uint64_t *bits, uint32_t *fill, uint64_t value, uint32_t n) {
+	*bits |= value << (64 - *fill - n);
+	*fill += n;
+	uint64_t word = __builtin_bswap64(*bits);
+	memcpy(&out[*bytes], &word, sizeof(word));
+	*bytes += *fill >> 3;
+	*bits <<= *fill & ~7U;
+	*fill &= 7;
+}
+
+/** @brief 64 bits of the stream starting at bit position, at least 57 of them valid, zeros past the end */
+static inline uint64_t Peek_Bits(const uint8_t *in, size_t size, size_t position) {
+	size_t byte = position >> 3;
+	uint64_t word = 0;
+	if (byte + 8 <= size) {
+		memcpy(&word, &in[byte], sizeof(word));
+		word = __builtin_bswap64(word);
+	}
+	else {
+		for (size_t i = 0; i < 8; i++) {
+			word = (word << 8) | ((byte + i < size) ? in[byte + i] : 0);
+		}
+	}
+	return word << (position & 7);
+}
+
+/** @brief Read the pair after the first, returns 0 on a corrupt stream, always inlined so the state stays in registers */
+static inline __attribute__((always_inline)) int Read_Pair(const uint8_t *in, size_t size, size_t *position, uint64_t *timeMs, uint64_t *delta,
+		uint32_t *value, uint8_t *leading, uint8_t *trailing) {
+
+	/* Time, the value is taken from the same load unless the time took over 13 bits */
+	uint64_t word = Peek_Bits(in, size, *position);
+	uint32_t used = 1;
+	if (word >> 63) {
+		uint32_t ones = (~word == 0) ? 4 : (uint32_t)__builtin_clzll(~word);
+		if (ones < 4) {
+			uint32_t width = dodWidth[ones];
+			uint64_t raw = (word << (ones + 1)) >> (64 - width);
+			*delta += (uint64_t)((int64_t)(raw << (64 - width)) >> (64 - width));
+			used = ones + 1 + width;
+		}
+		else {
+			uint64_t high = Peek_Bits(in, size, *position + 4) >> 32;
+			uint64_t low = Peek_Bits(in, size, *position + 36) >> 32;
+			*delta += (high << 32) | low;
+			used = 68;
+		}
+	}
+	*timeMs += *delta;
+	*position += used;
+	word = (used <= 13) ? word << used : Peek_Bits(in, size, *position);
+
+	/* Value */
+	uint32_t changed = (uint32_t)(word >> 63);
+	uint32_t isNew = changed & (uint32_t)(word >> 62);
+	uint32_t newLeading = (uint32_t)(word >> 57) & 0x1F;
+	uint32_t newLength = ((uint32_t)(word >> 52) & 0x1F) + 1;
+	if ((isNew && (newLeading + newLength > 32)) || (changed && !isNew && (*leading == 32))) {
+		return 0;  // Window past the value, or '10' before any window
+	}
+	uint32_t lead = isNew ? newLeading : *leading;
+	uint32_t trail = isNew ? 32U - newLeading - newLength : *trailing;
+	uint32_t length = isNew ? newLength : 32U - lead - trail;
+	uint32_t header = isNew ? 12 : 2;
+	uint32_t x = (uint32_t)((word << header) >> (63 - (length - 1) % 64)) << (trail & 31);
+	*value ^= changed ? x : 0;
+	*position += changed ? header + length : 1;
+	*leading = (uint8_t)lead;
+	*trailing = (uint8_t)trail;
+
+	return (*position <= size * 8);
+}
+
+
+/** @brief Write the pair after the first as its time delta-of-delta and value XOR */
+static inline __attribute__((always_inline)) void Write_Pair(uint8_t *out, size_t *bytes, uint64_t *bits, uint32_t *fill, int64_t dod, uint32_t x,
+		uint32_t *leading, uint32_t *trailing) {
+
+	if (dod == 0) {
+		Put_Bits(out, bytes, bits, fill, 0, 1);
+	}
+	else if ((dod >= -64) && (dod <= 63)) {
+		Put_Bits(out, bytes, bits, fill, (0x2U << 7) | ((uint64_t)dod & 0x7F), 9);
+	}
+	else if ((dod >= -256) && (dod <= 255)) {
+		Put_Bits(out, bytes, bits, fill, (0x6U << 9) | ((uint64_t)dod & 0x1FF), 12);
+	}
+	else if ((dod >= -2048) && (dod <= 2047)) {
+		Put_Bits(out, bytes, bits, fill, (0xEU << 12) | ((uint64_t)dod & 0xFFF), 16);
+	}
+	else {
+		Put_Bits(out, bytes, bits, fill, (0xFULL << 32) | ((uint64_t)dod >> 32), 36);
+		Put_Bits(out, bytes, bits, fill, (uint32_t)dod, 32);
+	}
+
+	/* Value */
+	uint32_t lead = (x != 0) ? (uint32_t)__builtin_clz(x) : 32;
+	uint32_t trail = (x != 0) ? (uint32_t)__builtin_ctz(x) : 0;
+	uint32_t length = 32U - lead - trail;
+	uint32_t window = 32U - *leading - *trailing;
+	/* The previous window unless it is over 10 bits wider than needed, the cost of a new one */
+	int keep = (x == 0) || ((lead >= *leading) && (trail >= *trailing) && (window <= length + 10));
+	uint64_t code = (x == 0) ? 0 : keep ? (0x2ULL << window) | (x >> *trailing)
+			: ((uint64_t)((0x3U << 10) | (lead << 5) | (length - 1)) << length) | (x >> trail);
+	uint32_t n = (x == 0) ? 1 : keep ? window + 2 : length + 12;
+	Put_Bits(out, bytes, bits, fill, code, n);
+	*leading = keep ? *leading : lead;
+	*trailing = keep ? *trailing : trail;
+}
+
+
+/*****************************************************************
+ * @brief Start an empty series                                 *
+ * @param enc: Pointer to the Lux_Series_Encoder_t struct       *
+ * @param out: Buffer for the stream                            *
+ * @param capacity: Bytes in out, LUX_SERIES_BYTES_MAX(count)   *
+ *                  always fits count pairs                     *
+ ****************************************************************/
+void Lux_Series_Encoder_Init(Lux_Series_Encoder_t *enc, uint8_t *out, size_t capacity) {
+	memset(enc, 0, sizeof(*enc));
+	enc->out = out;
+	enc->capacity = capacity;
+	enc->leading = 32;  // No window yet, every XOR takes the long form
+}
+
+
+/*****************************************************************
+ * @brief Append one pair                                       *
+ * @param enc: Pointer to the Lux_Series_Encoder_t struct       *
+ * @param timeMs: Sample time, any order, though out of order   *
+ *                times cost the long time form                 *
+ * @param lux: Value, every float bit pattern round-trips       *
+ * @return 1 if appended, 0 if the buffer could be too small    *
+ ****************************************************************/
+int Lux_Series_Append(Lux_Series_Encoder_t *enc, uint64_t timeMs, float lux) {
+	return (int)Lux_Series_Append_Array(enc, &timeMs, &lux, 1);
+}
+
+
+/*****************************************************************
+ * @brief Append an array of pairs                              *
+ * @param enc: Pointer to the Lux_Series_Encoder_t struct       *
+ * @param timesMs: Array of count times                         *
+ * @param lux: Array of count values                            *
+ * @param count: Number of pairs                                *
+ * @return Number of pairs appended, below count if the buffer  *
+ *         could be too small                                   *
+ *                                                              *
+ * Lux_Series_Append() is this with one pair, appending arrays  *
+ * keeps the state in registers between pairs.                  *
+ ****************************************************************/
+uint64_t Lux_Series_Append_Array(Lux_Series_Encoder_t *enc, const uint64_t *timesMs, const float *lux, uint64_t count) {
+
+	uint8_t *out = enc->out;
+	size_t bytes = enc->bytes;
+	uint64_t bits = enc->bits;
+	uint32_t fill = enc->fill;
+	uint64_t prevTimeMs = enc->prevTimeMs;
+	uint64_t prevDelta = enc->prevDelta;
+	uint32_t prevValue = enc->prevValue;
+	uint32_t leading = enc->leading, trailing = enc->trailing;
+	uint64_t i = 0;
+
+	/* Every pair needs room for the longest pair plus the 8-byte store of Put_Bits() */
+	const size_t room = LUX_SERIES_PAIR_MAX_BITS / 8 + 8;
+
+	if ((count != 0) && (enc->count == 0) && (bytes + room <= enc->capacity)) {
+		prevTimeMs = timesMs[0];
+		prevValue = Float_Bits(lux[0]);
+		Put_Bits(out, &bytes, &bits, &fill, prevTimeMs >> 32, 32);
+		Put_Bits(out, &bytes, &bits, &fill, (uint32_t)prevTimeMs, 32);
+		Put_Bits(out, &bytes, &bits, &fill, prevValue, 32);
+		i = 1;
+	}
+	if ((enc->count != 0) || (i != 0)) {
+		for (; (i < count) && (bytes + room <= enc->capacity); i++) {
+			uint64_t delta = timesMs[i] - prevTimeMs;
+			uint32_t value = Float_Bits(lux[i]);
+			Write_Pair(out, &bytes, &bits, &fill, (int64_t)(delta - prevDelta), value ^ prevValue, &leading, &trailing);
+			prevTimeMs = timesMs[i];
+			prevDelta = delta;
+			prevValue = value;
+		}
+	}
+
+	enc->bytes = bytes;
+	enc->bits = bits;
+	enc->fill = fill;
+	enc->prevTimeMs = prevTimeMs;
+	enc->prevDelta = prevDelta;
+	enc->prevValue = prevValue;
+	enc->leading = (uint8_t)leading;
+	enc->trailing = (uint8_t)trailing;
+	enc->count += i;
+	return i;
+}
+
+
+/*****************************************************************
+ * @brief Write out the pending bits, zero padded to a byte     *
+ * @param enc: Pointer to the Lux_Series_Encoder_t struct       *
+ * @return Stream size in bytes                                 *
+ *                                                              *
+ * Nothing may be appended after this.                          *
+ ****************************************************************/
+size_t Lux_Series_Finish(Lux_Series_Encoder_t *enc) {
+	/* The last Put_Bits() already stored the partial byte */
+	enc->bytes += (enc->fill != 0);
+	enc->bits = 0;
+	enc->fill = 0;
+	return enc->bytes;
+}
+
+
+/*****************************************************************
+ * @brief Start reading a series                                *
+ * @param dec: Pointer to the Lux_Series_Decoder_t struct       *
+ * @param in: Stream                                            *
+ * @param size: Stream size in bytes                            *
+ * @param count: Number of pairs in the stream                  *
+ ****************************************************************/
+void Lux_Series_Decoder_Init(Lux_Series_Decoder_t *dec, const uint8_t *in, size_t size, uint64_t count) {
+	memset(dec, 0, sizeof(*dec));
+	dec->in = in;
+	dec->size = size;
+	dec->remaining = count;
+	dec->leading = 32;
+}
+
+
+/*****************************************************************
+ * @brief Read the next pair                                    *
+ * @param dec: Pointer to the Lux_Series_Decoder_t struct       *
+ * @param timeMs: Pointer to store the time                     *
+ * @param lux: Pointer to store the value                       *
+ * @return 1 if read, 0 at the end or on a corrupt stream       *
+ ****************************************************************/
+int Lux_Series_Next(Lux_Series_Decoder_t *dec, uint64_t *timeMs, float *lux) {
+
+	if (dec->remaining == 0) {
+		return 0;
+	}
+	if (dec->count == 0) {
+		dec->prevTimeMs = (Peek_Bits(dec->in, dec->size, 0) >> 32) << 32;
+		dec->prevTimeMs |= Peek_Bits(dec->in, dec->size, 32) >> 32;
+		dec->prevValue = (uint32_t)(Peek_Bits(dec->in, dec->size, 64) >> 32);
+		dec->position = LUX_SERIES_FIRST_BITS;
+		if (dec->position > dec->size * 8) {
+			return 0;
+		}
+	}
+	else if (!Read_Pair(dec->in, dec->size, &dec->position, &dec->prevTimeMs, &dec->prevDelta, &dec->prevValue,
+			&dec->leading, &dec->trailing)) {
+		return 0;
+	}
+
+	dec->count++;
+	dec->remaining--;
+	*timeMs = dec->prevTimeMs;
+	*lux = Bits_Float(dec->prevValue);
+	return 1;
+}
+
+
+/*****************************************************************
+ * @brief Read a whole series                                   *
+ * @param in: Stream                                            *
+ * @param size: Stream size in bytes                            *
+ * @param count: Number of pairs in the stream                  *
+ * @param timesMs: Array of count times                         *
+ * @param lux: Array of count values                            *
+ * @return Number of pairs read, below count on a corrupt stream *
+ *                                                              *
+ * Same as Lux_Series_Next() in a loop, with the state in       *
+ * locals.                                                      *
+ ****************************************************************/
+uint64_t Lux_Series_Decode(const uint8_t *in, size_t size, uint64_t count, uint64_t *timesMs, float *lux) {
+
+	if ((count == 0) || (size * 8 < LUX_SERIES_FIRST_BITS)) {
+		return 0;
+	}
+
+	size_t position = LUX_SERIES_FIRST_BITS;
+	uint64_t timeMs = ((Peek_Bits(in, size, 0) >> 32) << 32) | (Peek_Bits(in, size, 32) >> 32);
+	uint32_t value = (uint32_t)(Peek_Bits(in, size, 64) >> 32);
+	uint64_t delta = 0;
+	uint8_t leading = 32, trailing = 0;
+	uint64_t i = 0;
+
+	for (;;) {
+		timesMs[i] = timeMs;
+		lux[i] = Bits_Float(value);
+		if ((++i == count) || !Read_Pair(in, size, &position, &timeMs, &delta, &value, &leading, &trailing)) {
+			return i;
+		}
+	}
+}
@@ -0,0 +1,83 @@
+/**
+ * @file lux-series.h
+ * @brief Header file for the XOR float compressor of archived lux time series.
+ * @author Kent Hong
+ *
+ * This file contains the bit stream format and function prototypes for packing
+ * (timeMs, alsLuxData) pairs the way time-series databases pack float metrics.
+ * A stream is a big-endian bit string:
+ *   First pair   64-bit time, 32-bit float bits
+ *   Time         delta-of-delta of the time in ms, the delta before the first
+ *                pair counting as 0:
+ *                  0                     dod 0 (the usual case at a fixed period)
+ *                  10   + 7-bit dod      -64 to 63
+ *                  110  + 9-bit dod      -256 to 255
+ *                  1110 + 12-bit dod     -2048 to 2047
+ *                  1111 + 64-bit dod     anything else
+ *   Value        XOR of the float bits with the previous value:
+ *                  0                     same value
+ *                  10 + bits             meaningful bits inside the previous window, used
+ *                                        unless it is over 10 bits wider than needed
+ *                  11 + 5-bit leading zeros + 5-bit (length - 1) + bits
+ * Constant darkness costs 2 bits per pair. Noisy values cost up to 44 bits plus
+ * the time, so the worst case is LUX_SERIES_PAIR_MAX_BITS.
+ *
+ * The pair count is not in the stream, the caller keeps it next to the bytes.
+ *
+ * Build: see lux-series-tool.c
+ */
+
+#ifndef LUX_SERIES_H_
+#define LUX_SERIES_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LUX_SERIES_PAIR_MAX_BITS 112  // '1111' + 64-bit dod + '11' + 10 + 32 bits
+#define LUX_SERIES_FIRST_BITS 96      // Raw time and value of the first pair
+
+/** @brief Buffer size that always holds count pairs, with the slack of the 8-byte stores */
+#define LUX_SERIES_BYTES_MAX(count) ((size_t)(count) * (LUX_SERIES_PAIR_MAX_BITS / 8) + 16)
+
+/** @brief Stream being written */
+typedef struct {
+	uint8_t *out;          // Caller buffer
+	size_t capacity;       // Bytes in out
+	size_t bytes;          // Whole bytes written to out
+	uint64_t bits;         // Pending bits of the last partial byte, left-aligned
+	uint32_t fill;         // Number of pending bits, below 8 between calls
+	uint64_t count;        // Pairs appended
+	uint64_t prevTimeMs;
+	uint64_t prevDelta;    // Modulo 2^64, as the times
+	uint32_t prevValue;    // Float bits of the previous value
+	uint8_t leading;       // Window of the previous meaningful bits
+	uint8_t trailing;
+} Lux_Series_Encoder_t;
+
+/** @brief Stream being read */
+typedef struct {
+	const uint8_t *in;
+	size_t size;           // Bytes in in
+	size_t position;       // Bit position
+	uint64_t remaining;    // Pairs left to read
+	uint64_t count;        // Pairs read
+	uint64_t prevTimeMs;
+	uint64_t prevDelta;
+	uint32_t prevValue;
+	uint8_t leading;
+	uint8_t trailing;
+} Lux_Series_Decoder_t;
+
+
+/** @brief Function Prototypes for writing a series */
+void Lux_Series_Encoder_Init(Lux_Series_Encoder_t *enc, uint8_t *out, size_t capacity);
+int Lux_Series_Append(Lux_Series_Encoder_t *enc, uint64_t timeMs, float lux);
+uint64_t Lux_Series_Append_Array(Lux_Series_Encoder_t *enc, const uint64_t *timesMs, const float *lux, uint64_t count);
+size_t Lux_Series_Finish(Lux_Series_Encoder_t *enc);
+
+/** @brief Function Prototypes for reading a series */
+void Lux_Series_Decoder_Init(Lux_Series_Decoder_t *dec, const uint8_t *in, size_t size, uint64_t count);
+int Lux_Series_Next(Lux_Series_Decoder_t *dec, uint64_t *timeMs, float *lux);
+uint64_t Lux_Series_Decode(const uint8_t *in, size_t size, uint64_t count, uint64_t *timesMs, float *lux);
+
+#endif /* LUX_SERIES_H_ */
@@ -0,0 +1,196 @@
+/**
+ * @file sample-archive-tool.c
+ * @brief Build, inspect and query memory-mapped sample archives.
+ * @author Kent Hong
+ *
+ * Commands:
+ *   build   Convert ccsds-decode CSV (stdin or a file) into an archive. A tick
+ *           below the previous one is one of three things, told apart by size:
+ *           a 2^32 wrap (the tick moved forward by at most WRAP_GAP_MAX_MS modulo
+ *           2^32), frames sent slightly out of order (back by at most
+ *           REORDER_MAX_MS, stored with the previous time so the file stays
+ *           sorted), or a reboot (anything else, the tick restarted near 0 and
+ *           the new boot is placed right after the last stored time). Reboots
+ *           and clamped samples are reported. A reboot before the previous boot
+ *           had counted past the new tick cannot be seen in the ticks.
+ *   info    Print the header.
+ *   query   Print the records of [from, to) as CSV.
+ *   stats   Stream the records of [from, to) from the mapping and print count,
+ *           min, max and mean of both channels, with the time spent finding and
+ *           scanning the range.
+ *
+ * Build: cc -O2 -I.. -o sample-archive-tool sample-archive-tool.c sample-archive.c
+ * Usage: sample-archive-tool build archive.sar [samples.csv | -]
+ *        sample-archive-tool info archive.sar
+ *        sample-archive-tool query|stats archive.sar from_ms to_ms
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sample-archive.h"
+
+#define WRAP_GAP_MAX_MS 86400000U // Longest gap between samples across a tick wrap, 1 day
+#define REORDER_MAX_MS 60000U     // Largest backward step still treated as frames out of order
+
+/** @brief Gain and integration time by register code (pg. 13-14 of LTR-329 datasheet), 0 for reserved codes */
+static const uint8_t gainByCode[8] = {1, 2, 4, 8, 0, 0, 48, 96};
+static const uint16_t intTimeByCode[8] = {100, 50, 200, 400, 150, 250, 300, 350};
+
+static double Now_Ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void Usage(const char *name) {
+	fprintf(stderr, "usage: %s build archive.sar [samples.csv | -]\n"
+			"       %s info archive.sar\n"
+			"       %s query|stats archive.sar from_ms to_ms\n", name, name, name);
+	exit(2);
+}
+
+/** @brief seq,tick_ms,c0,c1,gain_code,int_code,flags lines as written by ccsds-decode */
+static int Build(const char *path, FILE *in) {
+
+	Sample_Archive_Writer_t writer;
+	if (!Sample_Archive_Create(&writer, path)) {
+		perror(path);
+		return 1;
+	}
+
+	char line[128];
+	unsigned long long lineNumber = 0, badLines = 0, clamped = 0, reboots = 0;
+	uint64_t epoch = 0, lastTime = 0;
+	uint32_t lastTick = 0;
+	int haveTick = 0;
+
+	while (fgets(line, sizeof(line), in) != NULL) {
+		unsigned long seq, tick, c0, c1, gainCode, intCode, flags;
+		lineNumber++;
+		if (sscanf(line, "%lu,%lu,%lu,%lu,%lu,%lu,%lx", &seq, &tick, &c0, &c1, &gainCode, &intCode, &flags) != 7
+				|| (tick > UINT32_MAX) || (c0 > UINT16_MAX) || (c1 > UINT16_MAX) || (gainCode > 7) || (intCode > 7) || (flags > 0xFF)) {
+			badLines += (lineNumber != 1); // The first line is the CSV header
+			continue;
+		}
+
+		/* Unwrap at 2^32, start a new epoch after a reboot, leave small reordering to the clamp below */
+		if (haveTick && ((uint32_t)tick < lastTick)) {
+			if ((uint32_t)((uint32_t)tick - lastTick) <= WRAP_GAP_MAX_MS) {
+				epoch += 1ULL << 32;
+			}
+			else if (lastTick - (uint32_t)tick > REORDER_MAX_MS) {
+				epoch = lastTime;
+				reboots++;
+			}
+		}
+		lastTick = (uint32_t)tick;
+		haveTick = 1;
+
+		Sample_Archive_Record_t record = { epoch + tick, (uint16_t)c0, (uint16_t)c1, intTimeByCode[intCode], gainByCode[gainCode], (uint8_t)flags };
+		if (record.timeMs < lastTime) {
+			record.timeMs = lastTime;
+			clamped++;
+		}
+		lastTime = record.timeMs;
+
+		if (!Sample_Archive_Append(&writer, &record)) {
+			perror(path);
+			return 1;
+		}
+	}
+
+	uint64_t records = writer.header.recordCount;
+	if (!Sample_Archive_Finish(&writer)) {
+		perror(path);
+		return 1;
+	}
+	fprintf(stderr, "%llu records, %llu bad lines, %llu reboots, %llu out of order clamped\n",
+			(unsigned long long)records, badLines, reboots, clamped);
+	return 0;
+}
+
+int main(int argc, char **argv) {
+
+	if (argc < 3) {
+		Usage(argv[0]);
+	}
+	const char *command = argv[1];
+	const char *path = argv[2];
+
+	if (strcmp(command, "build") == 0) {
+		FILE *in = stdin;
+		if ((argc > 3) && (strcmp(argv[3], "-") != 0)) {
+			in = fopen(argv[3], "r");
+			if (in == NULL) {
+				perror(argv[3]);
+				return 1;
+			}
+		}
+		return Build(path, in);
+	}
+
+	Sample_Archive_t archive;
+	if (!Sample_Archive_Open(&archive, path)) {
+		fprintf(stderr, "%s: not a sample archive\n", path);
+		return 1;
+	}
+	const Sample_Archive_Header_t *header = archive.header;
+
+	if (strcmp(command, "info") == 0) {
+		printf("version %u, %llu records in %llu blocks of %u, time %llu to %llu ms, %zu bytes\n",
+				header->version, (unsigned long long)header->recordCount, (unsigned long long)header->blockCount,
+				header->blockRecords, (unsigned long long)header->firstTimeMs, (unsigned long long)header->lastTimeMs, archive.size);
+		Sample_Archive_Close(&archive);
+		return 0;
+	}
+
+	if (argc != 5) {
+		Usage(argv[0]);
+	}
+	uint64_t fromMs = strtoull(argv[3], NULL, 0);
+	uint64_t toMs = strtoull(argv[4], NULL, 0);
+
+	double t0 = Now_Ns();
+	const Sample_Archive_Record_t *first;
+	uint64_t count = Sample_Archive_Range(&archive, fromMs, toMs, &first);
+	double t1 = Now_Ns();
+
+	if (strcmp(command, "query") == 0) {
+		printf("time_ms,c0,c1,gain,int_ms,flags\n");
+		for (uint64_t i = 0; i < count; i++) {
+			printf("%llu,%u,%u,%u,%u,0x%02X\n", (unsigned long long)first[i].timeMs, first[i].c0Data, first[i].c1Data,
+					first[i].alsGainData, first[i].alsIntData, first[i].flags);
+		}
+	}
+	else if (strcmp(command, "stats") == 0) {
+		uint16_t c0Min = UINT16_MAX, c0Max = 0, c1Min = UINT16_MAX, c1Max = 0;
+		uint64_t c0Sum = 0, c1Sum = 0;
+		for (uint64_t i = 0; i < count; i++) {
+			uint16_t c0 = first[i].c0Data, c1 = first[i].c1Data;
+			c0Min = (c0 < c0Min) ? c0 : c0Min;
+			c0Max = (c0 > c0Max) ? c0 : c0Max;
+			c1Min = (c1 < c1Min) ? c1 : c1Min;
+			c1Max = (c1 > c1Max) ? c1 : c1Max;
+			c0Sum += c0;
+			c1Sum += c1;
+		}
+		double t2 = Now_Ns();
+		printf("%llu records", (unsigned long long)count);
+		if (count != 0) {
+			printf(", c0 %u..%u mean %.1f, c1 %u..%u mean %.1f", c0Min, c0Max, (double)c0Sum / (double)count,
+					c1Min, c1Max, (double)c1Sum / (double)count);
+		}
+		printf("\nfind %.1f us, scan %.1f ms (%.0f Mrecords/s)\n", (t1 - t0) / 1e3, (t2 - t1) / 1e6,
+				(count != 0) ? (double)count * 1e3 / (t2 - t1) : 0.0);
+	}
+	else {
+		Usage(argv[0]);
+	}
+
+	Sample_Archive_Close(&archive);
+	return 0;
+}
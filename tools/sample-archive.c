@@ -0,0 +1,253 @@
+/**
+ * @file sample-archive.c
+ * @brief Implementation of the memory-mapped ground archive of LTR-329 samples.
+ * @author Kent Hong
+ *
+ * The writer streams records straight to the file and keeps only the time index
+ * in memory (8 bytes per 4096 records). The header is written last, so an
+ * archive whose writer did not finish has no magic and is refused by
+ * Sample_Archive_Open(). Every function returns 1 on success and 0 on failure.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "sample-archive.h"
+
+/** @brief Returns 1 on a little-endian host, the only byte order the mapping is read in */
+static int Host_Is_Little_Endian(void) {
+	return *(const uint8_t *)&(uint16_t){ 1 } == 1;
+}
+
+
+/*****************************************************************
+ * @brief Map an archive and check its header                   *
+ * @param archive: Pointer to the Sample_Archive_t struct       *
+ * @param path: Archive file                                    *
+ * @return 1 if the archive is mapped, 0 otherwise              *
+ ****************************************************************/
+int Sample_Archive_Open(Sample_Archive_t *archive, const char *path) {
+
+	struct stat st;
+	memset(archive, 0, sizeof(*archive));
+	if (!Host_Is_Little_Endian()) {
+		return 0;
+	}
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return 0;
+	}
+	if ((fstat(fd, &st) != 0) || ((size_t)st.st_size < SAMPLE_ARCHIVE_HEADER_SIZE)) {
+		close(fd);
+		return 0;
+	}
+	void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		return 0;
+	}
+
+	const Sample_Archive_Header_t *header = map;
+	uint64_t size = (uint64_t)st.st_size;
+	int valid = (memcmp(header->magic, SAMPLE_ARCHIVE_MAGIC, sizeof(header->magic)) == 0)
+			&& (header->version == SAMPLE_ARCHIVE_VERSION)
+			&& (header->headerSize == SAMPLE_ARCHIVE_HEADER_SIZE)
+			&& (header->recordSize == sizeof(Sample_Archive_Record_t))
+			&& (header->blockRecords != 0)
+			&& (header->blockCount == (header->recordCount + header->blockRecords - 1) / header->blockRecords)
+			&& (header->indexOffset % SAMPLE_ARCHIVE_ALIGN == 0)
+			&& (header->indexOffset >= header->headerSize + header->recordCount * header->recordSize)
+			&& (header->indexOffset <= size)
+			&& (header->blockCount <= (size - header->indexOffset) / sizeof(uint64_t));
+	if (!valid) {
+		munmap(map, (size_t)st.st_size);
+		return 0;
+	}
+
+	archive->map = map;
+	archive->size = (size_t)st.st_size;
+	archive->header = header;
+	archive->records = (const Sample_Archive_Record_t *)(archive->map + header->headerSize);
+	archive->index = (const uint64_t *)(archive->map + header->indexOffset);
+
+	/* The index is searched at random, the records are mostly streamed */
+	madvise((void *)archive->map, archive->size, MADV_SEQUENTIAL);
+	madvise((void *)(archive->map + header->indexOffset), archive->size - header->indexOffset, MADV_RANDOM);
+
+	return 1;
+}
+
+
+/** @brief Unmap an archive */
+void Sample_Archive_Close(Sample_Archive_t *archive) {
+	if (archive->map != NULL) {
+		munmap((void *)archive->map, archive->size);
+	}
+	memset(archive, 0, sizeof(*archive));
+}
+
+
+/*****************************************************************
+ * @brief Find the first record at or after a time              *
+ * @param archive: Pointer to the Sample_Archive_t struct       *
+ * @param timeMs: Time to look for                              *
+ * @return Record number, recordCount if every record is older  *
+ *                                                              *
+ * The first block starting at or after timeMs is found in the  *
+ * index, the answer then lies in the block before it or is the *
+ * first record of that block.                                  *
+ ****************************************************************/
+uint64_t Sample_Archive_Find(const Sample_Archive_t *archive, uint64_t timeMs) {
+
+	const Sample_Archive_Header_t *header = archive->header;
+	uint64_t lo = 0, hi = header->blockCount;
+	while (lo < hi) {
+		uint64_t mid = lo + (hi - lo) / 2;
+		if (archive->index[mid] < timeMs) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	if (lo == 0) {
+		return 0;
+	}
+
+	uint64_t first = (lo - 1) * header->blockRecords;
+	uint64_t last = lo * header->blockRecords;
+	last = (last < header->recordCount) ? last : header->recordCount;
+	while (first < last) {
+		uint64_t mid = first + (last - first) / 2;
+		if (archive->records[mid].timeMs < timeMs) {
+			first = mid + 1;
+		} else {
+			last = mid;
+		}
+	}
+
+	return first;
+}
+
+
+/*****************************************************************
+ * @brief Locate the records of a time range                    *
+ * @param archive: Pointer to the Sample_Archive_t struct       *
+ * @param fromMs: Start of the range, included                  *
+ * @param toMs: End of the range, excluded                      *
+ * @param first: Pointer to store the first record, it points   *
+ *               into the mapping and is valid until Close      *
+ * @return Number of records in the range                       *
+ ****************************************************************/
+uint64_t Sample_Archive_Range(const Sample_Archive_t *archive, uint64_t fromMs, uint64_t toMs, const Sample_Archive_Record_t **first) {
+
+	uint64_t begin = Sample_Archive_Find(archive, fromMs);
+	uint64_t end = (toMs > fromMs) ? Sample_Archive_Find(archive, toMs) : begin;
+
+	*first = &archive->records[begin];
+	return end - begin;
+}
+
+
+/*****************************************************************
+ * @brief Start writing an archive                              *
+ * @param writer: Pointer to the Sample_Archive_Writer_t struct *
+ * @param path: Archive file, truncated                         *
+ * @return 1 if the file is open, 0 otherwise                   *
+ ****************************************************************/
+int Sample_Archive_Create(Sample_Archive_Writer_t *writer, const char *path) {
+
+	static const uint8_t zeros[SAMPLE_ARCHIVE_HEADER_SIZE];
+	memset(writer, 0, sizeof(*writer));
+	if (!Host_Is_Little_Endian()) {
+		return 0;
+	}
+
+	writer->file = fopen(path, "wb");
+	if (writer->file == NULL) {
+		return 0;
+	}
+	setvbuf(writer->file, NULL, _IOFBF, 1 << 20);
+
+	Sample_Archive_Header_t *header = &writer->header;
+	memcpy(header->magic, SAMPLE_ARCHIVE_MAGIC, sizeof(header->magic));
+	header->version = SAMPLE_ARCHIVE_VERSION;
+	header->headerSize = SAMPLE_ARCHIVE_HEADER_SIZE;
+	header->recordSize = sizeof(Sample_Archive_Record_t);
+	header->blockRecords = SAMPLE_ARCHIVE_BLOCK_RECORDS;
+
+	/* Placeholder, the real header goes in once the index is written */
+	return fwrite(zeros, 1, sizeof(zeros), writer->file) == sizeof(zeros);
+}
+
+
+/*****************************************************************
+ * @brief Append one record                                     *
+ * @param writer: Pointer to the Sample_Archive_Writer_t struct *
+ * @param record: Record to append, not older than the last one *
+ * @return 1 if appended, 0 if out of order or on a write error *
+ ****************************************************************/
+int Sample_Archive_Append(Sample_Archive_Writer_t *writer, const Sample_Archive_Record_t *record) {
+
+	Sample_Archive_Header_t *header = &writer->header;
+	if ((header->recordCount != 0) && (record->timeMs < header->lastTimeMs)) {
+		return 0;
+	}
+
+	if (header->recordCount % header->blockRecords == 0) {
+		if (header->blockCount == writer->indexCapacity) {
+			uint64_t capacity = (writer->indexCapacity != 0) ? writer->indexCapacity * 2 : 1024;
+			uint64_t *index = realloc(writer->index, capacity * sizeof(*index));
+			if (index == NULL) {
+				return 0;
+			}
+			writer->index = index;
+			writer->indexCapacity = capacity;
+		}
+		writer->index[header->blockCount++] = record->timeMs;
+	}
+
+	if (fwrite(record, sizeof(*record), 1, writer->file) != 1) {
+		return 0;
+	}
+	if (header->recordCount == 0) {
+		header->firstTimeMs = record->timeMs;
+	}
+	header->lastTimeMs = record->timeMs;
+	header->recordCount++;
+
+	return 1;
+}
+
+
+/*****************************************************************
+ * @brief Write the index and header and close the file         *
+ * @param writer: Pointer to the Sample_Archive_Writer_t struct *
+ * @return 1 if the archive is complete, 0 on a write error     *
+ ****************************************************************/
+int Sample_Archive_Finish(Sample_Archive_Writer_t *writer) {
+
+	static const uint8_t zeros[SAMPLE_ARCHIVE_ALIGN];
+	Sample_Archive_Header_t *header = &writer->header;
+	uint64_t end = header->headerSize + header->recordCount * header->recordSize;
+	uint64_t pad = (SAMPLE_ARCHIVE_ALIGN - end % SAMPLE_ARCHIVE_ALIGN) % SAMPLE_ARCHIVE_ALIGN;
+	header->indexOffset = end + pad;
+
+	int ok = (fwrite(zeros, 1, (size_t)pad, writer->file) == pad)
+			&& (fwrite(writer->index, sizeof(*writer->index), (size_t)header->blockCount, writer->file) == header->blockCount)
+			&& (fflush(writer->file) == 0)
+			&& (fseek(writer->file, 0, SEEK_SET) == 0)
+			&& (fwrite(header, sizeof(*header), 1, writer->file) == 1);
+	ok = (fclose(writer->file) == 0) && ok;
+
+	free(writer->index);
+	writer->index = NULL;
+	writer->file = NULL;
+	return ok;
+}
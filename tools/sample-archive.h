@@ -0,0 +1,93 @@
+/**
+ * @file sample-archive.h
+ * @brief Header file for the memory-mapped ground archive of LTR-329 samples.
+ * @author Kent Hong
+ *
+ * This file contains the on-disk format and function prototypes for a sample
+ * archive that analysis tools mmap() and query by time range without loading
+ * or copying it. All fields are little-endian, the tools require a
+ * little-endian host.
+ *
+ * File layout, every section starts on a SAMPLE_ARCHIVE_ALIGN boundary:
+ *   Header        4096 bytes  Sample_Archive_Header_t
+ *   Records       16 bytes each, sorted by timeMs, in blocks of blockRecords
+ *   Time index    uint64 timeMs of the first record of every block
+ * The index is 1/4096 of the record data, so a query binary-searches the index
+ * (a few pages) and then one block, O(log n) with at most two block pages
+ * touched. A range comes back as a pointer and a count into the mapping.
+ *
+ * Build: see sample-archive-tool.c
+ */
+
+#ifndef SAMPLE_ARCHIVE_H_
+#define SAMPLE_ARCHIVE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define SAMPLE_ARCHIVE_MAGIC "LTR329AR"
+#define SAMPLE_ARCHIVE_VERSION 1
+#define SAMPLE_ARCHIVE_ALIGN 4096          // Section alignment, one page
+#define SAMPLE_ARCHIVE_HEADER_SIZE 4096
+#define SAMPLE_ARCHIVE_BLOCK_RECORDS 4096  // Records per index entry, 64 KiB blocks
+
+/** @brief One sample, the LTR329_t fields with an unwrapped timestamp */
+typedef struct {
+	uint64_t timeMs;      // Sample tick unwrapped past 2^32, non-decreasing through the file
+	uint16_t c0Data;      // Raw CH0 counts
+	uint16_t c1Data;      // Raw CH1 counts
+	uint16_t alsIntData;  // Integration time in ms
+	uint8_t alsGainData;  // Gain, 0 for a reserved gain code
+	uint8_t flags;        // LTR_329_FLAG_* quality flags
+} Sample_Archive_Record_t;
+
+_Static_assert(sizeof(Sample_Archive_Record_t) == 16, "records must stay 16 bytes");
+
+/** @brief File header, fixed size */
+typedef struct {
+	char magic[8];          // SAMPLE_ARCHIVE_MAGIC, not terminated
+	uint32_t version;       // SAMPLE_ARCHIVE_VERSION
+	uint32_t headerSize;    // SAMPLE_ARCHIVE_HEADER_SIZE, offset of the first record
+	uint32_t recordSize;    // sizeof(Sample_Archive_Record_t)
+	uint32_t blockRecords;  // Records per index entry
+	uint64_t recordCount;
+	uint64_t blockCount;    // Entries in the time index
+	uint64_t indexOffset;   // Offset of the time index
+	uint64_t firstTimeMs;   // Time of the first record, 0 if empty
+	uint64_t lastTimeMs;    // Time of the last record, 0 if empty
+	uint8_t reserved[SAMPLE_ARCHIVE_HEADER_SIZE - 64]; // Zero
+} Sample_Archive_Header_t;
+
+_Static_assert(sizeof(Sample_Archive_Header_t) == SAMPLE_ARCHIVE_HEADER_SIZE, "header must stay one page");
+
+/** @brief Open archive, read-only mapping */
+typedef struct {
+	const uint8_t *map;
+	size_t size;
+	const Sample_Archive_Header_t *header;
+	const Sample_Archive_Record_t *records; // header->recordCount records
+	const uint64_t *index;                  // header->blockCount entries
+} Sample_Archive_t;
+
+/** @brief Archive being written, records are appended in time order */
+typedef struct {
+	FILE *file;
+	Sample_Archive_Header_t header;
+	uint64_t *index;        // First time of every block, grown as blocks start
+	uint64_t indexCapacity;
+} Sample_Archive_Writer_t;
+
+
+/** @brief Function Prototypes for reading an archive */
+int Sample_Archive_Open(Sample_Archive_t *archive, const char *path);
+void Sample_Archive_Close(Sample_Archive_t *archive);
+uint64_t Sample_Archive_Find(const Sample_Archive_t *archive, uint64_t timeMs);
+uint64_t Sample_Archive_Range(const Sample_Archive_t *archive, uint64_t fromMs, uint64_t toMs, const Sample_Archive_Record_t **first);
+
+/** @brief Function Prototypes for writing an archive */
+int Sample_Archive_Create(Sample_Archive_Writer_t *writer, const char *path);
+int Sample_Archive_Append(Sample_Archive_Writer_t *writer, const Sample_Archive_Record_t *record);
+int Sample_Archive_Finish(Sample_Archive_Writer_t *writer);
+
+#endif /* SAMPLE_ARCHIVE_H_ */
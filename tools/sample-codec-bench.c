@@ -0,0 +1,172 @@
+/**
+ * @file sample-codec-bench.c
+ * @brief Host compression ratio, encode cost and round trip of the delta sample codec on orbit light curves.
+ * @author Kent Hong
+ *
+ * Generates a synthetic LEO light curve: 600 ms samples over 90 min orbits
+ * with 55 min of sunlight and 35 min of eclipse, a 60 s tumble modulating the
+ * sunlit counts, and count noise. The samples go through Sample_Encoder_Add()
+ * and, for reference, the raw 6-byte records of CCSDS_Encoder_Add(). Prints
+ * bytes per sample on the link for both, the best encode time per sample of
+ * several rounds, and decodes every delta packet back with CCSDS_Parse_Packet()
+ * and Sample_Decoder_Next(), comparing each sample field by field.
+ *
+ * With -w the delta packets are also written to a file for ccsds-decode.
+ *
+ * Build: cc -O2 -I.. -o sample-codec-bench sample-codec-bench.c ../Sample-Codec.c ../CCSDS-Packet.c -lm
+ * Usage: sample-codec-bench [-o orbits] [-r rounds] [-w packets.bin]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "Sample-Codec.h"
+
+#define PERIOD_MS 600
+#define ORBIT_S 5400.0   // 90 min orbit
+#define SUNLIT_S 3300.0  // 55 min of it in sunlight
+#define TUMBLE_S 60.0    // Attitude tumble period
+#define ORBITS_MAX 64
+#define SAMPLES_PER_ORBIT 9000 // ORBIT_S at PERIOD_MS
+
+static CCSDS_Sample_t samples[ORBITS_MAX * SAMPLES_PER_ORBIT];
+static uint8_t stream[sizeof(samples) / sizeof(samples[0]) * 8];
+static Sample_Encoder_t encoder;
+static CCSDS_Encoder_t rawEncoder;
+
+static double Now_Ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/** @brief Orbit light curve at gain 1, 100 ms: sunlight with a tumble, a few counts in eclipse */
+static void Make_Samples(uint32_t count) {
+	srand(1);
+	for (uint32_t i = 0; i < count; i++) {
+		double t = (double)i * PERIOD_MS / 1000.0;
+		uint8_t sunlit = fmod(t, ORBIT_S) < SUNLIT_S;
+		double attitude = 0.5 + 0.5 * sin(t * 6.283185307179586 / TUMBLE_S);
+		double c0 = sunlit ? 2000.0 + 18000.0 * attitude : 3.0;
+		double c1 = sunlit ? c0 * 0.35 : 1.0;
+		c0 += (double)(rand() % 41 - 20) * (sunlit ? 1.0 : 0.1);
+		c1 += (double)(rand() % 21 - 10) * (sunlit ? 1.0 : 0.1);
+		samples[i].tick = i * PERIOD_MS;
+		samples[i].c0Data = (uint16_t)((c0 < 0.0) ? 0.0 : c0);
+		samples[i].c1Data = (uint16_t)((c1 < 0.0) ? 0.0 : c1);
+		samples[i].configCode = 0x00;
+		samples[i].flags = 0;
+	}
+}
+
+/** @brief Delta-encode every sample into stream, returns the bytes written */
+static size_t Encode(uint32_t count) {
+	uint8_t packet[SAMPLE_CODEC_PACKET_MAX];
+	size_t length = 0;
+	Sample_Encoder_Init(&encoder, CCSDS_APID_LTR_329_DELTA, PERIOD_MS);
+	for (uint32_t i = 0; i < count; i++) {
+		uint16_t packetLength = Sample_Encoder_Add(&encoder, &samples[i], packet);
+		memcpy(&stream[length], packet, packetLength);
+		length += packetLength;
+	}
+	uint16_t packetLength = Sample_Encoder_Flush(&encoder, packet);
+	memcpy(&stream[length], packet, packetLength);
+	return length + packetLength;
+}
+
+/** @brief Parse and decode the stream, returns the samples matching the input, -1 on a malformed packet */
+static long Decode(size_t length, uint32_t count) {
+	uint32_t decoded = 0;
+	long matching = 0;
+	for (size_t pos = 0; pos < length; ) {
+		CCSDS_Header_t header;
+		int32_t packetLength = CCSDS_Parse_Packet(&stream[pos], (uint32_t)(length - pos), &header);
+		if (packetLength <= 0) {
+			return -1;
+		}
+		Sample_Decoder_t decoder;
+		CCSDS_Sample_t sample;
+		int8_t status;
+		Sample_Decoder_Init(&decoder, &header);
+		while ((status = Sample_Decoder_Next(&decoder, &sample)) == 1) {
+			const CCSDS_Sample_t *in = &samples[decoded++];
+			matching += (decoded <= count) && (sample.tick == in->tick) && (sample.c0Data == in->c0Data) && (sample.c1Data == in->c1Data)
+					&& (sample.configCode == in->configCode) && (sample.flags == in->flags);
+		}
+		if (status < 0) {
+			return -1;
+		}
+		pos += (size_t)packetLength;
+	}
+	return (decoded == count) ? matching : -1;
+}
+
+int main(int argc, char **argv) {
+
+	long orbits = 16, rounds = 10;
+	const char *outPath = NULL;
+	int opt;
+	while ((opt = getopt(argc, argv, "o:r:w:")) != -1) {
+		if (opt == 'o') {
+			orbits = strtol(optarg, NULL, 0);
+		}
+		else if (opt == 'r') {
+			rounds = strtol(optarg, NULL, 0);
+		}
+		else if (opt == 'w') {
+			outPath = optarg;
+		}
+		else {
+			fprintf(stderr, "usage: %s [-o orbits] [-r rounds] [-w packets.bin]\n", argv[0]);
+			return 2;
+		}
+	}
+	if ((orbits < 1) || (orbits > ORBITS_MAX)) {
+		fprintf(stderr, "orbits 1..%d\n", ORBITS_MAX);
+		return 2;
+	}
+
+	uint32_t count = (uint32_t)orbits * SAMPLES_PER_ORBIT;
+	Make_Samples(count);
+
+	/* Raw 6-byte records for reference */
+	uint8_t rawPacket[CCSDS_PACKET_MAX];
+	size_t rawLength = 0;
+	CCSDS_Encoder_Init(&rawEncoder, CCSDS_APID_LTR_329, PERIOD_MS);
+	for (uint32_t i = 0; i < count; i++) {
+		rawLength += CCSDS_Encoder_Add(&rawEncoder, &samples[i], rawPacket);
+	}
+	rawLength += CCSDS_Encoder_Flush(&rawEncoder, rawPacket);
+
+	/* Best of the rounds, the host is not quiet */
+	size_t length = 0;
+	double encodeNs = 1e30;
+	for (long r = 0; r < rounds; r++) {
+		double t0 = Now_Ns();
+		length = Encode(count);
+		double elapsed = Now_Ns() - t0;
+		encodeNs = (elapsed < encodeNs) ? elapsed : encodeNs;
+	}
+
+	long matching = Decode(length, count);
+	printf("%ld orbits, %u samples\n", orbits, count);
+	printf("delta  %8zu bytes  %5.2f B/sample\n", length, (double)length / count);
+	printf("raw    %8zu bytes  %5.2f B/sample\n", rawLength, (double)rawLength / count);
+	printf("ratio %.2fx, encode %.1f ns/sample\n", (double)rawLength / (double)length, encodeNs / count);
+	printf("round trip: %ld of %u samples exact\n", (matching < 0) ? 0 : matching, count);
+
+	if (outPath != NULL) {
+		FILE *out = fopen(outPath, "wb");
+		if ((out == NULL) || (fwrite(stream, 1, length, out) != length) || (fclose(out) != 0)) {
+			perror(outPath);
+			return 1;
+		}
+	}
+
+	return (matching == (long)count) ? 0 : 1;
+}
@@ -0,0 +1,212 @@
+/**
+ * @file sample-history-bench.c
+ * @brief Host throughput benchmark for the packed sample record and history.
+ * @author Kent Hong
+ *
+ * Fills a history with synthetic samples (mixed gains, a few invalid and
+ * saturated samples, and a long gap), checks that packing round-trips, then
+ * times per-sample pack and unpack, history push and unpack, and the batch
+ * statistics and lux kernels. The lux kernel is compared with the per-sample
+ * formula of LTR_329_Calculate_Lux() over an array of CCSDS_Sample_t.
+ *
+ * Build: cc -O2 -I.. -o sample-history-bench sample-history-bench.c ../Sample-History.c -lm
+ * Usage: sample-history-bench [-r rounds]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "Sample-History.h"
+
+#define PERIOD_MS 600
+
+static Sample_History_t hist;
+static CCSDS_Sample_t samples[SAMPLE_HISTORY_SIZE];
+static CCSDS_Sample_t unpacked[SAMPLE_HISTORY_SIZE];
+static Sample_Packed_t packed[SAMPLE_HISTORY_SIZE];
+static float luxSoA[SAMPLE_HISTORY_SIZE];
+static float luxAoS[SAMPLE_HISTORY_SIZE];
+static volatile uint32_t sink;
+
+static double Now_Ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/** @brief Per-sample formula of LTR_329_Calculate_Lux(), one struct at a time */
+static void Lux_AoS(const CCSDS_Sample_t *in, uint16_t count, float *lux) {
+	static const uint8_t gainByCode[8] = {1, 2, 4, 8, 0, 0, 48, 96};
+	static const uint16_t intTimeByCode[8] = {100, 50, 200, 400, 150, 250, 300, 350};
+	for (uint16_t i = 0; i < count; i++) {
+		uint8_t gain = gainByCode[(in[i].configCode >> 3) & 0x07];
+		uint16_t intTime = intTimeByCode[in[i].configCode & 0x07];
+		uint32_t sum = (uint32_t)in[i].c0Data + in[i].c1Data;
+		if ((in[i].flags & LTR_329_FLAGS_INVALID) || (gain == 0) || (sum == 0)) {
+			lux[i] = 0.0f;
+			continue;
+		}
+		float ratio = (float)in[i].c1Data / (float)sum;
+		if (ratio < 0.45f) {
+			lux[i] = (float)(1.7743 * in[i].c0Data + 1.1059 * in[i].c1Data) / gain / intTime;
+		}
+		else if (ratio < 0.64f) {
+			lux[i] = (float)(4.2785 * in[i].c0Data - 1.9548 * in[i].c1Data) / gain / intTime;
+		}
+		else if (ratio < 0.85f) {
+			lux[i] = (float)(0.5926 * in[i].c0Data + 0.1185 * in[i].c1Data) / gain / intTime;
+		}
+		else {
+			lux[i] = 0.0f;
+		}
+	}
+}
+
+/** @brief Synthetic samples on the period grid, one gap of 300 periods in the middle */
+static uint16_t Make_Samples(void) {
+	static const uint8_t codes[4] = {0x00, 0x08, 0x1B, 0x31};
+	uint32_t tick = 1000;
+	uint16_t n;
+	for (n = 0; n < SAMPLE_HISTORY_SIZE - 2; n++) {
+		CCSDS_Sample_t *s = &samples[n];
+		tick += (n == SAMPLE_HISTORY_SIZE / 2) ? 300 * PERIOD_MS : PERIOD_MS * (1 + (uint32_t)(rand() % 3));
+		s->tick = tick;
+		s->c0Data = (uint16_t)(rand() & 0xFFFF);
+		s->c1Data = (uint16_t)(s->c0Data * (rand() % 100) / 100);
+		s->configCode = codes[rand() % 4];
+		s->flags = ((rand() % 50) == 0) ? LTR_329_FLAG_I2C_ERROR : ((rand() % 50) == 0) ? LTR_329_FLAG_SATURATED : 0;
+	}
+	return n;
+}
+
+/** @brief Compare every field except padding, invalid flags compare as a class */
+static int Same_Sample(const CCSDS_Sample_t *a, const CCSDS_Sample_t *b) {
+	return (a->tick == b->tick) && (a->c0Data == b->c0Data) && (a->c1Data == b->c1Data) && (a->configCode == b->configCode)
+			&& (((a->flags & LTR_329_FLAGS_INVALID) != 0) == ((b->flags & LTR_329_FLAGS_INVALID) != 0))
+			&& ((a->flags & LTR_329_FLAGS_INVALID) || ((a->flags & LTR_329_FLAG_SATURATED) == (b->flags & LTR_329_FLAG_SATURATED)));
+}
+
+static void Report(const char *name, double ns, long rounds, uint16_t count) {
+	double perSample = ns / ((double)rounds * count);
+	printf("%-28s %7.2f ns/sample %8.1f Msample/s\n", name, perSample, 1e3 / perSample);
+}
+
+int main(int argc, char **argv) {
+
+	long rounds = 20000;
+	int opt;
+	while ((opt = getopt(argc, argv, "r:")) != -1) {
+		if (opt == 'r') {
+			rounds = strtol(optarg, NULL, 0);
+		}
+		else {
+			fprintf(stderr, "usage: %s [-r rounds]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	srand(1);
+	uint16_t count = Make_Samples();
+
+	/* Round trips */
+	Sample_History_Init(&hist, PERIOD_MS);
+	for (uint16_t i = 0; i < count; i++) {
+		if (!Sample_History_Push(&hist, &samples[i])) {
+			fprintf(stderr, "history full at %u\n", i);
+			return 1;
+		}
+	}
+	if ((Sample_History_Unpack(&hist, unpacked) != count) || (hist.lastTick != samples[count - 1].tick)) {
+		fprintf(stderr, "history unpack count or last tick mismatch\n");
+		return 1;
+	}
+	for (uint16_t i = 0; i < count; i++) {
+		if (!Same_Sample(&samples[i], &unpacked[i])) {
+			fprintf(stderr, "history round trip mismatch at %u\n", i);
+			return 1;
+		}
+	}
+	Lux_AoS(samples, count, luxAoS);
+	Sample_History_Lux(&hist, luxSoA);
+	float worst = 0.0f;
+	for (uint16_t i = 0, j = 0; i < hist.count; i++) {
+		if (hist.mode[i] == SAMPLE_PACK_GAP) {
+			continue;
+		}
+		float err = fabsf(luxSoA[i] - luxAoS[j]) / fmaxf(luxAoS[j], 1e-3f);
+		worst = (err > worst) ? err : worst;
+		j++;
+	}
+	printf("%u samples in %u entries, %zu B packed vs %zu B as CCSDS_Sample_t, worst lux deviation %.2g\n",
+			count, hist.count, (size_t)hist.count * sizeof(Sample_Packed_t), (size_t)count * sizeof(CCSDS_Sample_t), (double)worst);
+
+	/* Per-sample pack and unpack, the gap sample is packed from the grid tick before it */
+	double t0 = Now_Ns();
+	for (long r = 0; r < rounds; r++) {
+		uint32_t prev = samples[0].tick;
+		for (uint16_t i = 0; i < count; i++) {
+			if (!Sample_Pack(&samples[i], prev, PERIOD_MS, &packed[i])) {
+				packed[i].dt = 0;
+			}
+			prev = samples[i].tick;
+		}
+		sink += packed[r % count].c0Data;
+	}
+	Report("Sample_Pack", Now_Ns() - t0, rounds, count);
+
+	t0 = Now_Ns();
+	for (long r = 0; r < rounds; r++) {
+		uint32_t prev = samples[0].tick;
+		for (uint16_t i = 0; i < count; i++) {
+			Sample_Unpack(&packed[i], prev, PERIOD_MS, &unpacked[i]);
+			prev = unpacked[i].tick;
+		}
+		sink += unpacked[r % count].c1Data;
+	}
+	Report("Sample_Unpack", Now_Ns() - t0, rounds, count);
+
+	t0 = Now_Ns();
+	for (long r = 0; r < rounds; r++) {
+		Sample_History_Init(&hist, PERIOD_MS);
+		for (uint16_t i = 0; i < count; i++) {
+			Sample_History_Push(&hist, &samples[i]);
+		}
+		sink += hist.count;
+	}
+	Report("Sample_History_Push", Now_Ns() - t0, rounds, count);
+
+	t0 = Now_Ns();
+	for (long r = 0; r < rounds; r++) {
+		sink += Sample_History_Unpack(&hist, unpacked);
+	}
+	Report("Sample_History_Unpack", Now_Ns() - t0, rounds, count);
+
+	Sample_History_Stats_t stats;
+	t0 = Now_Ns();
+	for (long r = 0; r < rounds; r++) {
+		Sample_History_Stats(&hist, &stats);
+		sink += stats.c0Sum;
+	}
+	Report("Sample_History_Stats", Now_Ns() - t0, rounds, count);
+
+	t0 = Now_Ns();
+	for (long r = 0; r < rounds; r++) {
+		Sample_History_Lux(&hist, luxSoA);
+		sink += (uint32_t)luxSoA[r % count];
+	}
+	Report("Sample_History_Lux (SoA)", Now_Ns() - t0, rounds, count);
+
+	t0 = Now_Ns();
+	for (long r = 0; r < rounds; r++) {
+		Lux_AoS(samples, count, luxAoS);
+		sink += (uint32_t)luxAoS[r % count];
+	}
+	Report("Per-sample lux (AoS)", Now_Ns() - t0, rounds, count);
+
+	return 0;
+}
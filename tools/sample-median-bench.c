@@ -0,0 +1,165 @@
+/**
+ * @file sample-median-bench.c
+ * @brief Host per-sample cost of the sliding-window median filter against a sort per sample.
+ * @author Kent Hong
+ *
+ * Runs synthetic samples (a slow light curve with noise, single-sample spikes
+ * and the odd invalid sample) through Sample_Median_Add() for windows of 5 to
+ * 255, checks every filtered sample against the median of a sorted copy of the
+ * window, and prints the best per-sample time of several rounds for both. Build
+ * with SAMPLE_MEDIAN_WINDOW_MAX 255 to cover every window.
+ *
+ * Build: cc -O2 -DSAMPLE_MEDIAN_WINDOW_MAX=255 -I.. -o sample-median-bench sample-median-bench.c ../Sample-Median.c -lm
+ * Usage: sample-median-bench [-r rounds]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "Sample-Median.h"
+
+#define SAMPLE_COUNT 20000
+#define PERIOD_MS 600
+#define ORBIT_SAMPLES 9000 // About 90 min at PERIOD_MS
+
+static CCSDS_Sample_t samples[SAMPLE_COUNT];
+static CCSDS_Sample_t filtered[SAMPLE_COUNT];
+static CCSDS_Sample_t sorted[SAMPLE_COUNT];
+static Sample_Median_t median;
+static volatile uint32_t sink;
+
+static double Now_Ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/** @brief A light curve of a few orbits at one config, noise, spikes on 1 sample in 50, invalid 1 in 200 */
+static void Make_Samples(void) {
+	for (uint32_t i = 0; i < SAMPLE_COUNT; i++) {
+		CCSDS_Sample_t *s = &samples[i];
+		double light = 20000.0 * (1.0 + sin((double)i * 6.283185307179586 / ORBIT_SAMPLES));
+		double c0 = light + (double)(rand() % 201 - 100);
+		s->tick = 1000 + i * PERIOD_MS;
+		s->c0Data = (uint16_t)c0;
+		s->c1Data = (uint16_t)(c0 * 0.3 + (double)(rand() % 41 - 20));
+		s->configCode = 0x08;
+		s->flags = ((rand() % 200) == 0) ? LTR_329_FLAG_I2C_ERROR : 0;
+		if ((rand() % 50) == 0) {
+			s->c0Data = 65535;
+			s->c1Data = (uint16_t)(rand() & 0xFFFF);
+		}
+	}
+}
+
+/** @brief Insertion sort of the window copy, fast for the near-sorted copies of a slow light curve */
+static void Sort_Counts(uint16_t *counts, uint16_t n) {
+	for (uint16_t i = 1; i < n; i++) {
+		uint16_t value = counts[i];
+		uint16_t j = i;
+		while ((j > 0) && (counts[j - 1] > value)) {
+			counts[j] = counts[j - 1];
+			j--;
+		}
+		counts[j] = value;
+	}
+}
+
+/** @brief Reference: copy the ring of the last window valid counts and sort it for every sample */
+static void Sort_Filter(uint16_t window) {
+	static uint16_t ring[2][SAMPLE_MEDIAN_WINDOW_MAX];
+	static uint16_t copy[SAMPLE_MEDIAN_WINDOW_MAX];
+	uint16_t filled = 0, head = 0;
+	for (uint32_t i = 0; i < SAMPLE_COUNT; i++) {
+		sorted[i] = samples[i];
+		if (samples[i].flags & LTR_329_FLAGS_INVALID) {
+			continue;
+		}
+		ring[0][head] = samples[i].c0Data;
+		ring[1][head] = samples[i].c1Data;
+		head = (head + 1U == window) ? 0 : head + 1U;
+		filled += (filled < window);
+		for (uint8_t c = 0; c < 2; c++) {
+			memcpy(copy, ring[c], filled * sizeof(copy[0]));
+			Sort_Counts(copy, filled);
+			uint16_t middle = (filled & 1U) ? copy[filled / 2U] : (uint16_t)(((uint32_t)copy[filled / 2U - 1U] + copy[filled / 2U] + 1U) / 2U);
+			if (c == 0) {
+				sorted[i].c0Data = middle;
+			}
+			else {
+				sorted[i].c1Data = middle;
+			}
+		}
+	}
+}
+
+static void Heap_Filter(uint16_t window) {
+	Sample_Median_Init(&median, window);
+	for (uint32_t i = 0; i < SAMPLE_COUNT; i++) {
+		Sample_Median_Add(&median, &samples[i], &filtered[i]);
+	}
+}
+
+int main(int argc, char **argv) {
+
+	static const uint16_t windows[] = {5, 9, 15, 31, 63, 127, 255};
+	long rounds = 20;
+	int opt;
+	while ((opt = getopt(argc, argv, "r:")) != -1) {
+		if (opt == 'r') {
+			rounds = strtol(optarg, NULL, 0);
+		}
+		else {
+			fprintf(stderr, "usage: %s [-r rounds]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	srand(1);
+	Make_Samples();
+	printf("%u samples, Sample_Median_t is %zu B for windows up to %u\n", SAMPLE_COUNT, sizeof(Sample_Median_t), SAMPLE_MEDIAN_WINDOW_MAX);
+	printf("window   heap ns/sample   sort ns/sample   speedup   spikes left\n");
+
+	for (size_t w = 0; w < sizeof(windows) / sizeof(windows[0]); w++) {
+		uint16_t window = windows[w];
+		if (window > SAMPLE_MEDIAN_WINDOW_MAX) {
+			break;
+		}
+
+		Heap_Filter(window);
+		Sort_Filter(window);
+		uint32_t spikes = 0;
+		for (uint32_t i = 0; i < SAMPLE_COUNT; i++) {
+			if ((filtered[i].c0Data != sorted[i].c0Data) || (filtered[i].c1Data != sorted[i].c1Data)
+					|| (filtered[i].tick != samples[i].tick) || (filtered[i].flags != samples[i].flags)) {
+				fprintf(stderr, "window %u: sample %u differs from the sorted median\n", window, i);
+				return 1;
+			}
+			spikes += (filtered[i].c0Data == 65535);
+		}
+
+		/* Best of the rounds, the host is not quiet */
+		double heapNs = 1e30, sortNs = 1e30;
+		for (long r = 0; r < rounds; r++) {
+			double t0 = Now_Ns();
+			Heap_Filter(window);
+			double elapsed = Now_Ns() - t0;
+			heapNs = (elapsed < heapNs) ? elapsed : heapNs;
+			sink += filtered[r % SAMPLE_COUNT].c0Data;
+
+			t0 = Now_Ns();
+			Sort_Filter(window);
+			elapsed = Now_Ns() - t0;
+			sortNs = (elapsed < sortNs) ? elapsed : sortNs;
+			sink += sorted[r % SAMPLE_COUNT].c0Data;
+		}
+		printf("%6u   %14.1f   %14.1f   %6.1fx   %11u\n", window, heapNs / SAMPLE_COUNT, sortNs / SAMPLE_COUNT, sortNs / heapNs, spikes);
+	}
+
+	return 0;
+}
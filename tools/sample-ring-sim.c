@@ -0,0 +1,240 @@
+/**
+ * @file sample-ring-sim.c
+ * @brief Host simulation of the store-and-forward sample ring with the burst drain of main.c.
+ * @author Kent Hong
+ *
+ * Mode checks: a full ring in SAMPLE_RING_OVERWRITE mode must keep the newest
+ * SAMPLE_RING_SIZE samples and one in SAMPLE_RING_STOP mode the oldest, both
+ * counting every lost sample.
+ *
+ * Burst simulation: the main loop of main.c with STORE_AND_FORWARD and the
+ * delta format. Every loop pushes one sample; while a drain is due it pops into
+ * Sample_Encoder_Add() until one packet comes out, and flushes the partial
+ * packet once the ring is empty. Part way through, a ground pass ("set pass 1"
+ * for pass_samples loops) forces the drain: the ring must empty during the pass,
+ * and the samples taken after that go out in whole packets, not one by one.
+ * The packets are decoded back with CCSDS_Parse_Packet() and
+ * Sample_Decoder_Next(); every sample must come back once, in order and
+ * unchanged, with none dropped by the ring.
+ *
+ * Timing: best of several rounds of push and pop on a half-full ring, in ns
+ * per operation. With -w the burst packets are written for ccsds-decode.
+ *
+ * Build: cc -O2 -I.. -o sample-ring-sim sample-ring-sim.c ../Sample-Ring.c ../Sample-Codec.c ../CCSDS-Packet.c
+ * Usage: sample-ring-sim [-n samples] [-H high_watermark] [-L low_watermark] [-p pass_samples] [-w packets.bin]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "Sample-Ring.h"
+#include "Sample-Codec.h"
+
+#define PERIOD_MS 600
+#define SAMPLES_MAX 1000000
+#define TIMING_OPS 10000000U
+
+static Sample_Ring_t ring;
+static Sample_Encoder_t encoder;
+static uint8_t stream[SAMPLES_MAX * 8];
+static volatile uint32_t sink;
+static int failures;
+
+static double Now_Ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void Check(int ok, const char *what) {
+	printf("%-4s %s\n", ok ? "ok" : "FAIL", what);
+	failures += !ok;
+}
+
+static void Make_Sample(uint32_t n, CCSDS_Sample_t *sample) {
+	sample->tick = n * PERIOD_MS;
+	sample->c0Data = (uint16_t)(1000U + n % 50U);
+	sample->c1Data = (uint16_t)(400U + n % 7U);
+	sample->configCode = 0x00;
+	sample->flags = 0;
+}
+
+/** @brief Fill a ring past full, returns 1 if the first sample popped has tick firstTick and the losses were counted */
+static uint8_t Check_Full(Sample_Ring_Mode_t mode, uint32_t firstTick) {
+	CCSDS_Sample_t sample;
+	Sample_Ring_Init(&ring, mode, 0, 0);
+	for (uint32_t n = 0; n < 2U * SAMPLE_RING_SIZE; n++) {
+		Make_Sample(n, &sample);
+		Sample_Ring_Push(&ring, &sample);
+	}
+	uint16_t count = Sample_Ring_Count(&ring);
+	return (count == SAMPLE_RING_SIZE) && (ring.dropped == SAMPLE_RING_SIZE) && Sample_Ring_Pop(&ring, &sample) && (sample.tick == firstTick);
+}
+
+/** @brief Counts of one simulated run */
+typedef struct {
+	uint32_t bursts;       // Drains started by the high watermark
+	uint32_t packets;      // Packets sent by the loop
+	uint32_t passPackets;  // Packets sent during the ground pass
+	uint32_t passDrainMs;  // Time from the start of the pass until the ring was empty, 0 if it never was
+} Run_Counts_t;
+
+/** @brief The main loop for count samples with a ground pass from passStart, returns the bytes of packets written to stream */
+static size_t Run(uint32_t count, uint16_t high, uint16_t low, uint32_t passStart, uint32_t passSamples, Run_Counts_t *counts) {
+	size_t length = 0;
+	uint8_t wasDue = 0;
+	memset(counts, 0, sizeof(*counts));
+	Sample_Ring_Init(&ring, SAMPLE_RING_OVERWRITE, high, low);
+	Sample_Encoder_Init(&encoder, CCSDS_APID_LTR_329_DELTA, PERIOD_MS);
+	for (uint32_t n = 0; n < count; n++) {
+		CCSDS_Sample_t sample;
+		Make_Sample(n, &sample);
+		Sample_Ring_Push(&ring, &sample);
+
+		/* "set pass 1" and "set pass 0" from the console */
+		if ((n == passStart) || (n == passStart + passSamples)) {
+			Sample_Ring_Force_Drain(&ring, n == passStart);
+		}
+
+		/* As main.c: at most one packet per loop, the last partial packet of a burst flushed, none during a pass */
+		uint8_t due = Sample_Ring_Drain_Due(&ring);
+		counts->bursts += due && !wasDue && !ring.forced;
+		wasDue = due;
+		if (due) {
+			uint16_t packetLength = 0;
+			while ((packetLength == 0) && Sample_Ring_Pop(&ring, &sample)) {
+				packetLength = Sample_Encoder_Add(&encoder, &sample, &stream[length]);
+			}
+			if ((packetLength == 0) && (Sample_Ring_Count(&ring) == 0) && !ring.forced) {
+				packetLength = Sample_Encoder_Flush(&encoder, &stream[length]);
+			}
+			length += packetLength;
+			counts->packets += (packetLength != 0);
+			counts->passPackets += (packetLength != 0) && ring.forced;
+		}
+		if (ring.forced && (Sample_Ring_Count(&ring) == 0) && (counts->passDrainMs == 0)) {
+			counts->passDrainMs = (n - passStart + 1U) * PERIOD_MS;
+		}
+	}
+
+	/* What is still held goes out with the next pass, here all at once */
+	Sample_Ring_Force_Drain(&ring, 1);
+	CCSDS_Sample_t sample;
+	while (Sample_Ring_Drain_Due(&ring) && Sample_Ring_Pop(&ring, &sample)) {
+		length += Sample_Encoder_Add(&encoder, &sample, &stream[length]);
+	}
+	length += Sample_Encoder_Flush(&encoder, &stream[length]);
+	Sample_Ring_Force_Drain(&ring, 0);
+	return length;
+}
+
+/** @brief Decode the stream, returns the samples recovered in order and unchanged, -1 on a malformed packet */
+static long Decode(size_t length, uint32_t count) {
+	long recovered = 0;
+	uint32_t n = 0;
+	for (size_t pos = 0; pos < length; ) {
+		CCSDS_Header_t header;
+		int32_t packetLength = CCSDS_Parse_Packet(&stream[pos], (uint32_t)(length - pos), &header);
+		if (packetLength <= 0) {
+			return -1;
+		}
+		Sample_Decoder_t decoder;
+		CCSDS_Sample_t sample, expected;
+		int8_t status;
+		Sample_Decoder_Init(&decoder, &header);
+		while ((status = Sample_Decoder_Next(&decoder, &sample)) == 1) {
+			Make_Sample(n++, &expected);
+			recovered += (sample.tick == expected.tick) && (sample.c0Data == expected.c0Data) && (sample.c1Data == expected.c1Data)
+					&& (sample.configCode == expected.configCode) && (sample.flags == expected.flags);
+		}
+		if (status < 0) {
+			return -1;
+		}
+		pos += (size_t)packetLength;
+	}
+	return (n == count) ? recovered : -1;
+}
+
+int main(int argc, char **argv) {
+
+	long count = 20000, high = 768, low = 0, passSamples = 500;
+	const char *outPath = NULL;
+	int opt;
+	while ((opt = getopt(argc, argv, "n:H:L:p:w:")) != -1) {
+		if (opt == 'n') {
+			count = strtol(optarg, NULL, 0);
+		}
+		else if (opt == 'H') {
+			high = strtol(optarg, NULL, 0);
+		}
+		else if (opt == 'L') {
+			low = strtol(optarg, NULL, 0);
+		}
+		else if (opt == 'p') {
+			passSamples = strtol(optarg, NULL, 0);
+		}
+		else if (opt == 'w') {
+			outPath = optarg;
+		}
+		else {
+			fprintf(stderr, "usage: %s [-n samples] [-H high_watermark] [-L low_watermark] [-p pass_samples] [-w packets.bin]\n", argv[0]);
+			return 2;
+		}
+	}
+	if ((count < 1) || (count > SAMPLES_MAX) || (high < 1) || (high > SAMPLE_RING_SIZE) || (low < 0) || (low >= high)
+			|| (passSamples < 1) || (passSamples > count / 2)) {
+		fprintf(stderr, "1..%d samples, 0 <= low < high <= %d, a pass of 1 to half the samples\n", SAMPLES_MAX, SAMPLE_RING_SIZE);
+		return 2;
+	}
+
+	Check(Check_Full(SAMPLE_RING_OVERWRITE, SAMPLE_RING_SIZE * PERIOD_MS), "overwrite mode keeps the newest samples");
+	Check(Check_Full(SAMPLE_RING_STOP, 0), "stop mode keeps the oldest samples");
+
+	/* The pass starts half way, wherever the ring is between two bursts */
+	Run_Counts_t counts;
+	uint32_t passStart = (uint32_t)(count / 2);
+	size_t length = Run((uint32_t)count, (uint16_t)high, (uint16_t)low, passStart, (uint32_t)passSamples, &counts);
+	long recovered = Decode(length, (uint32_t)count);
+	printf("%ld samples, watermarks %ld/%ld: %u bursts, %u packets, peak %u, %u dropped\n", count, high, low, counts.bursts, counts.packets, ring.peak,
+			ring.dropped);
+	printf("ground pass of %ld samples: ring empty after %u ms, %u packets\n", passSamples, counts.passDrainMs, counts.passPackets);
+	Check(ring.dropped == 0, "no samples dropped by the ring");
+	Check(counts.passDrainMs != 0, "a ground pass empties the ring");
+	Check(counts.passPackets <= (uint32_t)(passSamples + high) / 32U + 1U, "a ground pass sends whole packets, not one per sample");
+	Check(recovered == count, "every sample recovered once, in order and unchanged");
+
+	/* Push and pop on a half-full ring, best of the rounds as the host is not quiet */
+	double bestNs = 1e30;
+	for (int r = 0; r < 5; r++) {
+		CCSDS_Sample_t sample;
+		Make_Sample(0, &sample);
+		Sample_Ring_Init(&ring, SAMPLE_RING_OVERWRITE, 0, 0);
+		for (uint32_t n = 0; n < SAMPLE_RING_SIZE / 2U; n++) {
+			Sample_Ring_Push(&ring, &sample);
+		}
+		double t0 = Now_Ns();
+		for (uint32_t n = 0; n < TIMING_OPS / 2U; n++) {
+			sample.tick = n;
+			Sample_Ring_Push(&ring, &sample);
+			sink += Sample_Ring_Pop(&ring, &sample);
+		}
+		double elapsed = Now_Ns() - t0;
+		bestNs = (elapsed < bestNs) ? elapsed : bestNs;
+	}
+	printf("push and pop %.1f ns each\n", bestNs / TIMING_OPS);
+
+	if (outPath != NULL) {
+		FILE *out = fopen(outPath, "wb");
+		if ((out == NULL) || (fwrite(stream, 1, length, out) != length) || (fclose(out) != 0)) {
+			perror(outPath);
+			return 1;
+		}
+	}
+
+	printf("%d failures\n", failures);
+	return (failures == 0) ? 0 : 1;
+}